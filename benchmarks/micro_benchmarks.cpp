@@ -0,0 +1,512 @@
+#include "synthetic_feed.h"
+#include "../cpp_parser/include/parser.h"
+#include "../cpp_parser/include/json_serializer.h"
+#include "../cpp_parser/include/json_writer.h"
+#include "../cpp_parser/include/compact_message.h"
+#include "../cpp_order_book/order_book.h"
+#include "../cpp_order_book/ring_queue.h"
+#include "../cpp_order_book/trading_strategy.h"
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Microbenchmarks for the hot paths of the parser, book, queues and strategy.
+// All input comes from synthetic_feed.h, so runs are reproducible anywhere.
+
+namespace {
+
+constexpr uint64_t SESSION_START = 34200ull * 1000000000ull;
+constexpr uint32_t MID_PRICE = 1000000;  // $100.00
+constexpr uint32_t TICK = 100;
+constexpr uint16_t LOCATE = 1;
+
+std::unique_ptr<itch::Parser> stream_parser(const std::string& bytes) {
+    return std::make_unique<itch::Parser>(std::make_unique<std::istringstream>(bytes));
+}
+
+// Every message of a synthetic feed, parsed once up front
+const std::vector<itch::Message>& feed_messages() {
+    static const std::vector<itch::Message> messages = [] {
+        std::vector<itch::Message> parsed;
+        auto parser = stream_parser(itch::generate_feed(100000));
+        while (auto message = parser->parse_message()) {
+            parsed.push_back(std::move(*message));
+        }
+        return parsed;
+    }();
+    return messages;
+}
+
+// --- Parser ---------------------------------------------------------------
+
+// One message type over and over; the parser is rewound when it runs out
+void BM_ParseMessage(benchmark::State& state, char type) {
+    constexpr size_t BATCH = 4096;
+    std::string bytes;
+    itch::ItchEncoder encoder(bytes);
+    for (size_t i = 0; i < BATCH; ++i) {
+        encoder.sample(type, LOCATE, SESSION_START + i);
+    }
+
+    auto parser = stream_parser(bytes);
+    size_t parsed = 0;
+    for (auto _ : state) {
+        if (parsed == BATCH) {
+            parser->reset();
+            parsed = 0;
+        }
+        auto message = parser->parse_message();
+        benchmark::DoNotOptimize(message);
+        ++parsed;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes.size() / BATCH));
+}
+
+BENCHMARK_CAPTURE(BM_ParseMessage, SystemEvent, 'S');
+BENCHMARK_CAPTURE(BM_ParseMessage, StockDirectory, 'R');
+BENCHMARK_CAPTURE(BM_ParseMessage, TradingAction, 'H');
+BENCHMARK_CAPTURE(BM_ParseMessage, RegShoRestriction, 'Y');
+BENCHMARK_CAPTURE(BM_ParseMessage, ParticipantPosition, 'L');
+BENCHMARK_CAPTURE(BM_ParseMessage, MwcbDeclineLevel, 'V');
+BENCHMARK_CAPTURE(BM_ParseMessage, MwcbBreach, 'W');
+BENCHMARK_CAPTURE(BM_ParseMessage, IpoQuotingPeriod, 'K');
+BENCHMARK_CAPTURE(BM_ParseMessage, LULDAuctionCollar, 'J');
+BENCHMARK_CAPTURE(BM_ParseMessage, AddOrder, 'A');
+BENCHMARK_CAPTURE(BM_ParseMessage, AddOrderMpid, 'F');
+BENCHMARK_CAPTURE(BM_ParseMessage, OrderExecuted, 'E');
+BENCHMARK_CAPTURE(BM_ParseMessage, OrderExecutedWithPrice, 'C');
+BENCHMARK_CAPTURE(BM_ParseMessage, OrderCancelled, 'X');
+BENCHMARK_CAPTURE(BM_ParseMessage, DeleteOrder, 'D');
+BENCHMARK_CAPTURE(BM_ParseMessage, ReplaceOrder, 'U');
+BENCHMARK_CAPTURE(BM_ParseMessage, NonCrossTrade, 'P');
+BENCHMARK_CAPTURE(BM_ParseMessage, CrossTrade, 'Q');
+BENCHMARK_CAPTURE(BM_ParseMessage, BrokenTrade, 'B');
+BENCHMARK_CAPTURE(BM_ParseMessage, Imbalance, 'I');
+BENCHMARK_CAPTURE(BM_ParseMessage, RetailPriceImprovement, 'N');
+
+// The synthetic order flow, i.e. the real mix of message types
+void BM_ParseFeed(benchmark::State& state) {
+    const std::string bytes = itch::generate_feed(100000);
+    auto parser = stream_parser(bytes);
+    for (auto _ : state) {
+        auto message = parser->parse_message();
+        if (!message) {
+            parser->reset();
+            message = parser->parse_message();
+        }
+        benchmark::DoNotOptimize(message);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_ParseFeed);
+
+// Buffering the synthetic feed as a decode chunk: a std::vector<Message>
+// against a CompactChunk. bytes_per_message is the storage each one holds.
+void BM_BufferMessages(benchmark::State& state) {
+    const auto& messages = feed_messages();
+    size_t bytes = 0;
+    for (auto _ : state) {
+        std::vector<itch::Message> chunk;
+        chunk.reserve(messages.size());
+        for (const auto& message : messages) {
+            chunk.push_back(message);
+        }
+        bytes = chunk.capacity() * sizeof(itch::Message);
+        benchmark::DoNotOptimize(chunk.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * messages.size()));
+    state.counters["bytes_per_message"] = static_cast<double>(bytes) / messages.size();
+}
+
+BENCHMARK(BM_BufferMessages);
+
+void BM_BufferCompact(benchmark::State& state) {
+    const auto& messages = feed_messages();
+    size_t bytes = 0;
+    for (auto _ : state) {
+        itch::CompactChunk chunk;
+        chunk.reserve(messages.size());
+        for (const auto& message : messages) {
+            itch::Message copy = message;
+            chunk.push_back(std::move(copy));
+        }
+        bytes = chunk.bytes();
+        benchmark::DoNotOptimize(&chunk[0]);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * messages.size()));
+    state.counters["bytes_per_message"] = static_cast<double>(bytes) / messages.size();
+}
+
+BENCHMARK(BM_BufferCompact);
+
+// --- OrderBook ------------------------------------------------------------
+
+itch::Message add_message(uint64_t reference, itch::Side side, uint32_t shares, uint32_t price) {
+    itch::ArrayString8 stock;
+    stock.fill(' ');
+    stock[0] = 'B';
+    stock[1] = 'N';
+    stock[2] = 'C';
+    stock[3] = 'H';
+    return itch::Message{'A', LOCATE, 0, SESSION_START,
+                         itch::AddOrder{reference, side, shares, stock, itch::Price4(price), std::nullopt}};
+}
+
+itch::Message delete_message(uint64_t reference) {
+    return itch::Message{'D', LOCATE, 0, SESSION_START, itch::DeleteOrder{reference}};
+}
+
+// Price of level `level` (0 = best) on one side
+uint32_t level_price(itch::Side side, size_t level) {
+    const uint32_t offset = static_cast<uint32_t>(level + 1) * TICK;
+    return side == itch::Side::Buy ? MID_PRICE - offset : MID_PRICE + offset;
+}
+
+// One symbol with state.range(0) price levels a side and ORDERS_PER_LEVEL
+// orders on each, in the engine picked by state.range(1). Orders hold
+// enough shares that execute/cancel benchmarks never empty them.
+class BookFixture {
+public:
+    static constexpr size_t ORDERS_PER_LEVEL = 4;
+    static constexpr uint32_t RESTING_SHARES = 1u << 30;
+
+    explicit BookFixture(const benchmark::State& state)
+        : depth(static_cast<size_t>(state.range(0))),
+          book(state.range(1) ? hft::BookEngine::Ladder : hft::BookEngine::Map) {
+        for (size_t level = 0; level < depth; ++level) {
+            for (size_t i = 0; i < ORDERS_PER_LEVEL; ++i) {
+                for (itch::Side side : {itch::Side::Buy, itch::Side::Sell}) {
+                    references.push_back(next_reference);
+                    book.apply(add_message(next_reference++, side, RESTING_SHARES, level_price(side, level)));
+                }
+            }
+        }
+    }
+
+    const size_t depth;
+    hft::OrderBook book;
+    std::vector<uint64_t> references;  // Resting orders, buy and sell interleaved
+    uint64_t next_reference = 1;
+};
+
+void book_args(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgsProduct({{1, 10, 100, 1000}, {0, 1}})->ArgNames({"depth", "ladder"});
+}
+
+// Adds spread over the existing levels; they are deleted again, untimed, every BATCH adds
+void BM_BookAdd(benchmark::State& state) {
+    constexpr size_t BATCH = 1024;
+    BookFixture fixture(state);
+    std::vector<itch::Message> adds;
+    std::vector<itch::Message> deletes;
+    for (size_t i = 0; i < BATCH; ++i) {
+        const itch::Side side = i % 2 == 0 ? itch::Side::Buy : itch::Side::Sell;
+        const uint64_t reference = fixture.next_reference++;
+        adds.push_back(add_message(reference, side, 100, level_price(side, (i / 2) % fixture.depth)));
+        deletes.push_back(delete_message(reference));
+    }
+
+    size_t next = 0;
+    for (auto _ : state) {
+        if (next == BATCH) {
+            state.PauseTiming();
+            for (const auto& message : deletes) {
+                fixture.book.apply(message);
+            }
+            next = 0;
+            state.ResumeTiming();
+        }
+        fixture.book.apply(adds[next++]);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_BookAdd)->Apply(book_args);
+
+// Deletes of orders added, untimed, every BATCH deletes
+void BM_BookDelete(benchmark::State& state) {
+    constexpr size_t BATCH = 1024;
+    BookFixture fixture(state);
+    std::vector<itch::Message> adds;
+    std::vector<itch::Message> deletes;
+    for (size_t i = 0; i < BATCH; ++i) {
+        const itch::Side side = i % 2 == 0 ? itch::Side::Buy : itch::Side::Sell;
+        const uint64_t reference = fixture.next_reference++;
+        adds.push_back(add_message(reference, side, 100, level_price(side, (i / 2) % fixture.depth)));
+        deletes.push_back(delete_message(reference));
+    }
+
+    size_t next = BATCH;
+    for (auto _ : state) {
+        if (next == BATCH) {
+            state.PauseTiming();
+            for (const auto& message : adds) {
+                fixture.book.apply(message);
+            }
+            next = 0;
+            state.ResumeTiming();
+        }
+        fixture.book.apply(deletes[next++]);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_BookDelete)->Apply(book_args);
+
+// Partial executions, one share at a time, round-robin over the resting orders
+void BM_BookExecute(benchmark::State& state) {
+    BookFixture fixture(state);
+    std::vector<itch::Message> executes;
+    for (uint64_t reference : fixture.references) {
+        executes.push_back(itch::Message{'E', LOCATE, 0, SESSION_START,
+                                         itch::OrderExecuted{reference, 1, reference}});
+    }
+
+    size_t next = 0;
+    for (auto _ : state) {
+        fixture.book.apply(executes[next]);
+        next = next + 1 == executes.size() ? 0 : next + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_BookExecute)->Apply(book_args);
+
+// Partial cancels, one share at a time, round-robin over the resting orders
+void BM_BookCancel(benchmark::State& state) {
+    BookFixture fixture(state);
+    std::vector<itch::Message> cancels;
+    for (uint64_t reference : fixture.references) {
+        cancels.push_back(itch::Message{'X', LOCATE, 0, SESSION_START,
+                                        itch::OrderCancelled{reference, 1}});
+    }
+
+    size_t next = 0;
+    for (auto _ : state) {
+        fixture.book.apply(cancels[next]);
+        next = next + 1 == cancels.size() ? 0 : next + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_BookCancel)->Apply(book_args);
+
+// Each resting order replaced in turn with a new reference on another level,
+// so the book keeps its shape. Replaces are built, untimed, BATCH at a time.
+void BM_BookReplace(benchmark::State& state) {
+    constexpr size_t BATCH = 4096;
+    BookFixture fixture(state);
+    std::vector<itch::Message> replaces;
+    size_t order = 0;
+    auto refill = [&] {
+        replaces.clear();
+        for (size_t i = 0; i < BATCH; ++i) {
+            const itch::Side side = order % 2 == 0 ? itch::Side::Buy : itch::Side::Sell;
+            const uint32_t price = level_price(side, (order * 7 / 2) % fixture.depth);
+            const uint64_t new_reference = fixture.next_reference++;
+            replaces.push_back(itch::Message{'U', LOCATE, 0, SESSION_START,
+                                             itch::ReplaceOrder{fixture.references[order], new_reference,
+                                                                BookFixture::RESTING_SHARES, itch::Price4(price)}});
+            fixture.references[order] = new_reference;
+            order = order + 1 == fixture.references.size() ? 0 : order + 1;
+        }
+    };
+    refill();
+
+    size_t next = 0;
+    for (auto _ : state) {
+        if (next == BATCH) {
+            state.PauseTiming();
+            refill();
+            next = 0;
+            state.ResumeTiming();
+        }
+        fixture.book.apply(replaces[next++]);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_BookReplace)->Apply(book_args);
+
+void BM_GetVolumes(benchmark::State& state) {
+    BookFixture fixture(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fixture.book.get_volumes(LOCATE));
+    }
+}
+
+BENCHMARK(BM_GetVolumes)->Apply(book_args);
+
+// The string overload, which looks the ticker up first
+void BM_GetVolumesByName(benchmark::State& state) {
+    BookFixture fixture(state);
+    const std::string stock = "BNCH";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fixture.book.get_volumes(stock));
+    }
+}
+
+BENCHMARK(BM_GetVolumesByName)->Apply(book_args);
+
+void BM_GetImbalance(benchmark::State& state) {
+    BookFixture fixture(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fixture.book.get_imbalance(LOCATE));
+    }
+}
+
+BENCHMARK(BM_GetImbalance)->Apply(book_args);
+
+// --- JSON output ----------------------------------------------------------
+
+void BM_JsonSerializerToJson(benchmark::State& state) {
+    const auto& messages = feed_messages();
+    size_t next = 0;
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        const std::string text = itch::JsonSerializer::to_json(messages[next]).dump();
+        bytes += static_cast<int64_t>(text.size());
+        next = next + 1 == messages.size() ? 0 : next + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(bytes);
+}
+
+BENCHMARK(BM_JsonSerializerToJson);
+
+// Same text through the reusable buffer the pipeline writes with
+void BM_JsonWriter(benchmark::State& state) {
+    const auto& messages = feed_messages();
+    itch::JsonWriter writer;
+    size_t next = 0;
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        writer.clear();
+        writer.write(messages[next]);
+        benchmark::DoNotOptimize(writer.view().data());
+        bytes += static_cast<int64_t>(writer.size());
+        next = next + 1 == messages.size() ? 0 : next + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(bytes);
+}
+
+BENCHMARK(BM_JsonWriter);
+
+// --- Queues ---------------------------------------------------------------
+
+hft::QueueKind queue_kind(const benchmark::State& state) {
+    return static_cast<hft::QueueKind>(state.range(0));
+}
+
+void queue_args(benchmark::internal::Benchmark* benchmark) {
+    for (hft::QueueKind kind : {hft::QueueKind::Locked, hft::QueueKind::Spsc, hft::QueueKind::Mpsc}) {
+        benchmark->Arg(static_cast<int64_t>(kind));
+    }
+    benchmark->ArgName("kind");
+}
+
+// Push then pop on one thread: the uncontended cost of each backend
+void BM_QueuePushPop(benchmark::State& state) {
+    hft::ConcurrentQueue<hft::MarketUpdate> queue(queue_kind(state), 1024);
+    hft::MarketUpdate update;
+    for (auto _ : state) {
+        queue.push(update);
+        queue.pop(update);
+        benchmark::DoNotOptimize(update);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(hft::queue_kind_name(queue_kind(state)));
+}
+
+BENCHMARK(BM_QueuePushPop)->Apply(queue_args);
+
+// Batches of 64 through push_batch/pop_batch
+void BM_QueueBatch(benchmark::State& state) {
+    constexpr size_t BATCH = 64;
+    hft::ConcurrentQueue<hft::MarketUpdate> queue(queue_kind(state), 1024);
+    std::vector<hft::MarketUpdate> in;
+    std::vector<hft::MarketUpdate> out;
+    for (auto _ : state) {
+        in.assign(BATCH, hft::MarketUpdate{});
+        queue.push_batch(in);
+        queue.pop_batch(out, BATCH);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+    state.SetLabel(hft::queue_kind_name(queue_kind(state)));
+}
+
+BENCHMARK(BM_QueueBatch)->Apply(queue_args);
+
+// One producer thread and one consumer thread, each moving the same number
+// of updates. Thread 0 sets the queue up before the start barrier and tears
+// it down after the stop barrier.
+void BM_QueueHandoff(benchmark::State& state) {
+    static std::unique_ptr<hft::ConcurrentQueue<hft::MarketUpdate>> queue;
+    if (state.thread_index() == 0) {
+        queue = std::make_unique<hft::ConcurrentQueue<hft::MarketUpdate>>(queue_kind(state), 4096);
+    }
+
+    hft::MarketUpdate update;
+    for (auto _ : state) {
+        if (state.thread_index() == 0) {
+            queue->push(update);
+        } else {
+            queue->pop(update);
+            benchmark::DoNotOptimize(update);
+        }
+    }
+
+    if (state.thread_index() == 0) {
+        state.SetItemsProcessed(state.iterations());
+        state.SetLabel(hft::queue_kind_name(queue_kind(state)));
+    }
+}
+
+BENCHMARK(BM_QueueHandoff)->Apply(queue_args)->Threads(2)->UseRealTime();
+
+// --- Strategy -------------------------------------------------------------
+
+// The market updates a book publishes after each AddOrder of the synthetic feed
+std::vector<hft::MarketUpdate> feed_updates(hft::OrderBook& book) {
+    std::vector<hft::MarketUpdate> updates;
+    for (const auto& message : feed_messages()) {
+        book.apply(message);
+        if (std::holds_alternative<itch::AddOrder>(message.body)) {
+            updates.push_back(book.get_market_update(message.stock_locate, message.timestamp));
+        }
+    }
+    return updates;
+}
+
+void BM_ProcessMarketUpdate(benchmark::State& state) {
+    hft::OrderBook book;
+    const std::vector<hft::MarketUpdate> updates = feed_updates(book);
+    const std::string output_dir = (std::filesystem::temp_directory_path() / "nasdaq_benchmarks").string();
+    auto strategy = std::make_unique<hft::LiquidityReversionStrategy>(
+        [&book](hft::SymbolId symbol) -> const std::string& { return book.symbols().name(symbol); },
+        output_dir);
+
+    size_t next = 0;
+    for (auto _ : state) {
+        strategy->process_market_update(updates[next]);
+        next = next + 1 == updates.size() ? 0 : next + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    // The destructor flushes the trade log; keep that out of the timings
+    strategy.reset();
+    std::filesystem::remove_all(output_dir);
+}
+
+BENCHMARK(BM_ProcessMarketUpdate);
+
+} // namespace
+
+BENCHMARK_MAIN();
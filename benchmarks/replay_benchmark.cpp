@@ -0,0 +1,213 @@
+#include "synthetic_feed.h"
+#include "../cpp_parser/include/parser.h"
+#include "../cpp_parser/include/batch_decoder.h"
+#include "../cpp_parser/include/decompressor.h"
+#include "../cpp_order_book/order_book.h"
+#include "../cpp_order_book/trading_strategy.h"
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <variant>
+#include <vector>
+
+// End-to-end replay of a whole ITCH file: parse only, parse into the book,
+// and parse into the book with the strategy acting on every book change, as
+// order_book_processor does. Without --input a synthetic feed is written to
+// the temp directory first, so the run is the same on every machine.
+// The batch variants do the same through itch::BatchDecoder and the book's
+// batch apply; they need an uncompressed (mappable) file.
+
+namespace {
+
+struct ReplayOptions {
+    std::string input_file;     // Empty for the synthetic feed
+    size_t messages = 1000000;  // Synthetic feed size
+    uint64_t seed = 1;
+    itch::InputBackend backend = itch::InputBackend::Mmap;
+};
+
+void replay_parse(benchmark::State& state, const ReplayOptions& options) {
+    size_t messages = 0;
+    for (auto _ : state) {
+        auto parser = itch::Parser::open(options.input_file, options.backend);
+        while (auto message = parser->parse_message()) {
+            benchmark::DoNotOptimize(message);
+            ++messages;
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(messages));
+}
+
+// BatchDecoder maps the file, so it cannot read compressed input
+bool skip_if_compressed(benchmark::State& state, const ReplayOptions& options) {
+    itch::Compression format;
+    if (itch::detect_compression(options.input_file, format)) {
+        state.SkipWithError("batch decode needs an uncompressed file");
+        return true;
+    }
+    return false;
+}
+
+void replay_parse_batch(benchmark::State& state, const ReplayOptions& options) {
+    if (skip_if_compressed(state, options)) {
+        return;
+    }
+    size_t messages = 0;
+    itch::MessageBatch batch;
+    for (auto _ : state) {
+        auto decoder = itch::BatchDecoder::open(options.input_file);
+        while (decoder->next_batch(batch)) {
+            benchmark::DoNotOptimize(batch.refs.data());
+            messages += batch.size();
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(messages));
+}
+
+void replay_book_batch(benchmark::State& state, const ReplayOptions& options) {
+    if (skip_if_compressed(state, options)) {
+        return;
+    }
+    size_t messages = 0;
+    itch::MessageBatch batch;
+    std::vector<hft::OrderBook::BatchChange> changes;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto book = std::make_unique<hft::OrderBook>(state.range(0) ? hft::BookEngine::Ladder : hft::BookEngine::Map);
+        state.ResumeTiming();
+
+        auto decoder = itch::BatchDecoder::open(options.input_file);
+        while (decoder->next_batch(batch)) {
+            changes.clear();
+            book->apply(batch, changes);
+            messages += batch.size();
+        }
+
+        state.PauseTiming();
+        book.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(messages));
+}
+
+void replay_book(benchmark::State& state, const ReplayOptions& options) {
+    size_t messages = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto book = std::make_unique<hft::OrderBook>(state.range(0) ? hft::BookEngine::Ladder : hft::BookEngine::Map);
+        state.ResumeTiming();
+
+        auto parser = itch::Parser::open(options.input_file, options.backend);
+        while (auto message = parser->parse_message()) {
+            book->apply(*message);
+            ++messages;
+        }
+
+        state.PauseTiming();
+        book.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(messages));
+}
+
+void replay_pipeline(benchmark::State& state, const ReplayOptions& options) {
+    const std::string output_dir = (std::filesystem::temp_directory_path() / "nasdaq_replay").string();
+    size_t messages = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto book = std::make_unique<hft::OrderBook>(state.range(0) ? hft::BookEngine::Ladder : hft::BookEngine::Map);
+        auto strategy = std::make_unique<hft::LiquidityReversionStrategy>(
+            [&book](hft::SymbolId symbol) -> const std::string& { return book->symbols().name(symbol); },
+            output_dir);
+        state.ResumeTiming();
+
+        auto parser = itch::Parser::open(options.input_file, options.backend);
+        while (auto message = parser->parse_message()) {
+            const hft::SymbolId changed = book->apply(*message);
+            if (changed != hft::INVALID_SYMBOL) {
+                strategy->process_market_update(book->get_market_update(changed, message->timestamp));
+            }
+            ++messages;
+        }
+
+        state.PauseTiming();
+        strategy.reset();
+        book.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(messages));
+    std::filesystem::remove_all(output_dir);
+}
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--input FILE] [--messages N] [--seed S] [--stream] [benchmark flags...]" << std::endl;
+    std::cerr << "  --input FILE : raw ITCH 5.0 file to replay, optionally gzip/zstd-compressed" << std::endl;
+    std::cerr << "  --messages N : size of the synthetic feed used without --input (default 1000000)" << std::endl;
+    std::cerr << "  --seed S     : seed of the synthetic feed (default 1)" << std::endl;
+    std::cerr << "  --stream     : read through std::istream instead of a memory mapping" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    // Take our own flags out and leave the rest to Google Benchmark
+    ReplayOptions options;
+    std::vector<char*> args;
+    for (int i = 0; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--input" && has_value) {
+            options.input_file = argv[++i];
+        } else if (arg == "--messages" && has_value) {
+            options.messages = std::stoull(argv[++i]);
+        } else if (arg == "--seed" && has_value) {
+            options.seed = std::stoull(argv[++i]);
+        } else if (arg == "--stream") {
+            options.backend = itch::InputBackend::Stream;
+        } else if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+
+    std::string synthetic_file;
+    if (options.input_file.empty()) {
+        itch::SyntheticFeedOptions feed;
+        feed.seed = options.seed;
+        synthetic_file = (std::filesystem::temp_directory_path() /
+                          ("replay_" + std::to_string(options.seed) + "_" + std::to_string(options.messages) + ".itch")).string();
+        try {
+            itch::write_feed(synthetic_file, options.messages, feed);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        options.input_file = synthetic_file;
+    }
+
+    benchmark::RegisterBenchmark("Replay/parse", replay_parse, options)->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("Replay/parse_batch", replay_parse_batch, options)->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("Replay/book", replay_book, options)
+        ->Arg(0)->Arg(1)->ArgName("ladder")->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("Replay/book_batch", replay_book_batch, options)
+        ->Arg(0)->Arg(1)->ArgName("ladder")->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("Replay/pipeline", replay_pipeline, options)
+        ->Arg(0)->Arg(1)->ArgName("ladder")->Unit(benchmark::kMillisecond);
+
+    int benchmark_argc = static_cast<int>(args.size());
+    benchmark::Initialize(&benchmark_argc, args.data());
+    if (benchmark::ReportUnrecognizedArguments(benchmark_argc, args.data())) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    if (!synthetic_file.empty()) {
+        std::filesystem::remove(synthetic_file);
+    }
+    return 0;
+}
@@ -0,0 +1,446 @@
+#include "synthetic_feed.h"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace itch {
+
+void ItchEncoder::begin(char type, uint16_t stock_locate, uint64_t timestamp) {
+    start_ = out_.size();
+    u16(0);
+    u8(static_cast<uint8_t>(type));
+    u16(stock_locate);
+    u16(0);  // Tracking number
+    u48(timestamp);
+}
+
+void ItchEncoder::end() {
+    const size_t length = out_.size() - start_ - 2;
+    out_[start_] = static_cast<char>(length >> 8);
+    out_[start_ + 1] = static_cast<char>(length & 0xFF);
+}
+
+void ItchEncoder::text(std::string_view value, size_t width) {
+    const size_t used = std::min(value.size(), width);
+    out_.append(value.data(), used);
+    out_.append(width - used, ' ');
+}
+
+void ItchEncoder::big_endian(uint64_t value, int bytes) {
+    for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+        out_ += static_cast<char>((value >> shift) & 0xFF);
+    }
+}
+
+void ItchEncoder::sample(char type, uint16_t stock_locate, uint64_t timestamp) {
+    const std::string stock = synthetic_symbol(stock_locate);
+    begin(type, stock_locate, timestamp);
+    switch (type) {
+        case 'S':
+            u8('O');
+            break;
+        case 'R':
+            text(stock, 8);
+            u8('Q');         // Market category
+            u8('N');         // Financial status
+            u32(100);        // Round lot size
+            u8('N');         // Round lots only
+            u8('C');         // Issue classification
+            text("C ", 2);   // Issue subtype
+            u8('P');         // Authenticity
+            u8('N');         // Short sale threshold
+            u8('N');         // IPO flag
+            u8('1');         // LULD reference price tier
+            u8('N');         // ETP flag
+            u32(0);          // ETP leverage factor
+            u8('N');         // Inverse indicator
+            break;
+        case 'H':
+            text(stock, 8);
+            u8('T');
+            u8(0);
+            text("", 4);
+            break;
+        case 'Y':
+            text(stock, 8);
+            u8('0');
+            break;
+        case 'L':
+            text("MPID", 4);
+            text(stock, 8);
+            u8('Y');
+            u8('N');
+            u8('A');
+            break;
+        case 'V':
+            u64(3000000000000);
+            u64(2800000000000);
+            u64(2600000000000);
+            break;
+        case 'W':
+            u8('1');
+            break;
+        case 'K':
+            text(stock, 8);
+            u32(34200);
+            u8('A');
+            u32(250000);
+            break;
+        case 'J':
+            text(stock, 8);
+            u32(250000);
+            u32(262500);
+            u32(237500);
+            u32(1);
+            break;
+        case 'A':
+        case 'F':
+            u64(1);
+            u8('B');
+            u32(100);
+            text(stock, 8);
+            u32(250000);
+            if (type == 'F') {
+                text("MPID", 4);
+            }
+            break;
+        case 'E':
+            u64(1);
+            u32(100);
+            u64(1);
+            break;
+        case 'C':
+            u64(1);
+            u32(100);
+            u64(1);
+            u8('Y');
+            u32(250100);
+            break;
+        case 'X':
+            u64(1);
+            u32(50);
+            break;
+        case 'D':
+            u64(1);
+            break;
+        case 'U':
+            u64(1);
+            u64(2);
+            u32(200);
+            u32(250100);
+            break;
+        case 'P':
+            u64(0);
+            u8('S');
+            u32(100);
+            text(stock, 8);
+            u32(250000);
+            u64(1);
+            break;
+        case 'Q':
+            u64(10000);
+            text(stock, 8);
+            u32(250000);
+            u64(1);
+            u8('O');
+            break;
+        case 'B':
+            u64(1);
+            break;
+        case 'I':
+            u64(10000);
+            u64(500);
+            u8('B');
+            text(stock, 8);
+            u32(251000);
+            u32(250500);
+            u32(250000);
+            u8('O');
+            u8('L');
+            break;
+        case 'N':
+            text(stock, 8);
+            u8('B');
+            break;
+        default:
+            throw std::runtime_error("Unknown ITCH message type: " + std::string(1, type));
+    }
+    end();
+}
+
+std::string synthetic_symbol(uint16_t stock_locate) {
+    std::string symbol(4, 'A');
+    unsigned index = stock_locate > 0 ? stock_locate - 1u : 0u;
+    for (int i = 3; i >= 0; --i) {
+        symbol[i] = static_cast<char>('A' + index % 26);
+        index /= 26;
+    }
+    return symbol;
+}
+
+namespace {
+
+constexpr uint64_t SESSION_START = 34200ull * 1000000000ull;  // 9:30 in nanoseconds after midnight
+constexpr uint32_t TICK = 100;                                // One cent in 1/10000 dollars
+constexpr uint32_t BOOK_LEVELS = 20;                          // Orders rest up to this many ticks from the mid
+
+// SplitMix64: tiny, fast, and unlike the <random> distributions it gives the
+// same sequence with every standard library
+class SplitMix64 {
+public:
+    explicit SplitMix64(uint64_t seed) : state_(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state_ += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, bound)
+    uint64_t below(uint64_t bound) { return next() % bound; }
+
+private:
+    uint64_t state_;
+};
+
+struct LiveOrder {
+    uint64_t reference;
+    uint32_t price;
+    uint32_t shares;
+    char side;
+};
+
+struct SymbolFlow {
+    std::string stock;
+    uint32_t mid;
+    std::vector<LiveOrder> orders;
+};
+
+class FeedBuilder {
+public:
+    FeedBuilder(const SyntheticFeedOptions& options, std::string& out)
+        : options_(options), random_(options.seed), out_(out) {
+        if (options.symbols == 0) {
+            throw std::runtime_error("Synthetic feed needs at least one symbol");
+        }
+        flows_.resize(options.symbols);
+        for (uint16_t i = 0; i < options.symbols; ++i) {
+            flows_[i].stock = synthetic_symbol(static_cast<uint16_t>(i + 1));
+            flows_[i].mid = static_cast<uint32_t>(10 + random_.below(490)) * 10000;
+        }
+    }
+
+    void opening() {
+        for (char event : {'O', 'S', 'Q'}) {
+            out_.begin('S', 0, tick());
+            out_.u8(static_cast<uint8_t>(event));
+            out_.end();
+        }
+        for (unsigned locate = 1; locate <= options_.symbols; ++locate) {
+            out_.sample('R', static_cast<uint16_t>(locate), tick());
+        }
+        for (unsigned locate = 1; locate <= options_.symbols; ++locate) {
+            out_.begin('H', static_cast<uint16_t>(locate), tick());
+            out_.text(flows_[locate - 1].stock, 8);
+            out_.u8('T');
+            out_.u8(0);
+            out_.text("", 4);
+            out_.end();
+        }
+    }
+
+    void closing() {
+        for (char event : {'M', 'E', 'C'}) {
+            out_.begin('S', 0, tick());
+            out_.u8(static_cast<uint8_t>(event));
+            out_.end();
+        }
+    }
+
+    // One order message for a symbol, weighted towards low locates so a few
+    // symbols are busy and most are quiet, as in a real feed
+    void order_message() {
+        const uint16_t bound = static_cast<uint16_t>(random_.below(options_.symbols) + 1);
+        const uint16_t index = static_cast<uint16_t>(random_.below(bound));
+        SymbolFlow& flow = flows_[index];
+        const uint16_t locate = static_cast<uint16_t>(index + 1);
+
+        // Walk the mid a tick now and then
+        if (random_.below(16) == 0) {
+            flow.mid = random_.below(2) == 0 || flow.mid <= (BOOK_LEVELS + 1) * TICK ? flow.mid + TICK : flow.mid - TICK;
+        }
+
+        const size_t target = options_.orders_per_symbol;
+        const uint64_t roll = random_.below(100);
+        if (flow.orders.size() < target / 2 + 1 || (roll < 40 && flow.orders.size() < 2 * target)) {
+            add_order(flow, locate, roll % 10 == 0);
+        } else if (roll < 60) {
+            delete_order(flow, locate);
+        } else if (roll < 70) {
+            cancel_order(flow, locate);
+        } else if (roll < 80) {
+            execute_order(flow, locate, false);
+        } else if (roll < 83) {
+            execute_order(flow, locate, true);
+        } else if (roll < 97) {
+            replace_order(flow, locate);
+        } else {
+            trade(flow, locate);
+        }
+    }
+
+private:
+    const SyntheticFeedOptions& options_;
+    SplitMix64 random_;
+    ItchEncoder out_;
+    std::vector<SymbolFlow> flows_;
+    uint64_t timestamp_ = SESSION_START;
+    uint64_t next_reference_ = 1;
+    uint64_t next_match_ = 1;
+
+    uint64_t tick() {
+        timestamp_ += 1 + random_.below(2000);
+        return timestamp_;
+    }
+
+    uint32_t quote_price(const SymbolFlow& flow, char side) {
+        const uint32_t offset = static_cast<uint32_t>(1 + random_.below(BOOK_LEVELS)) * TICK;
+        return side == 'B' ? flow.mid - offset : flow.mid + offset;
+    }
+
+    uint32_t round_lots() {
+        return static_cast<uint32_t>(1 + random_.below(10)) * 100;
+    }
+
+    // Removes the picked order from the list; swap-and-pop keeps it O(1)
+    LiveOrder take(SymbolFlow& flow, size_t index) {
+        const LiveOrder order = flow.orders[index];
+        flow.orders[index] = flow.orders.back();
+        flow.orders.pop_back();
+        return order;
+    }
+
+    size_t pick(const SymbolFlow& flow) {
+        return static_cast<size_t>(random_.below(flow.orders.size()));
+    }
+
+    void add_order(SymbolFlow& flow, uint16_t locate, bool with_mpid) {
+        const char side = random_.below(2) == 0 ? 'B' : 'S';
+        const LiveOrder order{next_reference_++, quote_price(flow, side), round_lots(), side};
+        flow.orders.push_back(order);
+
+        out_.begin(with_mpid ? 'F' : 'A', locate, tick());
+        out_.u64(order.reference);
+        out_.u8(static_cast<uint8_t>(order.side));
+        out_.u32(order.shares);
+        out_.text(flow.stock, 8);
+        out_.u32(order.price);
+        if (with_mpid) {
+            out_.text("SYNT", 4);
+        }
+        out_.end();
+    }
+
+    void delete_order(SymbolFlow& flow, uint16_t locate) {
+        const LiveOrder order = take(flow, pick(flow));
+        out_.begin('D', locate, tick());
+        out_.u64(order.reference);
+        out_.end();
+    }
+
+    void cancel_order(SymbolFlow& flow, uint16_t locate) {
+        LiveOrder& order = flow.orders[pick(flow)];
+        if (order.shares < 2) {
+            delete_order(flow, locate);
+            return;
+        }
+        const uint32_t cancelled = static_cast<uint32_t>(1 + random_.below(order.shares - 1));
+        order.shares -= cancelled;
+        out_.begin('X', locate, tick());
+        out_.u64(order.reference);
+        out_.u32(cancelled);
+        out_.end();
+    }
+
+    void execute_order(SymbolFlow& flow, uint16_t locate, bool with_price) {
+        const size_t index = pick(flow);
+        LiveOrder& order = flow.orders[index];
+        const uint32_t executed = random_.below(2) == 0
+            ? order.shares
+            : static_cast<uint32_t>(1 + random_.below(order.shares));
+        const uint64_t reference = order.reference;
+        const uint32_t price = order.price;
+        order.shares -= executed;
+        if (order.shares == 0) {
+            take(flow, index);
+        }
+
+        out_.begin(with_price ? 'C' : 'E', locate, tick());
+        out_.u64(reference);
+        out_.u32(executed);
+        out_.u64(next_match_++);
+        if (with_price) {
+            out_.u8('Y');
+            out_.u32(price + TICK);
+        }
+        out_.end();
+    }
+
+    void replace_order(SymbolFlow& flow, uint16_t locate) {
+        const size_t index = pick(flow);
+        LiveOrder& order = flow.orders[index];
+        const uint64_t old_reference = order.reference;
+        order.reference = next_reference_++;
+        order.price = quote_price(flow, order.side);
+        order.shares = round_lots();
+
+        out_.begin('U', locate, tick());
+        out_.u64(old_reference);
+        out_.u64(order.reference);
+        out_.u32(order.shares);
+        out_.u32(order.price);
+        out_.end();
+    }
+
+    // Trade against a hidden order: no book change
+    void trade(SymbolFlow& flow, uint16_t locate) {
+        out_.begin('P', locate, tick());
+        out_.u64(0);
+        out_.u8(random_.below(2) == 0 ? 'B' : 'S');
+        out_.u32(round_lots());
+        out_.text(flow.stock, 8);
+        out_.u32(flow.mid);
+        out_.u64(next_match_++);
+        out_.end();
+    }
+};
+
+} // namespace
+
+std::string generate_feed(size_t messages, const SyntheticFeedOptions& options) {
+    std::string feed;
+    feed.reserve(messages * 32 + options.symbols * 64 + 64);
+    FeedBuilder builder(options, feed);
+    builder.opening();
+    for (size_t i = 0; i < messages; ++i) {
+        builder.order_message();
+    }
+    builder.closing();
+    return feed;
+}
+
+void write_feed(const std::string& path, size_t messages, const SyntheticFeedOptions& options) {
+    const std::string feed = generate_feed(messages, options);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file: " + path);
+    }
+    file.write(feed.data(), static_cast<std::streamsize>(feed.size()));
+    if (!file) {
+        throw std::runtime_error("Failed to write file: " + path);
+    }
+}
+
+} // namespace itch
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace itch {
+
+// Appends raw ITCH 5.0 messages to a string: a 2-byte length prefix, then the
+// big-endian fields in the order Parser reads them.
+class ItchEncoder {
+public:
+    explicit ItchEncoder(std::string& out) : out_(out) {}
+
+    // Start a message with its common header; end() fills in the length
+    void begin(char type, uint16_t stock_locate, uint64_t timestamp);
+    void end();
+
+    void u8(uint8_t value) { out_ += static_cast<char>(value); }
+    void u16(uint16_t value) { big_endian(value, 2); }
+    void u32(uint32_t value) { big_endian(value, 4); }
+    void u48(uint64_t value) { big_endian(value, 6); }
+    void u64(uint64_t value) { big_endian(value, 8); }
+
+    // Fixed-width text, space padded (stock symbols, MPIDs)
+    void text(std::string_view value, size_t width);
+
+    // One valid message of any type the parser knows, with arbitrary field values.
+    // Throws std::runtime_error for an unknown type.
+    void sample(char type, uint16_t stock_locate, uint64_t timestamp);
+
+private:
+    std::string& out_;
+    size_t start_ = 0;
+
+    void big_endian(uint64_t value, int bytes);
+};
+
+struct SyntheticFeedOptions {
+    uint64_t seed = 1;
+    uint16_t symbols = 64;          // Stock locates 1..symbols
+    size_t orders_per_symbol = 50;  // Resting orders per symbol the flow hovers around
+};
+
+// Deterministic order flow for benchmarks and tests without a licensed
+// capture: the opening system events, a stock directory and trading action
+// per symbol, `messages` order messages (adds, executes, cancels, deletes,
+// replaces and trades against live orders, with prices walking around a
+// per-symbol mid), then the closing system events. The same options always
+// give the same bytes, on any platform.
+std::string generate_feed(size_t messages, const SyntheticFeedOptions& options = {});
+
+// Write generate_feed() to a file.
+// Throws std::runtime_error if the file cannot be written.
+void write_feed(const std::string& path, size_t messages, const SyntheticFeedOptions& options = {});
+
+// Ticker for a synthetic stock locate ("AAAA", "AAAB", ...)
+std::string synthetic_symbol(uint16_t stock_locate);
+
+} // namespace itch
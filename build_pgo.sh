@@ -0,0 +1,33 @@
+#!/bin/bash
+# Two-stage profile-guided build of every C++ target
+#
+#   ./build_pgo.sh [training.itch]
+#
+# Stage 1 builds instrumented binaries and runs the pgo_train workload (the
+# replay benchmark, then integrated_processor and parallel_processor) on the
+# given ITCH file, or on a synthetic feed when none is given. Stage 2
+# rebuilds in the same directory with the recorded profiles.
+# BUILD_DIR (default: build-pgo) and extra CMAKE_ARGS can be set in the environment.
+
+set -e
+
+SOURCE_DIR="$(cd "$(dirname "$0")" && pwd)"
+BUILD_DIR="${BUILD_DIR:-$SOURCE_DIR/build-pgo}"
+TRAINING_INPUT="${1:-}"
+if [ -n "$TRAINING_INPUT" ]; then
+    TRAINING_INPUT="$(cd "$(dirname "$TRAINING_INPUT")" && pwd)/$(basename "$TRAINING_INPUT")"
+fi
+
+echo "Stage 1: instrumented build"
+cmake -S "$SOURCE_DIR" -B "$BUILD_DIR" $CMAKE_ARGS \
+    -DNASDAQ_PGO=GENERATE -DNASDAQ_PGO_TRAINING_INPUT="$TRAINING_INPUT"
+cmake --build "$BUILD_DIR" -j"$(nproc 2>/dev/null || sysctl -n hw.ncpu)"
+
+echo "Training on ${TRAINING_INPUT:-a synthetic feed}"
+cmake --build "$BUILD_DIR" --target pgo_train
+
+echo "Stage 2: optimized build"
+cmake -S "$SOURCE_DIR" -B "$BUILD_DIR" -DNASDAQ_PGO=USE
+cmake --build "$BUILD_DIR" -j"$(nproc 2>/dev/null || sysctl -n hw.ncpu)"
+
+echo "Profile-guided binaries are in $BUILD_DIR"
@@ -0,0 +1,311 @@
+#include "backtest.h"
+#include "update_stream.h"
+#include "work_stealing_pool.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace hft {
+
+namespace {
+
+double parse_number(const std::string& text, const std::string& field) {
+    size_t used = 0;
+    double value;
+    try {
+        value = std::stod(text, &used);
+    } catch (const std::exception&) {
+        used = 0;
+    }
+    if (used == 0 || used != text.size()) {
+        throw std::invalid_argument("Invalid grid value '" + text + "' in '" + field + "'");
+    }
+    return value;
+}
+
+// Output directory name for each input, made unique if two files share a name
+std::vector<std::string> day_names(const std::vector<std::string>& inputs) {
+    std::vector<std::string> names;
+    for (const auto& input : inputs) {
+        std::string name = std::filesystem::path(input).filename().string();
+        const std::string base = name;
+        for (int n = 2; std::find(names.begin(), names.end(), name) != names.end(); n++) {
+            name = base + "_" + std::to_string(n);
+        }
+        names.push_back(name);
+    }
+    return names;
+}
+
+// Wait for every task before rethrowing the first failure, since the tasks
+// hold references into the caller's frame
+void wait_all(std::vector<std::future<void>>& futures) {
+    std::exception_ptr error;
+    for (auto& future : futures) {
+        try {
+            future.get();
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+json stats_json(const TradeStats& stats, double initial_capital) {
+    json out;
+    out["num_trades"] = stats.num_trades;
+    out["total_pnl"] = stats.total_pnl;
+    out["return_pct"] = stats.total_pnl / initial_capital * 100.0;
+    out["win_rate"] = stats.win_rate;
+    out["sharpe_ratio"] = stats.sharpe_ratio;
+    return out;
+}
+
+} // namespace
+
+std::vector<StrategyParams> ParameterGrid::expand() const {
+    std::vector<StrategyParams> grid;
+    for (double liquidity : liquidity_thresholds) {
+        for (double reverse : reverse_thresholds) {
+            for (int size : position_sizes) {
+                for (int hold : hold_time_ticks) {
+                    grid.push_back(StrategyParams{liquidity, reverse, size, hold});
+                }
+            }
+        }
+    }
+    return grid;
+}
+
+std::vector<double> parse_grid_values(const std::string& text) {
+    std::vector<double> values;
+    std::stringstream items(text);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        if (item.find(':') == std::string::npos) {
+            values.push_back(parse_number(item, text));
+            continue;
+        }
+
+        const size_t first_colon = item.find(':');
+        const size_t second_colon = item.find(':', first_colon + 1);
+        if (second_colon == std::string::npos || item.find(':', second_colon + 1) != std::string::npos) {
+            throw std::invalid_argument("Invalid grid range '" + item + "' (expected first:last:step)");
+        }
+        const std::string first = item.substr(0, first_colon);
+        const std::string last = item.substr(first_colon + 1, second_colon - first_colon - 1);
+        const std::string step = item.substr(second_colon + 1);
+        const double from = parse_number(first, text);
+        const double to = parse_number(last, text);
+        const double by = parse_number(step, text);
+        if (by <= 0 || to < from) {
+            throw std::invalid_argument("Invalid grid range '" + item + "'");
+        }
+        // Count the steps up front so rounding never drops or adds the last value
+        const size_t steps = static_cast<size_t>(std::floor((to - from) / by + 1e-9));
+        for (size_t i = 0; i <= steps; i++) {
+            values.push_back(from + i * by);
+        }
+    }
+    if (values.empty()) {
+        throw std::invalid_argument("Empty grid '" + text + "'");
+    }
+    return values;
+}
+
+std::vector<int> parse_grid_ints(const std::string& text) {
+    std::vector<int> values;
+    for (double value : parse_grid_values(text)) {
+        if (value != std::floor(value)) {
+            throw std::invalid_argument("Grid '" + text + "' must hold whole numbers");
+        }
+        values.push_back(static_cast<int>(value));
+    }
+    return values;
+}
+
+std::string params_label(const StrategyParams& params) {
+    std::ostringstream label;
+    label << "lt" << params.liquidity_threshold
+          << "_rt" << params.reverse_threshold
+          << "_ps" << params.position_size
+          << "_ht" << params.hold_time_ticks;
+    return label.str();
+}
+
+BacktestReport run_backtests(const std::vector<std::string>& inputs,
+                             const std::vector<StrategyParams>& grid,
+                             const BacktestOptions& options) {
+    if (inputs.empty() || grid.empty()) {
+        throw std::invalid_argument("A backtest needs at least one input file and one parameter set");
+    }
+
+    BacktestReport report;
+    report.days = day_names(inputs);
+
+    const size_t num_threads = options.num_threads > 0 ? options.num_threads
+                                                       : std::max(1u, std::thread::hardware_concurrency());
+    WorkStealingPool pool(num_threads);
+
+    const std::string stream_dir = options.stream_dir.empty()
+        ? (std::filesystem::path(options.output_dir) / "streams").string() : options.stream_dir;
+    std::filesystem::create_directories(stream_dir);
+
+    // Decode every day that has no up-to-date stream yet, one day per task
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> stream_paths;
+    for (const auto& day : report.days) {
+        stream_paths.push_back((std::filesystem::path(stream_dir) / (day + ".updates")).string());
+    }
+    std::vector<std::future<void>> decodes;
+    for (size_t day = 0; day < inputs.size(); day++) {
+        if (options.reuse_streams && update_stream_matches(stream_paths[day], inputs[day], options.detection)) {
+            continue;
+        }
+        report.days_decoded++;
+        decodes.push_back(pool.enqueue([&inputs, &stream_paths, &options, day] {
+            decode_update_stream(inputs[day], stream_paths[day], options.engine, options.detection);
+        }));
+    }
+    wait_all(decodes);
+    report.decode_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Map each day once; every task replaying it reads the same pages
+    std::vector<std::unique_ptr<UpdateStream>> streams;
+    for (const auto& path : stream_paths) {
+        streams.push_back(std::make_unique<UpdateStream>(path));
+        report.day_updates.push_back(streams.back()->size());
+    }
+
+    report.results.resize(grid.size());
+    for (size_t i = 0; i < grid.size(); i++) {
+        report.results[i].params = grid[i];
+        report.results[i].days.resize(inputs.size());
+    }
+
+    const size_t group_size = options.group_size > 0 ? options.group_size
+                                                     : (grid.size() + num_threads - 1) / num_threads;
+
+    // One task per (day, group of parameter sets). Each writes only its own
+    // results' entries for its day, so tasks share nothing mutable.
+    start = std::chrono::steady_clock::now();
+    std::vector<std::future<void>> runs;
+    for (size_t day = 0; day < inputs.size(); day++) {
+        for (size_t first = 0; first < grid.size(); first += group_size) {
+            const size_t last = std::min(first + group_size, grid.size());
+            runs.push_back(pool.enqueue([&report, &streams, &options, day, first, last] {
+                const UpdateStream& stream = *streams[day];
+                const std::string& day_name = report.days[day];
+
+                std::vector<std::unique_ptr<LiquidityReversionStrategy>> strategies;
+                for (size_t i = first; i < last; i++) {
+                    const StrategyParams& params = report.results[i].params;
+                    const auto output_dir = std::filesystem::path(options.output_dir) / params_label(params) / day_name;
+                    strategies.push_back(std::make_unique<LiquidityReversionStrategy>(
+                        [&stream](SymbolId symbol) -> const std::string& { return stream.name(symbol); },
+                        output_dir.string(),
+                        options.initial_capital,
+                        params.liquidity_threshold,
+                        params.reverse_threshold,
+                        params.position_size,
+                        params.hold_time_ticks));
+                }
+
+                // Update-major, so each update is read once for the whole group
+                for (const MarketUpdate& update : stream) {
+                    for (auto& strategy : strategies) {
+                        strategy->process_market_update(update);
+                    }
+                }
+
+                for (size_t i = first; i < last; i++) {
+                    DayResult& result = report.results[i].days[day];
+                    result.day = day_name;
+                    result.trades = strategies[i - first]->trades();
+                    result.stats = compute_trade_stats(result.trades, options.initial_capital);
+                }
+            }));
+        }
+    }
+    wait_all(runs);
+    report.backtest_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Each parameter set's days back to back, as if it had traded them in sequence
+    for (auto& result : report.results) {
+        std::vector<TradeRecord> trades;
+        for (const auto& day : result.days) {
+            trades.insert(trades.end(), day.trades.begin(), day.trades.end());
+        }
+        result.stats = compute_trade_stats(trades, options.initial_capital);
+    }
+    return report;
+}
+
+void write_backtest_summary(const BacktestReport& report, const BacktestOptions& options,
+                            const std::string& path) {
+    std::vector<size_t> ranked(report.results.size());
+    std::iota(ranked.begin(), ranked.end(), 0);
+    std::stable_sort(ranked.begin(), ranked.end(), [&report](size_t a, size_t b) {
+        return report.results[a].stats.total_pnl > report.results[b].stats.total_pnl;
+    });
+
+    json summary;
+    summary["initial_capital"] = options.initial_capital;
+    summary["book"] = options.engine == BookEngine::Ladder ? "ladder" : "map";
+    summary["update_trigger"] = change_detection_name(options.detection);
+    summary["parameter_sets"] = report.results.size();
+    summary["days_decoded"] = report.days_decoded;
+    summary["decode_seconds"] = report.decode_seconds;
+    summary["backtest_seconds"] = report.backtest_seconds;
+
+    json days = json::array();
+    for (size_t day = 0; day < report.days.size(); day++) {
+        days.push_back({{"day", report.days[day]}, {"updates", report.day_updates[day]}});
+    }
+    summary["days"] = days;
+
+    json results = json::array();
+    for (size_t index : ranked) {
+        const BacktestResult& result = report.results[index];
+        json entry = stats_json(result.stats, options.initial_capital);
+        entry["label"] = params_label(result.params);
+        entry["liquidity_threshold"] = result.params.liquidity_threshold;
+        entry["reverse_threshold"] = result.params.reverse_threshold;
+        entry["position_size"] = result.params.position_size;
+        entry["hold_time_ticks"] = result.params.hold_time_ticks;
+
+        json per_day = json::array();
+        for (const auto& day : result.days) {
+            json day_entry = stats_json(day.stats, options.initial_capital);
+            day_entry["day"] = day.day;
+            per_day.push_back(day_entry);
+        }
+        entry["days"] = per_day;
+        results.push_back(entry);
+    }
+    summary["results"] = results;
+
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to write backtest summary " + path);
+    }
+    out << summary.dump(4) << std::endl;
+}
+
+} // namespace hft
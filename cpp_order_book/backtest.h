@@ -0,0 +1,80 @@
+#pragma once
+
+#include "order_book.h"
+#include "trading_strategy.h"
+#include "trade_log.h"
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace hft {
+
+// Values for each strategy parameter; a sweep runs every combination
+struct ParameterGrid {
+    std::vector<double> liquidity_thresholds{StrategyParams{}.liquidity_threshold};
+    std::vector<double> reverse_thresholds{StrategyParams{}.reverse_threshold};
+    std::vector<int> position_sizes{StrategyParams{}.position_size};
+    std::vector<int> hold_time_ticks{StrategyParams{}.hold_time_ticks};
+
+    // The cartesian product, varying hold_time_ticks fastest
+    std::vector<StrategyParams> expand() const;
+};
+
+// Parse grid values: a comma-separated list ("1.5,1.8,2.0"), a range
+// "first:last:step" ("1.5:2.0:0.25", last included), or a mix of both.
+// Throws std::invalid_argument for anything else.
+std::vector<double> parse_grid_values(const std::string& text);
+std::vector<int> parse_grid_ints(const std::string& text);
+
+// Short name for a parameter set, also its output directory: "lt1.8_rt0.6_ps100_ht15"
+std::string params_label(const StrategyParams& params);
+
+struct BacktestOptions {
+    std::string output_dir = "backtest_output";
+    std::string stream_dir;       // Decoded days; empty means output_dir/streams
+    size_t num_threads = 0;       // 0 means hardware concurrency
+    size_t group_size = 0;        // Parameter sets per pass over a day; 0 spreads them over the threads
+    BookEngine engine = BookEngine::Map;
+    ChangeDetection detection;
+    double initial_capital = 1000000.0;
+    bool reuse_streams = true;    // Skip decoding days whose stream is already up to date
+};
+
+// One parameter set on one day
+struct DayResult {
+    std::string day;  // Input file name
+    TradeStats stats;
+    std::vector<TradeRecord> trades;
+};
+
+// One parameter set over every day, in input order
+struct BacktestResult {
+    StrategyParams params;
+    std::vector<DayResult> days;
+    TradeStats stats;  // Over the trades of every day together
+};
+
+struct BacktestReport {
+    std::vector<std::string> days;
+    std::vector<size_t> day_updates;    // Updates replayed per day
+    std::vector<BacktestResult> results;  // In grid order
+    size_t days_decoded = 0;            // Days that were not already decoded
+    double decode_seconds = 0.0;
+    double backtest_seconds = 0.0;
+};
+
+// Decode each ITCH file once into an update stream (see update_stream.h),
+// then replay every day to every parameter set on a thread pool. Each pool
+// task makes one pass over one day's memory-mapped stream, feeding a group
+// of strategies, so the stream is read once per group rather than parsed
+// once per parameter set. Every strategy writes its trade log and
+// performance summary under output_dir/<label>/<day>/.
+BacktestReport run_backtests(const std::vector<std::string>& inputs,
+                             const std::vector<StrategyParams>& grid,
+                             const BacktestOptions& options);
+
+// Write the report as JSON, parameter sets ranked by total P&L
+void write_backtest_summary(const BacktestReport& report, const BacktestOptions& options,
+                            const std::string& path);
+
+} // namespace hft
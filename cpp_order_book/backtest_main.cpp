@@ -0,0 +1,131 @@
+#include "backtest.h"
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+using namespace hft;
+
+namespace {
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <input_file>..." << std::endl;
+    std::cerr << "  <input_file>   : Raw ITCH 5.0 files, one per day (optionally gzip/zstd-compressed)" << std::endl;
+    std::cerr << "  --liquidity G  : Liquidity thresholds to sweep (default 1.8)" << std::endl;
+    std::cerr << "  --reverse G    : Reverse thresholds (default 0.6)" << std::endl;
+    std::cerr << "  --size G       : Position sizes (default 100)" << std::endl;
+    std::cerr << "  --hold G       : Hold times in ticks (default 15)" << std::endl;
+    std::cerr << "                   G is a list (1.5,1.8,2.0), a range first:last:step (1.5:2.0:0.25), or both" << std::endl;
+    std::cerr << "  --output DIR   : Summary, per-run trade logs and decoded days (default backtest_output)" << std::endl;
+    std::cerr << "  --streams DIR  : Where decoded days are kept and reused (default OUTPUT/streams)" << std::endl;
+    std::cerr << "  --redecode     : Decode every day again even if its stream is up to date" << std::endl;
+    std::cerr << "  --threads N    : Worker threads (default: hardware concurrency)" << std::endl;
+    std::cerr << "  --group N      : Parameter sets fed per pass over a day (default: spread over the threads)" << std::endl;
+    std::cerr << "  --capital X    : Initial capital per run (default 1000000)" << std::endl;
+    std::cerr << "  --ladder       : Decode with the integer-tick ladder book instead of the std::map book" << std::endl;
+    std::cerr << "  --update-trigger T : totals (default), top or depth:N; see integrated_processor" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    ParameterGrid grid;
+    BacktestOptions options;
+    std::vector<std::string> inputs;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            const bool has_value = i + 1 < argc;
+            if (arg == "--liquidity" && has_value) {
+                grid.liquidity_thresholds = parse_grid_values(argv[++i]);
+            } else if (arg == "--reverse" && has_value) {
+                grid.reverse_thresholds = parse_grid_values(argv[++i]);
+            } else if (arg == "--size" && has_value) {
+                grid.position_sizes = parse_grid_ints(argv[++i]);
+            } else if (arg == "--hold" && has_value) {
+                grid.hold_time_ticks = parse_grid_ints(argv[++i]);
+            } else if (arg == "--output" && has_value) {
+                options.output_dir = argv[++i];
+            } else if (arg == "--streams" && has_value) {
+                options.stream_dir = argv[++i];
+            } else if (arg == "--redecode") {
+                options.reuse_streams = false;
+            } else if (arg == "--threads" && has_value) {
+                options.num_threads = std::stoul(argv[++i]);
+            } else if (arg == "--group" && has_value) {
+                options.group_size = std::stoul(argv[++i]);
+            } else if (arg == "--capital" && has_value) {
+                options.initial_capital = std::stod(argv[++i]);
+            } else if (arg == "--ladder") {
+                options.engine = BookEngine::Ladder;
+            } else if (arg == "--update-trigger" && has_value) {
+                options.detection = parse_change_detection(argv[++i]);
+            } else if (arg.rfind("--", 0) == 0) {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                print_usage(argv[0]);
+                return 1;
+            } else {
+                inputs.push_back(arg);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (inputs.empty()) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const std::vector<StrategyParams> params = grid.expand();
+    std::cout << "Backtesting " << params.size() << " parameter sets over " << inputs.size() << " days" << std::endl;
+
+    BacktestReport report;
+    const std::string summary_path = (std::filesystem::path(options.output_dir) / "backtest_summary.json").string();
+    try {
+        report = run_backtests(inputs, params, options);
+        write_backtest_summary(report, options, summary_path);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    size_t updates = 0;
+    for (size_t count : report.day_updates) {
+        updates += count;
+    }
+    std::cout << "Decoded " << report.days_decoded << " of " << report.days.size() << " days in "
+              << std::fixed << std::setprecision(2) << report.decode_seconds << " s" << std::endl;
+    std::cout << "Replayed " << updates << " updates to " << params.size() << " parameter sets in "
+              << report.backtest_seconds << " s ("
+              << std::setprecision(0) << updates * params.size() / std::max(report.backtest_seconds, 1e-9)
+              << " strategy updates/sec)" << std::endl;
+
+    // Best few by total P&L; the summary has them all
+    std::vector<const BacktestResult*> ranked;
+    for (const auto& result : report.results) {
+        ranked.push_back(&result);
+    }
+    std::stable_sort(ranked.begin(), ranked.end(), [](const BacktestResult* a, const BacktestResult* b) {
+        return a->stats.total_pnl > b->stats.total_pnl;
+    });
+    const size_t shown = std::min<size_t>(ranked.size(), 10);
+    std::cout << std::endl << std::left << std::setw(32) << "Parameters" << std::right
+              << std::setw(10) << "Trades" << std::setw(16) << "Total P&L"
+              << std::setw(10) << "Win %" << std::setw(10) << "Sharpe" << std::endl;
+    for (size_t i = 0; i < shown; i++) {
+        const BacktestResult& result = *ranked[i];
+        std::cout << std::left << std::setw(32) << params_label(result.params) << std::right
+                  << std::setw(10) << result.stats.num_trades
+                  << std::setw(16) << std::setprecision(2) << result.stats.total_pnl
+                  << std::setw(10) << result.stats.win_rate
+                  << std::setw(10) << result.stats.sharpe_ratio << std::endl;
+    }
+    std::cout << std::endl << "Summary written to " << summary_path << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "order_book.h"
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <filesystem>
+#include <utility>
+
+namespace hft {
+
+// When to snapshot the book during a replay. Either trigger (or both) may be set.
+struct CheckpointPolicy {
+    std::string directory = "snapshots";
+    uint64_t every_messages = 0;  // Messages between snapshots, 0 to disable
+    uint64_t every_ns = 0;        // Feed time between snapshots, 0 to disable
+    
+    bool enabled() const {
+        return every_messages > 0 || every_ns > 0;
+    }
+};
+
+// Writes book snapshots as a replay crosses the policy's message or feed-time
+// boundaries. Snapshots are named by message count, so the one to restart
+// from sorts last: <directory>/book_<messages>.snap
+class Checkpointer {
+public:
+    // `start` is where the replay began (a restored snapshot, or the start of the feed)
+    Checkpointer(const OrderBook& book, CheckpointPolicy policy, const FeedPosition& start = {})
+        : book_(book), policy_(std::move(policy)), last_messages_(start.messages) {
+        if (start.timestamp > 0 && policy_.every_ns > 0) {
+            next_timestamp_ = start.timestamp + policy_.every_ns;
+        }
+        if (policy_.enabled()) {
+            std::filesystem::create_directories(policy_.directory);
+        }
+    }
+    
+    // Call after each message is applied, with the offset of the next one.
+    // Returns true if a snapshot was written.
+    bool after_message(const FeedPosition& position) {
+        if (!policy_.enabled()) {
+            return false;
+        }
+        
+        bool due = policy_.every_messages > 0 &&
+                   position.messages - last_messages_ >= policy_.every_messages;
+        if (policy_.every_ns > 0) {
+            // The first timestamp seen starts the clock
+            if (next_timestamp_ == 0) {
+                next_timestamp_ = position.timestamp + policy_.every_ns;
+            } else if (position.timestamp >= next_timestamp_) {
+                due = true;
+            }
+        }
+        if (!due) {
+            return false;
+        }
+        
+        book_.save_snapshot(path_for(position.messages), position);
+        last_messages_ = position.messages;
+        if (policy_.every_ns > 0) {
+            next_timestamp_ = position.timestamp + policy_.every_ns;
+        }
+        written_++;
+        return true;
+    }
+    
+    size_t snapshots_written() const {
+        return written_;
+    }
+    
+    std::string path_for(uint64_t messages) const {
+        char name[48];
+        std::snprintf(name, sizeof(name), "/book_%012llu.snap", static_cast<unsigned long long>(messages));
+        return policy_.directory + name;
+    }
+
+private:
+    const OrderBook& book_;
+    CheckpointPolicy policy_;
+    uint64_t last_messages_ = 0;
+    uint64_t next_timestamp_ = 0;  // 0 until the first timestamp is seen
+    size_t written_ = 0;
+};
+
+} // namespace hft
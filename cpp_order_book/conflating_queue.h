@@ -0,0 +1,152 @@
+#pragma once
+
+#include "market_update.h"
+#include "ring_queue.h"
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+
+namespace hft {
+
+// Market update queue that keeps only the latest state per symbol.
+//
+// One slot per SymbolId plus a FIFO of symbols with a pending slot. Pushing
+// for a symbol that is still waiting overwrites its slot in place, so the
+// queue never holds more than one update per symbol and producers never
+// block: a consumer that falls behind sees fewer, fresher updates instead of
+// a growing backlog. Symbols come out in the order they first became pending.
+//
+// Same consumer interface as ConcurrentQueue: pop and pop_batch wait for an
+// update and return false / 0 once set_done() has been called and every
+// pending symbol has been taken.
+class ConflatingUpdateQueue {
+public:
+    ConflatingUpdateQueue()
+        : slots_(SymbolTable::MAX_SYMBOLS),
+          pending_(SymbolTable::MAX_SYMBOLS, 0),
+          order_(SymbolTable::MAX_SYMBOLS) {}
+    
+    ConflatingUpdateQueue(const ConflatingUpdateQueue&) = delete;
+    ConflatingUpdateQueue& operator=(const ConflatingUpdateQueue&) = delete;
+    
+    // Updates without a symbol have no slot and are dropped
+    void push(const MarketUpdate& update) {
+        if (update.symbol == INVALID_SYMBOL) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (done_) {
+                return;
+            }
+            slots_[update.symbol] = update;
+            if (pending_[update.symbol]) {
+                conflated_++;
+                return;
+            }
+            pending_[update.symbol] = 1;
+            order_[(head_ + count_) % order_.size()] = update.symbol;
+            count_++;
+            size_.store(count_, std::memory_order_release);
+        }
+        not_empty_.notify_one();
+    }
+    
+    bool pop(MarketUpdate& update) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!wait_for_update(lock)) {
+            return false;
+        }
+        update = take();
+        return true;
+    }
+    
+    // Replace updates with up to max pending updates, waiting for at least one.
+    // Returns 0 once done and drained.
+    size_t pop_batch(std::vector<MarketUpdate>& updates, size_t max) {
+        updates.clear();
+        if (max == 0) {
+            return 0;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!wait_for_update(lock)) {
+            return 0;
+        }
+        while (count_ > 0 && updates.size() < max) {
+            updates.push_back(take());
+        }
+        return updates.size();
+    }
+    
+    // Spin instead of sleeping while nothing is pending; call before the consumer starts
+    void set_consumer_busy_poll(bool busy_poll) {
+        busy_poll_ = busy_poll;
+    }
+    
+    void set_done() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
+        }
+        done_flag_.store(true, std::memory_order_release);
+        not_empty_.notify_all();
+    }
+    
+    // Symbols with an update waiting
+    size_t size() const {
+        return size_.load(std::memory_order_relaxed);
+    }
+    
+    // Updates overwritten before the consumer took them
+    size_t conflated() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return conflated_;
+    }
+
+private:
+    // Called with the lock held; false once done and drained
+    bool wait_for_update(std::unique_lock<std::mutex>& lock) {
+        if (busy_poll_) {
+            while (count_ == 0 && !done_) {
+                lock.unlock();
+                while (size_.load(std::memory_order_acquire) == 0 &&
+                       !done_flag_.load(std::memory_order_acquire)) {
+                    cpu_relax();
+                }
+                lock.lock();
+            }
+        } else {
+            not_empty_.wait(lock, [this] { return count_ > 0 || done_; });
+        }
+        return count_ > 0;
+    }
+    
+    // Called with the lock held and count_ > 0
+    MarketUpdate take() {
+        const SymbolId symbol = order_[head_];
+        head_ = (head_ + 1) % order_.size();
+        count_--;
+        size_.store(count_, std::memory_order_release);
+        pending_[symbol] = 0;
+        return slots_[symbol];
+    }
+    
+    std::vector<MarketUpdate> slots_;  // Latest update per symbol
+    std::vector<uint8_t> pending_;     // 1 while a symbol's slot is waiting in order_
+    std::vector<SymbolId> order_;      // Ring of pending symbols; each appears at most once
+    size_t head_ = 0;
+    size_t count_ = 0;
+    size_t conflated_ = 0;
+    bool done_ = false;
+    bool busy_poll_ = false;
+    
+    mutable std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::atomic<size_t> size_{0};         // Mirrors count_ for size() and busy polling
+    std::atomic<bool> done_flag_{false};  // Mirrors done_ for busy polling
+};
+
+} // namespace hft
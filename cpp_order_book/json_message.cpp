@@ -0,0 +1,320 @@
+#include "json_message.h"
+#include <charconv>
+#include <limits>
+
+namespace hft {
+
+namespace {
+
+// Fields seen while decoding, checked against what the message type needs
+constexpr unsigned HAS_LOCATE = 1 << 0;
+constexpr unsigned HAS_TIMESTAMP = 1 << 1;
+constexpr unsigned HAS_REFERENCE = 1 << 2;
+constexpr unsigned HAS_NEW_REFERENCE = 1 << 3;
+constexpr unsigned HAS_SHARES = 1 << 4;
+constexpr unsigned HAS_PRICE = 1 << 5;
+constexpr unsigned HAS_SIDE = 1 << 6;
+constexpr unsigned HAS_STOCK = 1 << 7;
+
+// Reads JSON values in place. The first error moves the cursor to the end of
+// the text, so every later read fails too and callers only check once.
+class JsonCursor {
+public:
+    explicit JsonCursor(std::string_view text)
+        : pos_(text.data()), end_(text.data() + text.size()) {}
+    
+    bool failed() const {
+        return failed_;
+    }
+    
+    // True if only whitespace is left
+    bool at_end() {
+        skip_space();
+        return pos_ == end_;
+    }
+    
+    // Call on_member(key) for each member of an object; it must consume the value
+    template <typename OnMember>
+    void object(OnMember&& on_member) {
+        if (!consume('{')) {
+            fail();
+            return;
+        }
+        if (consume('}')) {
+            return;
+        }
+        do {
+            std::string_view key = string();
+            if (failed_ || !consume(':')) {
+                fail();
+                return;
+            }
+            on_member(key);
+        } while (!failed_ && consume(','));
+        if (!consume('}')) {
+            fail();
+        }
+    }
+
+    // Contents of a string, with any escapes left as they are
+    std::string_view string() {
+        if (!consume('"')) {
+            fail();
+            return {};
+        }
+        const char* begin = pos_;
+        while (pos_ < end_ && *pos_ != '"') {
+            if (*pos_ == '\\' && pos_ + 1 < end_) {
+                ++pos_;
+            }
+            ++pos_;
+        }
+        if (pos_ >= end_) {
+            fail();
+            return {};
+        }
+        return std::string_view(begin, pos_++ - begin);
+    }
+
+    // Unsigned integer that must fit in T
+    template <typename T>
+    T number() {
+        skip_space();
+        T value = 0;
+        auto [next, error] = std::from_chars(pos_, end_, value);
+        if (error != std::errc()) {
+            fail();
+            return 0;
+        }
+        pos_ = next;
+        return value;
+    }
+
+    // Timestamps are numbers, or numbers in a string from some producers
+    uint64_t timestamp() {
+        skip_space();
+        if (pos_ == end_ || *pos_ != '"') {
+            return number<uint64_t>();
+        }
+        std::string_view text = string();
+        uint64_t value = 0;
+        auto [next, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (error != std::errc() || next != text.data() + text.size()) {
+            fail();
+        }
+        return value;
+    }
+
+    // Decimal price string ("101.2500") in 1/10000 dollars, rounded on the fifth decimal
+    uint32_t price() {
+        std::string_view text = string();
+        const char* pos = text.data();
+        const char* end = pos + text.size();
+        
+        uint64_t dollars = 0;
+        auto [next, error] = std::from_chars(pos, end, dollars);
+        if (error != std::errc()) {
+            fail();
+            return 0;
+        }
+        pos = next;
+        
+        uint64_t fraction = 0;
+        int digits = 0;
+        bool round_up = false;
+        if (pos < end && *pos == '.') {
+            ++pos;
+            for (; pos < end && is_digit(*pos); ++pos) {
+                if (digits < 4) {
+                    fraction = fraction * 10 + (*pos - '0');
+                } else if (digits == 4) {
+                    round_up = *pos >= '5';
+                }
+                digits++;
+            }
+        }
+        for (; digits < 4; digits++) {
+            fraction *= 10;
+        }
+        
+        if (pos != end || dollars > std::numeric_limits<uint32_t>::max() / 10000) {
+            fail();
+            return 0;
+        }
+        const uint64_t raw = dollars * 10000 + fraction + (round_up ? 1 : 0);
+        if (raw > std::numeric_limits<uint32_t>::max()) {
+            fail();
+            return 0;
+        }
+        return static_cast<uint32_t>(raw);
+    }
+
+    // Step over a value of any type
+    void skip() {
+        skip_space();
+        if (pos_ == end_) {
+            fail();
+            return;
+        }
+        if (*pos_ == '"') {
+            string();
+        } else if (*pos_ == '{') {
+            object([this](std::string_view) { skip(); });
+        } else if (*pos_ == '[') {
+            ++pos_;
+            if (consume(']')) {
+                return;
+            }
+            do {
+                skip();
+            } while (!failed_ && consume(','));
+            if (!consume(']')) {
+                fail();
+            }
+        } else {
+            // Number, true, false or null
+            const char* begin = pos_;
+            while (pos_ < end_ && *pos_ != ',' && *pos_ != '}' && *pos_ != ']' && !is_space(*pos_)) {
+                ++pos_;
+            }
+            if (pos_ == begin) {
+                fail();
+            }
+        }
+    }
+
+private:
+    const char* pos_;
+    const char* end_;
+    bool failed_ = false;
+
+    static bool is_space(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    static bool is_digit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    void skip_space() {
+        while (pos_ < end_ && is_space(*pos_)) {
+            ++pos_;
+        }
+    }
+
+    bool consume(char c) {
+        skip_space();
+        if (pos_ < end_ && *pos_ == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    void fail() {
+        failed_ = true;
+        pos_ = end_;
+    }
+};
+
+JsonBookMessage::Type type_for(std::string_view tag) {
+    using Type = JsonBookMessage::Type;
+    if (tag == "AddOrder") return Type::AddOrder;
+    if (tag == "StockDirectory") return Type::StockDirectory;
+    if (tag == "DeleteOrder") return Type::DeleteOrder;
+    if (tag == "OrderExecuted") return Type::OrderExecuted;
+    if (tag == "OrderExecutedWithPrice") return Type::OrderExecutedWithPrice;
+    if (tag == "OrderCancelled") return Type::OrderCancelled;
+    if (tag == "ReplaceOrder") return Type::ReplaceOrder;
+    return Type::Other;
+}
+
+// Fields each message type cannot be applied without
+unsigned required_fields(JsonBookMessage::Type type) {
+    using Type = JsonBookMessage::Type;
+    switch (type) {
+        case Type::AddOrder:
+            return HAS_REFERENCE | HAS_SHARES | HAS_PRICE | HAS_SIDE | HAS_STOCK | HAS_TIMESTAMP;
+        case Type::StockDirectory:
+            return HAS_STOCK | HAS_LOCATE;
+        case Type::DeleteOrder:
+            return HAS_REFERENCE;
+        case Type::OrderExecuted:
+        case Type::OrderExecutedWithPrice:
+        case Type::OrderCancelled:
+            return HAS_REFERENCE | HAS_SHARES;
+        case Type::ReplaceOrder:
+            return HAS_REFERENCE | HAS_NEW_REFERENCE | HAS_PRICE | HAS_SHARES;
+        default:
+            return 0;
+    }
+}
+
+// One field of the message body, e.g. "reference" of {"AddOrder":{...}}
+void decode_field(JsonCursor& cursor, std::string_view key, JsonBookMessage& message, unsigned& fields) {
+    if (key == "reference" || key == "old_reference") {
+        message.reference = cursor.number<uint64_t>();
+        fields |= HAS_REFERENCE;
+    } else if (key == "new_reference") {
+        message.new_reference = cursor.number<uint64_t>();
+        fields |= HAS_NEW_REFERENCE;
+    } else if (key == "shares" || key == "executed" || key == "cancelled") {
+        message.shares = cursor.number<uint32_t>();
+        fields |= HAS_SHARES;
+    } else if (key == "price") {
+        message.raw_price = cursor.price();
+        fields |= HAS_PRICE;
+    } else if (key == "side") {
+        std::string_view side = cursor.string();
+        message.buy = !side.empty() && side[0] == 'B';
+        fields |= HAS_SIDE;
+    } else if (key == "stock") {
+        message.stock = cursor.string();
+        fields |= HAS_STOCK;
+    } else {
+        cursor.skip();
+    }
+}
+
+} // namespace
+
+JsonDecodeResult decode_json_message(std::string_view text, JsonBookMessage& message) {
+    message = JsonBookMessage{};
+    JsonCursor cursor(text);
+    unsigned fields = 0;
+
+    cursor.object([&](std::string_view key) {
+        if (key == "body") {
+            // {"<MessageType>":{fields}}; only the types the book uses are decoded
+            cursor.object([&](std::string_view tag) {
+                message.type = type_for(tag);
+                if (message.type == JsonBookMessage::Type::Other) {
+                    cursor.skip();
+                    return;
+                }
+                cursor.object([&](std::string_view field) {
+                    decode_field(cursor, field, message, fields);
+                });
+            });
+        } else if (key == "stock_locate") {
+            message.stock_locate = cursor.number<SymbolId>();
+            fields |= HAS_LOCATE;
+        } else if (key == "timestamp") {
+            message.timestamp = cursor.timestamp();
+            fields |= HAS_TIMESTAMP;
+        } else {
+            cursor.skip();
+        }
+    });
+
+    if (cursor.failed() || !cursor.at_end()) {
+        return JsonDecodeResult::Malformed;
+    }
+    const unsigned required = required_fields(message.type);
+    if ((fields & required) != required) {
+        return JsonDecodeResult::MissingField;
+    }
+    return JsonDecodeResult::Ok;
+}
+
+} // namespace hft
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "symbol_table.h"
+#include <string_view>
+#include <cstdint>
+
+namespace hft {
+
+// The fields of one JSON feed message that the book acts on, decoded straight
+// from the text cpp_parser's JsonSerializer writes:
+//
+//   {"body":{"AddOrder":{"price":"101.2500","reference":7,...}},"stock_locate":1,...}
+//
+// Keys may come in any order and unknown keys are skipped, but values must have
+// the serializer's types (prices as decimal strings, integers as numbers).
+struct JsonBookMessage {
+    enum class Type : uint8_t {
+        Other,  // Valid message the book ignores
+        AddOrder,
+        StockDirectory,
+        DeleteOrder,
+        OrderExecuted,
+        OrderExecutedWithPrice,
+        OrderCancelled,
+        ReplaceOrder
+    };
+    
+    Type type = Type::Other;
+    SymbolId stock_locate = INVALID_SYMBOL;  // INVALID_SYMBOL when absent
+    uint64_t timestamp = 0;
+    uint64_t reference = 0;      // old_reference for ReplaceOrder
+    uint64_t new_reference = 0;  // ReplaceOrder only
+    uint32_t shares = 0;         // shares, executed or cancelled
+    uint32_t raw_price = 0;      // 1/10000 dollars
+    bool buy = false;            // AddOrder side
+    std::string_view stock;      // As in the feed (space padded); points into the decoded text
+};
+
+enum class JsonDecodeResult : uint8_t {
+    Ok,
+    Malformed,    // Not JSON, or a value of the wrong type
+    MissingField  // A field the message type needs is absent
+};
+
+// Outcome counts for decoded JSON messages, kept instead of logging each failure
+struct JsonDecodeStats {
+    uint64_t decoded = 0;         // Messages of a type the book uses
+    uint64_t ignored = 0;         // Valid messages of any other type
+    uint64_t malformed = 0;
+    uint64_t missing_fields = 0;
+    
+    void count(JsonDecodeResult result, JsonBookMessage::Type type) {
+        if (result == JsonDecodeResult::Malformed) {
+            malformed++;
+        } else if (result == JsonDecodeResult::MissingField) {
+            missing_fields++;
+        } else if (type == JsonBookMessage::Type::Other) {
+            ignored++;
+        } else {
+            decoded++;
+        }
+    }
+    
+    uint64_t rejected() const {
+        return malformed + missing_fields;
+    }
+};
+
+// Decode one message without building a DOM or copying strings. `message` is
+// fully reset first; on failure it holds whatever was decoded before the error.
+JsonDecodeResult decode_json_message(std::string_view text, JsonBookMessage& message);
+
+} // namespace hft
@@ -1,5 +1,8 @@
 #include "order_book.h"
 #include "trading_strategy.h"
+#include "checkpoint.h"
+#include "../cpp_parser/include/parser.h"
+#include "../cpp_parser/include/decompressor.h"
 #include <nlohmann/json.hpp>
 #include <fstream>
 #include <iostream>
@@ -33,152 +36,294 @@ void write_market_data(const std::string& symbol,
     output_file << market_data.dump() << std::endl;
 }
 
-std::vector<json> load_json_data(const std::string& filename, size_t max_messages = 0) {
-    std::vector<json> messages;
-    std::ifstream file(filename);
+// Feed the book and strategy with the current state of one stock
+template <typename Symbol>
+void publish_market_data(const Symbol& symbol,
+                         const std::string& stock,
+                         uint64_t timestamp,
+                         hft::OrderBook& order_book,
+                         hft::LiquidityReversionStrategy& strategy,
+                         std::ofstream& output_file) {
+    // Get market data for this stock (by symbol ID or name)
+    auto best_prices = order_book.get_best_prices(symbol);
+    auto volumes = order_book.get_volumes(symbol);
+    double imbalance = order_book.get_imbalance(symbol);
     
-    if (!file.is_open()) {
-        std::cerr << "Failed to open file: " << filename << std::endl;
-        return messages;
-    }
+    // Write market data to output
+    write_market_data(stock, best_prices, volumes, imbalance, timestamp, output_file);
     
-    // Check if the file starts with a '[' character
-    char first_char = file.peek();
-    bool is_json_array = (first_char == '[');
-    
-    if (is_json_array) {
-        // Skip the opening bracket
-        file.get();
+    // Execute trading strategy
+    strategy.process_market_update(
+        stock, 
+        best_prices.first,   // bid price
+        best_prices.second,  // ask price
+        volumes.first,       // bid volume
+        volumes.second,      // ask volume
+        imbalance,           // order book imbalance
+        timestamp            // timestamp
+    );
+}
+
+// Raw ITCH files start with a big-endian length prefix, JSON files with '[' or '{'.
+// Compressed files are assumed to hold ITCH.
+bool is_itch_file(const std::string& filename) {
+    itch::Compression format;
+    if (itch::detect_compression(filename, format)) {
+        return true;
     }
+    std::ifstream file(filename, std::ios::binary);
+    return file.is_open() && file.peek() == 0;
+}
+
+// Parse a raw ITCH file and apply every message straight to the book (no JSON).
+// Replay starts at `start` (a restored snapshot's position, or the top of the file)
+// and snapshots the book as the checkpoint policy asks.
+size_t process_itch_file(const std::string& filename,
+                         size_t max_messages,
+                         const std::vector<std::string>& stocks,
+                         hft::OrderBook& order_book,
+                         hft::LiquidityReversionStrategy& strategy,
+                         std::ofstream& output_file,
+                         std::set<std::string>& unique_stocks,
+                         const hft::FeedPosition& start,
+                         const hft::CheckpointPolicy& checkpoints) {
+    auto parser = itch::Parser::open(filename, itch::InputBackend::Stream);
+    if (start.offset > 0) {
+        parser->seek(start.offset);
+    }
+    hft::Checkpointer checkpointer(order_book, checkpoints, start);
+    hft::SymbolFilter filter(stocks);
+    std::vector<bool> seen(hft::SymbolTable::MAX_SYMBOLS, false);
+    auto start_time = std::chrono::high_resolution_clock::now();
     
-    std::string line;
-    size_t count = 0;
-    size_t line_number = 0;
-    
-    while (std::getline(file, line) && (max_messages == 0 || count < max_messages)) {
-        line_number++;
-        try {
-            // Trim whitespace
-            line.erase(0, line.find_first_not_of(" \t\n\r\f\v"));
-            line.erase(line.find_last_not_of(" \t\n\r\f\v") + 1);
-            
-            // Skip empty lines
-            if (line.empty()) {
-                continue;
-            }
-            
-            // Remove trailing comma if present
-            if (line.back() == ',') {
-                line.pop_back();
-            }
-            
-            // Skip if this is the closing bracket of the JSON array
-            if (line == "]" || line == "}]") {
-                continue;
-            }
-            
-            // Parse the JSON
-            json j = json::parse(line);
-            
-            // Extract the message body
-            if (j.contains("body")) {
-                messages.push_back(j);
-                count++;
-                
-                // Show progress
-                if (count % 10000 == 0) {
-                    std::cout << "Loaded " << count << " messages..." << std::endl;
+    size_t count = start.messages;
+    while (auto message = parser->parse_message()) {
+        const auto* add_order = std::get_if<itch::AddOrder>(&message->body);
+        std::string_view padded_stock;
+        if (add_order) {
+            padded_stock = std::string_view(add_order->stock.data(), add_order->stock.size());
+        }
+        
+        // Other order messages carry no symbol; the book ignores unknown references
+        if (!add_order || filter.allows(message->stock_locate, padded_stock)) {
+            // Any message that changes a symbol's book publishes it
+            const hft::SymbolId symbol = order_book.apply(*message);
+            if (symbol != hft::INVALID_SYMBOL) {
+                const std::string& stock = order_book.symbols().name(symbol);
+                if (!seen[symbol]) {
+                    seen[symbol] = true;
+                    unique_stocks.insert(stock);
                 }
+                publish_market_data(symbol, stock, message->timestamp, order_book, strategy, output_file);
             }
-        } catch (const std::exception& e) {
-            std::cerr << "Error parsing line " << line_number << " (skipping): " << e.what() << std::endl;
-            // Print a part of the problematic line for debugging
-            if (line.length() > 100) {
-                std::cerr << "Line starts with: " << line.substr(0, 100) << "..." << std::endl;
-            } else {
-                std::cerr << "Line: " << line << std::endl;
-            }
+        }
+        
+        // Show progress
+        count++;
+        if (count % 10000 == 0) {
+            auto current_time = std::chrono::high_resolution_clock::now();
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                current_time - start_time).count() / 1000.0;
+            double rate = (count - start.messages) / elapsed;
+            
+            std::cout << "Processed " << count << " messages (" << (rate) << " msgs/sec)" << std::endl;
+        }
+        
+        if (checkpointer.after_message({parser->offset(), count, message->timestamp})) {
+            std::cout << "Wrote snapshot " << checkpointer.path_for(count) << std::endl;
+        }
+        
+        if (max_messages > 0 && count >= max_messages) {
+            break;
         }
     }
     
-    std::cout << "Loaded " << messages.size() << " messages from " << filename << std::endl;
-    return messages;
+    if (checkpointer.snapshots_written() > 0) {
+        std::cout << "Wrote " << checkpointer.snapshots_written() << " snapshots to " << checkpoints.directory << std::endl;
+    }
+    return count;
 }
 
-std::vector<json> filter_messages_by_stocks(const std::vector<json>& messages, 
-                                           const std::vector<std::string>& stocks) {
-    if (stocks.empty()) {
-        return messages;  // No filtering needed
+// Stream a JSON file (one message per line, optionally wrapped in a JSON array)
+// into the book. Each line is decoded in place and applied before the next is
+// read, so memory stays flat however large the file is. The stock filter
+// matches AddOrders as in the ITCH path; other order messages carry no symbol
+// and always go through (the book ignores references it does not hold).
+size_t process_json_file(const std::string& filename,
+                         size_t max_messages,
+                         const std::vector<std::string>& stocks,
+                         hft::OrderBook& order_book,
+                         hft::LiquidityReversionStrategy& strategy,
+                         std::ofstream& output_file,
+                         std::set<std::string>& unique_stocks) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file: " << filename << std::endl;
+        return 0;
     }
     
-    std::vector<json> filtered;
-    std::set<std::string> stock_set(stocks.begin(), stocks.end());
+    // Skip the opening bracket of a JSON array
+    if (file.peek() == '[') {
+        file.get();
+    }
     
-    for (const auto& message : messages) {
-        try {
-            if (message.contains("body")) {
-                const auto& body = message["body"];
-                
-                // Check for AddOrder and filter by stock
-                if (body.contains("AddOrder") && body["AddOrder"].contains("stock")) {
-                    std::string stock = body["AddOrder"]["stock"];
-                    // Trim whitespace from stock symbol
-                    stock.erase(0, stock.find_first_not_of(" \t\n\r\f\v"));
-                    stock.erase(stock.find_last_not_of(" \t\n\r\f\v") + 1);
-                    
-                    if (stock_set.find(stock) != stock_set.end()) {
-                        filtered.push_back(message);
-                    }
-                }
-                // Include other message types for matched stocks
-                else if ((body.contains("DeleteOrder") || 
-                         body.contains("OrderExecuted") || 
-                         body.contains("OrderCancelled") || 
-                         body.contains("ReplaceOrder")) && 
-                         body.contains("reference")) {
-                    filtered.push_back(message);
+    hft::SymbolFilter filter(stocks);
+    std::vector<bool> seen(hft::SymbolTable::MAX_SYMBOLS, false);
+    hft::JsonDecodeStats stats;
+    hft::JsonBookMessage message;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    
+    std::string line;
+    size_t count = 0;
+    while ((max_messages == 0 || count < max_messages) && std::getline(file, line)) {
+        // Trim whitespace
+        std::string_view text(line);
+        const size_t first = text.find_first_not_of(" \t\n\r\f\v");
+        if (first == std::string_view::npos) {
+            continue;
+        }
+        text = text.substr(first, text.find_last_not_of(" \t\n\r\f\v") + 1 - first);
+            
+        // Remove trailing comma if present
+        if (text.back() == ',') {
+            text.remove_suffix(1);
+        }
+            
+        // Skip if this is the closing bracket of the JSON array
+        if (text == "]" || text == "}]") {
+            continue;
+        }
+        
+        // The last message of an array may share its line with the closing bracket
+        if (text.front() == '{' && text.back() == ']') {
+            text.remove_suffix(1);
+        }
+        
+        // Lines that do not decode are counted and reported once at the end
+        const hft::JsonDecodeResult result = hft::decode_json_message(text, message);
+        stats.count(result, message.type);
+        const bool add_order = message.type == hft::JsonBookMessage::Type::AddOrder;
+        if (result == hft::JsonDecodeResult::Ok &&
+            (!add_order || filter.allows(message.stock_locate, message.stock))) {
+            // Any message that changes a symbol's book publishes it
+            const hft::SymbolId symbol = order_book.apply(message);
+            if (symbol != hft::INVALID_SYMBOL) {
+                const std::string& stock = order_book.symbols().name(symbol);
+                if (!seen[symbol]) {
+                    seen[symbol] = true;
+                    unique_stocks.insert(stock);
                 }
+                publish_market_data(symbol, stock, message.timestamp, order_book, strategy, output_file);
             }
-        } catch (const std::exception& e) {
-            std::cerr << "Error filtering message: " << e.what() << std::endl;
+        }
+        
+        // Show progress
+        count++;
+        if (count % 10000 == 0) {
+            auto current_time = std::chrono::high_resolution_clock::now();
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                current_time - start_time).count() / 1000.0;
+            double rate = count / elapsed;
+            
+            std::cout << "Processed " << count << " messages (" << (rate) << " msgs/sec)" << std::endl;
         }
     }
     
-    std::cout << "Filtered to " << filtered.size() << " messages for specified stocks" << std::endl;
-    return filtered;
+    if (stats.rejected() > 0) {
+        std::cerr << "Skipped " << stats.malformed << " malformed JSON messages and "
+                  << stats.missing_fields << " missing required fields" << std::endl;
+    }
+    return count;
 }
 
-
-
 int main(int argc, char* argv[]) {
+    // Split option flags from positional arguments
+    hft::BookEngine engine = hft::BookEngine::Map;
+    hft::CheckpointPolicy checkpoints;
+    std::string resume_file;
+    std::string update_trigger = "totals";
+    std::vector<char*> args;
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--ladder") {
+            engine = hft::BookEngine::Ladder;
+        } else if (arg == "--checkpoint-every" && has_value) {
+            checkpoints.every_messages = std::stoull(argv[++i]);
+        } else if (arg == "--checkpoint-ns" && has_value) {
+            checkpoints.every_ns = std::stoull(argv[++i]);
+        } else if (arg == "--checkpoint-dir" && has_value) {
+            checkpoints.directory = argv[++i];
+        } else if (arg == "--resume" && has_value) {
+            resume_file = argv[++i];
+        } else if (arg == "--update-trigger" && has_value) {
+            update_trigger = argv[++i];
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    argc = static_cast<int>(args.size());
+    argv = args.data();
+
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_file> [num_messages] [output_file] [trading_output_dir] [stocks...]" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " [--ladder] [--checkpoint-every N] [--checkpoint-ns T] [--checkpoint-dir DIR] [--resume SNAPSHOT]"
+                  << " [--update-trigger totals|top|depth:N] <input_file> [num_messages] [output_file] [trading_output_dir] [stocks...]" << std::endl;
+        std::cerr << "  --ladder             : Use the integer-tick ladder book instead of the std::map book" << std::endl;
+        std::cerr << "  --checkpoint-every N : Snapshot the book every N messages (raw ITCH input)" << std::endl;
+        std::cerr << "  --checkpoint-ns T    : Snapshot the book every T nanoseconds of feed time (raw ITCH input)" << std::endl;
+        std::cerr << "  --checkpoint-dir DIR : Where snapshots go (default: snapshots)" << std::endl;
+        std::cerr << "  --resume SNAPSHOT    : Restore the book from a snapshot and continue the feed after it" << std::endl;
+        std::cerr << "  --update-trigger T   : Publish market data when a message changes a symbol's best prices and" << std::endl;
+        std::cerr << "                         side totals (totals, default), best-level sizes (top) or best N levels (depth:N)" << std::endl;
         return 1;
     }
-    
+
     // Parse command line arguments
     std::string input_file = argv[1];
     size_t num_messages = (argc > 2) ? std::stoi(argv[2]) : 0;
     std::string output_file = (argc > 3) ? argv[3] : "market_data.jsonl";
     std::string trading_output_dir = (argc > 4) ? argv[4] : "trading_output";
-    
+
     // Collect stock filters
     std::vector<std::string> stocks;
     for (int i = 5; i < argc; i++) {
         stocks.push_back(argv[i]);
     }
-    
-    // Load messages
-    auto messages = load_json_data(input_file, num_messages);
-    
-    // Filter messages if stocks specified
-    if (!stocks.empty()) {
-        messages = filter_messages_by_stocks(messages, stocks);
-    }
-    
+
+    const bool itch_input = is_itch_file(input_file);
+
     // Create order book
-    hft::OrderBook order_book;
-    
+    hft::OrderBook order_book(engine);
+    try {
+        order_book.set_change_detection(hft::parse_change_detection(update_trigger));
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    // Restart from a snapshot instead of replaying the feed from the top
+    hft::FeedPosition start;
+    if (checkpoints.enabled() && !itch_input) {
+        std::cerr << "Checkpoints are only taken for raw ITCH input, ignoring" << std::endl;
+    }
+    if (!resume_file.empty()) {
+        if (!itch_input) {
+            std::cerr << "--resume needs raw ITCH input" << std::endl;
+            return 1;
+        }
+        try {
+            auto load_start = std::chrono::high_resolution_clock::now();
+            start = order_book.load_snapshot(resume_file);
+            auto load_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::high_resolution_clock::now() - load_start).count();
+            std::cout << "Restored " << resume_file << " in " << load_ms << " ms, resuming after message "
+                      << start.messages << " (byte offset " << start.offset << ")" << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "Error restoring snapshot: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
     // Create trading strategy
     hft::LiquidityReversionStrategy strategy(
         order_book,
@@ -189,104 +334,55 @@ int main(int argc, char* argv[]) {
         100,                // Position size (from the Liquidity Reversion strategy)
         20                  // Hold time ticks (from the Liquidity Reversion strategy)
     );
-    
+
     // Open output file
     std::ofstream output_stream(output_file);
     if (!output_stream.is_open()) {
         std::cerr << "Failed to open output file: " << output_file << std::endl;
         return 1;
     }
-    
+
     // Process messages and generate market data
     auto start_time = std::chrono::high_resolution_clock::now();
     std::set<std::string> unique_stocks;
-    
+
     size_t count = 0;
-    for (const auto& message : messages) {
+    if (itch_input) {
+        std::cout << "Processing raw ITCH file " << input_file << std::endl;
         try {
-            // Convert to string
-            std::string message_json = message.dump();
-            
-            // Process message in order book
-            order_book.process_message(message_json);
-            
-            // Extract stock from message
-            std::string stock;
-            if (message.contains("body")) {
-                const auto& body = message["body"];
-                
-                if (body.contains("AddOrder") && body["AddOrder"].contains("stock")) {
-                    stock = body["AddOrder"]["stock"];
-                    // Trim whitespace from stock symbol
-                    stock.erase(0, stock.find_first_not_of(" \t\n\r\f\v"));
-                    stock.erase(stock.find_last_not_of(" \t\n\r\f\v") + 1);
-                    unique_stocks.insert(stock);
-                }
-            }
-            
-            // For each known stock, update market data if this is an important message type
-            if (!stock.empty()) {
-                // Get market data for this stock
-                auto best_prices = order_book.get_best_prices(stock);
-                auto volumes = order_book.get_volumes(stock);
-                double imbalance = order_book.get_imbalance(stock);
-                uint64_t timestamp = 0;
-                if (message.contains("timestamp")) {
-                    // Handle the timestamp which can be either a string or a number
-                    if (message["timestamp"].is_string()) {
-                        timestamp = std::stoull(message["timestamp"].get<std::string>());
-                    } else {
-                        timestamp = message["timestamp"].get<uint64_t>();
-                    }
-                }
-                
-                // Write market data to output
-                write_market_data(stock, best_prices, volumes, imbalance, timestamp, output_stream);
-                
-                // Execute trading strategy
-                strategy.process_market_update(
-                    stock, 
-                    best_prices.first,   // bid price
-                    best_prices.second,  // ask price
-                    volumes.first,       // bid volume
-                    volumes.second,      // ask volume
-                    imbalance,           // order book imbalance
-                    timestamp            // timestamp
-                );
-            }
-            
-            // Show progress
-            count++;
-            if (count % 10000 == 0) {
-                auto current_time = std::chrono::high_resolution_clock::now();
-                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-                    current_time - start_time).count() / 1000.0;
-                double rate = count / elapsed;
-                
-                std::cout << "Processed " << count << "/" << messages.size() 
-                          << " messages (" << (rate) << " msgs/sec)" << std::endl;
-            }
+            count = process_itch_file(input_file, num_messages, stocks, order_book, strategy,
+                                      output_stream, unique_stocks, start, checkpoints);
         } catch (const std::exception& e) {
-            std::cerr << "Error processing message: " << e.what() << std::endl;
+            std::cerr << "Error processing ITCH file: " << e.what() << std::endl;
+            return 1;
         }
+    } else {
+        std::cout << "Streaming JSON file " << input_file << std::endl;
+        count = process_json_file(input_file, num_messages, stocks, order_book, strategy,
+                                  output_stream, unique_stocks);
     }
-    
+
     // Calculate final performance metrics
     auto end_time = std::chrono::high_resolution_clock::now();
     auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
         end_time - start_time).count() / 1000.0;
     double rate = count / elapsed;
-    
+
     std::cout << "Processing complete!" << std::endl;
     std::cout << "Processed " << count << " messages in " << elapsed << " seconds" << std::endl;
     std::cout << "Rate: " << rate << " messages per second" << std::endl;
     std::cout << "Unique stocks processed: " << unique_stocks.size() << std::endl;
-    
+    if (engine == hft::BookEngine::Ladder) {
+        const hft::LadderStats ladder = order_book.ladder_stats();
+        std::cout << "Ladder levels: " << ladder.window_levels << " in window, " << ladder.overflow_levels
+                  << " in overflow, " << ladder.recenters << " window moves" << std::endl;
+    }
+
     // Print trading strategy performance
     strategy.print_performance();
-    
+
     // Close output file
     output_stream.close();
-    
+
     return 0;
 }
\ No newline at end of file
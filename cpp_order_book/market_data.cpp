@@ -0,0 +1,252 @@
+#include "market_data.h"
+#include <cstring>
+#include <cerrno>
+#include <new>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace hft {
+
+namespace {
+
+constexpr size_t header_size() {
+    return (sizeof(MarketDataRing::Header) + 63) & ~size_t{63};
+}
+
+size_t region_size(size_t capacity) {
+    return header_size() + (capacity + SymbolTable::MAX_SYMBOLS) * sizeof(MarketDataRing::Slot);
+}
+
+// shm_open names start with a single slash
+std::string shm_path(const std::string& name) {
+    return name.empty() || name[0] == '/' ? name : "/" + name;
+}
+
+std::runtime_error shm_error(const std::string& what, const std::string& name) {
+    return std::runtime_error(what + " market data ring " + name + ": " + std::strerror(errno));
+}
+
+} // namespace
+
+MarketDataRing::MarketDataRing(const std::string& shm_name, size_t capacity)
+    : name_(shm_name), owner_(true) {
+    capacity_ = round_up_pow2(capacity > 0 ? capacity : 1);
+    mask_ = capacity_ - 1;
+    region_size_ = region_size(capacity_);
+
+    int fd = -1;
+    if (!name_.empty()) {
+        fd = ::shm_open(shm_path(name_).c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw shm_error("Failed to create", name_);
+        }
+        if (::ftruncate(fd, static_cast<off_t>(region_size_)) != 0) {
+            ::close(fd);
+            ::shm_unlink(shm_path(name_).c_str());
+            throw shm_error("Failed to size", name_);
+        }
+    }
+    map_region(fd, true);
+
+    // Fresh mappings are zeroed, which is every slot's initial state; the
+    // header still needs its magic and sizes
+    header_ = new (region_) Header();
+    header_->capacity = capacity_;
+    ring_ = reinterpret_cast<Slot*>(static_cast<char*>(region_) + header_size());
+    states_ = ring_ + capacity_;
+}
+
+MarketDataRing MarketDataRing::attach(const std::string& shm_name) {
+    MarketDataRing ring;
+    ring.name_ = shm_name;
+
+    const int fd = ::shm_open(shm_path(shm_name).c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        throw shm_error("Failed to open", shm_name);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw shm_error("Failed to open", shm_name);
+    }
+    ring.region_size_ = static_cast<size_t>(info.st_size);
+    if (ring.region_size_ < header_size()) {
+        ::close(fd);
+        throw std::runtime_error(shm_name + " is not a market data ring");
+    }
+    ring.map_region(fd, false);
+
+    ring.header_ = static_cast<Header*>(ring.region_);
+    const Header expected;
+    if (std::memcmp(ring.header_->magic, expected.magic, sizeof(expected.magic)) != 0 ||
+        ring.header_->version != expected.version || ring.header_->record_size != expected.record_size ||
+        ring.header_->symbol_slots != expected.symbol_slots ||
+        ring.region_size_ != region_size(ring.header_->capacity)) {
+        throw std::runtime_error(shm_name + " is not a market data ring this build can read");
+    }
+    ring.capacity_ = ring.header_->capacity;
+    ring.mask_ = ring.capacity_ - 1;
+    ring.ring_ = reinterpret_cast<Slot*>(static_cast<char*>(ring.region_) + header_size());
+    ring.states_ = ring.ring_ + ring.capacity_;
+    return ring;
+}
+
+MarketDataRing::MarketDataRing(MarketDataRing&& other) noexcept
+    : name_(std::move(other.name_)),
+      owner_(other.owner_),
+      region_(other.region_),
+      region_size_(other.region_size_),
+      header_(other.header_),
+      ring_(other.ring_),
+      states_(other.states_),
+      capacity_(other.capacity_),
+      mask_(other.mask_) {
+    other.owner_ = false;
+    other.region_ = nullptr;
+}
+
+MarketDataRing::~MarketDataRing() {
+    if (region_) {
+        ::munmap(region_, region_size_);
+    }
+    if (owner_ && !name_.empty()) {
+        ::shm_unlink(shm_path(name_).c_str());
+    }
+}
+
+void MarketDataRing::map_region(int fd, bool create) {
+    const int protection = create ? PROT_READ | PROT_WRITE : PROT_READ;
+    const int flags = fd < 0 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_SHARED;
+    void* region = ::mmap(nullptr, region_size_, protection, flags, fd, 0);
+    const int error = errno;
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    if (region == MAP_FAILED) {
+        errno = error;
+        if (create && fd >= 0) {
+            ::shm_unlink(shm_path(name_).c_str());
+        }
+        throw shm_error("Failed to map", name_.empty() ? "(in-process)" : name_);
+    }
+    region_ = region;
+}
+
+void MarketDataRing::write_slot(Slot& slot, const MarketDataRecord& record) {
+    slot.stamp.store(BUSY, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&slot.record, &record, sizeof(record));
+    slot.stamp.store(record.sequence, std::memory_order_release);
+}
+
+bool MarketDataRing::read_slot(const Slot& slot, MarketDataRecord& record, uint64_t& stamp) {
+    stamp = slot.stamp.load(std::memory_order_acquire);
+    if (stamp == BUSY) {
+        return false;
+    }
+    std::memcpy(&record, &slot.record, sizeof(record));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.stamp.load(std::memory_order_relaxed) == stamp;
+}
+
+uint64_t MarketDataRing::publish(const MarketUpdate& update, std::string_view symbol) {
+    MarketDataRecord record;
+    record.sequence = header_->last_sequence.load(std::memory_order_relaxed) + 1;
+    record.kind = MarketDataKind::Delta;
+    record.set_symbol(symbol);
+    record.update = update;
+    record.update.feed_stamp = 0;  // Process-local cycle count, meaningless to subscribers
+
+    write_slot(ring_[(record.sequence - 1) & mask_], record);
+    if (update.symbol != INVALID_SYMBOL) {
+        write_slot(states_[update.symbol], record);
+    }
+    header_->last_sequence.store(record.sequence, std::memory_order_release);
+    return record.sequence;
+}
+
+int MarketDataRing::read(uint64_t sequence, MarketDataRecord& record) const {
+    if (sequence == 0 || sequence > last_sequence()) {
+        return 0;
+    }
+    uint64_t stamp;
+    // Busy or torn means the writer has moved on to sequence + capacity
+    if (!read_slot(ring_[(sequence - 1) & mask_], record, stamp) || stamp != sequence) {
+        return -1;
+    }
+    return 1;
+}
+
+bool MarketDataRing::read_state(SymbolId symbol, MarketDataRecord& record) const {
+    uint64_t stamp;
+    for (size_t attempt = 0; attempt < STATE_READ_ATTEMPTS; attempt++) {
+        if (read_slot(states_[symbol], record, stamp)) {
+            return stamp != 0;
+        }
+        cpu_relax();  // A live writer is mid-record and never holds a slot for long
+    }
+    return false;  // Left busy by a publisher that stopped mid-write
+}
+
+MarketDataReader::MarketDataReader(const MarketDataRing& ring, const std::vector<std::string>& symbols)
+    : ring_(ring),
+      filter_(symbols),
+      snapshot_sequence_(SymbolTable::MAX_SYMBOLS, 0) {}
+
+size_t MarketDataReader::poll(std::vector<MarketDataRecord>& out, size_t max) {
+    const size_t start = out.size();
+    if (needs_snapshot_) {
+        snapshot(out);
+    }
+
+    MarketDataRecord record;
+    while (out.size() - start < max) {
+        const int result = ring_.read(next_, record);
+        if (result == 0) {
+            break;
+        }
+        if (result < 0) {
+            recoveries_++;
+            snapshot(out);
+            continue;
+        }
+        next_++;
+        const SymbolId symbol = record.update.symbol;
+        if (record.sequence <= snapshot_sequence_[symbol] || !filter_.allows(symbol, record.symbol_name())) {
+            continue;
+        }
+        out.push_back(record);
+    }
+    return out.size() - start;
+}
+
+void MarketDataReader::snapshot(std::vector<MarketDataRecord>& out) {
+    needs_snapshot_ = false;
+    const uint64_t resume = ring_.last_sequence();
+
+    MarketDataRecord record;
+    uint32_t count = 0;
+    for (size_t id = 1; id < SymbolTable::MAX_SYMBOLS; id++) {
+        const SymbolId symbol = static_cast<SymbolId>(id);
+        snapshot_sequence_[symbol] = 0;
+        if (!ring_.read_state(symbol, record) || !filter_.allows(symbol, record.symbol_name())) {
+            continue;
+        }
+        snapshot_sequence_[symbol] = record.sequence;
+        record.kind = MarketDataKind::Snapshot;
+        out.push_back(record);
+        count++;
+    }
+
+    MarketDataRecord end;
+    end.sequence = resume;
+    end.kind = MarketDataKind::SnapshotEnd;
+    end.count = count;
+    out.push_back(end);
+    next_ = resume + 1;
+}
+
+} // namespace hft
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "market_update.h"
+#include "symbol_table.h"
+#include "ring_queue.h"
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+namespace hft {
+
+// Kinds of MarketDataRecord, in the shared-memory ring and on the wire
+enum class MarketDataKind : uint8_t {
+    Delta = 1,        // A symbol's book changed; update holds its new state
+    Snapshot = 2,     // A symbol's state as of the end of the snapshot
+    SnapshotEnd = 3,  // Last record of a snapshot; count is the number of Snapshot records before it
+    Heartbeat = 4     // Sent to idle TCP subscribers; sequence is the latest delta published
+};
+
+// One published record. Fixed size, little-endian, with the ticker in
+// every record, so a subscriber needs no other state to render it.
+//
+// sequence numbers the deltas from 1 without gaps. A Snapshot carries the
+// sequence of the delta it reflects, and SnapshotEnd the sequence the
+// deltas that follow it continue from.
+struct MarketDataRecord {
+    uint64_t sequence = 0;
+    MarketDataKind kind = MarketDataKind::Delta;
+    uint8_t reserved[3] = {};
+    uint32_t count = 0;  // SnapshotEnd only
+    char symbol[8] = {};  // NUL-padded when shorter than 8 characters
+    MarketUpdate update;
+    
+    std::string_view symbol_name() const {
+        size_t length = 0;
+        while (length < sizeof(symbol) && symbol[length] != '\0') {
+            length++;
+        }
+        return std::string_view(symbol, length);
+    }
+    
+    void set_symbol(std::string_view name) {
+        std::fill(std::begin(symbol), std::end(symbol), '\0');
+        std::copy(name.begin(), name.begin() + std::min(name.size(), sizeof(symbol)), symbol);
+    }
+};
+
+static_assert(std::is_trivially_copyable_v<MarketDataRecord>, "MarketDataRecord is copied as raw bytes");
+static_assert(sizeof(MarketDataRecord) == 56, "MarketDataRecord layout is part of the protocol");
+
+// Single-writer broadcast ring of deltas plus the latest record per symbol,
+// in POSIX shared memory (/dev/shm/<name>) or, without a name, in process
+// memory for in-process readers such as MarketDataServer.
+//
+// Region layout: a header, `capacity` ring slots, then one state slot per
+// SymbolId. Every slot is a cache line holding a stamp and a record. The
+// writer never waits for readers: a reader that falls more than `capacity`
+// deltas behind is lapped and recovers from the state slots (see
+// MarketDataReader). Slots are seqlocked: the stamp is BUSY while the
+// record is being written, and afterwards the record's sequence.
+class MarketDataRing {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1 << 16;  // Deltas kept for readers that fall behind
+    static constexpr uint64_t BUSY = ~uint64_t{0};
+    
+    // Tries read_state gives a busy or changing slot before treating it as
+    // absent. A write takes well under a microsecond, so a slot still busy
+    // after this many spins belongs to a publisher that died mid-record.
+    static constexpr size_t STATE_READ_ATTEMPTS = 1 << 16;
+    
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> stamp{0};
+        MarketDataRecord record;
+    };
+    
+    struct Header {
+        char magic[8] = {'H', 'F', 'T', 'M', 'D', 'R', 'N', 'G'};
+        uint32_t version = 1;
+        uint32_t record_size = sizeof(MarketDataRecord);
+        uint64_t capacity = 0;
+        uint64_t symbol_slots = SymbolTable::MAX_SYMBOLS;
+        alignas(64) std::atomic<uint64_t> last_sequence{0};  // Latest delta fully written
+    };
+    
+    // Create the ring, replacing any shared-memory object of the same name;
+    // an empty name keeps it in process memory. Throws std::runtime_error if
+    // shared memory cannot be set up.
+    explicit MarketDataRing(const std::string& shm_name, size_t capacity = DEFAULT_CAPACITY);
+    
+    // Attach a reader to a ring another process created
+    static MarketDataRing attach(const std::string& shm_name);
+    
+    MarketDataRing(MarketDataRing&& other) noexcept;
+    MarketDataRing& operator=(MarketDataRing&&) = delete;
+    MarketDataRing(const MarketDataRing&) = delete;
+    MarketDataRing& operator=(const MarketDataRing&) = delete;
+    
+    // Unmaps the region; the creator also unlinks the shared-memory name
+    ~MarketDataRing();
+    
+    // Writer only: publish one book change as the next delta and return its sequence
+    uint64_t publish(const MarketUpdate& update, std::string_view symbol);
+    
+    uint64_t last_sequence() const {
+        return header_->last_sequence.load(std::memory_order_acquire);
+    }
+    
+    size_t capacity() const { return capacity_; }
+    const std::string& name() const { return name_; }
+    
+    // Copy delta `sequence` if it is still in the ring.
+    // Returns 1 on success, 0 if it has not been published yet, -1 if it has been overwritten.
+    int read(uint64_t sequence, MarketDataRecord& record) const;
+    
+    // Copy the latest state of a symbol; false if it was never published, or
+    // if its slot stays busy for STATE_READ_ATTEMPTS tries
+    bool read_state(SymbolId symbol, MarketDataRecord& record) const;
+
+private:
+    MarketDataRing() = default;
+    
+    std::string name_;
+    bool owner_ = false;
+    void* region_ = nullptr;
+    size_t region_size_ = 0;
+    Header* header_ = nullptr;
+    Slot* ring_ = nullptr;
+    Slot* states_ = nullptr;
+    size_t capacity_ = 0;
+    size_t mask_ = 0;
+    
+    void map_region(int fd, bool create);
+    
+    static void write_slot(Slot& slot, const MarketDataRecord& record);
+    static bool read_slot(const Slot& slot, MarketDataRecord& record, uint64_t& stamp);
+};
+
+// Reads a MarketDataRing from its own cursor, keeping only the symbols
+// its filter allows.
+//
+// A reader starts with a snapshot: one Snapshot record per known symbol,
+// then SnapshotEnd, then deltas. If the writer laps it, it emits a fresh
+// snapshot and carries on from there. A state slot can be newer than the
+// point the snapshot resumes from, so deltas at or below the sequence a
+// symbol's Snapshot carried are skipped; what a subscriber sees per symbol
+// therefore never goes backwards.
+class MarketDataReader {
+public:
+    // Empty symbols means every symbol
+    explicit MarketDataReader(const MarketDataRing& ring, const std::vector<std::string>& symbols = {});
+    
+    // Append up to max deltas to out (a snapshot is always appended whole);
+    // returns how many records were appended. Never blocks: returns 0 when
+    // nothing new has been published.
+    size_t poll(std::vector<MarketDataRecord>& out, size_t max);
+    
+    // Start over with a snapshot on the next poll
+    void request_snapshot() { needs_snapshot_ = true; }
+    
+    // Snapshots taken after being lapped, not counting the first
+    size_t recoveries() const { return recoveries_; }
+    
+    // Sequence of the next delta this reader expects
+    uint64_t next_sequence() const { return next_; }
+
+private:
+    const MarketDataRing& ring_;
+    SymbolFilter filter_;
+    std::vector<uint64_t> snapshot_sequence_;  // Per symbol, from the latest snapshot
+    uint64_t next_ = 1;
+    bool needs_snapshot_ = true;
+    size_t recoveries_ = 0;
+    
+    void snapshot(std::vector<MarketDataRecord>& out);
+};
+
+} // namespace hft
@@ -0,0 +1,332 @@
+#include "market_data_server.h"
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+namespace hft {
+
+namespace {
+
+constexpr size_t RECORD_SIZE = sizeof(MarketDataRecord);
+constexpr size_t COMPACT_BYTES = 1 << 20;  // Sent bytes kept before the output buffer is compacted
+
+std::runtime_error socket_error(const std::string& what) {
+    return std::runtime_error("Market data server: " + what + ": " + std::strerror(errno));
+}
+
+} // namespace
+
+struct MarketDataServer::Client {
+    int fd = -1;
+    std::vector<char> input;
+    std::vector<char> output;  // Whole records from offset 0
+    size_t sent = 0;
+    std::unique_ptr<SymbolFilter> filter;  // Null until the first SubscribeRequest
+    bool needs_snapshot = false;
+    std::chrono::steady_clock::time_point last_write = std::chrono::steady_clock::now();
+
+    ~Client() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    bool subscribed() const {
+        return filter != nullptr;
+    }
+
+    bool allows(const MarketDataRecord& record) {
+        return filter->allows(record.update.symbol, record.symbol_name());
+    }
+
+    size_t pending() const {
+        return output.size() - sent;
+    }
+
+    void append(const MarketDataRecord& record) {
+        const char* bytes = reinterpret_cast<const char*>(&record);
+        output.insert(output.end(), bytes, bytes + RECORD_SIZE);
+        last_write = std::chrono::steady_clock::now();
+    }
+
+    // Forget every record not yet started, keeping the one on the wire whole
+    void drop_backlog() {
+        output.resize(std::min(output.size(), (sent + RECORD_SIZE - 1) / RECORD_SIZE * RECORD_SIZE));
+    }
+};
+
+MarketDataServer::MarketDataServer(const MarketDataRing& ring, uint16_t port, const std::string& address)
+    : ring_(ring),
+      reader_(ring),
+      latest_(SymbolTable::MAX_SYMBOLS) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (::inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+        throw std::runtime_error("Market data server: invalid address " + address);
+    }
+
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        throw socket_error("socket");
+    }
+    const int one = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listen_fd_, 64) != 0) {
+        const auto error = socket_error("cannot listen on " + address + ":" + std::to_string(port));
+        ::close(listen_fd_);
+        throw error;
+    }
+    socklen_t length = sizeof(addr);
+    ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &length);
+    port_ = ntohs(addr.sin_port);
+
+    thread_ = std::thread([this] { run(); });
+}
+
+MarketDataServer::~MarketDataServer() {
+    stop();
+    ::close(listen_fd_);
+}
+
+void MarketDataServer::stop() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    stopping_.store(true, std::memory_order_release);
+    thread_.join();
+}
+
+void MarketDataServer::run() {
+    std::vector<MarketDataRecord> records;
+    std::vector<pollfd> fds;
+    records.reserve(READ_BATCH);
+
+    while (true) {
+        const bool stopping = stopping_.load(std::memory_order_acquire);
+        records.clear();
+        reader_.poll(records, READ_BATCH);
+        apply(records);
+
+        const auto now = std::chrono::steady_clock::now();
+        for (auto& client : clients_) {
+            if (!client->subscribed()) {
+                continue;
+            }
+            if (client->needs_snapshot) {
+                send_snapshot(*client);
+            } else if (client->pending() == 0 && now - client->last_write >= HEARTBEAT_INTERVAL) {
+                MarketDataRecord heartbeat;
+                heartbeat.sequence = position_;
+                heartbeat.kind = MarketDataKind::Heartbeat;
+                client->append(heartbeat);
+            }
+        }
+
+        // Write what each client can take now; poll waits for the rest
+        for (auto& client : clients_) {
+            if (client->pending() > 0 && !flush(*client)) {
+                client.reset();
+            }
+        }
+        clients_.erase(std::remove(clients_.begin(), clients_.end(), nullptr), clients_.end());
+        client_count_.store(clients_.size(), std::memory_order_relaxed);
+
+        if (stopping && records.empty()) {
+            break;
+        }
+
+        fds.clear();
+        fds.push_back({listen_fd_, POLLIN, 0});
+        for (const auto& client : clients_) {
+            fds.push_back({client->fd, static_cast<short>(POLLIN | (client->pending() > 0 ? POLLOUT : 0)), 0});
+        }
+        // A full batch means the ring has more waiting
+        const int timeout = records.size() == READ_BATCH ? 0 : POLL_TIMEOUT_MS;
+        if (::poll(fds.data(), fds.size(), timeout) <= 0) {
+            continue;
+        }
+
+        for (size_t i = 1; i < fds.size(); i++) {
+            Client& client = *clients_[i - 1];
+            const bool readable = fds[i].revents & (POLLIN | POLLHUP | POLLERR);
+            const bool writable = fds[i].revents & POLLOUT;
+            if ((readable && !read_requests(client)) || (writable && !flush(client))) {
+                clients_[i - 1].reset();
+            }
+        }
+        clients_.erase(std::remove(clients_.begin(), clients_.end(), nullptr), clients_.end());
+        if (fds[0].revents & POLLIN) {
+            accept_clients();
+        }
+        client_count_.store(clients_.size(), std::memory_order_relaxed);
+    }
+
+    clients_.clear();
+    client_count_.store(0, std::memory_order_relaxed);
+}
+
+void MarketDataServer::accept_clients() {
+    while (true) {
+        const int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;  // EAGAIN once the backlog is empty; anything else is the client's problem
+        }
+        const int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        auto client = std::make_unique<Client>();
+        client->fd = fd;
+        clients_.push_back(std::move(client));
+    }
+}
+
+bool MarketDataServer::read_requests(Client& client) {
+    char buffer[4096];
+    while (true) {
+        const ssize_t received = ::recv(client.fd, buffer, sizeof(buffer), 0);
+        if (received == 0) {
+            return false;
+        }
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return false;
+        }
+        client.input.insert(client.input.end(), buffer, buffer + received);
+    }
+
+    // Act on every complete request; anything malformed drops the client
+    size_t offset = 0;
+    const SubscribeRequest expected;
+    while (client.input.size() - offset >= sizeof(SubscribeRequest)) {
+        SubscribeRequest request;
+        std::memcpy(&request, client.input.data() + offset, sizeof(request));
+        if (std::memcmp(request.magic, expected.magic, sizeof(expected.magic)) != 0 ||
+            request.count >= SymbolTable::MAX_SYMBOLS) {
+            return false;
+        }
+        const size_t size = sizeof(request) + request.count * 8;
+        if (client.input.size() - offset < size) {
+            break;
+        }
+
+        std::vector<std::string> symbols;
+        const char* names = client.input.data() + offset + sizeof(request);
+        for (uint32_t i = 0; i < request.count; i++) {
+            const char* name = names + i * 8;
+            symbols.emplace_back(SymbolTable::trim(std::string_view(name, strnlen(name, 8))));
+        }
+        client.filter = std::make_unique<SymbolFilter>(symbols);
+        client.drop_backlog();
+        client.needs_snapshot = true;
+        offset += size;
+    }
+    client.input.erase(client.input.begin(), client.input.begin() + offset);
+    return true;
+}
+
+void MarketDataServer::apply(const std::vector<MarketDataRecord>& records) {
+    for (const auto& record : records) {
+        const SymbolId symbol = record.update.symbol;
+        switch (record.kind) {
+            case MarketDataKind::Snapshot:
+            case MarketDataKind::Delta:
+                if (latest_[symbol].sequence == 0) {
+                    known_.push_back(symbol);
+                }
+                latest_[symbol] = record;
+                break;
+            case MarketDataKind::SnapshotEnd:
+                // The server was lapped (or just started): every client starts over
+                position_ = record.sequence;
+                for (auto& client : clients_) {
+                    client->needs_snapshot = client->subscribed();
+                    client->drop_backlog();
+                }
+                continue;
+            case MarketDataKind::Heartbeat:
+                continue;
+        }
+        if (record.kind != MarketDataKind::Delta) {
+            continue;
+        }
+
+        position_ = record.sequence;
+        for (auto& client : clients_) {
+            if (!client->subscribed() || client->needs_snapshot || !client->allows(record)) {
+                continue;
+            }
+            client->append(record);
+            records_sent_.fetch_add(1, std::memory_order_relaxed);
+            if (client->pending() > MAX_PENDING_BYTES) {
+                client->drop_backlog();
+                client->needs_snapshot = true;
+            }
+        }
+    }
+}
+
+void MarketDataServer::send_snapshot(Client& client) {
+    uint32_t count = 0;
+    for (SymbolId symbol : known_) {
+        MarketDataRecord record = latest_[symbol];
+        if (!client.allows(record)) {
+            continue;
+        }
+        record.kind = MarketDataKind::Snapshot;
+        client.append(record);
+        count++;
+    }
+
+    MarketDataRecord end;
+    end.sequence = position_;
+    end.kind = MarketDataKind::SnapshotEnd;
+    end.count = count;
+    client.append(end);
+    client.needs_snapshot = false;
+    records_sent_.fetch_add(count + 1, std::memory_order_relaxed);
+    snapshots_sent_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool MarketDataServer::flush(Client& client) {
+    while (client.pending() > 0) {
+        const ssize_t written = ::send(client.fd, client.output.data() + client.sent, client.pending(),
+                                       MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return false;
+        }
+        client.sent += static_cast<size_t>(written);
+    }
+
+    if (client.sent == client.output.size()) {
+        client.output.clear();
+        client.sent = 0;
+    } else if (client.sent >= COMPACT_BYTES) {
+        // Drop whole sent records only, so the buffer still starts on a record
+        const size_t whole = client.sent / RECORD_SIZE * RECORD_SIZE;
+        client.output.erase(client.output.begin(), client.output.begin() + whole);
+        client.sent -= whole;
+    }
+    return true;
+}
+
+} // namespace hft
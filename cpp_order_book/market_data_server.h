@@ -0,0 +1,87 @@
+#pragma once
+
+#include "market_data.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace hft {
+
+// Subscription request a TCP client sends to MarketDataServer: this header,
+// then `count` 8-byte symbols, NUL- or space-padded. count 0 subscribes to
+// every symbol. Sending another request replaces the filter and starts a
+// fresh snapshot.
+struct SubscribeRequest {
+    char magic[4] = {'M', 'D', 'S', 'B'};
+    uint32_t count = 0;
+};
+
+static_assert(sizeof(SubscribeRequest) == 8, "SubscribeRequest layout is part of the protocol");
+
+// Streams a MarketDataRing to remote subscribers over TCP as raw
+// MarketDataRecords.
+//
+// One thread reads the ring like any other MarketDataReader and keeps the
+// latest record per symbol, so each new or re-subscribing client gets a
+// snapshot consistent with the position the server has reached, then the
+// deltas its filter allows. Sockets are non-blocking and the book never
+// waits on a client: one that lets more than MAX_PENDING_BYTES pile up has
+// its backlog dropped and gets a fresh snapshot instead, as does everyone
+// if the server itself is lapped. Idle clients get a Heartbeat every second.
+class MarketDataServer {
+public:
+    static constexpr size_t MAX_PENDING_BYTES = 4 << 20;
+    static constexpr size_t READ_BATCH = 4096;  // Records taken from the ring per pass
+    static constexpr std::chrono::milliseconds HEARTBEAT_INTERVAL{1000};
+    static constexpr int POLL_TIMEOUT_MS = 1;   // Longest a delta waits when no socket is busy
+    
+    // Listen on address:port (port 0 picks a free one) and start serving.
+    // Throws std::runtime_error if the socket cannot be set up.
+    MarketDataServer(const MarketDataRing& ring, uint16_t port, const std::string& address = "0.0.0.0");
+    
+    // Stops the server and disconnects every client
+    ~MarketDataServer();
+    
+    MarketDataServer(const MarketDataServer&) = delete;
+    MarketDataServer& operator=(const MarketDataServer&) = delete;
+    
+    // Serve whatever is still in the ring, then stop
+    void stop();
+    
+    uint16_t port() const { return port_; }
+    size_t clients() const { return client_count_.load(std::memory_order_relaxed); }
+    size_t records_sent() const { return records_sent_.load(std::memory_order_relaxed); }
+    size_t snapshots_sent() const { return snapshots_sent_.load(std::memory_order_relaxed); }
+
+private:
+    struct Client;
+    
+    const MarketDataRing& ring_;
+    MarketDataReader reader_;
+    int listen_fd_ = -1;
+    uint16_t port_ = 0;
+    std::vector<std::unique_ptr<Client>> clients_;  // Server thread only
+    std::vector<MarketDataRecord> latest_;          // Latest record per symbol
+    std::vector<SymbolId> known_;                   // Symbols with a record in latest_
+    uint64_t position_ = 0;                         // Last delta processed
+    
+    std::atomic<bool> stopping_{false};
+    std::atomic<size_t> client_count_{0};
+    std::atomic<size_t> records_sent_{0};
+    std::atomic<size_t> snapshots_sent_{0};
+    std::thread thread_;
+    
+    void run();
+    void accept_clients();
+    bool read_requests(Client& client);
+    void apply(const std::vector<MarketDataRecord>& records);
+    void send_snapshot(Client& client);
+    bool flush(Client& client);
+};
+
+} // namespace hft
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "symbol_table.h"
+#include <cstdint>
+#include <type_traits>
+
+namespace hft {
+
+// Top-of-book snapshot handed from a book thread to the strategy thread.
+// No symbol string to allocate or hash, and prices stay in exact ITCH units
+// (1/10000 dollars) until the strategy reads them, so queues move it as a
+// plain 32-byte copy.
+struct MarketUpdate {
+    uint64_t timestamp = 0;
+    uint32_t bid_price = 0;   // 0 when the side is empty
+    uint32_t ask_price = 0;
+    uint32_t bid_volume = 0;  // Shares resting on each side
+    uint32_t ask_volume = 0;
+    SymbolId symbol = INVALID_SYMBOL;
+    uint32_t feed_stamp = 0;  // cycle_stamp() of the message's arrival, 0 when metrics are off
+
+    double bid() const { return bid_price / 10000.0; }
+    double ask() const { return ask_price / 10000.0; }
+
+    // Same ratio as OrderBook::get_imbalance
+    double imbalance() const {
+        if (bid_volume + ask_volume == 0) return 0.0;
+        return static_cast<double>(bid_volume) / (bid_volume + ask_volume);
+    }
+};
+
+static_assert(std::is_trivially_copyable_v<MarketUpdate>, "MarketUpdate is copied through queues with memcpy");
+static_assert(sizeof(MarketUpdate) == 32, "MarketUpdate should stay at half a cache line");
+
+} // namespace hft
@@ -0,0 +1,204 @@
+#include "metrics.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace hft {
+
+namespace {
+
+std::atomic<uint64_t> next_metrics_id{1};
+
+} // namespace
+
+void HistogramSnapshot::add(const LatencyHistogram& histogram) {
+    // Buckets are summed into the total, so a concurrent record never leaves it short of them
+    uint64_t added = 0;
+    for (size_t bucket = 0; bucket < counts_.size(); ++bucket) {
+        const uint64_t count = histogram.bucket_count(bucket);
+        counts_[bucket] += count;
+        added += count;
+    }
+    count_ += added;
+    sum_ += histogram.sum();
+    max_ = std::max(max_, histogram.max());
+}
+
+uint64_t HistogramSnapshot::value_at(double percentile) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    const double clamped = std::min(100.0, std::max(0.0, percentile));
+    const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(clamped / 100.0 * count_ + 0.5));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < counts_.size(); ++bucket) {
+        seen += counts_[bucket];
+        if (seen >= target) {
+            return std::min(LatencyHistogram::highest_value(bucket), max_);
+        }
+    }
+    return max_;
+}
+
+std::string_view stage_name(Stage stage) {
+    switch (stage) {
+        case Stage::Decode: return "decode";
+        case Stage::Serialize: return "serialize";
+        case Stage::JsonDecode: return "json_decode";
+        case Stage::BookApply: return "book_apply";
+        case Stage::UpdateEmit: return "update_emit";
+        case Stage::StrategyDecision: return "strategy_decision";
+        case Stage::FeedToSignal: return "feed_to_signal";
+    }
+    return "unknown";
+}
+
+PipelineMetrics::PipelineMetrics()
+    : id_(next_metrics_id++),
+      start_cycles_(cycle_clock()),
+      start_time_(std::chrono::steady_clock::now()),
+      reported_time_(start_time_) {}
+
+PipelineMetrics::~PipelineMetrics() {
+    try {
+        stop_reporting();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+LatencyHistogram& PipelineMetrics::add_histogram(Stage stage) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& list = histograms_[static_cast<size_t>(stage)];
+    list.push_back(std::make_unique<LatencyHistogram>());
+    return *list.back();
+}
+
+void PipelineMetrics::add_gauge(const std::string& name, std::function<size_t()> read) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    gauges_.push_back(Gauge{name, std::move(read)});
+}
+
+void PipelineMetrics::remove_gauge(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    gauges_.erase(std::remove_if(gauges_.begin(), gauges_.end(),
+                                 [&](const Gauge& gauge) { return gauge.name == name; }),
+                  gauges_.end());
+}
+
+double PipelineMetrics::cycles_per_ns() const {
+    // Wait out a few milliseconds first so an early report still gets a usable rate
+    std::chrono::steady_clock::time_point now;
+    do {
+        now = std::chrono::steady_clock::now();
+    } while (now - start_time_ < std::chrono::milliseconds(5));
+    const uint64_t cycles = cycle_clock() - start_cycles_;
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_time_).count();
+    return static_cast<double>(cycles) / elapsed;
+}
+
+void PipelineMetrics::start_reporting(const std::string& path, std::chrono::milliseconds interval) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (reporter_.joinable()) {
+        throw std::runtime_error("Metrics reporter already running");
+    }
+    output_.open(path, std::ios::trunc);
+    if (!output_.is_open()) {
+        throw std::runtime_error("Failed to open metrics file: " + path);
+    }
+    stopping_ = false;
+    
+    reporter_ = std::thread([this, interval] {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto next_report = std::chrono::steady_clock::now() + interval;
+        while (!stop_signal_.wait_for(lock, SAMPLE_INTERVAL, [this] { return stopping_; })) {
+            sample_gauges();
+            if (std::chrono::steady_clock::now() >= next_report) {
+                output_ << report_locked(false) << '\n' << std::flush;
+                next_report += interval;
+            }
+        }
+    });
+}
+
+void PipelineMetrics::stop_reporting() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!reporter_.joinable()) {
+            return;
+        }
+        stopping_ = true;
+    }
+    stop_signal_.notify_all();
+    reporter_.join();
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    sample_gauges();
+    output_ << report_locked(true) << '\n';
+    output_.close();
+    if (output_.fail()) {
+        throw std::runtime_error("Failed to write metrics file");
+    }
+}
+
+std::string PipelineMetrics::report(bool final) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sample_gauges();
+    return report_locked(final);
+}
+
+void PipelineMetrics::sample_gauges() {
+    for (Gauge& gauge : gauges_) {
+        gauge.last = gauge.read();
+        gauge.max = std::max(gauge.max, gauge.last);
+    }
+}
+
+std::string PipelineMetrics::report_locked(bool final) {
+    const auto now = std::chrono::steady_clock::now();
+    const double interval_s = std::chrono::duration<double>(now - reported_time_).count();
+    const double ns_per_cycle = 1.0 / cycles_per_ns();
+    reported_time_ = now;
+    
+    nlohmann::json report;
+    report["elapsed_s"] = std::chrono::duration<double>(now - start_time_).count();
+    report["final"] = final;
+    report["cycles_per_ns"] = 1.0 / ns_per_cycle;
+    
+    // Counts and percentiles cover the whole run so far; rate covers the last interval
+    nlohmann::json stages = nlohmann::json::object();
+    for (size_t i = 0; i < STAGE_COUNT; ++i) {
+        HistogramSnapshot snapshot;
+        for (const auto& histogram : histograms_[i]) {
+            snapshot.add(*histogram);
+        }
+        if (snapshot.count() == 0) {
+            continue;
+        }
+        const uint64_t new_samples = snapshot.count() - reported_counts_[i];
+        reported_counts_[i] = snapshot.count();
+        
+        nlohmann::json& stage = stages[std::string(stage_name(static_cast<Stage>(i)))];
+        stage["count"] = snapshot.count();
+        stage["threads"] = histograms_[i].size();
+        stage["rate"] = interval_s > 0 ? new_samples / interval_s : 0.0;
+        stage["mean_ns"] = snapshot.mean() * ns_per_cycle;
+        stage["p50_ns"] = snapshot.value_at(50.0) * ns_per_cycle;
+        stage["p99_ns"] = snapshot.value_at(99.0) * ns_per_cycle;
+        stage["p999_ns"] = snapshot.value_at(99.9) * ns_per_cycle;
+        stage["max_ns"] = snapshot.max() * ns_per_cycle;
+    }
+    report["stages"] = std::move(stages);
+    
+    nlohmann::json gauges = nlohmann::json::object();
+    for (Gauge& gauge : gauges_) {
+        gauges[gauge.name] = {{"last", gauge.last}, {"max", gauge.max}};
+        gauge.max = gauge.last;
+    }
+    report["gauges"] = std::move(gauges);
+    
+    return report.dump();
+}
+
+} // namespace hft
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace hft {
+
+// Raw cycle counter: the TSC on x86, the virtual counter on ARM64 and
+// steady_clock nanoseconds anywhere else. The TSC is assumed invariant
+// (constant rate, in step across cores), as on any recent x86 server.
+inline uint64_t cycle_clock() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t value;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// 32-bit cycle stamps fit in spare bytes of the structs that carry them.
+// On x86 they count units of 16 cycles, so they only wrap after tens of
+// seconds; 0 means "not stamped".
+#if defined(__x86_64__) || defined(__i386__)
+constexpr int CYCLE_STAMP_SHIFT = 4;
+#else
+constexpr int CYCLE_STAMP_SHIFT = 0;
+#endif
+
+inline uint32_t cycle_stamp() {
+    const uint32_t stamp = static_cast<uint32_t>(cycle_clock() >> CYCLE_STAMP_SHIFT);
+    return stamp != 0 ? stamp : 1;
+}
+
+inline uint64_t cycles_since(uint32_t stamp) {
+    return static_cast<uint64_t>(static_cast<uint32_t>(cycle_stamp() - stamp)) << CYCLE_STAMP_SHIFT;
+}
+
+// Log-linear (HDR style) histogram of cycle counts: 32 linear buckets per
+// power of two, so a value is reported within 1/32 of what was recorded.
+// One thread records into it; any thread may read it at the same time.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+    static constexpr size_t BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+    
+    void record(uint64_t value) {
+        bump(counts_[index(value)], 1);
+        bump(count_, 1);
+        bump(sum_, value);
+        if (value > max_.load(std::memory_order_relaxed)) {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+    
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    uint64_t bucket_count(size_t bucket) const { return counts_[bucket].load(std::memory_order_relaxed); }
+    
+    static size_t index(uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return static_cast<size_t>(value);
+        }
+        const int exponent = 63 - __builtin_clzll(value);
+        const int shift = exponent - SUB_BUCKET_BITS;
+        return (shift + 1) * SUB_BUCKETS + ((value >> shift) & (SUB_BUCKETS - 1));
+    }
+    
+    // Largest value that lands in a bucket
+    static uint64_t highest_value(size_t bucket) {
+        if (bucket < SUB_BUCKETS) {
+            return bucket;
+        }
+        const int shift = static_cast<int>(bucket / SUB_BUCKETS) - 1;
+        const uint64_t lowest = (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+        return lowest + ((uint64_t(1) << shift) - 1);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> counts_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+    
+    // Single writer, so a plain load and store instead of a locked add
+    static void bump(std::atomic<uint64_t>& counter, uint64_t amount) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+};
+
+// Several LatencyHistograms added together, read when reporting
+class HistogramSnapshot {
+public:
+    HistogramSnapshot() : counts_(LatencyHistogram::BUCKETS, 0) {}
+    
+    void add(const LatencyHistogram& histogram);
+    
+    uint64_t count() const { return count_; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ > 0 ? static_cast<double>(sum_) / count_ : 0.0; }
+    
+    // Value at or below which `percentile` percent of the samples fall
+    uint64_t value_at(double percentile) const;
+
+private:
+    std::vector<uint64_t> counts_;
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t max_ = 0;
+};
+
+// Pipeline stages with a latency histogram each
+enum class Stage : uint8_t {
+    Decode,            // Parsing one ITCH message
+    Serialize,         // Writing one message as JSON (JSON path)
+    JsonDecode,        // Decoding one JSON message back for the book (JSON path)
+    BookApply,         // OrderBook::apply for one message
+    UpdateEmit,        // Snapshotting the book and queueing the MarketUpdate
+    StrategyDecision,  // The strategy handling one MarketUpdate
+    FeedToSignal       // Processor taking a message's batch off the parser queue to the strategy's decision
+};
+
+constexpr size_t STAGE_COUNT = 7;
+
+std::string_view stage_name(Stage stage);
+
+// Metrics shared by the pipeline's threads: a histogram per stage for each
+// thread that records into it, plus named gauges (queue depths) sampled by a
+// reporter thread. The reporter appends one JSON object per interval to its
+// output file, with per-stage counts, rates and p50/p99/p99.9 latencies in
+// nanoseconds, and a final object when it stops.
+class PipelineMetrics {
+public:
+    PipelineMetrics();
+    ~PipelineMetrics();
+    
+    PipelineMetrics(const PipelineMetrics&) = delete;
+    PipelineMetrics& operator=(const PipelineMetrics&) = delete;
+    
+    // The calling thread's histogram for a stage, created on first use
+    LatencyHistogram& histogram(Stage stage) {
+        ThreadHistograms& local = thread_histograms();
+        if (local.owner != id_) {
+            local = ThreadHistograms{id_, {}};
+        }
+        LatencyHistogram*& slot = local.stages[static_cast<size_t>(stage)];
+        if (!slot) {
+            slot = &add_histogram(stage);
+        }
+        return *slot;
+    }
+    
+    void record(Stage stage, uint64_t cycles) {
+        histogram(stage).record(cycles);
+    }
+    
+    // Sample `read` as a gauge until it is removed; it is called from the reporter thread
+    void add_gauge(const std::string& name, std::function<size_t()> read);
+    
+    // Returns once the gauge will not be read again
+    void remove_gauge(const std::string& name);
+    
+    // Write a report to `path` every `interval` from a background thread.
+    // Throws std::runtime_error if the file cannot be opened.
+    void start_reporting(const std::string& path, std::chrono::milliseconds interval);
+    
+    // Write the final report and stop the reporter thread
+    void stop_reporting();
+    
+    // One report as a single line of JSON
+    std::string report(bool final);
+    
+    // Cycle counter rate, measured against steady_clock since construction
+    double cycles_per_ns() const;
+
+private:
+    static constexpr std::chrono::milliseconds SAMPLE_INTERVAL{10};  // Gauge sampling period
+    
+    struct ThreadHistograms {
+        uint64_t owner = 0;  // id_ of the PipelineMetrics the pointers belong to
+        std::array<LatencyHistogram*, STAGE_COUNT> stages{};
+    };
+    
+    struct Gauge {
+        std::string name;
+        std::function<size_t()> read;
+        size_t last = 0;
+        size_t max = 0;  // Since the previous report
+    };
+    
+    static ThreadHistograms& thread_histograms() {
+        thread_local ThreadHistograms histograms;
+        return histograms;
+    }
+    
+    const uint64_t id_;
+    const uint64_t start_cycles_;
+    const std::chrono::steady_clock::time_point start_time_;
+    
+    std::mutex mutex_;  // Guards everything below
+    std::array<std::vector<std::unique_ptr<LatencyHistogram>>, STAGE_COUNT> histograms_;
+    std::array<uint64_t, STAGE_COUNT> reported_counts_{};  // Counts at the previous report, for rates
+    std::chrono::steady_clock::time_point reported_time_;
+    std::vector<Gauge> gauges_;
+    
+    std::ofstream output_;
+    std::thread reporter_;
+    std::condition_variable stop_signal_;
+    bool stopping_ = false;
+    
+    LatencyHistogram& add_histogram(Stage stage);
+    void sample_gauges();
+    std::string report_locked(bool final);
+};
+
+// Times a scope into one stage; does nothing when metrics is null
+class StageTimer {
+public:
+    StageTimer(PipelineMetrics* metrics, Stage stage)
+        : metrics_(metrics), stage_(stage), start_(metrics ? cycle_clock() : 0) {}
+    
+    ~StageTimer() {
+        if (metrics_) {
+            metrics_->record(stage_, cycle_clock() - start_);
+        }
+    }
+    
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    PipelineMetrics* metrics_;
+    Stage stage_;
+    uint64_t start_;
+};
+
+} // namespace hft
@@ -1,349 +1,549 @@
 #include "order_book.h"
+#include "metrics.h"
+#include "../cpp_parser/include/message.h"
+#include "../cpp_parser/include/batch_decoder.h"
 #include <nlohmann/json.hpp>
 #include <algorithm>
 #include <iostream>
 #include <stdexcept>
 #include <cstring> // for strncpy
 #include <charconv> // for fast string to number conversion
+#include <variant>
+#include <cmath>
+#include <fstream>
+#include <filesystem>
 
 using json = nlohmann::json;
 
-// String to double conversion with error handling
-inline double fast_stod(const std::string& str) {
-    try {
-        size_t pos = 0;
-        double result = std::stod(str, &pos);
-        // Check if the entire string was processed
-        if (pos == str.size()) {
-            return result;
+namespace hft {
+
+// Exact integer price (1/10000 dollars) for a decimal price
+inline uint32_t to_raw_price(double price) {
+    return static_cast<uint32_t>(std::llround(price * 10000.0));
+}
+
+ChangeDetection parse_change_detection(const std::string& text) {
+    ChangeDetection detection;
+    if (text == "totals") {
+        detection.trigger = ChangeTrigger::SideTotals;
+    } else if (text == "top") {
+        detection.trigger = ChangeTrigger::TopOfBook;
+    } else if (text.rfind("depth:", 0) == 0 && text.size() > 6 &&
+               text.find_first_not_of("0123456789", 6) == std::string::npos) {
+        detection.trigger = ChangeTrigger::Depth;
+        detection.depth_levels = std::stoul(text.substr(6));
+        if (detection.depth_levels == 0) {
+            throw std::invalid_argument("depth:N needs at least one level");
         }
-    } catch (const std::exception& e) {
-        // Fall through to return 0.0
+    } else {
+        throw std::invalid_argument("Unknown change trigger '" + text + "' (totals, top or depth:N)");
     }
-    return 0.0;
+    return detection;
 }
 
-namespace hft {
+std::string change_detection_name(const ChangeDetection& detection) {
+    switch (detection.trigger) {
+        case ChangeTrigger::SideTotals: return "totals";
+        case ChangeTrigger::TopOfBook: return "top";
+        case ChangeTrigger::Depth: return "depth:" + std::to_string(detection.depth_levels);
+    }
+    return "unknown";
+}
 
-OrderBook::OrderBook() {}
+OrderBook::OrderBook(BookEngine engine)
+    : engine_(engine), best_prices_(SymbolTable::MAX_SYMBOLS, {0.0, 0.0}) {}
 OrderBook::~OrderBook() {}
 
-// Thread-local JSON object to avoid reallocation
-thread_local json j;
+SymbolId OrderBook::process_message(std::string_view message_json) {
+    JsonBookMessage message;
+    const JsonDecodeResult result = decode_json_message(message_json, message);
+    json_stats_.count(result, message.type);
+    if (result == JsonDecodeResult::Ok) {
+        return apply(message);
+    }
+    return INVALID_SYMBOL;
+}
 
-void OrderBook::process_message(const std::string& message_json) {
-    try {
-        // Parse JSON message - reuse the thread-local json object
-        j = json::parse(message_json);
-        
-        // Check message type based on your ITCH format
-        if (j.contains("body")) {
-            const auto& body = j["body"];
+SymbolId OrderBook::apply(const JsonBookMessage& message) {
+    StageTimer timer(metrics_, Stage::BookApply);
+    using Type = JsonBookMessage::Type;
+    SymbolId touched = INVALID_SYMBOL;
+    switch (message.type) {
+        case Type::AddOrder: {
+            // Same symbol handling as the ITCH path: stock_locate when present, else intern the name
+            SymbolId symbol = message.stock_locate;
+            if (symbol == INVALID_SYMBOL) {
+                symbol = symbols_.intern(message.stock);
+            } else if (!symbols_.known(symbol)) {
+                symbols_.assign(symbol, message.stock);
+            }
             
-            // Process different message types
-            if (body.contains("AddOrder")) {
-                const auto& add_order = body["AddOrder"];
-                
-                // Check if all required fields exist
-                if (!add_order.contains("stock") || !add_order.contains("reference") || 
-                    !add_order.contains("price") || !add_order.contains("shares") || 
-                    !add_order.contains("side") || !j.contains("timestamp")) {
-                    std::cerr << "AddOrder message missing required fields, skipping" << std::endl;
-                    return;
-                }
-                
-                // Get stock and trim whitespace in-place
-                std::string stock = add_order["stock"].get<std::string>();
-                const auto first = stock.find_first_not_of(" \t\n\r\f\v");
-                const auto last = stock.find_last_not_of(" \t\n\r\f\v");
-                if (first != std::string::npos && last != std::string::npos) {
-                    stock = stock.substr(first, last - first + 1);
-                } else {
-                    stock.clear();
-                }
-                
-                // Fast price conversion
-                double price = fast_stod(add_order["price"].get<std::string>());
-                
+            Order order{
+                symbol,
+                message.reference,
+                message.raw_price / 10000.0,
+                message.shares,
+                message.buy ? Side::Buy : Side::Sell,
+                message.timestamp,
+                message.raw_price
+            };
+            touched = process_add_order(order);
+            break;
+        }
+        case Type::StockDirectory:
+            symbols_.assign(message.stock_locate, message.stock);
+            break;
+        case Type::DeleteOrder:
+            touched = process_delete_order(message.reference);
+            break;
+        case Type::OrderExecuted:
+        case Type::OrderExecutedWithPrice:
+            touched = process_execute_order(message.reference, message.shares);
+            break;
+        case Type::OrderCancelled:
+            touched = process_cancel_order(message.reference, message.shares);
+            break;
+        case Type::ReplaceOrder:
+            touched = process_replace_order(message.reference, message.new_reference,
+                                            message.raw_price, message.shares);
+            break;
+        case Type::Other:
+            break;
+    }
+    return report_change(touched);
+}
+
+SymbolId OrderBook::apply(const itch::Message& message) {
+    StageTimer timer(metrics_, Stage::BookApply);
+    const SymbolId touched = std::visit([this, &message](auto&& body) -> SymbolId {
+        using T = std::decay_t<decltype(body)>;
+        
+        if constexpr (std::is_same_v<T, itch::AddOrder>) {
+            Order order{
+                symbol_for_add(message.stock_locate, std::string_view(body.stock.data(), body.stock.size())),
+                body.reference,
+                body.price.raw() / 10000.0,
+                body.shares,
+                body.side == itch::Side::Buy ? Side::Buy : Side::Sell,
+                message.timestamp,
+                body.price.raw()
+            };
+            return process_add_order(order);
+        } else if constexpr (std::is_same_v<T, itch::StockDirectory>) {
+            symbols_.assign(message.stock_locate, std::string_view(body.stock.data(), body.stock.size()));
+        } else if constexpr (std::is_same_v<T, itch::DeleteOrder>) {
+            return process_delete_order(body.reference);
+        } else if constexpr (std::is_same_v<T, itch::OrderExecuted>) {
+            return process_execute_order(body.reference, body.executed);
+        } else if constexpr (std::is_same_v<T, itch::OrderExecutedWithPrice>) {
+            return process_execute_order(body.reference, body.executed);
+        } else if constexpr (std::is_same_v<T, itch::OrderCancelled>) {
+            return process_cancel_order(body.reference, body.cancelled);
+        } else if constexpr (std::is_same_v<T, itch::ReplaceOrder>) {
+            return process_replace_order(body.old_reference, body.new_reference,
+                                         body.price.raw(), body.shares);
+        }
+        return INVALID_SYMBOL;
+    }, message.body);
+    return report_change(touched);
+}
+
+void OrderBook::apply(const itch::MessageBatch& batch, std::vector<BatchChange>& changes) {
+    using Kind = itch::BatchKind;
+    size_t next_other = 0;
+    for (size_t row = 0; row < batch.size(); ++row) {
+        SymbolId touched = INVALID_SYMBOL;
+        switch (batch.kinds[row]) {
+            case Kind::Add: {
+                const uint32_t raw_price = batch.prices[row];
                 Order order{
-                    stock,
-                    add_order["reference"].get<uint64_t>(),
-                    price,
-                    add_order["shares"].get<uint32_t>(),
-                    add_order["side"].get<std::string>(),
-                    j["timestamp"].get<uint64_t>()
+                    symbol_for_add(batch.locates[row],
+                                   std::string_view(batch.stocks[row].data(), batch.stocks[row].size())),
+                    batch.refs[row],
+                    raw_price / 10000.0,
+                    batch.shares[row],
+                    batch.sides[row] == itch::Side::Buy ? Side::Buy : Side::Sell,
+                    batch.timestamps[row],
+                    raw_price
                 };
-                process_add_order(order);
-            }
-            else if (body.contains("DeleteOrder")) {
-                const auto& delete_order = body["DeleteOrder"];
-                if (!delete_order.contains("reference")) {
-                    std::cerr << "DeleteOrder message missing reference field, skipping" << std::endl;
-                    return;
-                }
-                process_delete_order(delete_order["reference"].get<uint64_t>());
+                touched = process_add_order(order);
+                break;
             }
-            else if (body.contains("OrderExecuted")) {
-                const auto& executed = body["OrderExecuted"];
-                if (!executed.contains("reference") || !executed.contains("executed")) {
-                    std::cerr << "OrderExecuted message missing required fields, skipping" << std::endl;
-                    return;
+            case Kind::Execute:
+                touched = process_execute_order(batch.refs[row], batch.shares[row]);
+                break;
+            case Kind::Cancel:
+                touched = process_cancel_order(batch.refs[row], batch.shares[row]);
+                break;
+            case Kind::Delete:
+                touched = process_delete_order(batch.refs[row]);
+                break;
+            case Kind::Replace:
+                touched = process_replace_order(batch.refs[row], batch.new_refs[row],
+                                                batch.prices[row], batch.shares[row]);
+                break;
+            case Kind::Other: {
+                // apply() reports its own change
+                const SymbolId changed = apply(batch.others[next_other++]);
+                if (changed != INVALID_SYMBOL) {
+                    changes.push_back({static_cast<uint32_t>(row), changed});
                 }
-                process_execute_order(executed["reference"].get<uint64_t>(), executed["executed"].get<uint32_t>());
+                continue;
             }
-            else if (body.contains("OrderCancelled")) {
-                const auto& cancelled = body["OrderCancelled"];
-                if (!cancelled.contains("reference") || !cancelled.contains("cancelled")) {
-                    std::cerr << "OrderCancelled message missing required fields, skipping" << std::endl;
-                    return;
-                }
-                process_cancel_order(cancelled["reference"].get<uint64_t>(), cancelled["cancelled"].get<uint32_t>());
-            }
-            else if (body.contains("ReplaceOrder")) {
-                const auto& replace = body["ReplaceOrder"];
-                if (!replace.contains("original_reference") || !replace.contains("new_reference") || 
-                    !replace.contains("price") || !replace.contains("shares")) {
-                    // Skip silently
-                    return;
-                }
-                
-                // Get price as string and convert to double
-                std::string price_str = replace["price"].get<std::string>();
-                double price = 0.0;
-                try {
-                    price = std::stod(price_str);
-                } catch (const std::exception& e) {
-                    std::cerr << "Error parsing price: " << price_str << ": " << e.what() << std::endl;
-                    return;
-                }
-                
-                process_replace_order(
-                    replace["original_reference"].get<uint64_t>(), 
-                    replace["new_reference"].get<uint64_t>(),
-                    price,
-                    replace["shares"].get<uint32_t>()
-                );
+        }
+        if (report_change(touched) != INVALID_SYMBOL) {
+            changes.push_back({static_cast<uint32_t>(row), touched});
+        }
+    }
+}
+
+// The stock_locate is the symbol ID; the name is only copied the first time
+SymbolId OrderBook::symbol_for_add(SymbolId locate, std::string_view stock) {
+    if (locate == INVALID_SYMBOL) {
+        return symbols_.intern(stock);
+    }
+    if (!symbols_.known(locate)) {
+        symbols_.assign(locate, stock);
+    }
+    return locate;
+}
+
+SymbolId OrderBook::report_change(SymbolId symbol) {
+    if (symbol == INVALID_SYMBOL || symbol >= books_.size()) {
+        return INVALID_SYMBOL;
+    }
+    SymbolBook& book = books_[symbol];
+    const BookSummary summary = summarize(symbol, book);
+    if (summary == book.reported) {
+        return INVALID_SYMBOL;
+    }
+    book.reported = summary;
+    return symbol;
+}
+
+OrderBook::BookSummary OrderBook::summarize(SymbolId symbol, const SymbolBook& book) const {
+    BookSummary summary;
+    summary.bid_price = to_raw_price(best_prices_[symbol].first);
+    summary.ask_price = to_raw_price(best_prices_[symbol].second);
+    
+    switch (change_detection_.trigger) {
+        case ChangeTrigger::SideTotals:
+            summary.bid_shares = book.bid_volume;
+            summary.ask_shares = book.ask_volume;
+            break;
+        case ChangeTrigger::TopOfBook:
+            if (engine_ == BookEngine::Ladder) {
+                summary.bid_shares = book.bid_ladder.volume_at(summary.bid_price);
+                summary.ask_shares = book.ask_ladder.volume_at(summary.ask_price);
+            } else {
+                summary.bid_shares = book.bids.empty() ? 0 : book.bids.rbegin()->second;
+                summary.ask_shares = book.asks.empty() ? 0 : book.asks.begin()->second;
             }
+            break;
+        case ChangeTrigger::Depth: {
+            const auto [bid_shares, ask_shares] = get_depth_volumes(symbol, change_detection_.depth_levels);
+            summary.bid_shares = bid_shares;
+            summary.ask_shares = ask_shares;
+            break;
         }
-    } catch (const std::exception& e) {
-        std::cerr << "Error processing message: " << e.what() << std::endl;
     }
+    return summary;
 }
 
-void OrderBook::process_add_order(const Order& order) {
+SymbolId OrderBook::process_add_order(const Order& order) {
     // Store the order
-    orders_.emplace(order.reference, order);
+    orders_.insert(order);
     
     // Update the order book
-    auto& book = books_[order.stock];
-    
-    // Use pointer to the appropriate price level map
-    PriceLevel* price_level = (order.side[0] == 'B') ? &book.first : &book.second;
-    (*price_level)[order.price] += order.shares;
-    
-    // Mark volumes as dirty
-    volumes_cache_.erase(order.stock);
+    add_to_level(order);
     
     // Update best prices
-    update_best_prices(order.stock);
+    update_best_prices(order.symbol);
+    return order.symbol;
 }
 
-void OrderBook::process_execute_order(uint64_t reference, uint32_t shares) {
-    auto order_it = orders_.find(reference);
-    if (order_it == orders_.end()) {
-        return;  // Order not found
+SymbolId OrderBook::process_execute_order(uint64_t reference, uint32_t shares) {
+    Order* found = orders_.find(reference);
+    if (!found) {
+        return INVALID_SYMBOL;  // Order not found
     }
     
-    Order& order = order_it->second;
-    auto book_it = books_.find(order.stock);
-    if (book_it == books_.end()) {
-        return;  // No book for this stock
-    }
+    Order& order = *found;
+    const SymbolId symbol = order.symbol;
     
     // Calculate the actual number of shares to execute
     uint32_t shares_to_execute = std::min(shares, order.shares);
     
-    // Get the appropriate price level
-    auto& price_levels = (order.side[0] == 'B') ? book_it->second.first : book_it->second.second;
-    auto price_it = price_levels.find(order.price);
-    
-    if (price_it != price_levels.end()) {
-        // Update the price level
-        if (price_it->second > shares_to_execute) {
-            price_it->second -= shares_to_execute;
-        } else {
-            price_levels.erase(price_it);
-        }
-    }
-    
-    // Mark volumes as dirty
-    volumes_cache_.erase(order.stock);
+    // Update the price level
+    remove_from_level(order, shares_to_execute);
     
     // Reduce shares in the order
-    order.shares -= std::min(shares, order.shares);
+    order.shares -= shares_to_execute;
     if (order.shares == 0) {
         orders_.erase(reference);
     }
     
     // Update best prices
-    update_best_prices(order.stock);
+    update_best_prices(symbol);
+    return symbol;
 }
 
-void OrderBook::process_delete_order(uint64_t reference) {
-    auto order_it = orders_.find(reference);
-    if (order_it == orders_.end()) {
-        return;  // Order not found
-    }
-    
-    const Order& order = order_it->second;
-    auto book_it = books_.find(order.stock);
-    if (book_it == books_.end()) {
-        orders_.erase(order_it);
-        return;
+SymbolId OrderBook::process_delete_order(uint64_t reference) {
+    const Order* order = orders_.find(reference);
+    if (!order) {
+        return INVALID_SYMBOL;  // Order not found
     }
     
-    // Get the appropriate price level
-    auto& price_levels = (order.side[0] == 'B') ? book_it->second.first : book_it->second.second;
-    auto price_it = price_levels.find(order.price);
-    
-    if (price_it != price_levels.end()) {
-        // Update the price level
-        if (price_it->second > order.shares) {
-            price_it->second -= order.shares;
-        } else {
-            price_levels.erase(price_it);
-        }
-    }
+    const SymbolId symbol = order->symbol;
     
-    // Mark volumes as dirty
-    volumes_cache_.erase(order.stock);
+    // Update the price level
+    remove_from_level(*order, order->shares);
     
     // Remove the order
-    orders_.erase(order_it);
+    orders_.erase(reference);
     
     // Update best prices
-    update_best_prices(order.stock);
+    update_best_prices(symbol);
+    return symbol;
 }
 
-void OrderBook::process_cancel_order(uint64_t reference, uint32_t shares) {
-    if (orders_.find(reference) == orders_.end()) {
-        return;  // Order not found
+SymbolId OrderBook::process_cancel_order(uint64_t reference, uint32_t shares) {
+    Order* found = orders_.find(reference);
+    if (!found) {
+        return INVALID_SYMBOL;  // Order not found
     }
     
-    Order& order = orders_[reference];
-    const std::string& stock = order.stock;
-    double price = order.price;
+    Order& order = *found;
+    const SymbolId symbol = order.symbol;
     
     // Reduce shares in the order book
-    if (order.side == "Buy") {
-        books_[stock].first[price] -= std::min(shares, order.shares);
-        if (books_[stock].first[price] == 0) {
-            books_[stock].first.erase(price);
-        }
-    } else {
-        books_[stock].second[price] -= std::min(shares, order.shares);
-        if (books_[stock].second[price] == 0) {
-            books_[stock].second.erase(price);
-        }
-    }
+    uint32_t shares_to_cancel = std::min(shares, order.shares);
+    remove_from_level(order, shares_to_cancel);
     
     // Reduce shares in the order
-    order.shares -= std::min(shares, order.shares);
+    order.shares -= shares_to_cancel;
     if (order.shares == 0) {
         orders_.erase(reference);
     }
     
     // Update best prices
-    update_best_prices(stock);
+    update_best_prices(symbol);
+    return symbol;
 }
 
-void OrderBook::process_replace_order(uint64_t old_reference, uint64_t new_reference,
-                                     double price, uint32_t shares) {
-    if (orders_.find(old_reference) == orders_.end()) {
-        return;  // Original order not found
+SymbolId OrderBook::process_replace_order(uint64_t old_reference, uint64_t new_reference,
+                                          uint32_t raw_price, uint32_t shares) {
+    const Order* found = orders_.find(old_reference);
+    if (!found) {
+        return INVALID_SYMBOL;  // Original order not found
     }
     
     // Get original order details
-    Order old_order = orders_[old_reference];
-    const std::string& stock = old_order.stock;
+    const Order old_order = *found;
     
     // First remove the old order
     process_delete_order(old_reference);
     
     // Then add the new order
     Order new_order{
-        stock,
+        old_order.symbol,
         new_reference,
-        price,
+        raw_price / 10000.0,
         shares,
         old_order.side,
-        old_order.timestamp  // Keep the same timestamp
+        old_order.timestamp,  // Keep the same timestamp
+        raw_price
     };
-    process_add_order(new_order);
+    return process_add_order(new_order);
+}
+
+const OrderBook::SymbolBook* OrderBook::find_book(SymbolId symbol) const {
+    if (symbol >= books_.size() || !books_[symbol].active) {
+        return nullptr;  // No orders seen for this stock
+    }
+    return &books_[symbol];
+}
+
+OrderBook::SymbolBook& OrderBook::book_for(SymbolId symbol) {
+    if (symbol >= books_.size()) {
+        books_.resize(static_cast<size_t>(symbol) + 1);
+    }
+    return books_[symbol];
 }
 
-void OrderBook::update_best_prices(std::string_view stock) {
-    auto it = books_.find(std::string(stock));
-    if (it == books_.end()) {
-        best_prices_.erase(std::string(stock));
+void OrderBook::add_to_level(const Order& order) {
+    SymbolBook& book = book_for(order.symbol);
+    book.active = true;
+    (order.side == Side::Buy ? book.bid_volume : book.ask_volume) += order.shares;
+    
+    if (engine_ == BookEngine::Ladder) {
+        (order.side == Side::Buy ? book.bid_ladder : book.ask_ladder).add(order.raw_price, order.shares);
         return;
     }
     
-    const auto& bids = it->second.first;
-    const auto& asks = it->second.second;
+    (order.side == Side::Buy ? book.bids : book.asks)[order.price] += order.shares;
+}
+
+void OrderBook::remove_from_level(const Order& order, uint32_t shares) {
+    if (!find_book(order.symbol)) {
+        return;  // No book for this stock
+    }
+    SymbolBook& book = books_[order.symbol];
+    uint32_t& side_volume = order.side == Side::Buy ? book.bid_volume : book.ask_volume;
     
-    double best_bid = bids.empty() ? 0.0 : bids.rbegin()->first;
-    double best_ask = asks.empty() ? 0.0 : asks.begin()->first;
+    if (engine_ == BookEngine::Ladder) {
+        side_volume -= (order.side == Side::Buy ? book.bid_ladder : book.ask_ladder).remove(order.raw_price, shares);
+        return;
+    }
     
-    best_prices_[std::string(stock)] = {best_bid, best_ask};
+    auto& price_levels = order.side == Side::Buy ? book.bids : book.asks;
+    auto price_it = price_levels.find(order.price);
+    if (price_it != price_levels.end()) {
+        if (price_it->second > shares) {
+            price_it->second -= shares;
+            side_volume -= shares;
+        } else {
+            side_volume -= price_it->second;
+            price_levels.erase(price_it);
+        }
+    }
 }
 
-void OrderBook::update_volumes_cache(std::string_view stock) const {
-    auto it = books_.find(std::string(stock));
-    if (it == books_.end()) {
-        volumes_cache_.erase(std::string(stock));
+template <typename F>
+void OrderBook::for_each_level(const SymbolBook& book, Side side, F&& f) const {
+    if (engine_ == BookEngine::Ladder) {
+        auto visit = [&f](uint32_t raw_price, uint32_t volume) {
+            return visit_level(f, raw_price / 10000.0, volume);
+        };
+        if (side == Side::Buy) {
+            book.bid_ladder.for_each_descending(visit);
+        } else {
+            book.ask_ladder.for_each_ascending(visit);
+        }
         return;
     }
     
-    const auto& bids = it->second.first;
-    const auto& asks = it->second.second;
-    
-    uint32_t bid_volume = 0;
-    uint32_t ask_volume = 0;
-    
-    for (const auto& [price, qty] : bids) {
-        bid_volume += qty;
+    if (side == Side::Buy) {
+        for (auto rit = book.bids.rbegin(); rit != book.bids.rend(); ++rit) {
+            if (!visit_level(f, rit->first, rit->second)) return;
+        }
+    } else {
+        for (const auto& [price, volume] : book.asks) {
+            if (!visit_level(f, price, volume)) return;
+        }
+    }
+}
+
+void OrderBook::update_best_prices(SymbolId symbol) {
+    const SymbolBook* book = find_book(symbol);
+    if (!book) {
+        best_prices_[symbol] = {0.0, 0.0};
+        return;
     }
     
-    for (const auto& [price, qty] : asks) {
-        ask_volume += qty;
+    if (engine_ == BookEngine::Ladder) {
+        // O(1): a bit scan over the ladder window
+        best_prices_[symbol] = {
+            book->bid_ladder.highest() / 10000.0,
+            book->ask_ladder.lowest() / 10000.0
+        };
+        return;
     }
     
-    volumes_cache_[std::string(stock)] = {bid_volume, ask_volume};
+    double best_bid = book->bids.empty() ? 0.0 : book->bids.rbegin()->first;
+    double best_ask = book->asks.empty() ? 0.0 : book->asks.begin()->first;
+    
+    best_prices_[symbol] = {best_bid, best_ask};
+}
+
+std::pair<uint32_t, uint32_t> OrderBook::get_volumes(SymbolId symbol) const {
+    // O(1): totals are maintained as levels change
+    const SymbolBook* book = find_book(symbol);
+    return book ? std::make_pair(book->bid_volume, book->ask_volume) : std::make_pair(0u, 0u);
 }
 
 std::pair<uint32_t, uint32_t> OrderBook::get_volumes(std::string_view stock) const {
-    auto it = volumes_cache_.find(std::string(stock));
-    if (it == volumes_cache_.end()) {
-        update_volumes_cache(stock);
-        it = volumes_cache_.find(std::string(stock));
-    }
-    return it != volumes_cache_.end() ? it->second : std::make_pair(0u, 0u);
+    return get_volumes(symbols_.find(stock));
+}
+
+double OrderBook::get_imbalance(SymbolId symbol) const {
+    auto [bid_volume, ask_volume] = get_volumes(symbol);
+    if (bid_volume + ask_volume == 0) return 0.0;
+    return static_cast<double>(bid_volume) / (bid_volume + ask_volume);
 }
 
 double OrderBook::get_imbalance(std::string_view stock) const {
-    auto [bid_volume, ask_volume] = get_volumes(stock);
+    return get_imbalance(symbols_.find(stock));
+}
+
+MarketUpdate OrderBook::get_market_update(SymbolId symbol, uint64_t timestamp) const {
+    const auto [best_bid, best_ask] = get_best_prices(symbol);
+    const auto [bid_volume, ask_volume] = get_volumes(symbol);
+    
+    MarketUpdate update;
+    update.timestamp = timestamp;
+    update.bid_price = to_raw_price(best_bid);
+    update.ask_price = to_raw_price(best_ask);
+    update.bid_volume = bid_volume;
+    update.ask_volume = ask_volume;
+    update.symbol = symbol;
+    return update;
+}
+
+std::pair<uint32_t, uint32_t> OrderBook::get_depth_volumes(SymbolId symbol, size_t levels) const {
+    const SymbolBook* book = find_book(symbol);
+    if (!book || levels == 0) {
+        return {0, 0};
+    }
+    
+    // Walks at most `levels` levels per side
+    uint32_t bid_volume = 0;
+    uint32_t ask_volume = 0;
+    size_t seen = 0;
+    for_each_level(*book, Side::Buy, [&](double, uint32_t qty) {
+        bid_volume += qty;
+        return ++seen < levels;
+    });
+    
+    seen = 0;
+    for_each_level(*book, Side::Sell, [&](double, uint32_t qty) {
+        ask_volume += qty;
+        return ++seen < levels;
+    });
+    
+    return {bid_volume, ask_volume};
+}
+
+double OrderBook::get_depth_imbalance(SymbolId symbol, size_t levels) const {
+    auto [bid_volume, ask_volume] = get_depth_volumes(symbol, levels);
     if (bid_volume + ask_volume == 0) return 0.0;
     return static_cast<double>(bid_volume) / (bid_volume + ask_volume);
 }
 
+double OrderBook::get_depth_imbalance(std::string_view stock, size_t levels) const {
+    return get_depth_imbalance(symbols_.find(stock), levels);
+}
+
+LadderStats OrderBook::ladder_stats() const {
+    LadderStats stats;
+    for (const auto& book : books_) {
+        for (const PriceLadder* ladder : { &book.bid_ladder, &book.ask_ladder }) {
+            stats.window_levels += ladder->window_levels();
+            stats.overflow_levels += ladder->overflow_levels();
+            stats.recenters += ladder->recenters();
+        }
+    }
+    return stats;
+}
+
 std::string OrderBook::get_order_book_snapshot(std::string_view stock) const {
     std::string result = "Order Book Snapshot for ";
     result += stock;
     result += "\nBids (price x size):\n";
     
-    auto it = books_.find(std::string(stock));
-    if (it == books_.end()) {
+    const SymbolId symbol = symbols_.find(stock);
+    const SymbolBook* book = find_book(symbol);
+    if (!book) {
         return result + "No orders for this stock\n";
     }
     
@@ -352,25 +552,25 @@ std::string OrderBook::get_order_book_snapshot(std::string_view stock) const {
     buffer.reserve(128);
     
     // Get bids in descending order (highest price first)
-    for (auto rit = it->second.first.rbegin(); rit != it->second.first.rend(); ++rit) {
+    for_each_level(*book, Side::Buy, [&](double price, uint32_t shares) {
         buffer.clear();
-        buffer = std::to_string(rit->first) + " x " + std::to_string(rit->second) + "\n";
+        buffer = std::to_string(price) + " x " + std::to_string(shares) + "\n";
         result += buffer;
-    }
+    });
     
     result += "---\nAsks (price x size):\n";
     
     // Get asks in ascending order (lowest price first)
-    for (const auto& [price, shares] : it->second.second) {
+    for_each_level(*book, Side::Sell, [&](double price, uint32_t shares) {
         buffer.clear();
         buffer = std::to_string(price) + " x " + std::to_string(shares) + "\n";
         result += buffer;
-    }
+    });
     
     // Add best prices and imbalance
-    auto [best_bid, best_ask] = get_best_prices(stock);
-    auto [bid_vol, ask_vol] = get_volumes(stock);
-    double imbalance = get_imbalance(stock);
+    auto [best_bid, best_ask] = get_best_prices(symbol);
+    auto [bid_vol, ask_vol] = get_volumes(symbol);
+    double imbalance = get_imbalance(symbol);
     
     result += "---\nSummary:\n";
     result += "Best Bid: " + std::to_string(best_bid) + " x " + std::to_string(bid_vol) + "\n";
@@ -381,8 +581,9 @@ std::string OrderBook::get_order_book_snapshot(std::string_view stock) const {
 }
 
 std::string OrderBook::get_order_book_json(std::string_view stock) const {
-    auto it = books_.find(std::string(stock));
-    if (it == books_.end()) {
+    const SymbolId symbol = symbols_.find(stock);
+    const SymbolBook* book = find_book(symbol);
+    if (!book) {
         return "{}";  // Stock not found
     }
     
@@ -390,30 +591,30 @@ std::string OrderBook::get_order_book_json(std::string_view stock) const {
     
     // Add bids to snapshot
     json bids = json::array();
-    for (auto rit = it->second.first.rbegin(); rit != it->second.first.rend(); ++rit) {
+    for_each_level(*book, Side::Buy, [&](double price, uint32_t volume) {
         bids.push_back({
-            {"price", rit->first},
-            {"volume", rit->second},
+            {"price", price},
+            {"volume", volume},
             {"side", "bid"}
         });
-    }
+    });
     snapshot["bids"] = bids;
     
     // Add asks to snapshot
     json asks = json::array();
-    for (const auto& [price, volume] : it->second.second) {
+    for_each_level(*book, Side::Sell, [&](double price, uint32_t volume) {
         asks.push_back({
             {"price", price},
             {"volume", volume},
             {"side", "ask"}
         });
-    }
+    });
     snapshot["asks"] = asks;
     
     // Add summary information
-    auto [best_bid, best_ask] = get_best_prices(stock);
-    auto [bid_vol, ask_vol] = get_volumes(stock);
-    double imbalance = get_imbalance(stock);
+    auto [best_bid, best_ask] = get_best_prices(symbol);
+    auto [bid_vol, ask_vol] = get_volumes(symbol);
+    double imbalance = get_imbalance(symbol);
     
     snapshot["summary"] = {
         {"best_bid", best_bid},
@@ -426,11 +627,265 @@ std::string OrderBook::get_order_book_json(std::string_view stock) const {
     return snapshot.dump();
 }
 
+std::pair<double, double> OrderBook::get_best_prices(SymbolId symbol) const {
+    // best_prices_[INVALID_SYMBOL] is never written, so unknown stocks read (0, 0)
+    return best_prices_[symbol];
+}
+
 std::pair<double, double> OrderBook::get_best_prices(std::string_view stock) const {
-    auto it = best_prices_.find(std::string(stock));
-    return it != best_prices_.end() ? it->second : std::make_pair(0.0, 0.0);
+    return get_best_prices(symbols_.find(stock));
+}
+
+// Snapshot file layout (native byte order): SnapshotHeader, then
+// num_symbols x {SymbolId, uint16_t length, name bytes},
+// num_books x {SnapshotBook, bid levels best first, ask levels best first},
+// num_orders x SnapshotOrder
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = {'H', 'F', 'T', 'B', 'O', 'O', 'K', '\0'};
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t engine;
+    uint64_t offset;
+    uint64_t messages;
+    uint64_t timestamp;
+    uint64_t num_symbols;
+    uint64_t num_books;
+    uint64_t num_orders;
+};
+
+struct SnapshotBook {
+    SymbolId symbol;
+    uint16_t reserved;
+    uint32_t bid_volume;
+    uint32_t ask_volume;
+    uint32_t num_bids;
+    uint32_t num_asks;
+};
+
+struct SnapshotLevel {
+    double price;        // Map key
+    uint32_t raw_price;  // Ladder key
+    uint32_t volume;
+};
+
+struct SnapshotOrder {
+    uint64_t reference;
+    uint64_t timestamp;
+    double price;
+    uint32_t raw_price;
+    uint32_t shares;
+    SymbolId symbol;
+    Side side;
+    uint8_t reserved[5];
+};
+
+template <typename T>
+void append_pod(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Bounds-checked reads over a snapshot loaded into memory
+class SnapshotReader {
+public:
+    SnapshotReader(const std::string& data, const std::string& path) : data_(data), path_(path) {}
+    
+    template <typename T>
+    T read() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+    
+    std::string_view read_bytes(size_t length) {
+        return std::string_view(take(length), length);
+    }
+
+private:
+    const std::string& data_;
+    const std::string& path_;
+    size_t pos_ = 0;
+    
+    const char* take(size_t length) {
+        if (data_.size() - pos_ < length) {
+            throw std::runtime_error("Truncated book snapshot: " + path_);
+        }
+        const char* p = data_.data() + pos_;
+        pos_ += length;
+        return p;
+    }
+};
+
+} // namespace
+
+void OrderBook::save_snapshot(const std::string& path, const FeedPosition& position) const {
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.engine = static_cast<uint32_t>(engine_);
+    header.offset = position.offset;
+    header.messages = position.messages;
+    header.timestamp = position.timestamp;
+    header.num_orders = orders_.size();
+    
+    // The whole snapshot is built in memory and written with one call
+    std::string out(sizeof(header), '\0');
+    out.reserve(sizeof(header) + orders_.size() * (sizeof(SnapshotOrder) + sizeof(SnapshotLevel)));
+    
+    for (size_t id = 1; id < SymbolTable::MAX_SYMBOLS; ++id) {
+        if (!symbols_.known(static_cast<SymbolId>(id))) {
+            continue;
+        }
+        const std::string& name = symbols_.name(static_cast<SymbolId>(id));
+        append_pod(out, static_cast<SymbolId>(id));
+        append_pod(out, static_cast<uint16_t>(name.size()));
+        out.append(name);
+        header.num_symbols++;
+    }
+    
+    for (size_t id = 0; id < books_.size(); ++id) {
+        const SymbolBook& book = books_[id];
+        if (!book.active) {
+            continue;
+        }
+        
+        const size_t at = out.size();
+        SnapshotBook entry{};
+        entry.symbol = static_cast<SymbolId>(id);
+        entry.bid_volume = book.bid_volume;
+        entry.ask_volume = book.ask_volume;
+        append_pod(out, entry);
+        
+        // Best level first, so a ladder restored from it centres on the inside
+        for (Side side : {Side::Buy, Side::Sell}) {
+            uint32_t& count = side == Side::Buy ? entry.num_bids : entry.num_asks;
+            auto write_level = [&](double price, uint32_t raw_price, uint32_t volume) {
+                append_pod(out, SnapshotLevel{price, raw_price, volume});
+                count++;
+            };
+            if (engine_ == BookEngine::Ladder) {
+                auto visit = [&](uint32_t raw_price, uint32_t volume) {
+                    write_level(raw_price / 10000.0, raw_price, volume);
+                };
+                if (side == Side::Buy) {
+                    book.bid_ladder.for_each_descending(visit);
+                } else {
+                    book.ask_ladder.for_each_ascending(visit);
+                }
+            } else {
+                for_each_level(book, side, [&](double price, uint32_t volume) {
+                    write_level(price, to_raw_price(price), volume);
+                });
+            }
+        }
+        std::memcpy(&out[at], &entry, sizeof(entry));
+        header.num_books++;
+    }
+    
+    orders_.for_each([&out](const Order& order) {
+        SnapshotOrder entry{};
+        entry.reference = order.reference;
+        entry.timestamp = order.timestamp;
+        entry.price = order.price;
+        entry.raw_price = order.raw_price;
+        entry.shares = order.shares;
+        entry.symbol = order.symbol;
+        entry.side = order.side;
+        append_pod(out, entry);
+    });
+    
+    std::memcpy(&out[0], &header, sizeof(header));
+    
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to create book snapshot: " + path);
+    }
+    file.write(out.data(), static_cast<std::streamsize>(out.size()));
+    if (!file) {
+        throw std::runtime_error("Failed to write book snapshot: " + path);
+    }
 }
 
-// get_imbalance is already implemented with string_view
+FeedPosition OrderBook::load_snapshot(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!std::filesystem::is_regular_file(path) || !file.is_open()) {
+        throw std::runtime_error("Failed to open book snapshot: " + path);
+    }
+    
+    // One read for the whole file; parsing is then plain memory copies
+    file.seekg(0, std::ios::end);
+    const std::streamoff size = file.tellg();
+    if (size < 0) {
+        throw std::runtime_error("Failed to read book snapshot: " + path);
+    }
+    std::string data(static_cast<size_t>(size), '\0');
+    file.seekg(0, std::ios::beg);
+    file.read(&data[0], size);
+    
+    SnapshotReader reader(data, path);
+    const auto header = reader.read<SnapshotHeader>();
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error(path + " is not a book snapshot");
+    }
+    if (header.version != SNAPSHOT_VERSION) {
+        throw std::runtime_error(path + ": unsupported book snapshot version " + std::to_string(header.version));
+    }
+    if (header.engine != static_cast<uint32_t>(engine_)) {
+        throw std::runtime_error(path + " was taken with a different book engine");
+    }
+    
+    // Start from an empty book
+    orders_ = OrderStore<Order>();
+    symbols_ = SymbolTable();
+    books_.clear();
+    std::fill(best_prices_.begin(), best_prices_.end(), std::make_pair(0.0, 0.0));
+    
+    for (uint64_t i = 0; i < header.num_symbols; ++i) {
+        const auto id = reader.read<SymbolId>();
+        const auto length = reader.read<uint16_t>();
+        symbols_.assign(id, reader.read_bytes(length));
+    }
+    
+    for (uint64_t i = 0; i < header.num_books; ++i) {
+        const auto entry = reader.read<SnapshotBook>();
+        SymbolBook& book = book_for(entry.symbol);
+        book.active = true;
+        book.bid_volume = entry.bid_volume;
+        book.ask_volume = entry.ask_volume;
+        
+        for (uint32_t n = 0; n < entry.num_bids + entry.num_asks; ++n) {
+            const auto level = reader.read<SnapshotLevel>();
+            const bool bid = n < entry.num_bids;
+            if (engine_ == BookEngine::Ladder) {
+                (bid ? book.bid_ladder : book.ask_ladder).add(level.raw_price, level.volume);
+            } else {
+                (bid ? book.bids : book.asks).emplace(level.price, level.volume);
+            }
+        }
+        update_best_prices(entry.symbol);
+        
+        // A full replay would have reported this state already
+        book.reported = summarize(entry.symbol, book);
+    }
+    
+    orders_.reserve(header.num_orders);
+    for (uint64_t i = 0; i < header.num_orders; ++i) {
+        const auto entry = reader.read<SnapshotOrder>();
+        orders_.insert(Order{
+            entry.symbol,
+            entry.reference,
+            entry.price,
+            entry.shares,
+            entry.side,
+            entry.timestamp,
+            entry.raw_price
+        });
+    }
+    
+    return FeedPosition{header.offset, header.messages, header.timestamp};
+}
 
 }  // namespace hft
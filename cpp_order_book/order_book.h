@@ -7,25 +7,110 @@
 #include <memory>
 #include <optional>
 #include <cstdint>
+#include "price_ladder.h"
+#include "symbol_table.h"
+#include "order_store.h"
+#include "market_update.h"
+#include "json_message.h"
+
+namespace itch {
+struct Message;
+struct MessageBatch;
+}
 
 namespace hft {
 
+class PipelineMetrics;
+
+enum class Side : uint8_t {
+    Buy,
+    Sell
+};
+
 struct Order {
-    std::string stock;
+    SymbolId symbol;
     uint64_t reference;
     double price;
     uint32_t shares;
-    std::string side;  // "Buy" or "Sell"
+    Side side;
     uint64_t timestamp;
+    uint32_t raw_price = 0;  // Exact price in 1/10000 dollars
+};
+
+// Where in the feed a book snapshot was taken, so replay can resume right after it
+struct FeedPosition {
+    uint64_t offset = 0;     // Input byte offset of the next message (itch::Parser::offset)
+    uint64_t messages = 0;   // Messages read before that offset
+    uint64_t timestamp = 0;  // Feed time of the last message read
+};
+
+// Where BookEngine::Ladder keeps its levels, summed over every side of every book
+struct LadderStats {
+    size_t window_levels = 0;    // Levels in the flat windows around the inside
+    size_t overflow_levels = 0;  // Levels in the std::map overflow, outside the windows
+    uint64_t recenters = 0;      // Window moves, including each side's first placement
+};
+
+// Price level storage behind OrderBook, selectable for A/B comparison
+enum class BookEngine {
+    Map,    // std::map keyed on double prices
+    Ladder  // Integer-tick PriceLadder with bitmap best-price lookup
+};
+
+// What OrderBook::apply watches to decide that a symbol's book changed
+enum class ChangeTrigger {
+    SideTotals,  // Best prices or total shares per side, i.e. anything in a MarketUpdate
+    TopOfBook,   // Best prices or the shares resting at them
+    Depth        // Best prices or the shares in the best depth_levels levels of each side
+};
+
+struct ChangeDetection {
+    ChangeTrigger trigger = ChangeTrigger::SideTotals;
+    size_t depth_levels = 5;  // ChangeTrigger::Depth only
 };
 
+// Parse "totals", "top" or "depth:N" (N levels per side).
+// Throws std::invalid_argument for anything else.
+ChangeDetection parse_change_detection(const std::string& text);
+
+// The same spelling back, for printing
+std::string change_detection_name(const ChangeDetection& detection);
+
 class OrderBook {
 public:
-    OrderBook();
+    explicit OrderBook(BookEngine engine = BookEngine::Map);
     ~OrderBook();
-
-    // Process a single message and update the order book
-    void process_message(const std::string& message_json);
+    
+    // Every way of applying a message returns the symbol whose watched summary
+    // (see set_change_detection) the message changed, or INVALID_SYMBOL when
+    // nothing a MarketUpdate consumer cares about moved. Callers publish
+    // updates off this instead of after every AddOrder.
+    
+    // Decode a single JSON message (JsonSerializer layout) and update the order book.
+    // Messages that fail to decode are counted in json_stats() and skipped.
+    SymbolId process_message(std::string_view message_json);
+    
+    // Apply a JSON message decoded with decode_json_message
+    SymbolId apply(const JsonBookMessage& message);
+    
+    // Apply a parsed ITCH message directly, without a JSON round-trip
+    SymbolId apply(const itch::Message& message);
+    
+    // A message of a batch that changed a symbol's book
+    struct BatchChange {
+        uint32_t row;  // Row in the batch, for its timestamp
+        SymbolId symbol;
+    };
+    
+    // Apply a struct-of-arrays batch from itch::BatchDecoder in feed order,
+    // appending a BatchChange for each row that changed a symbol's book.
+    // The hot rows are applied straight from the columns; the rest go
+    // through apply(const itch::Message&). Not timed into Stage::BookApply.
+    void apply(const itch::MessageBatch& batch, std::vector<BatchChange>& changes);
+    
+    // Choose what apply() treats as a change. Defaults to ChangeTrigger::SideTotals.
+    void set_change_detection(const ChangeDetection& detection) { change_detection_ = detection; }
+    const ChangeDetection& change_detection() const { return change_detection_; }
     
     // Get a human-readable snapshot of the order book for a stock
     std::string get_order_book_snapshot(std::string_view stock) const;
@@ -35,44 +120,133 @@ public:
     
     // Get the best bid and ask for a stock
     std::pair<double, double> get_best_prices(std::string_view stock) const;
+    std::pair<double, double> get_best_prices(SymbolId symbol) const;
     
     // Get the total volume at the bid and ask for a stock
     std::pair<uint32_t, uint32_t> get_volumes(std::string_view stock) const;
+    std::pair<uint32_t, uint32_t> get_volumes(SymbolId symbol) const;
     
     // Calculate the imbalance for a stock (ratio of bid volume to total volume)
     double get_imbalance(std::string_view stock) const;
-
+    double get_imbalance(SymbolId symbol) const;
+    
+    // Best prices and side volumes for a symbol, packed for the strategy thread
+    MarketUpdate get_market_update(SymbolId symbol, uint64_t timestamp) const;
+    
+    // Volume and imbalance over only the best `levels` price levels of each side
+    std::pair<uint32_t, uint32_t> get_depth_volumes(SymbolId symbol, size_t levels) const;
+    double get_depth_imbalance(std::string_view stock, size_t levels) const;
+    double get_depth_imbalance(SymbolId symbol, size_t levels) const;
+    
+    // Symbol IDs seen so far (from StockDirectory and AddOrder messages)
+    const SymbolTable& symbols() const { return symbols_; }
+    
+    BookEngine engine() const { return engine_; }
+    
+    // Outcomes of the JSON messages given to process_message
+    const JsonDecodeStats& json_stats() const { return json_stats_; }
+    
+    // Ladder level placement, walking every book (all zero for BookEngine::Map)
+    LadderStats ladder_stats() const;
+    
+    // Time every apply() into Stage::BookApply; null (the default) turns it off
+    void set_metrics(PipelineMetrics* metrics) { metrics_ = metrics; }
+    
+    // Write the complete book (symbol table, price levels, live orders) and the
+    // feed position to a native-endian binary snapshot.
+    // Throws std::runtime_error if the file cannot be written.
+    void save_snapshot(const std::string& path, const FeedPosition& position) const;
+    
+    // Replace the book's contents with a snapshot and return where the feed
+    // should resume. The snapshot must come from a book with the same engine.
+    // Each symbol's restored state counts as already reported, so set the
+    // change detection first; the next update is the next real change.
+    // Throws std::runtime_error if the file is missing, truncated or incompatible.
+    FeedPosition load_snapshot(const std::string& path);
+    
 private:
     // Use efficient data structures for the order book
     // Key: price level, Value: total volume at that level
     using PriceLevel = std::map<double, uint32_t>;
     
-    // Store orders by reference ID
-    std::unordered_map<uint64_t, Order> orders_;
+    // The watched view of one symbol's book, compared after every message
+    struct BookSummary {
+        uint32_t bid_price = 0;
+        uint32_t ask_price = 0;
+        uint32_t bid_shares = 0;  // Side total, best level or best N levels, per ChangeTrigger
+        uint32_t ask_shares = 0;
+        
+        bool operator==(const BookSummary& other) const {
+            return bid_price == other.bid_price && ask_price == other.ask_price &&
+                   bid_shares == other.bid_shares && ask_shares == other.ask_shares;
+        }
+    };
     
-    // Store order books for each stock (bids are stored in reverse order)
-    std::unordered_map<std::string, std::pair<PriceLevel, PriceLevel>> books_;  // stock -> (bids, asks)
+    // Everything the book keeps for one symbol, indexed by SymbolId
+    struct SymbolBook {
+        PriceLevel bids;          // BookEngine::Map
+        PriceLevel asks;
+        PriceLadder bid_ladder{PriceLadder::Inside::Highest};  // BookEngine::Ladder
+        PriceLadder ask_ladder{PriceLadder::Inside::Lowest};
+        bool active = false;      // At least one order has been added
     
-    // Track best bid/ask for fast access
-    std::unordered_map<std::string, std::pair<double, double>> best_prices_;  // stock -> (bid, ask)
+        // Running per-side share totals, updated by each level change
+        uint32_t bid_volume = 0;
+        uint32_t ask_volume = 0;
+        
+        BookSummary reported;  // Summary as of the last change apply() reported
+    };
     
-    // Process specific message types
-    void process_add_order(const Order& order);
-    void process_execute_order(uint64_t reference, uint32_t shares);
-    void process_delete_order(uint64_t reference);
-    void process_cancel_order(uint64_t reference, uint32_t shares);
-    void process_replace_order(uint64_t old_reference, uint64_t new_reference,
-                              double price, uint32_t shares);
+    // Store orders by reference ID (pooled records, open-addressing index)
+    OrderStore<Order> orders_;
     
-    // Update best prices after order book changes
-    void update_best_prices(std::string_view stock);
+    BookEngine engine_;
+    SymbolTable symbols_;
+    
+    // Per-symbol books, grown on demand as new symbol IDs show up
+    std::vector<SymbolBook> books_;
+    
+    // Track best bid/ask for fast access, sized for every possible ID up front.
+    // Written on every apply, so only the applying thread may read it while
+    // messages are still coming in.
+    std::vector<std::pair<double, double>> best_prices_;  // symbol -> (bid, ask)
+    
+    JsonDecodeStats json_stats_;
+    PipelineMetrics* metrics_ = nullptr;
+    ChangeDetection change_detection_;
     
-    // Update volumes cache for a stock
-    void update_volumes_cache(std::string_view stock) const;
+    // Process specific message types. Each returns the symbol it touched, or
+    // INVALID_SYMBOL when the order was unknown.
+    SymbolId symbol_for_add(SymbolId locate, std::string_view stock);
+    SymbolId process_add_order(const Order& order);
+    SymbolId process_execute_order(uint64_t reference, uint32_t shares);
+    SymbolId process_delete_order(uint64_t reference);
+    SymbolId process_cancel_order(uint64_t reference, uint32_t shares);
+    SymbolId process_replace_order(uint64_t old_reference, uint64_t new_reference,
+                                   uint32_t raw_price, uint32_t shares);
     
-    // Cache for volume data to avoid recalculating
-    mutable std::unordered_map<std::string, std::pair<uint32_t, uint32_t>> volumes_cache_;
-    mutable bool volumes_dirty_ = true;
+    // The symbol if its summary differs from the last one reported (and
+    // remember it), else INVALID_SYMBOL. Run once per message, after the
+    // whole message is applied, so a replace that ends where it started
+    // reports nothing.
+    SymbolId report_change(SymbolId symbol);
+    BookSummary summarize(SymbolId symbol, const SymbolBook& book) const;
+    
+    // Add or remove shares at the order's price level
+    void add_to_level(const Order& order);
+    void remove_from_level(const Order& order, uint32_t shares);
+    
+    // Book for a symbol, or nullptr if no orders have been seen for it
+    const SymbolBook* find_book(SymbolId symbol) const;
+    SymbolBook& book_for(SymbolId symbol);
+    
+    // Visit (price, volume) for each level of one side, best price first.
+    // The visitor may return false to stop early.
+    template <typename F>
+    void for_each_level(const SymbolBook& book, Side side, F&& f) const;
+    
+    // Update best prices after order book changes
+    void update_best_prices(SymbolId symbol);
 };
 
-}  // namespace hft
\ No newline at end of file
+}  // namespace hft
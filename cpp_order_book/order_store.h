@@ -0,0 +1,174 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+namespace hft {
+
+// Live orders keyed by ITCH order reference.
+//
+// Records are plain structs kept in fixed-size slabs, so adding an order
+// never calls malloc once the pool has warmed up and a deleted order's slot
+// is reused by the next add. Lookups go through an open-addressing table
+// (linear probing, backward-shift deletion) that maps a reference to its
+// slot, so an execute/cancel/delete costs one multiply and usually one
+// cache line. Record pointers stay valid until the record is erased.
+template <typename Record>
+class OrderStore {
+public:
+    OrderStore() {
+        rehash(INITIAL_CAPACITY);
+    }
+    
+    // Record for a reference, nullptr if not live
+    Record* find(uint64_t reference) {
+        for (size_t i = home(reference);; i = (i + 1) & mask_) {
+            const Entry& entry = table_[i];
+            if (entry.slot == EMPTY) {
+                return nullptr;
+            }
+            if (entry.reference == reference) {
+                return &record(entry.slot);
+            }
+        }
+    }
+    
+    // Store a copy of the record under record.reference. A reference that is
+    // already live keeps its existing record (like unordered_map::emplace).
+    Record* insert(const Record& value) {
+        if ((size_ + 1) * 2 > table_.size()) {
+            rehash(table_.size() * 2);
+        }
+        
+        size_t i = home(value.reference);
+        for (; table_[i].slot != EMPTY; i = (i + 1) & mask_) {
+            if (table_[i].reference == value.reference) {
+                return &record(table_[i].slot);
+            }
+        }
+        
+        const uint32_t slot = allocate();
+        record(slot) = value;
+        table_[i] = {value.reference, slot};
+        size_++;
+        return &record(slot);
+    }
+    
+    // Remove a live reference and recycle its slot
+    void erase(uint64_t reference) {
+        size_t i = home(reference);
+        for (;; i = (i + 1) & mask_) {
+            if (table_[i].slot == EMPTY) {
+                return;
+            }
+            if (table_[i].reference == reference) {
+                break;
+            }
+        }
+        
+        free_slots_.push_back(table_[i].slot);
+        size_--;
+        
+        // Shift later entries of the probe run back so no tombstones are needed
+        for (size_t j = (i + 1) & mask_; table_[j].slot != EMPTY; j = (j + 1) & mask_) {
+            const size_t h = home(table_[j].reference);
+            // Move j into the hole at i unless its home lies cyclically in (i, j]
+            if (((j - h) & mask_) >= ((j - i) & mask_)) {
+                table_[i] = table_[j];
+                i = j;
+            }
+        }
+        table_[i].slot = EMPTY;
+    }
+    
+    size_t size() const {
+        return size_;
+    }
+    
+    // Grow the index so `count` live records fit without rehashing
+    void reserve(size_t count) {
+        size_t capacity = table_.size();
+        while (count * 2 > capacity) {
+            capacity *= 2;
+        }
+        if (capacity != table_.size()) {
+            rehash(capacity);
+        }
+    }
+    
+    // Visit every live record, in no particular order
+    template <typename F>
+    void for_each(F&& f) const {
+        for (const Entry& entry : table_) {
+            if (entry.slot != EMPTY) {
+                f(record(entry.slot));
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+    static constexpr size_t INITIAL_CAPACITY = 1 << 16;  // Table entries, a power of two
+    static constexpr size_t SLAB_SHIFT = 12;              // 4096 records per slab
+    static constexpr size_t SLAB_SIZE = size_t(1) << SLAB_SHIFT;
+    
+    struct Entry {
+        uint64_t reference;
+        uint32_t slot;
+    };
+    
+    std::vector<Entry> table_;
+    size_t mask_ = 0;
+    int shift_ = 0;
+    size_t size_ = 0;
+    
+    std::vector<std::unique_ptr<Record[]>> slabs_;
+    std::vector<uint32_t> free_slots_;
+    uint32_t next_slot_ = 0;  // First never-used slot
+    
+    // Fibonacci hashing spreads sequential references across the table
+    size_t home(uint64_t reference) const {
+        return static_cast<size_t>((reference * 0x9E3779B97F4A7C15ull) >> shift_);
+    }
+    
+    Record& record(uint32_t slot) {
+        return slabs_[slot >> SLAB_SHIFT][slot & (SLAB_SIZE - 1)];
+    }
+    
+    const Record& record(uint32_t slot) const {
+        return slabs_[slot >> SLAB_SHIFT][slot & (SLAB_SIZE - 1)];
+    }
+    
+    uint32_t allocate() {
+        if (!free_slots_.empty()) {
+            const uint32_t slot = free_slots_.back();
+            free_slots_.pop_back();
+            return slot;
+        }
+        if ((next_slot_ >> SLAB_SHIFT) == slabs_.size()) {
+            slabs_.emplace_back(new Record[SLAB_SIZE]);
+        }
+        return next_slot_++;
+    }
+    
+    void rehash(size_t capacity) {
+        std::vector<Entry> old = std::move(table_);
+        table_.assign(capacity, Entry{0, EMPTY});
+        mask_ = capacity - 1;
+        shift_ = 64 - __builtin_ctzll(capacity);
+        
+        for (const Entry& entry : old) {
+            if (entry.slot != EMPTY) {
+                size_t i = home(entry.reference);
+                while (table_[i].slot != EMPTY) {
+                    i = (i + 1) & mask_;
+                }
+                table_[i] = entry;
+            }
+        }
+    }
+};
+
+} // namespace hft
@@ -7,8 +7,65 @@
 using namespace hft;
 
 int main(int argc, char* argv[]) {
+    // Split option flags from positional arguments
+    hft::BookEngine engine = hft::BookEngine::Map;
+    std::string placement_file;
+    std::vector<std::string> placement_settings;
+    std::string update_trigger = "totals";
+    bool conflate = false;
+    std::vector<char*> args;
+    for (int i = 0; i < argc; i++) {
+        if (std::string(argv[i]) == "--ladder") {
+            engine = hft::BookEngine::Ladder;
+        } else if (std::string(argv[i]) == "--placement" && i + 1 < argc) {
+            placement_file = argv[++i];
+        } else if (std::string(argv[i]) == "--place" && i + 1 < argc) {
+            placement_settings.push_back(argv[++i]);
+        } else if (std::string(argv[i]) == "--update-trigger" && i + 1 < argc) {
+            update_trigger = argv[++i];
+        } else if (std::string(argv[i]) == "--conflate") {
+            conflate = true;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    argc = static_cast<int>(args.size());
+    argv = args.data();
+    
+    // The config file first, then each --place on top of it
+    hft::ThreadPlacement placement;
+    try {
+        if (!placement_file.empty()) {
+            placement.load(placement_file);
+        }
+        for (const auto& setting : placement_settings) {
+            placement.set(setting);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    
+    hft::ChangeDetection change_detection;
+    try {
+        change_detection = hft::parse_change_detection(update_trigger);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_file> [num_messages] [trading_output_dir] [num_threads] [stocks...]" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " [--ladder] [--placement FILE] [--place STAGE.KEY=VALUE] [--update-trigger totals|top|depth:N] [--conflate] <input_file> [num_messages] [trading_output_dir] [num_shards] [stocks...]" << std::endl;
+        std::cerr << "  <input_file> : JSON lines or raw ITCH 5.0 (optionally gzip/zstd-compressed)" << std::endl;
+        std::cerr << "  [num_shards] : Order book shards, one thread each; symbols are split across them by stock_locate" << std::endl;
+        std::cerr << "  --ladder     : Use the integer-tick ladder book instead of the std::map book" << std::endl;
+        std::cerr << "  --placement FILE : Thread placement config, one STAGE.KEY=VALUE per line" << std::endl;
+        std::cerr << "  --place STAGE.KEY=VALUE : One placement setting, applied after --placement; repeatable" << std::endl;
+        std::cerr << "                 STAGE is decode (feed thread), book (shard i is thread i) or strategy;" << std::endl;
+        std::cerr << "                 KEY is cpus (e.g. 4-7,12), numa (node) or busy_poll (1/0)" << std::endl;
+        std::cerr << "  --update-trigger T : Publish an update when a message changes a symbol's best prices and side" << std::endl;
+        std::cerr << "                 totals (totals, default), best-level sizes (top) or best N levels (depth:N)" << std::endl;
+        std::cerr << "  --conflate   : Keep only the latest update per symbol while the strategy thread is behind" << std::endl;
         return 1;
     }
     
@@ -17,7 +74,7 @@ int main(int argc, char* argv[]) {
     size_t num_messages = (argc > 2) ? std::stoi(argv[2]) : 0;
     std::string trading_output_dir = (argc > 3) ? argv[3] : "trading_output_parallel";
     
-    // Determine number of threads (0 means use hardware concurrency)
+    // Determine number of shards (0 means use hardware concurrency)
     size_t num_threads = (argc > 4) ? std::stoi(argv[4]) : 0;
     if (num_threads == 0) {
         num_threads = std::thread::hardware_concurrency();
@@ -33,8 +90,13 @@ int main(int argc, char* argv[]) {
     std::cout << "---------------------------------" << std::endl;
     std::cout << "Input file: " << input_file << std::endl;
     std::cout << "Trading output directory: " << trading_output_dir << std::endl;
-    std::cout << "Number of threads: " << num_threads << std::endl;
+    std::cout << "Order book shards: " << num_threads << std::endl;
     std::cout << "Message limit: " << (num_messages > 0 ? std::to_string(num_messages) : "No limit") << std::endl;
+    std::cout << "Decode thread: " << placement.decode.describe() << std::endl;
+    std::cout << "Shard threads: " << placement.book.describe() << std::endl;
+    std::cout << "Strategy thread: " << placement.strategy.describe() << std::endl;
+    std::cout << "Update trigger: " << hft::change_detection_name(change_detection) << std::endl;
+    std::cout << "Update queue: " << (conflate ? "conflating" : "every update") << std::endl;
     
     if (!stocks.empty()) {
         std::cout << "Stock filters: ";
@@ -51,8 +113,11 @@ int main(int argc, char* argv[]) {
         input_file,
         trading_output_dir,
         num_messages,
-        stocks
+        stocks,
+        engine
     );
+    processor.set_placement(placement);
+    processor.set_update_options(change_detection, conflate);
     
     // Run the processor
     processor.run();
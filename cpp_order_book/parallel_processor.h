@@ -1,21 +1,25 @@
 #pragma once
 
 #include "order_book.h"
+#include "sharded_book.h"
 #include "trading_strategy.h"
+#include "ring_queue.h"
+#include "conflating_queue.h"
+#include "market_update.h"
+#include "thread_placement.h"
+#include "../cpp_parser/include/parser.h"
+#include "../cpp_parser/include/decompressor.h"
 #include <nlohmann/json.hpp>
 #include <vector>
 #include <string>
+#include <memory>
 #include <thread>
-#include <mutex>
-#include <queue>
-#include <condition_variable>
 #include <atomic>
-#include <functional>
-#include <future>
+#include <algorithm>
+#include <unordered_map>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
-#include <set>
 #include <chrono>
 #include <filesystem>
 
@@ -23,203 +27,150 @@ using json = nlohmann::json;
 
 namespace hft {
 
-// Market update structure to pass between threads
-struct MarketUpdate {
-    std::string symbol;
-    double bid_price;
-    double ask_price;
-    uint32_t bid_volume;
-    uint32_t ask_volume;
-    double imbalance;
-    uint64_t timestamp;
-};
-
-// Thread-safe queue for market updates
+// Queue of market updates from the shards to the strategy thread. Every
+// shard publishes from its own thread, so this is the multi-producer ring;
+// a full queue blocks the shards until the strategy catches up. With
+// conflate set, shards never block: only the latest update per symbol is
+// kept while the strategy thread is behind (see ConflatingUpdateQueue).
 class MarketUpdateQueue {
 public:
-    // Maximum queue size - set to a reasonable value that won't exhaust memory
-    // but still allows for high throughput
-    static constexpr size_t MAX_QUEUE_SIZE = 250000;
+    static constexpr size_t CAPACITY = 1 << 16;
     
-    void push(const MarketUpdate& update) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        // Block if the queue is already too large
-        // This provides backpressure to slow down producers when needed
-        while (queue_.size() >= MAX_QUEUE_SIZE && !is_done_) {
-            // Wait a short time and check again - prevents tight loop
-            condition_push_.wait_for(lock, std::chrono::milliseconds(1));
+    explicit MarketUpdateQueue(QueueKind kind = QueueKind::Mpsc, bool conflate = false)
+        : queue_(kind, conflate ? 1 : CAPACITY) {
+        if (conflate) {
+            conflating_ = std::make_unique<ConflatingUpdateQueue>();
         }
-        
-        if (is_done_) return; // Don't add more items if shutting down
-        
-        queue_.push(update);
-        lock.unlock();
-        condition_.notify_one();
     }
     
-    bool pop(MarketUpdate& update) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        condition_.wait(lock, [this] { 
-            return !queue_.empty() || is_done_; 
-        });
-        
-        if (queue_.empty() && is_done_) {
-            return false; // Signal consumer to exit
-        }
-        
-        update = queue_.front();
-        queue_.pop();
-        
-        // Notify producers when queue has space
-        if (queue_.size() < MAX_QUEUE_SIZE/2) {
-            lock.unlock();
-            condition_push_.notify_all(); // Wake up producers when queue is half empty
+    void push(const MarketUpdate& update) {
+        if (conflating_) {
+            conflating_->push(update);
         } else {
-            lock.unlock();
+            queue_.push(update);
         }
-        
-        return true;
     }
     
-    void set_done() {
-        std::unique_lock<std::mutex> lock(mutex_);
-        is_done_ = true;
-        lock.unlock();
-        condition_.notify_all();
+    bool pop(MarketUpdate& update) {
+        return conflating_ ? conflating_->pop(update) : queue_.pop(update);
     }
     
-    size_t size() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return queue_.size();
+    // Replace updates with up to max queued updates; 0 once done and drained
+    size_t pop_batch(std::vector<MarketUpdate>& updates, size_t max) {
+        return conflating_ ? conflating_->pop_batch(updates, max) : queue_.pop_batch(updates, max);
     }
     
-private:
-    std::queue<MarketUpdate> queue_;
-    std::mutex mutex_;
-    std::condition_variable condition_;
-    std::condition_variable condition_push_; // Used to signal producers when queue has space
-    bool is_done_ = false;
-};
-
-// Thread pool implementation
-class ThreadPool {
-public:
-    ThreadPool(size_t num_threads) : stop(false) {
-        for (size_t i = 0; i < num_threads; ++i) {
-            workers.emplace_back([this] {
-                while (true) {
-                    std::function<void()> task;
-                    {
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock, [this] {
-                            return this->stop || !this->tasks.empty();
-                        });
-                        
-                        if (this->stop && this->tasks.empty()) {
-                            return;
-                        }
-                        
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                    }
-                    
-                    task();
-                }
-            });
+    void set_done() {
+        if (conflating_) {
+            conflating_->set_done();
+        } else {
+            queue_.set_done();
         }
     }
     
-    ~ThreadPool() {
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            stop = true;
-        }
-        
-        condition.notify_all();
-        
-        for (std::thread &worker : workers) {
-            worker.join();
+    // Spin instead of sleeping while the queue is empty; call before the consumer starts
+    void set_consumer_busy_poll(bool busy_poll) {
+        if (conflating_) {
+            conflating_->set_consumer_busy_poll(busy_poll);
+        } else {
+            queue_.set_consumer_busy_poll(busy_poll);
         }
     }
     
-    // Add task to the thread pool
-    template<class F, class... Args>
-    auto enqueue(F&& f, Args&&... args) {
-        using return_type = std::invoke_result_t<F, Args...>;
-        
-        auto task = std::make_shared<std::packaged_task<return_type()>>(
-            std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-        );
-        
-        std::future<return_type> res = task->get_future();
-        
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            if (stop) {
-                throw std::runtime_error("enqueue on stopped ThreadPool");
-            }
-            
-            tasks.emplace([task]() { (*task)(); });
-        }
-        
-        condition.notify_one();
-        return res;
+    size_t size() const {
+        return conflating_ ? conflating_->size() : queue_.size();
     }
     
-private:
-    // Worker threads
-    std::vector<std::thread> workers;
-    
-    // Task queue
-    std::queue<std::function<void()>> tasks;
+    // Updates replaced by a newer one for the same symbol; always 0 without conflation
+    size_t conflated() const {
+        return conflating_ ? conflating_->conflated() : 0;
+    }
     
-    // Synchronization
-    std::mutex queue_mutex;
-    std::condition_variable condition;
-    bool stop;
+private:
+    ConcurrentQueue<MarketUpdate> queue_;
+    std::unique_ptr<ConflatingUpdateQueue> conflating_;
 };
 
-// Parallel processor with producer-consumer pattern
+// Parallel processor: a ShardedOrderBook applies messages on per-symbol
+// shards, each with its own book, and one strategy thread consumes the
+// market updates they publish
 class ParallelProcessor {
 public:
+    static constexpr size_t STRATEGY_BATCH_SIZE = 256;  // Updates the strategy thread takes per pop
+    
     ParallelProcessor(
-        size_t num_threads, 
+        size_t num_threads,
         const std::string& input_file,
         const std::string& trading_output_dir,
         size_t num_messages = 0,
-        const std::vector<std::string>& stock_filters = {}
-    ) : thread_pool(num_threads),
+        const std::vector<std::string>& stock_filters = {},
+        BookEngine engine = BookEngine::Map
+    ) : num_shards_(num_threads),
         input_file_(input_file),
         trading_output_dir_(trading_output_dir),
         num_messages_(num_messages),
-        stock_filters_(stock_filters) {
+        stock_filters_(stock_filters),
+        engine_(engine) {
         
         // If num_threads is 0, use hardware concurrency
-        if (num_threads == 0) {
-            num_threads = std::thread::hardware_concurrency();
+        if (num_shards_ == 0) {
+            num_shards_ = std::max(1u, std::thread::hardware_concurrency());
         }
         
-        std::cout << "Using " << num_threads << " threads for processing" << std::endl;
+        std::cout << "Using " << num_shards_ << " order book shards" << std::endl;
+    }
+    
+    // Where the feed thread (decode; the thread calling run), the shards
+    // (book) and the strategy thread run. Call before run().
+    void set_placement(const ThreadPlacement& placement) {
+        placement_ = placement;
+    }
+    
+    // What change in a symbol's book publishes an update (default: side
+    // totals), and whether the strategy queue keeps only the latest update
+    // per symbol while the strategy thread is behind. Call before run().
+    void set_update_options(const ChangeDetection& detection, bool conflate) {
+        change_detection_ = detection;
+        conflate_ = conflate;
     }
     
     void run() {
         auto start_time = std::chrono::high_resolution_clock::now();
+        placement_.decode.apply_to_current_thread(0);
         
         // Create shared queue for market updates
-        MarketUpdateQueue market_updates;
+        MarketUpdateQueue market_updates(QueueKind::Mpsc, conflate_);
+        market_updates.set_consumer_busy_poll(placement_.strategy.busy_poll);
         
-        // Create order book
-        OrderBook order_book;
+        // One filter per shard, each only used on its shard's thread
+        std::vector<SymbolFilter> filters(num_shards_, SymbolFilter(stock_filters_));
         
-        // Create trading strategy with optimized parameters
+        // Shards publish straight from their own book whenever a message changes it
+        ShardedOrderBook books(num_shards_,
+            [&](size_t shard, const OrderBook& book, SymbolId symbol, uint64_t timestamp) {
+                if (!filters[shard].allows(symbol, book.symbols())) {
+                    return;
+                }
+                
+                // Push market update to queue for strategy thread
+                market_updates.push(book.get_market_update(symbol, timestamp));
+            },
+            engine_,
+            change_detection_,
+            placement_.book);
+        
+        // Create trading strategy with the tuned parameters. It prices its
+        // exits from the quotes it has been sent and names symbols through
+        // the shard that owns them.
+        const StrategyParams params;
         LiquidityReversionStrategy strategy(
-            order_book,
+            [&books](SymbolId symbol) -> const std::string& { return books.symbol_name(symbol); },
             trading_output_dir_,
             1000000.0,  // Initial capital
-            1.8,        // Liquidity threshold - increased to reduce false signals
-            0.6,        // Reverse threshold - more aggressive selling on imbalance
-            100,        // Position size
-            15          // Hold time ticks - reduced to lock in profits faster
+            params.liquidity_threshold,
+            params.reverse_threshold,
+            params.position_size,
+            params.hold_time_ticks
         );
         
         // Start consumer thread for trading strategy
@@ -227,42 +178,123 @@ public:
         std::atomic<size_t> updates_processed(0);
         
         std::thread strategy_thread([&] {
-            MarketUpdate update;
-            while (market_updates.pop(update)) {
-                strategy.process_market_update(
-                    update.symbol,
-                    update.bid_price,
-                    update.ask_price,
-                    update.bid_volume,
-                    update.ask_volume,
-                    update.imbalance,
-                    update.timestamp
-                );
-                updates_processed++;
-                
-                // Print progress every 100,000 updates
-                if (updates_processed % 100000 == 0) {
-                    std::cout << "Strategy processed " << updates_processed 
-                              << " market updates" << std::endl;
+            placement_.strategy.apply_to_current_thread(0);
+            std::vector<MarketUpdate> updates;
+            while (market_updates.pop_batch(updates, STRATEGY_BATCH_SIZE)) {
+                for (const MarketUpdate& update : updates) {
+                    strategy.process_market_update(update);
+                    updates_processed++;
                     
-                    // Optionally print strategy performance
-                    if (updates_processed % 1000000 == 0) {
-                        strategy.print_performance();
+                    // Print progress every 100,000 updates
+                    if (updates_processed % 100000 == 0) {
+                        std::cout << "Strategy processed " << updates_processed
+                                  << " market updates" << std::endl;
+                        
+                        // Optionally print strategy performance
+                        if (updates_processed % 1000000 == 0) {
+                            strategy.print_performance();
+                        }
                     }
                 }
             }
             strategy_done = true;
         });
         
+        size_t count = 0;
+        try {
+            count = is_itch_file(input_file_) ? feed_itch(books) : feed_json(books, market_updates, updates_processed);
+            
+            // Wait for every shard to apply what it was sent
+            books.flush();
+        } catch (const std::exception& e) {
+            std::cerr << "Error processing " << input_file_ << ": " << e.what() << std::endl;
+        }
+        
+        for (size_t i = 0; i < books.num_shards(); ++i) {
+            std::cout << "Shard " << i << " applied " << books.applied(i) << " messages" << std::endl;
+        }
+        if (books.routed_orders() > 0) {
+            std::cout << "Orders still routed by reference: " << books.routed_orders() << std::endl;
+        }
+        std::cout << "All shards done, waiting for strategy to catch up..." << std::endl;
+        std::cout << "Queue size: " << market_updates.size() << std::endl;
+        
+        // Signal that no more updates will be coming
+        market_updates.set_done();
+        
+        // Wait for strategy thread to complete
+        strategy_thread.join();
+        
+        // Print performance statistics
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            end_time - start_time).count() / 1000.0;
+        
+        std::cout << "Processing complete!" << std::endl;
+        std::cout << "Processed " << count << " messages in " << elapsed << " seconds" << std::endl;
+        std::cout << "Rate: " << (count / elapsed) << " messages per second" << std::endl;
+        std::cout << "Market updates processed: " << updates_processed.load() << std::endl;
+        if (conflate_) {
+            std::cout << "Market updates conflated: " << market_updates.conflated() << std::endl;
+        }
+        
+        // Print trading strategy performance
+        strategy.print_performance();
+    }
+    
+private:
+    size_t num_shards_;
+    
+    // Input file
+    std::string input_file_;
+    std::string trading_output_dir_;
+    size_t num_messages_;
+    std::vector<std::string> stock_filters_;
+    BookEngine engine_;
+    ThreadPlacement placement_;
+    ChangeDetection change_detection_;
+    bool conflate_ = false;
+    
+    // Raw ITCH files start with a big-endian length prefix, JSON files with '[' or '{'.
+    // Compressed files are assumed to hold ITCH.
+    static bool is_itch_file(const std::string& filename) {
+        itch::Compression format;
+        if (itch::detect_compression(filename, format)) {
+            return true;
+        }
+        std::ifstream file(filename, std::ios::binary);
+        return file.is_open() && file.peek() == 0;
+    }
+    
+    // Decode raw ITCH and route each parsed message to its shard
+    size_t feed_itch(ShardedOrderBook& books) {
+        std::cout << "Reading raw ITCH from " << input_file_ << "..." << std::endl;
+        auto parser = itch::Parser::open(input_file_, itch::InputBackend::Mmap);
+        
+        size_t count = 0;
+        while (auto message = parser->parse_message()) {
+            books.submit(std::move(*message));
+            count++;
+            
+            if (count % 1000000 == 0) {
+                std::cout << "Dispatched " << count << " messages" << std::endl;
+            }
+            if (num_messages_ > 0 && count >= num_messages_) {
+                break;
+            }
+        }
+        return count;
+    }
+    
+    // Load JSON lines and route each message to its shard
+    size_t feed_json(ShardedOrderBook& books, MarketUpdateQueue& market_updates,
+                     const std::atomic<size_t>& updates_processed) {
         // Load and process JSON data from file
         std::cout << "Loading JSON data from " << input_file_ << "..." << std::endl;
         
         std::ifstream file(input_file_);
         if (!file.is_open()) {
-            std::cerr << "Failed to open file: " << input_file_ << std::endl;
-            market_updates.set_done();
-            strategy_thread.join();
-            return;
+            throw std::runtime_error("Failed to open file: " + input_file_);
         }
         
         // Get file size for progress reporting
@@ -288,11 +320,6 @@ public:
         auto load_start_time = std::chrono::high_resolution_clock::now();
         size_t last_report_time = 0;
         
-        // Create a set of futures for batch processing
-        std::vector<std::future<void>> futures;
-        std::vector<json> batch;
-        size_t batch_size = 1000; // Process in batches of 1000 messages
-        
         while (std::getline(file, line) && (num_messages_ == 0 || count < num_messages_)) {
             line_number++;
             
@@ -309,8 +336,8 @@ public:
                     double lines_per_sec = line_number * 1000.0 / elapsed_ms;
                     double msgs_per_sec = count * 1000.0 / elapsed_ms;
                     
-                    std::cout << "Loading: " << std::fixed << std::setprecision(2) << percent_complete 
-                              << "% complete, read " << count << " messages, " << line_number 
+                    std::cout << "Loading: " << std::fixed << std::setprecision(2) << percent_complete
+                              << "% complete, read " << count << " messages, " << line_number
                               << " lines (" << std::setprecision(0) << lines_per_sec << " lines/sec, "
                               << std::setprecision(0) << msgs_per_sec << " msgs/sec)" << std::endl;
                     
@@ -340,145 +367,15 @@ public:
                     continue;
                 }
                 
-                // Parse JSON
-                json j = json::parse(line);
-                batch.push_back(j);
+                // Parse JSON and hand it to the shard that owns its symbol
+                books.submit(json::parse(line));
                 count++;
-                
-                // When batch is full, process it
-                if (batch.size() >= batch_size) {
-                    auto batch_copy = batch; // Copy to capture by value
-                    futures.push_back(
-                        thread_pool.enqueue([this, batch_copy, &order_book, &market_updates]() {
-                            process_batch(batch_copy, order_book, market_updates);
-                        })
-                    );
-                    batch.clear();
-                }
             } catch (const json::parse_error& e) {
                 std::cerr << "JSON parse error at line " << line_number << ": " << e.what() << std::endl;
             }
         }
-        
-        // Process any remaining messages in the last batch
-        if (!batch.empty()) {
-            auto batch_copy = batch;
-            futures.push_back(
-                thread_pool.enqueue([this, batch_copy, &order_book, &market_updates]() {
-                    process_batch(batch_copy, order_book, market_updates);
-                })
-            );
-        }
-        
-        // Wait for all futures to complete
-        for (auto& f : futures) {
-            f.get();
-        }
-        
-        std::cout << "All batches processed, waiting for strategy to catch up..." << std::endl;
-        std::cout << "Queue size: " << market_updates.size() << std::endl;
-        
-        // Signal that no more updates will be coming
-        market_updates.set_done();
-        
-        // Wait for strategy thread to complete
-        strategy_thread.join();
-        
-        // Print performance statistics
-        auto end_time = std::chrono::high_resolution_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-            end_time - start_time).count();
-        
-        std::cout << "Processing complete!" << std::endl;
-        std::cout << "Processed " << count << " messages in " << elapsed << " seconds" << std::endl;
-        std::cout << "Rate: " << (count / (double)elapsed) << " messages per second" << std::endl;
-        std::cout << "Market updates processed: " << updates_processed.load() << std::endl;
-        
-        // Print trading strategy performance
-        strategy.print_performance();
-    }
-    
-private:
-    // Thread pool
-    ThreadPool thread_pool;
-    
-    // Input file
-    std::string input_file_;
-    std::string trading_output_dir_;
-    size_t num_messages_;
-    std::vector<std::string> stock_filters_;
-    
-    // Process a batch of messages
-    void process_batch(
-        const std::vector<json>& messages, 
-        OrderBook& order_book,
-        MarketUpdateQueue& market_updates
-    ) {
-        std::mutex order_book_mutex;
-        std::set<std::string> unique_stocks;
-        
-        for (const auto& message : messages) {
-            std::string message_json = message.dump();
-            
-            // Process message in order book (thread-safe via mutex)
-            {
-                std::lock_guard<std::mutex> lock(order_book_mutex);
-                order_book.process_message(message_json);
-            }
-            
-            // Extract stock from message
-            std::string stock;
-            if (message.contains("body")) {
-                const auto& body = message["body"];
-                
-                if (body.contains("AddOrder") && body["AddOrder"].contains("stock")) {
-                    stock = body["AddOrder"]["stock"];
-                    // Trim whitespace from stock symbol
-                    stock.erase(0, stock.find_first_not_of(" \t\n\r\f\v"));
-                    stock.erase(stock.find_last_not_of(" \t\n\r\f\v") + 1);
-                    unique_stocks.insert(stock);
-                }
-            }
-            
-            // Update market data and trading strategy if we have a valid stock
-            if (!stock.empty()) {
-                // Get market data from order book (thread-safe via mutex)
-                double imbalance;
-                std::pair<double, double> best_prices;
-                std::pair<uint32_t, uint32_t> volumes;
-                
-                {
-                    std::lock_guard<std::mutex> lock(order_book_mutex);
-                    best_prices = order_book.get_best_prices(stock);
-                    volumes = order_book.get_volumes(stock);
-                    imbalance = order_book.get_imbalance(stock);
-                }
-                
-                // Get timestamp
-                uint64_t timestamp = 0;
-                if (message.contains("timestamp")) {
-                    if (message["timestamp"].is_string()) {
-                        timestamp = std::stoull(message["timestamp"].get<std::string>());
-                    } else {
-                        timestamp = message["timestamp"].get<uint64_t>();
-                    }
-                }
-                
-                // Push market update to queue for strategy thread
-                MarketUpdate update{
-                    stock,
-                    best_prices.first,   // bid price
-                    best_prices.second,  // ask price
-                    volumes.first,       // bid volume
-                    volumes.second,      // ask volume
-                    imbalance,           // order book imbalance
-                    timestamp            // timestamp
-                };
-                
-                market_updates.push(update);
-            }
-        }
+        return count;
     }
 };
 
-} // namespace hft
\ No newline at end of file
+} // namespace hft
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+
+namespace hft {
+
+// Call a level visitor; visitors may return false to stop the walk early
+template <typename F, typename Price>
+inline bool visit_level(F& f, Price price, uint32_t volume) {
+    if constexpr (std::is_same_v<std::invoke_result_t<F&, Price, uint32_t>, bool>) {
+        return f(price, volume);
+    } else {
+        f(price, volume);
+        return true;
+    }
+}
+
+// Price levels for one side of one book, keyed on exact integer prices
+// (ITCH Price4 raw units, 1/10000 of a dollar).
+//
+// Levels inside a window of WINDOW_TICKS ticks live in a flat array with a
+// two-level bitmap over it, so finding the best level is a couple of bit
+// scans. Levels outside the window (stub quotes, orders far from the
+// inside, sub-tick prices) go to a sorted overflow map. The window follows
+// the inside: whenever the best level of the side would sit in the overflow
+// map (the price ran away from the window, or the window emptied), the
+// window is re-centred on it and its levels are moved across.
+class PriceLadder {
+public:
+    static constexpr uint32_t WINDOW_TICKS = 1024;
+
+    // Which end of the ladder is the side's best price
+    enum class Inside {
+        Lowest,  // Asks
+        Highest  // Bids
+    };
+
+    explicit PriceLadder(Inside inside = Inside::Lowest) : inside_(inside) {}
+
+    // Add shares at a price level
+    void add(uint32_t price, uint32_t shares) {
+        if (shares == 0) {
+            return;
+        }
+        if (window_levels_ == 0) {
+            recenter(price);
+        }
+
+        size_t index;
+        if (in_window(price, index)) {
+            if (volumes_[index] == 0) {
+                set_bit(index);
+                window_levels_++;
+            }
+            volumes_[index] += shares;
+        } else {
+            overflow_[price] += shares;
+            follow_inside();
+        }
+    }
+
+    // Remove shares from a price level, dropping the level once it reaches zero.
+    // Returns the shares actually removed.
+    uint32_t remove(uint32_t price, uint32_t shares) {
+        size_t index;
+        if (in_window(price, index)) {
+            const uint32_t removed = volumes_[index] > shares ? shares : volumes_[index];
+            if (volumes_[index] > shares) {
+                volumes_[index] -= shares;
+            } else if (volumes_[index] > 0) {
+                volumes_[index] = 0;
+                clear_bit(index);
+                window_levels_--;
+                follow_inside();
+            }
+            return removed;
+        }
+
+        auto it = overflow_.find(price);
+        if (it == overflow_.end()) {
+            return 0;
+        }
+        const uint32_t removed = it->second > shares ? shares : it->second;
+        if (it->second > shares) {
+            it->second -= shares;
+        } else {
+            overflow_.erase(it);
+        }
+        return removed;
+    }
+
+    // Shares resting at a price level
+    uint32_t volume_at(uint32_t price) const {
+        size_t index;
+        if (in_window(price, index)) {
+            return volumes_[index];
+        }
+        auto it = overflow_.find(price);
+        return it != overflow_.end() ? it->second : 0;
+    }
+
+    bool empty() const {
+        return window_levels_ == 0 && overflow_.empty();
+    }
+
+    // Levels held in the flat window and in the overflow map
+    size_t window_levels() const { return window_levels_; }
+    size_t overflow_levels() const { return overflow_.size(); }
+
+    // Times the window has been moved, including the first placement
+    uint64_t recenters() const { return recenters_; }
+
+    // Highest price with volume (best bid), 0 if empty
+    uint32_t highest() const {
+        uint32_t best = overflow_.empty() ? 0 : overflow_.rbegin()->first;
+        if (summary_ != 0) {
+            const uint32_t price = window_highest();
+            best = price > best ? price : best;
+        }
+        return best;
+    }
+
+    // Lowest price with volume (best ask), 0 if empty
+    uint32_t lowest() const {
+        uint32_t best = overflow_.empty() ? 0 : overflow_.begin()->first;
+        if (summary_ != 0) {
+            const uint32_t price = window_lowest();
+            best = (best == 0 || price < best) ? price : best;
+        }
+        return best;
+    }
+
+    // Visit (price, volume) for every level, lowest price first (see visit_level)
+    template <typename F>
+    void for_each_ascending(F&& f) const {
+        auto it = overflow_.begin();
+        for (size_t index = next_set(0); index < WINDOW_TICKS; index = next_set(index + 1)) {
+            const uint32_t price = price_of(index);
+            for (; it != overflow_.end() && it->first < price; ++it) {
+                if (!visit_level(f, it->first, it->second)) return;
+            }
+            if (!visit_level(f, price, volumes_[index])) return;
+        }
+        for (; it != overflow_.end(); ++it) {
+            if (!visit_level(f, it->first, it->second)) return;
+        }
+    }
+
+    // Visit (price, volume) for every level, highest price first (see visit_level)
+    template <typename F>
+    void for_each_descending(F&& f) const {
+        auto it = overflow_.rbegin();
+        for (size_t index = prev_set(WINDOW_TICKS); index < WINDOW_TICKS; index = prev_set(index)) {
+            const uint32_t price = price_of(index);
+            for (; it != overflow_.rend() && it->first > price; ++it) {
+                if (!visit_level(f, it->first, it->second)) return;
+            }
+            if (!visit_level(f, price, volumes_[index])) return;
+        }
+        for (; it != overflow_.rend(); ++it) {
+            if (!visit_level(f, it->first, it->second)) return;
+        }
+    }
+
+private:
+    static constexpr size_t WORDS = WINDOW_TICKS / 64;
+    static_assert(WORDS <= 64, "summary bitmap holds one bit per word");
+
+    std::vector<uint32_t> volumes_;         // Allocated on first use, WINDOW_TICKS entries
+    uint64_t bits_[WORDS] = {};             // One bit per non-empty window slot
+    uint64_t summary_ = 0;                  // One bit per non-zero word of bits_
+    uint32_t tick_ = 1;                     // Price units per window slot
+    uint32_t base_ = 0;                     // Price of slot 0, a multiple of tick_
+    size_t window_levels_ = 0;
+    std::map<uint32_t, uint32_t> overflow_; // Levels outside the window
+    Inside inside_;                         // End of the ladder the window follows
+    uint64_t recenters_ = 0;
+
+    uint32_t price_of(size_t index) const {
+        return base_ + static_cast<uint32_t>(index) * tick_;
+    }
+
+    bool in_window(uint32_t price, size_t& index) const {
+        if (volumes_.empty() || price < base_ || (price - base_) % tick_ != 0) {
+            return false;
+        }
+        index = (price - base_) / tick_;
+        return index < WINDOW_TICKS;
+    }
+
+    // Highest and lowest window prices with volume; the window must not be empty
+    uint32_t window_highest() const {
+        const size_t word = 63 - __builtin_clzll(summary_);
+        return price_of(word * 64 + 63 - __builtin_clzll(bits_[word]));
+    }
+
+    uint32_t window_lowest() const {
+        const size_t word = __builtin_ctzll(summary_);
+        return price_of(word * 64 + __builtin_ctzll(bits_[word]));
+    }
+
+    void set_bit(size_t index) {
+        bits_[index / 64] |= uint64_t(1) << (index % 64);
+        summary_ |= uint64_t(1) << (index / 64);
+    }
+
+    void clear_bit(size_t index) {
+        bits_[index / 64] &= ~(uint64_t(1) << (index % 64));
+        if (bits_[index / 64] == 0) {
+            summary_ &= ~(uint64_t(1) << (index / 64));
+        }
+    }
+
+    // First set slot at or after index, WINDOW_TICKS if none
+    size_t next_set(size_t index) const {
+        if (index >= WINDOW_TICKS) {
+            return WINDOW_TICKS;
+        }
+        size_t word = index / 64;
+        uint64_t bits = bits_[word] & (~uint64_t(0) << (index % 64));
+        while (bits == 0) {
+            if (++word == WORDS) {
+                return WINDOW_TICKS;
+            }
+            bits = bits_[word];
+        }
+        return word * 64 + __builtin_ctzll(bits);
+    }
+
+    // Last set slot before index, WINDOW_TICKS if none
+    size_t prev_set(size_t index) const {
+        if (index == 0) {
+            return WINDOW_TICKS;
+        }
+        --index;
+        size_t word = index / 64;
+        uint64_t bits = bits_[word] & (~uint64_t(0) >> (63 - index % 64));
+        while (bits == 0) {
+            if (word-- == 0) {
+                return WINDOW_TICKS;
+            }
+            bits = bits_[word];
+        }
+        return word * 64 + 63 - __builtin_clzll(bits);
+    }
+
+    // Re-centre the window when the side's best level is in the overflow map,
+    // so best-price lookups and the busiest levels stay on the flat array
+    void follow_inside() {
+        if (overflow_.empty()) {
+            return;
+        }
+        const bool bids = inside_ == Inside::Highest;
+        const uint32_t outside = bids ? overflow_.rbegin()->first : overflow_.begin()->first;
+        if (summary_ != 0) {
+            const uint32_t window_best = bids ? window_highest() : window_lowest();
+            if (bids ? outside < window_best : outside > window_best) {
+                return;
+            }
+        }
+        recenter(outside);
+    }
+
+    // Move the window so that price sits in the middle. The current window
+    // levels are parked in the overflow map first, then every overflow level
+    // that falls inside the new window is pulled in.
+    void recenter(uint32_t price) {
+        if (volumes_.empty()) {
+            volumes_.assign(WINDOW_TICKS, 0);
+        }
+        for (size_t index = next_set(0); index < WINDOW_TICKS; index = next_set(index + 1)) {
+            overflow_.emplace(price_of(index), volumes_[index]);
+            volumes_[index] = 0;
+        }
+        for (auto& word : bits_) {
+            word = 0;
+        }
+        summary_ = 0;
+        window_levels_ = 0;
+        recenters_++;
+
+        // US equities quote in cents at or above $1, in hundredths of a cent below
+        tick_ = (price >= 10000 && price % 100 == 0) ? 100 : 1;
+        const uint32_t half = (WINDOW_TICKS / 2) * tick_;
+        base_ = price > half ? price - half : 0;
+        base_ -= base_ % tick_;
+
+        const uint64_t end = static_cast<uint64_t>(base_) + static_cast<uint64_t>(WINDOW_TICKS) * tick_;
+        for (auto it = overflow_.lower_bound(base_); it != overflow_.end() && it->first < end;) {
+            size_t index;
+            if (in_window(it->first, index)) {
+                volumes_[index] = it->second;
+                set_bit(index);
+                window_levels_++;
+                it = overflow_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+};
+
+} // namespace hft
@@ -0,0 +1,564 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdint>
+#include <cstddef>
+
+namespace hft {
+
+// Keeps the producer and consumer indices off each other's cache line
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Spin briefly, then yield, then sleep on a condition variable.
+//
+// A waiter registers itself before its final check of the condition and a
+// notifier fences before looking for waiters, so a notify that races with a
+// waiter going to sleep is never lost. notify() costs a fence and one load
+// when nobody is parked.
+//
+// In busy-poll mode the waiter never yields or parks: it spins until ready,
+// trading a whole core for wakeup latency.
+class SpinThenPark {
+public:
+    static constexpr int SPIN_ITERATIONS = 128;
+    static constexpr int YIELD_ITERATIONS = 64;
+    
+    // Set before any thread waits
+    void set_busy_poll(bool busy_poll) {
+        busy_poll_ = busy_poll;
+    }
+    
+    template <typename Ready>
+    void wait(Ready&& ready) {
+        if (busy_poll_) {
+            while (!ready()) {
+                cpu_relax();
+            }
+            return;
+        }
+        for (int i = 0; i < SPIN_ITERATIONS; ++i) {
+            if (ready()) {
+                return;
+            }
+            cpu_relax();
+        }
+        for (int i = 0; i < YIELD_ITERATIONS; ++i) {
+            if (ready()) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+        
+        std::unique_lock<std::mutex> lock(mutex_);
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        condition_.wait(lock, ready);
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    
+    // Call after publishing whatever the waiters' condition reads
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            condition_.notify_all();
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::atomic<int> waiters_{0};
+    bool busy_poll_ = false;
+};
+
+inline size_t round_up_pow2(size_t n) {
+    size_t capacity = 1;
+    while (capacity < n) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+// Bounded single-producer/single-consumer ring.
+//
+// Each side keeps a private copy of the other side's index and only reloads
+// it when the ring looks full (or empty), so in steady state a push or pop
+// touches one shared cache line.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity)
+        : slots_(round_up_pow2(capacity > 0 ? capacity : 1)), mask_(slots_.size() - 1) {}
+    
+    // Producer only. Moves from value on success.
+    bool try_push(T& value) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ == slots_.size()) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ == slots_.size()) {
+                return false;
+            }
+        }
+        slots_[tail & mask_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    
+    // Producer only. Moves as many of [first, last) as fit, publishing them
+    // with a single store; returns how many were taken.
+    template <typename It>
+    size_t try_push_batch(It first, It last) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t room = slots_.size() - (tail - head_cache_);
+        if (room < static_cast<size_t>(last - first)) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            room = slots_.size() - (tail - head_cache_);
+        }
+        size_t count = 0;
+        for (; first != last && count < room; ++first, ++count) {
+            slots_[(tail + count) & mask_] = std::move(*first);
+        }
+        if (count > 0) {
+            tail_.store(tail + count, std::memory_order_release);
+        }
+        return count;
+    }
+    
+    // Consumer only
+    bool try_pop(T& value) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) {
+                return false;
+            }
+        }
+        value = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    
+    // Consumer only. Appends up to max values to out; returns how many.
+    size_t try_pop_batch(std::vector<T>& out, size_t max) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+        }
+        size_t count = 0;
+        for (; head + count != tail_cache_ && count < max; ++count) {
+            out.push_back(std::move(slots_[(head + count) & mask_]));
+        }
+        if (count > 0) {
+            head_.store(head + count, std::memory_order_release);
+        }
+        return count;
+    }
+    
+    // Consumer only: nothing left to pop
+    bool empty() const {
+        return head_.load(std::memory_order_relaxed) == tail_.load(std::memory_order_acquire);
+    }
+    
+    // Producer only: no room for another push
+    bool full() const {
+        return tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_acquire) == slots_.size();
+    }
+    
+    // Approximate when called while both sides are running
+    size_t size() const {
+        const size_t head = head_.load(std::memory_order_acquire);
+        return tail_.load(std::memory_order_acquire) - head;
+    }
+    
+    size_t capacity() const {
+        return slots_.size();
+    }
+
+private:
+    std::vector<T> slots_;
+    const size_t mask_;
+    
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_{0};  // Next slot to pop
+    size_t tail_cache_ = 0;                                  // Consumer's view of tail_
+    
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_{0};  // Next slot to push
+    size_t head_cache_ = 0;                                  // Producer's view of head_
+};
+
+// Bounded multi-producer/single-consumer ring.
+//
+// Producers claim a slot with a CAS on the tail, then publish it through the
+// slot's sequence number (Vyukov's bounded queue), so a slow producer only
+// holds up the consumer at its own slot and never blocks other producers.
+template <typename T>
+class MpscRing {
+public:
+    explicit MpscRing(size_t capacity)
+        : capacity_(round_up_pow2(capacity > 0 ? capacity : 1)),
+          mask_(capacity_ - 1),
+          slots_(new Slot[capacity_]) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    
+    // Any thread. Moves from value on success.
+    bool try_push(T& value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[tail & mask_];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(tail);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(tail + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // Consumer hasn't freed this slot yet
+            } else {
+                tail = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    // Any thread. Stops at the first value that doesn't fit.
+    template <typename It>
+    size_t try_push_batch(It first, It last) {
+        size_t count = 0;
+        for (; first != last && try_push(*first); ++first) {
+            count++;
+        }
+        return count;
+    }
+    
+    // Consumer only
+    bool try_pop(T& value) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[head & mask_];
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+            return false;
+        }
+        value = std::move(slot.value);
+        slot.sequence.store(head + capacity_, std::memory_order_release);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    
+    // Consumer only. Appends up to max values to out; returns how many.
+    size_t try_pop_batch(std::vector<T>& out, size_t max) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t count = 0;
+        for (; count < max; ++count, ++head) {
+            Slot& slot = slots_[head & mask_];
+            if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+                break;
+            }
+            out.push_back(std::move(slot.value));
+            slot.sequence.store(head + capacity_, std::memory_order_release);
+        }
+        if (count > 0) {
+            head_.store(head, std::memory_order_release);
+        }
+        return count;
+    }
+    
+    // Consumer only: the next slot hasn't been published
+    bool empty() const {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        return slots_[head & mask_].sequence.load(std::memory_order_acquire) != head + 1;
+    }
+    
+    bool full() const {
+        return size() >= capacity_;
+    }
+    
+    // Counts slots claimed but not yet published; approximate under load
+    size_t size() const {
+        const size_t head = head_.load(std::memory_order_acquire);
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+    
+    size_t capacity() const {
+        return capacity_;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+    
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_{0};  // Next slot a producer claims
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_{0};  // Next slot to pop
+};
+
+enum class QueueKind {
+    Locked,  // std::deque behind a mutex; any number of producers and consumers
+    Spsc,    // Lock-free ring, one producer thread and one consumer thread
+    Mpsc     // Lock-free ring, any number of producers and one consumer
+};
+
+inline const char* queue_kind_name(QueueKind kind) {
+    switch (kind) {
+        case QueueKind::Locked: return "locked";
+        case QueueKind::Spsc: return "spsc";
+        case QueueKind::Mpsc: return "mpsc";
+    }
+    return "unknown";
+}
+
+// Bounded blocking queue over one of the backends above, chosen at construction.
+//
+// push() blocks while the queue is full; pop() blocks until a value arrives
+// or set_done() has been called and everything pushed before it has been
+// popped. Values pushed after set_done() are dropped, so producers can't
+// wedge on a queue nobody is draining any more.
+template <typename T>
+class ConcurrentQueue {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1 << 16;
+    
+    explicit ConcurrentQueue(QueueKind kind = QueueKind::Spsc, size_t capacity = DEFAULT_CAPACITY)
+        : kind_(kind), capacity_(round_up_pow2(capacity > 0 ? capacity : 1)) {
+        if (kind_ == QueueKind::Spsc) {
+            spsc_ = std::make_unique<SpscRing<T>>(capacity_);
+        } else if (kind_ == QueueKind::Mpsc) {
+            mpsc_ = std::make_unique<MpscRing<T>>(capacity_);
+        }
+    }
+    
+    ConcurrentQueue(const ConcurrentQueue&) = delete;
+    ConcurrentQueue& operator=(const ConcurrentQueue&) = delete;
+    
+    void push(T&& value) {
+        if (kind_ == QueueKind::Locked) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            locked_not_full_.wait(lock, [this] { return locked_.size() < capacity_ || is_done(); });
+            if (is_done()) {
+                return;
+            }
+            locked_.push_back(std::move(value));
+            lock.unlock();
+            locked_not_empty_.notify_one();
+            return;
+        }
+        
+        while (!ring_try_push(value)) {
+            not_full_.wait([this] { return !ring_full() || is_done(); });
+            if (is_done()) {
+                return;
+            }
+        }
+        not_empty_.notify();
+    }
+    
+    void push(const T& value) {
+        T copy(value);
+        push(std::move(copy));
+    }
+    
+    // Push a whole batch, preserving its order and waking the consumer once.
+    // Leaves values empty.
+    void push_batch(std::vector<T>& values) {
+        if (kind_ == QueueKind::Locked) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            for (auto& value : values) {
+                locked_not_full_.wait(lock, [this] { return locked_.size() < capacity_ || is_done(); });
+                if (is_done()) {
+                    break;
+                }
+                locked_.push_back(std::move(value));
+                if (locked_.size() == capacity_) {
+                    locked_not_empty_.notify_one();
+                }
+            }
+            lock.unlock();
+            locked_not_empty_.notify_one();
+            values.clear();
+            return;
+        }
+        
+        auto first = values.begin();
+        while (first != values.end()) {
+            first += ring_try_push_batch(first, values.end());
+            if (first == values.end()) {
+                break;
+            }
+            not_empty_.notify();
+            not_full_.wait([this] { return !ring_full() || is_done(); });
+            if (is_done()) {
+                break;
+            }
+        }
+        not_empty_.notify();
+        values.clear();
+    }
+    
+    // Consumer side. Returns false once the queue is done and drained.
+    bool pop(T& value) {
+        if (kind_ == QueueKind::Locked) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            locked_not_empty_.wait(lock, [this] { return !locked_.empty() || is_done(); });
+            if (locked_.empty()) {
+                return false;
+            }
+            value = std::move(locked_.front());
+            locked_.pop_front();
+            lock.unlock();
+            locked_not_full_.notify_one();
+            return true;
+        }
+        
+        while (!ring_try_pop(value)) {
+            if (is_done()) {
+                // Everything pushed before set_done() is visible by now
+                if (ring_try_pop(value)) {
+                    break;
+                }
+                return false;
+            }
+            not_empty_.wait([this] { return !ring_empty() || is_done(); });
+        }
+        not_full_.notify();
+        return true;
+    }
+    
+    // Consumer side. Replaces the contents of values with up to max values,
+    // waiting for at least one. Returns 0 once the queue is done and drained.
+    size_t pop_batch(std::vector<T>& values, size_t max) {
+        values.clear();
+        if (max == 0) {
+            return 0;
+        }
+        if (kind_ == QueueKind::Locked) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            locked_not_empty_.wait(lock, [this] { return !locked_.empty() || is_done(); });
+            while (!locked_.empty() && values.size() < max) {
+                values.push_back(std::move(locked_.front()));
+                locked_.pop_front();
+            }
+            lock.unlock();
+            locked_not_full_.notify_all();
+            return values.size();
+        }
+        
+        while (ring_try_pop_batch(values, max) == 0) {
+            if (is_done()) {
+                if (ring_try_pop_batch(values, max) > 0) {
+                    break;
+                }
+                return 0;
+            }
+            not_empty_.wait([this] { return !ring_empty() || is_done(); });
+        }
+        not_full_.notify();
+        return values.size();
+    }
+    
+    // Make the consumer spin on an empty ring instead of parking. Call before
+    // the consumer starts; the locked backend always sleeps.
+    void set_consumer_busy_poll(bool busy_poll) {
+        not_empty_.set_busy_poll(busy_poll);
+    }
+    
+    void set_done() {
+        if (kind_ == QueueKind::Locked) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_.store(true, std::memory_order_seq_cst);
+            }
+            locked_not_empty_.notify_all();
+            locked_not_full_.notify_all();
+            return;
+        }
+        done_.store(true, std::memory_order_seq_cst);
+        not_empty_.notify();
+        not_full_.notify();
+    }
+    
+    bool is_done() const {
+        return done_.load(std::memory_order_acquire);
+    }
+    
+    size_t size() const {
+        if (kind_ == QueueKind::Locked) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return locked_.size();
+        }
+        return spsc_ ? spsc_->size() : mpsc_->size();
+    }
+    
+    size_t capacity() const {
+        return capacity_;
+    }
+    
+    QueueKind kind() const {
+        return kind_;
+    }
+
+private:
+    const QueueKind kind_;
+    const size_t capacity_;
+    std::atomic<bool> done_{false};
+    
+    // Ring backends
+    std::unique_ptr<SpscRing<T>> spsc_;
+    std::unique_ptr<MpscRing<T>> mpsc_;
+    SpinThenPark not_empty_;  // Consumer waits here
+    SpinThenPark not_full_;   // Producers wait here
+    
+    // Locked backend
+    std::deque<T> locked_;
+    mutable std::mutex mutex_;
+    std::condition_variable locked_not_empty_;
+    std::condition_variable locked_not_full_;
+    
+    bool ring_try_push(T& value) {
+        return spsc_ ? spsc_->try_push(value) : mpsc_->try_push(value);
+    }
+    
+    template <typename It>
+    size_t ring_try_push_batch(It first, It last) {
+        return spsc_ ? spsc_->try_push_batch(first, last) : mpsc_->try_push_batch(first, last);
+    }
+    
+    bool ring_try_pop(T& value) {
+        return spsc_ ? spsc_->try_pop(value) : mpsc_->try_pop(value);
+    }
+    
+    size_t ring_try_pop_batch(std::vector<T>& values, size_t max) {
+        return spsc_ ? spsc_->try_pop_batch(values, max) : mpsc_->try_pop_batch(values, max);
+    }
+    
+    bool ring_empty() const {
+        return spsc_ ? spsc_->empty() : mpsc_->empty();
+    }
+    
+    bool ring_full() const {
+        return spsc_ ? spsc_->full() : mpsc_->full();
+    }
+};
+
+} // namespace hft
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+namespace hft {
+
+// Last N samples in a fixed circular buffer, with mean and variance kept up
+// to date as samples enter and leave (Welford's update, extended to remove
+// the evicted sample). push() is O(1) and never allocates; N is a template
+// parameter so the buffer lives inline and wrap-around is a compare against
+// a constant.
+template <size_t N>
+class RollingWindow {
+    static_assert(N > 0, "RollingWindow needs room for at least one sample");
+
+public:
+    static constexpr size_t capacity() { return N; }
+    
+    void push(double value) {
+        if (size_ < N) {
+            // Growing: plain Welford add
+            size_++;
+            const double delta = value - mean_;
+            mean_ += delta / size_;
+            m2_ += delta * (value - mean_);
+        } else {
+            // Full: the new sample replaces the oldest in one step
+            const double evicted = samples_[next_];
+            const double old_mean = mean_;
+            mean_ += (value - evicted) / N;
+            m2_ += (value - evicted) * (value - mean_ + evicted - old_mean);
+            if (m2_ < 0.0) {
+                m2_ = 0.0;  // Rounding can push it just below zero
+            }
+        }
+        samples_[next_] = value;
+        if (++next_ == N) {
+            next_ = 0;
+        }
+    }
+    
+    void clear() {
+        next_ = 0;
+        size_ = 0;
+        mean_ = 0.0;
+        m2_ = 0.0;
+    }
+    
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool full() const { return size_ == N; }
+    
+    // Most recent sample; the window must not be empty
+    double back() const {
+        return samples_[next_ == 0 ? N - 1 : next_ - 1];
+    }
+    
+    // i-th oldest sample still in the window
+    double operator[](size_t i) const {
+        const size_t first = size_ < N ? 0 : next_;
+        const size_t index = first + i;
+        return samples_[index < N ? index : index - N];
+    }
+    
+    double mean() const { return mean_; }
+    
+    // Population variance of the samples in the window
+    double variance() const {
+        return size_ > 0 ? m2_ / size_ : 0.0;
+    }
+    
+    double stddev() const {
+        return std::sqrt(variance());
+    }
+
+private:
+    std::array<double, N> samples_{};
+    size_t next_ = 0;   // Slot the next sample goes into
+    size_t size_ = 0;
+    double mean_ = 0.0;
+    double m2_ = 0.0;   // Sum of squared deviations from mean_
+};
+
+} // namespace hft
@@ -0,0 +1,449 @@
+#pragma once
+
+#include "order_book.h"
+#include "order_store.h"
+#include "ring_queue.h"
+#include "thread_placement.h"
+#include "../cpp_parser/include/message.h"
+#include <nlohmann/json.hpp>
+#include <vector>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+
+namespace hft {
+
+// Order book split across worker threads by symbol.
+//
+// Each shard owns a private OrderBook and a thread that applies its
+// messages in feed order, so no book is ever touched by two threads.
+// The dispatching thread routes every message by its stock_locate. Feeds
+// without one get an ID interned by the dispatcher and written into each
+// AddOrder, so IDs stay unique across shards, and the order reference is
+// remembered, with its remaining shares, so later executes/cancels/deletes/
+// replaces follow it to the same shard; the route is forgotten once the
+// order is gone. Messages that cannot affect a book are dropped.
+//
+// Each shard book runs the same ChangeDetection, and the change callback
+// fires on the shard's thread for every message, of any type, that changes
+// what that detection watches for a symbol.
+//
+// With a StagePlacement, shard i runs as thread i of that stage, pinned and
+// preferring the stage's NUMA node. Each shard builds its OrderBook on its
+// own thread once placed, so the book's tables are first touched there;
+// batches are filled by the dispatcher and stay on its node. With busy_poll
+// an idle shard spins on its queue instead of sleeping.
+class ShardedOrderBook {
+public:
+    // JSON message for OrderBook::process_message, with the timestamp the
+    // shard needs for its updates picked out by the dispatcher
+    struct JsonMessage {
+        std::string text;
+        SymbolId locate = INVALID_SYMBOL;
+        uint64_t timestamp = 0;
+    };
+    
+    // Either a parsed ITCH message or one JSON message
+    using ShardMessage = std::variant<itch::Message, JsonMessage>;
+    
+    // Runs on the shard's thread after a message changes a symbol's book, with that shard's book
+    using ChangeCallback = std::function<void(size_t shard, const OrderBook& book,
+                                              SymbolId symbol, uint64_t timestamp)>;
+    
+    static constexpr size_t BATCH_SIZE = 1024;  // Messages handed to a shard at a time
+    static constexpr size_t MAX_PENDING = 16;   // Batches queued per shard before submit blocks
+    
+    ShardedOrderBook(size_t num_shards, ChangeCallback on_change, BookEngine engine = BookEngine::Map,
+                     const ChangeDetection& detection = {}, const StagePlacement& placement = {})
+        : on_change_(std::move(on_change)), placement_(placement) {
+        if (num_shards == 0) {
+            num_shards = 1;
+        }
+        for (size_t i = 0; i < num_shards; ++i) {
+            shards_.push_back(std::make_unique<Shard>(engine, detection));
+        }
+        for (size_t i = 0; i < num_shards; ++i) {
+            shards_[i]->thread = std::thread([this, i] { run_shard(i); });
+        }
+        
+        // Wait until every shard has built its book, so symbol_name() and
+        // the change callback never see a shard without one
+        std::string error;
+        for (auto& shard : shards_) {
+            std::unique_lock<std::mutex> lock(shard->mutex);
+            shard->condition.wait(lock, [&] { return shard->book || !shard->error.empty(); });
+            if (error.empty()) {
+                error = shard->error;
+            }
+        }
+        if (!error.empty()) {
+            stop_shards();
+            throw std::runtime_error("Order book shard failed to start: " + error);
+        }
+    }
+    
+    // Batches not yet handed over are dropped; call flush() first to apply them
+    ~ShardedOrderBook() {
+        stop_shards();
+    }
+    
+    ShardedOrderBook(const ShardedOrderBook&) = delete;
+    ShardedOrderBook& operator=(const ShardedOrderBook&) = delete;
+    
+    // Route a parsed ITCH message (dispatching thread only)
+    void submit(itch::Message message) {
+        const size_t shard = std::visit([&](const auto& body) {
+            using T = std::decay_t<decltype(body)>;
+            const SymbolId locate = message.stock_locate;
+            if constexpr (std::is_same_v<T, itch::AddOrder>) {
+                message.stock_locate = symbol_for(locate, std::string_view(body.stock.data(), body.stock.size()));
+                return route_add(locate, message.stock_locate, body.reference, body.shares);
+            } else if constexpr (std::is_same_v<T, itch::StockDirectory>) {
+                return locate != INVALID_SYMBOL ? shard_of(locate) : NO_SHARD;
+            } else if constexpr (std::is_same_v<T, itch::DeleteOrder>) {
+                return route_existing(locate, body.reference, ALL_SHARES);
+            } else if constexpr (std::is_same_v<T, itch::OrderExecuted> ||
+                                 std::is_same_v<T, itch::OrderExecutedWithPrice>) {
+                return route_existing(locate, body.reference, body.executed);
+            } else if constexpr (std::is_same_v<T, itch::OrderCancelled>) {
+                return route_existing(locate, body.reference, body.cancelled);
+            } else if constexpr (std::is_same_v<T, itch::ReplaceOrder>) {
+                return route_replace(locate, body.old_reference, body.new_reference, body.shares);
+            } else {
+                return NO_SHARD;
+            }
+        }, message.body);
+        
+        if (shard != NO_SHARD) {
+            enqueue(shard, ShardMessage(std::move(message)));
+        }
+    }
+    
+    // Route a JSON message in the cpp_parser layout (dispatching thread only)
+    void submit(const nlohmann::json& message) {
+        if (!message.contains("body")) {
+            return;
+        }
+        const auto& body = message["body"];
+        SymbolId locate = INVALID_SYMBOL;
+        if (message.contains("stock_locate") && message["stock_locate"].is_number_unsigned()) {
+            locate = message["stock_locate"].get<SymbolId>();
+        }
+        
+        auto reference = [](const nlohmann::json& fields, const char* key) -> uint64_t {
+            return fields.contains(key) ? fields[key].get<uint64_t>() : 0;
+        };
+        auto shares = [](const nlohmann::json& fields, const char* key) -> uint32_t {
+            return fields.contains(key) ? fields[key].get<uint32_t>() : 0;
+        };
+        
+        JsonMessage routed;
+        routed.locate = locate;
+        if (message.contains("timestamp")) {
+            routed.timestamp = message["timestamp"].is_string()
+                ? std::stoull(message["timestamp"].get<std::string>())
+                : message["timestamp"].get<uint64_t>();
+        }
+        size_t shard = NO_SHARD;
+        if (body.contains("AddOrder")) {
+            const auto& add_order = body["AddOrder"];
+            if (add_order.contains("stock")) {
+                routed.locate = symbol_for(locate, add_order["stock"].get<std::string>());
+            }
+            shard = route_add(locate, routed.locate, reference(add_order, "reference"), shares(add_order, "shares"));
+        } else if (body.contains("StockDirectory")) {
+            shard = locate != INVALID_SYMBOL ? shard_of(locate) : NO_SHARD;
+        } else if (body.contains("DeleteOrder")) {
+            shard = route_existing(locate, reference(body["DeleteOrder"], "reference"), ALL_SHARES);
+        } else if (body.contains("OrderExecuted")) {
+            const auto& executed = body["OrderExecuted"];
+            shard = route_existing(locate, reference(executed, "reference"), shares(executed, "executed"));
+        } else if (body.contains("OrderExecutedWithPrice")) {
+            const auto& executed = body["OrderExecutedWithPrice"];
+            shard = route_existing(locate, reference(executed, "reference"), shares(executed, "executed"));
+        } else if (body.contains("OrderCancelled")) {
+            const auto& cancelled = body["OrderCancelled"];
+            shard = route_existing(locate, reference(cancelled, "reference"), shares(cancelled, "cancelled"));
+        } else if (body.contains("ReplaceOrder")) {
+            const auto& replace = body["ReplaceOrder"];
+            shard = route_replace(locate, reference(replace, "old_reference"),
+                                  reference(replace, "new_reference"), shares(replace, "shares"));
+        }
+        
+        if (shard != NO_SHARD) {
+            if (routed.locate != locate) {
+                // Hand the shard's book the dispatcher's ID for this symbol
+                nlohmann::json tagged = message;
+                tagged["stock_locate"] = routed.locate;
+                routed.text = tagged.dump();
+            } else {
+                routed.text = message.dump();
+            }
+            enqueue(shard, ShardMessage(std::move(routed)));
+        }
+    }
+    
+    // Hand over partially filled batches and wait until every shard has
+    // applied everything submitted so far. Rethrows the first shard error.
+    void flush() {
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            hand_over(i);
+        }
+        for (auto& shard : shards_) {
+            std::unique_lock<std::mutex> lock(shard->mutex);
+            shard->condition.wait(lock, [&] {
+                return shard->applied == shard->submitted || !shard->error.empty();
+            });
+            if (!shard->error.empty()) {
+                throw std::runtime_error("Order book shard failed: " + shard->error);
+            }
+        }
+    }
+    
+    size_t num_shards() const {
+        return shards_.size();
+    }
+    
+    // Shard that owns a stock_locate
+    size_t shard_of(SymbolId symbol) const {
+        return symbol % shards_.size();
+    }
+    
+    // Ticker for a symbol ID the caller was handed by a ChangeCallback. The
+    // owning shard wrote the name before publishing that ID, so any thread
+    // the ID reached through a queue may read it.
+    const std::string& symbol_name(SymbolId symbol) const {
+        return shards_[shard_of(symbol)]->book->symbols().name(symbol);
+    }
+    
+    // Messages applied by one shard so far
+    size_t applied(size_t shard) const {
+        std::lock_guard<std::mutex> lock(shards_[shard]->mutex);
+        return shards_[shard]->applied;
+    }
+    
+    // Live orders routed by reference, for feeds without a stock_locate
+    // (dispatching thread only)
+    size_t routed_orders() const {
+        return routes_.size();
+    }
+
+private:
+    static constexpr size_t NO_SHARD = static_cast<size_t>(-1);
+    static constexpr uint32_t ALL_SHARES = static_cast<uint32_t>(-1);  // Removes the order outright
+    
+    struct Shard {
+        Shard(BookEngine engine, const ChangeDetection& detection) : engine(engine), detection(detection) {}
+        
+        BookEngine engine;
+        ChangeDetection detection;
+        std::unique_ptr<OrderBook> book;  // Built and only touched by thread
+        std::thread thread;
+        
+        std::vector<ShardMessage> filling;  // Dispatcher's batch in progress
+        
+        mutable std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<std::vector<ShardMessage>> pending;
+        size_t submitted = 0;  // Messages handed over
+        size_t applied = 0;    // Messages applied to book
+        std::string error;
+        bool stop = false;
+        
+        // Mirrors of pending.size() and stop, read without the lock by a busy-polling shard
+        std::atomic<size_t> queued{0};
+        std::atomic<bool> stopping{false};
+    };
+    
+    // Shard for an order reference, used only when the feed carries no
+    // stock_locate. Shares are tracked as the book does, so the route goes
+    // when the book drops the order.
+    struct Route {
+        uint64_t reference;
+        uint32_t shard;
+        uint32_t shares;  // Still resting
+    };
+    
+    ChangeCallback on_change_;
+    StagePlacement placement_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    OrderStore<Route> routes_;
+    SymbolTable symbols_;  // IDs handed out for feeds without a stock_locate
+    
+    // The feed's stock_locate, or the dispatcher's interned ID when it has none
+    SymbolId symbol_for(SymbolId locate, std::string_view stock) {
+        return locate != INVALID_SYMBOL ? locate : symbols_.intern(stock);
+    }
+    
+    size_t route_add(SymbolId locate, SymbolId symbol, uint64_t reference, uint32_t shares) {
+        const size_t shard = shard_of(symbol);
+        if (locate == INVALID_SYMBOL) {
+            routes_.insert({reference, static_cast<uint32_t>(shard), shares});
+        }
+        return shard;
+    }
+    
+    // Shard for a message taking `removed` shares off an order (ALL_SHARES
+    // for a delete), dropping the route once none are left
+    size_t route_existing(SymbolId locate, uint64_t reference, uint32_t removed) {
+        if (locate != INVALID_SYMBOL) {
+            return shard_of(locate);
+        }
+        Route* route = routes_.find(reference);
+        if (!route) {
+            return NO_SHARD;  // Unknown order; no book would act on it
+        }
+        const size_t shard = route->shard;
+        route->shares -= std::min(removed, route->shares);
+        if (route->shares == 0) {
+            routes_.erase(reference);
+        }
+        return shard;
+    }
+    
+    size_t route_replace(SymbolId locate, uint64_t old_reference, uint64_t new_reference, uint32_t shares) {
+        const size_t shard = route_existing(locate, old_reference, ALL_SHARES);
+        if (locate == INVALID_SYMBOL && shard != NO_SHARD) {
+            routes_.insert({new_reference, static_cast<uint32_t>(shard), shares});
+        }
+        return shard;
+    }
+
+    
+    void enqueue(size_t index, ShardMessage&& message) {
+        Shard& shard = *shards_[index];
+        if (shard.filling.empty()) {
+            shard.filling.reserve(BATCH_SIZE);
+        }
+        shard.filling.push_back(std::move(message));
+        if (shard.filling.size() >= BATCH_SIZE) {
+            hand_over(index);
+        }
+    }
+    
+    // Move the dispatcher's batch onto the shard's queue, blocking while it is full
+    void hand_over(size_t index) {
+        Shard& shard = *shards_[index];
+        if (shard.filling.empty()) {
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            shard.condition.wait(lock, [&] {
+                return shard.pending.size() < MAX_PENDING || !shard.error.empty();
+            });
+            shard.submitted += shard.filling.size();
+            shard.pending.push_back(std::move(shard.filling));
+            shard.queued.store(shard.pending.size(), std::memory_order_release);
+        }
+        shard.condition.notify_all();
+        shard.filling = std::vector<ShardMessage>();
+    }
+    
+    void stop_shards() {
+        for (auto& shard : shards_) {
+            {
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                shard->stop = true;
+                shard->stopping.store(true, std::memory_order_release);
+            }
+            shard->condition.notify_all();
+        }
+        for (auto& shard : shards_) {
+            shard->thread.join();
+        }
+    }
+    
+    void run_shard(size_t index) {
+        Shard& shard = *shards_[index];
+        placement_.apply_to_current_thread(index);
+        
+        // Build the book only now, under this thread's memory policy, so its
+        // symbol tables, best prices and order index are first touched on
+        // the shard's node rather than the constructing thread's
+        std::unique_ptr<OrderBook> book;
+        std::string start_error;
+        try {
+            book = std::make_unique<OrderBook>(shard.engine);
+            book->set_change_detection(shard.detection);
+        } catch (const std::exception& e) {
+            start_error = e.what();
+        }
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.book = std::move(book);
+            shard.error = std::move(start_error);
+        }
+        shard.condition.notify_all();
+        if (!shard.book) {
+            return;
+        }
+        
+        while (true) {
+            if (placement_.busy_poll) {
+                while (shard.queued.load(std::memory_order_acquire) == 0 &&
+                       !shard.stopping.load(std::memory_order_acquire)) {
+                    cpu_relax();
+                }
+            }
+            
+            std::vector<ShardMessage> batch;
+            {
+                std::unique_lock<std::mutex> lock(shard.mutex);
+                shard.condition.wait(lock, [&] { return shard.stop || !shard.pending.empty(); });
+                if (shard.pending.empty()) {
+                    return;
+                }
+                batch = std::move(shard.pending.front());
+                shard.pending.pop_front();
+                shard.queued.store(shard.pending.size(), std::memory_order_release);
+            }
+            shard.condition.notify_all();
+            
+            std::string error;
+            try {
+                for (const auto& message : batch) {
+                    apply(index, *shard.book, message);
+                }
+            } catch (const std::exception& e) {
+                error = e.what();
+            }
+            
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                shard.applied += batch.size();
+                if (!error.empty() && shard.error.empty()) {
+                    shard.error = error;
+                }
+            }
+            shard.condition.notify_all();
+        }
+    }
+    
+    void apply(size_t index, OrderBook& book, const ShardMessage& message) {
+        if (const auto* parsed = std::get_if<itch::Message>(&message)) {
+            publish(index, book, book.apply(*parsed), parsed->timestamp);
+            return;
+        }
+        
+        const JsonMessage& json_message = std::get<JsonMessage>(message);
+        publish(index, book, book.process_message(json_message.text), json_message.timestamp);
+    }
+    
+    void publish(size_t index, const OrderBook& book, SymbolId changed, uint64_t timestamp) {
+        if (changed != INVALID_SYMBOL && on_change_) {
+            on_change_(index, book, changed, timestamp);
+        }
+    }
+};
+
+} // namespace hft
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+
+namespace hft {
+
+// Dense symbol ID. Equal to the ITCH stock_locate whenever the feed carries one.
+using SymbolId = uint16_t;
+
+// stock_locate 0 is reserved for market-wide messages, so it never names a stock
+constexpr SymbolId INVALID_SYMBOL = 0;
+
+// Maps symbol IDs to ticker names and back.
+// Names live in a fixed array indexed by ID: resolving an ID never hashes or
+// allocates, and a name reference stays valid once assigned.
+class SymbolTable {
+public:
+    static constexpr size_t MAX_SYMBOLS = 65536;
+    
+    SymbolTable() : names_(MAX_SYMBOLS) {
+        // Sized for a full day's directory so lookups never see a rehash
+        by_name_.reserve(16384);
+    }
+    
+    // Register a symbol under its stock_locate (StockDirectory or AddOrder).
+    // Space padding from the feed is stripped.
+    void assign(SymbolId id, std::string_view symbol) {
+        symbol = trim(symbol);
+        if (id == INVALID_SYMBOL || names_[id] == symbol) {
+            return;
+        }
+        if (!names_[id].empty()) {
+            by_name_.erase(names_[id]);
+        }
+        names_[id] = std::string(symbol);
+        by_name_[names_[id]] = id;
+    }
+    
+    // ID for a name, handing out the next free ID when the feed carried no locate
+    SymbolId intern(std::string_view symbol) {
+        symbol = trim(symbol);
+        SymbolId id = find(symbol);
+        if (id != INVALID_SYMBOL || symbol.empty()) {
+            return id;
+        }
+        while (next_free_ < MAX_SYMBOLS - 1 && !names_[next_free_].empty()) {
+            next_free_++;
+        }
+        id = static_cast<SymbolId>(next_free_);
+        assign(id, symbol);
+        return id;
+    }
+    
+    // ID for a name, INVALID_SYMBOL if it has not been seen
+    SymbolId find(std::string_view symbol) const {
+        auto it = by_name_.find(std::string(trim(symbol)));
+        return it != by_name_.end() ? it->second : INVALID_SYMBOL;
+    }
+    
+    bool known(SymbolId id) const {
+        return !names_[id].empty();
+    }
+    
+    const std::string& name(SymbolId id) const {
+        return names_[id];
+    }
+    
+    size_t size() const {
+        return by_name_.size();
+    }
+    
+    // Strip the space padding ITCH puts on 8-character symbols
+    static std::string_view trim(std::string_view symbol) {
+        const auto first = symbol.find_first_not_of(" \t\n\r\f\v");
+        if (first == std::string_view::npos) {
+            return {};
+        }
+        const auto last = symbol.find_last_not_of(" \t\n\r\f\v");
+        return symbol.substr(first, last - first + 1);
+    }
+
+private:
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, SymbolId> by_name_;
+    size_t next_free_ = 1;
+};
+
+// Stock filter resolved once per symbol ID, so checking a message costs a vector read
+class SymbolFilter {
+public:
+    explicit SymbolFilter(const std::vector<std::string>& symbols)
+        : symbols_(symbols.begin(), symbols.end()) {
+        if (!symbols_.empty()) {
+            state_.assign(SymbolTable::MAX_SYMBOLS, UNRESOLVED);
+        }
+    }
+    
+    bool empty() const {
+        return symbols_.empty();
+    }
+    
+    // Check a symbol whose name the table already knows
+    bool allows(SymbolId id, const SymbolTable& table) {
+        if (symbols_.empty()) {
+            return true;
+        }
+        return table.known(id) ? allows(id, table.name(id)) : state_[id] == ALLOWED;
+    }
+    
+    // Check a symbol by ID, using the (possibly padded) name the first time it is seen
+    bool allows(SymbolId id, std::string_view symbol) {
+        if (symbols_.empty()) {
+            return true;
+        }
+        if (id == INVALID_SYMBOL) {
+            return symbols_.count(std::string(SymbolTable::trim(symbol))) > 0;
+        }
+        uint8_t& state = state_[id];
+        if (state == UNRESOLVED) {
+            state = symbols_.count(std::string(SymbolTable::trim(symbol))) ? ALLOWED : BLOCKED;
+        }
+        return state == ALLOWED;
+    }
+
+private:
+    static constexpr uint8_t UNRESOLVED = 0;
+    static constexpr uint8_t ALLOWED = 1;
+    static constexpr uint8_t BLOCKED = 2;
+    
+    std::unordered_set<std::string> symbols_;
+    std::vector<uint8_t> state_;
+};
+
+} // namespace hft
@@ -0,0 +1,322 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cstddef>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+namespace hft {
+
+// Parse a Linux-style CPU list, comma-separated CPUs and ranges, e.g. "0-3,8-11".
+// Throws std::invalid_argument on anything else.
+inline std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        item.erase(0, item.find_first_not_of(" \t\n"));
+        item.erase(item.find_last_not_of(" \t\n") + 1);
+        if (item.empty()) {
+            continue;
+        }
+        if (item.find_first_not_of("0123456789-") != std::string::npos) {
+            throw std::invalid_argument("Bad CPU list: " + list);
+        }
+        const size_t dash = item.find('-');
+        const int first = std::stoi(item.substr(0, dash));
+        const int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+        if (last < first) {
+            throw std::invalid_argument("Bad CPU range: " + item);
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// One NUMA node: the kernel's node ID (nodeN in sysfs, the bit set_mempolicy
+// takes) and its CPUs. IDs need not be contiguous, e.g. nodes 0 and 2.
+struct NumaNode {
+    int id = 0;
+    std::vector<int> cpus;
+};
+
+// CPUs grouped by NUMA node, in node ID order. Read from sysfs on Linux; one
+// node 0 holding every CPU anywhere else, or when sysfs has no node entries.
+inline std::vector<NumaNode> numa_topology() {
+    std::vector<NumaNode> nodes;
+#ifdef __linux__
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", error)) {
+        const std::string name = entry.path().filename().string();
+        if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+            name.find_first_not_of("0123456789", 4) != std::string::npos) {
+            continue;
+        }
+        
+        std::ifstream file(entry.path() / "cpulist");
+        std::string list;
+        std::getline(file, list);
+        std::vector<int> cpus;
+        try {
+            cpus = parse_cpu_list(list);
+        } catch (const std::exception&) {
+            continue;
+        }
+        if (!cpus.empty()) {
+            nodes.push_back({std::stoi(name.substr(4)), std::move(cpus)});
+        }
+    }
+#endif
+    std::sort(nodes.begin(), nodes.end(), [](const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+    
+    if (nodes.empty()) {
+        nodes.emplace_back();
+        const unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned cpu = 0; cpu < cpus; ++cpu) {
+            nodes.back().cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+    return nodes;
+}
+
+// Node with a given ID, null if the machine has none
+inline const NumaNode* find_numa_node(int id, const std::vector<NumaNode>& topology) {
+    for (const NumaNode& node : topology) {
+        if (node.id == id) {
+            return &node;
+        }
+    }
+    return nullptr;
+}
+
+// ID of the node holding a CPU; -1 if it isn't listed
+inline int numa_node_of(int cpu, const std::vector<NumaNode>& topology) {
+    for (const NumaNode& node : topology) {
+        if (std::find(node.cpus.begin(), node.cpus.end(), cpu) != node.cpus.end()) {
+            return node.id;
+        }
+    }
+    return -1;
+}
+
+// Restrict the calling thread to the given CPUs. Linux only; elsewhere, and
+// on failure, it warns and leaves the thread where it is.
+inline bool pin_current_thread(const std::vector<int>& cpus) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    const int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (error != 0) {
+        std::cerr << "Warning: could not pin thread to CPU " << (cpus.empty() ? -1 : cpus.front())
+                  << (cpus.size() > 1 ? " and others" : "") << ": " << std::strerror(error) << std::endl;
+        return false;
+    }
+    return true;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+inline bool pin_current_thread(int cpu) {
+    return pin_current_thread(std::vector<int>{cpu});
+}
+
+// Prefer a NUMA node (kernel node ID) for memory the calling thread faults
+// in from now on. Preferred rather than bound, so allocation falls back to
+// other nodes when this one is full. Uses the raw set_mempolicy syscall, so
+// there is no libnuma dependency; a no-op off Linux.
+inline bool prefer_numa_node(int node) {
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+    constexpr int MPOL_PREFERRED_MODE = 1;  // MPOL_PREFERRED in <numaif.h>
+    constexpr size_t BITS = 8 * sizeof(unsigned long);
+    if (node < 0) {
+        return false;
+    }
+    std::vector<unsigned long> mask(static_cast<size_t>(node) / BITS + 1, 0);
+    mask.back() |= 1ul << (static_cast<size_t>(node) % BITS);
+    // The kernel reads one bit fewer than maxnode, hence the + 1 (as libnuma does)
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED_MODE, mask.data(), mask.size() * BITS + 1) != 0) {
+        std::cerr << "Warning: could not prefer NUMA node " << node << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+#else
+    (void)node;
+    return false;
+#endif
+}
+
+// Where the threads of one pipeline stage run
+struct StagePlacement {
+    std::vector<int> cpus;   // Thread i of the stage runs on cpus[i % size]; empty leaves it to numa_node or the OS
+    int numa_node = -1;      // Kernel node ID. Without cpus, threads may run anywhere on this node. Memory goes here either way.
+    bool busy_poll = false;  // Spin on the stage's input instead of sleeping when it runs dry
+    
+    bool placed() const {
+        return !cpus.empty() || numa_node >= 0;
+    }
+    
+    // CPU of thread `index`, or -1 when the stage has no CPU list
+    int cpu_for(size_t index) const {
+        return cpus.empty() ? -1 : cpus[index % cpus.size()];
+    }
+    
+    // Node ID the stage's memory should come from: numa_node, else the node
+    // of its first CPU, else -1
+    int memory_node(const std::vector<NumaNode>& topology) const {
+        if (numa_node >= 0) {
+            return numa_node;
+        }
+        return cpus.empty() ? -1 : numa_node_of(cpus.front(), topology);
+    }
+    
+    // Place the calling thread as thread `index` of this stage: pin it and
+    // point its allocations at the stage's node. Does nothing when unplaced.
+    void apply_to_current_thread(size_t index) const {
+        if (!placed()) {
+            return;
+        }
+        const auto topology = numa_topology();
+        if (!cpus.empty()) {
+            pin_current_thread(cpu_for(index));
+        } else if (const NumaNode* node = find_numa_node(numa_node, topology)) {
+            pin_current_thread(node->cpus);
+        } else {
+            std::cerr << "Warning: no NUMA node " << numa_node << std::endl;
+            return;
+        }
+        prefer_numa_node(memory_node(topology));
+    }
+    
+    std::string describe() const {
+        if (!placed() && !busy_poll) {
+            return "unplaced";
+        }
+        std::string text;
+        if (!cpus.empty()) {
+            text += "cpus";
+            for (size_t i = 0; i < cpus.size(); ++i) {
+                text += (i == 0 ? " " : ",") + std::to_string(cpus[i]);
+            }
+        }
+        if (numa_node >= 0) {
+            text += (text.empty() ? "" : ", ") + std::string("node ") + std::to_string(numa_node);
+        }
+        if (busy_poll) {
+            text += (text.empty() ? "" : ", ") + std::string("busy-poll");
+        }
+        return text;
+    }
+};
+
+// Thread placement for the three stages of a pipeline:
+//   decode   - the thread reading the feed, then any parser pool workers
+//   book     - the thread dispatching to the books, then the book workers or shards
+//   strategy - the strategy consumer
+//
+// Set from "stage.key = value" assignments, one per line in a config file
+// (blank lines and '#' comments allowed) or one per --place flag:
+//   book.cpus = 4-7        CPU list, threads take CPUs in order and wrap
+//   book.numa = 1          NUMA node ID, as in /sys/devices/system/node/node1
+//   strategy.busy_poll = 1 Spin instead of sleeping (1/0, true/false, on/off)
+struct ThreadPlacement {
+    StagePlacement decode;
+    StagePlacement book;
+    StagePlacement strategy;
+    
+    // Apply one assignment. Throws std::invalid_argument if it is malformed.
+    void set(const std::string& assignment) {
+        const size_t equals = assignment.find('=');
+        const size_t dot = assignment.find('.');
+        if (equals == std::string::npos || dot == std::string::npos || dot > equals) {
+            throw std::invalid_argument("Expected stage.key=value, got: " + assignment);
+        }
+        const std::string stage_name = trim(assignment.substr(0, dot));
+        const std::string key = trim(assignment.substr(dot + 1, equals - dot - 1));
+        const std::string value = trim(assignment.substr(equals + 1));
+        
+        StagePlacement* stage = nullptr;
+        if (stage_name == "decode") {
+            stage = &decode;
+        } else if (stage_name == "book") {
+            stage = &book;
+        } else if (stage_name == "strategy") {
+            stage = &strategy;
+        } else {
+            throw std::invalid_argument("Unknown stage '" + stage_name + "' (decode, book or strategy)");
+        }
+        
+        if (key == "cpus") {
+            stage->cpus = parse_cpu_list(value);
+        } else if (key == "numa") {
+            if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+                throw std::invalid_argument("Bad NUMA node: " + value);
+            }
+            stage->numa_node = std::stoi(value);
+        } else if (key == "busy_poll") {
+            if (value == "1" || value == "true" || value == "on") {
+                stage->busy_poll = true;
+            } else if (value == "0" || value == "false" || value == "off") {
+                stage->busy_poll = false;
+            } else {
+                throw std::invalid_argument("Bad busy_poll value: " + value);
+            }
+        } else {
+            throw std::invalid_argument("Unknown placement key '" + key + "' (cpus, numa or busy_poll)");
+        }
+    }
+    
+    // Apply every assignment in a config file.
+    // Throws std::runtime_error naming the file and line on any error.
+    void load(const std::string& path) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open placement file: " + path);
+        }
+        std::string line;
+        size_t line_number = 0;
+        while (std::getline(file, line)) {
+            line_number++;
+            line = trim(line.substr(0, line.find('#')));
+            if (line.empty()) {
+                continue;
+            }
+            try {
+                set(line);
+            } catch (const std::exception& e) {
+                throw std::runtime_error(path + ":" + std::to_string(line_number) + ": " + e.what());
+            }
+        }
+    }
+
+private:
+    static std::string trim(const std::string& text) {
+        const size_t first = text.find_first_not_of(" \t\r\n");
+        if (first == std::string::npos) {
+            return "";
+        }
+        return text.substr(first, text.find_last_not_of(" \t\r\n") - first + 1);
+    }
+};
+
+} // namespace hft
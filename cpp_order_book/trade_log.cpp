@@ -0,0 +1,174 @@
+#include "trade_log.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace hft {
+
+TradeLog::TradeLog(const std::string& path)
+    : path_(path), queue_(QueueKind::Spsc, QUEUE_CAPACITY) {
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        throw std::runtime_error("Failed to open trade log " + path + ": " + std::strerror(errno));
+    }
+    
+    buffer_.reserve(WRITE_BUFFER_SIZE + WRITER_BATCH * sizeof(TradeRecord));
+    TradeLogHeader header;
+    const char* bytes = reinterpret_cast<const char*>(&header);
+    buffer_.insert(buffer_.end(), bytes, bytes + sizeof(header));
+    
+    writer_ = std::thread([this] { run(); });
+}
+
+TradeLog::~TradeLog() {
+    try {
+        close();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+void TradeLog::close() {
+    if (!writer_.joinable()) {
+        return;
+    }
+    queue_.set_done();
+    writer_.join();
+    
+    if (::close(fd_) != 0 && error_.empty()) {
+        error_ = std::strerror(errno);
+    }
+    fd_ = -1;
+    if (!error_.empty()) {
+        throw std::runtime_error("Failed to write trade log " + path_ + ": " + error_);
+    }
+}
+
+void TradeLog::run() {
+    std::vector<TradeRecord> batch;
+    batch.reserve(WRITER_BATCH);
+    
+    while (queue_.pop_batch(batch, WRITER_BATCH)) {
+        const char* bytes = reinterpret_cast<const char*>(batch.data());
+        buffer_.insert(buffer_.end(), bytes, bytes + batch.size() * sizeof(TradeRecord));
+        if (buffer_.size() >= WRITE_BUFFER_SIZE) {
+            write_buffer();
+        }
+    }
+    write_buffer();
+}
+
+void TradeLog::write_buffer() {
+    const char* data = buffer_.data();
+    size_t remaining = buffer_.size();
+    
+    // After a failure keep draining the queue, but stop touching the file
+    while (remaining > 0 && error_.empty()) {
+        ssize_t written = ::write(fd_, data, remaining);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error_ = std::strerror(errno);
+            break;
+        }
+        data += written;
+        remaining -= static_cast<size_t>(written);
+    }
+    buffer_.clear();
+}
+
+TradeStats compute_trade_stats(const std::vector<TradeRecord>& trades, double initial_capital) {
+    TradeStats stats;
+    stats.num_trades = trades.size();
+    stats.final_capital = initial_capital;
+    if (trades.empty()) {
+        return stats;
+    }
+    
+    // Replay the strategy's capital bookkeeping: every fill moves the
+    // notional, closing fills then book their P&L
+    int winning_trades = 0;
+    for (const auto& trade : trades) {
+        const double notional = trade.price * trade.quantity;
+        stats.final_capital += trade.side == Side::Sell ? notional : -notional;
+        stats.final_capital += trade.pnl;
+        stats.total_pnl += trade.pnl;
+        if (trade.pnl > 0) {
+            winning_trades++;
+        }
+    }
+    stats.win_rate = static_cast<int>((winning_trades * 100) / trades.size());
+    
+    // Per-trade returns on the capital P&L compounds into
+    std::vector<double> returns;
+    returns.reserve(trades.size());
+    double prev_capital = initial_capital;
+    for (const auto& trade : trades) {
+        double new_capital = prev_capital + trade.pnl;
+        returns.push_back((new_capital - prev_capital) / prev_capital);
+        prev_capital = new_capital;
+    }
+    
+    double sum = 0.0;
+    for (double r : returns) {
+        sum += r;
+    }
+    double mean = sum / returns.size();
+    
+    double sq_sum = 0.0;
+    for (double r : returns) {
+        sq_sum += (r - mean) * (r - mean);
+    }
+    double std_dev = std::sqrt(sq_sum / returns.size());
+    
+    // Annualized, assuming 0 risk-free rate
+    stats.sharpe_ratio = std_dev > 0 ? (mean / std_dev) * std::sqrt(252.0) : 0.0;
+    return stats;
+}
+
+std::vector<TradeRecord> read_trade_log(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open trade log " + path);
+    }
+    
+    TradeLogHeader expected;
+    TradeLogHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0) {
+        throw std::runtime_error(path + " is not a trade log");
+    }
+    if (header.version != expected.version || header.record_size != expected.record_size) {
+        throw std::runtime_error(path + ": unsupported trade log version " + std::to_string(header.version));
+    }
+    
+    file.seekg(0, std::ios::end);
+    const size_t body = static_cast<size_t>(file.tellg()) - sizeof(header);
+    file.seekg(sizeof(header), std::ios::beg);
+    
+    // A trailing partial record means the writer died mid-write; drop it
+    std::vector<TradeRecord> trades(body / sizeof(TradeRecord));
+    file.read(reinterpret_cast<char*>(trades.data()), trades.size() * sizeof(TradeRecord));
+    return trades;
+}
+
+void write_trades_csv(const std::vector<TradeRecord>& trades, std::ostream& out) {
+    out << "timestamp,symbol,side,quantity,price,pnl" << '\n';
+    for (const auto& trade : trades) {
+        out << trade.timestamp << ","
+            << trade.symbol_name() << ","
+            << trade.side_name() << ","
+            << trade.quantity << ","
+            << std::fixed << std::setprecision(4) << trade.price << ","
+            << std::fixed << std::setprecision(2) << trade.pnl << '\n';
+    }
+}
+
+} // namespace hft
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "order_book.h"
+#include "ring_queue.h"
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <ostream>
+#include <cstdint>
+#include <type_traits>
+
+namespace hft {
+
+// One fill, as written to the binary trade log. Fixed size and trivially
+// copyable, so the strategy thread hands it over without formatting anything.
+struct TradeRecord {
+    uint64_t timestamp = 0;
+    double price = 0.0;
+    double pnl = 0.0;      // Realised P&L; 0 for the trade opening a position
+    int32_t quantity = 0;
+    char symbol[8] = {};   // NUL-padded when shorter than 8 characters
+    Side side = Side::Buy;
+    uint8_t reserved[3] = {};
+    
+    std::string_view symbol_name() const {
+        size_t length = 0;
+        while (length < sizeof(symbol) && symbol[length] != '\0') {
+            length++;
+        }
+        return std::string_view(symbol, length);
+    }
+    
+    void set_symbol(std::string_view name) {
+        const size_t length = name.size() < sizeof(symbol) ? name.size() : sizeof(symbol);
+        std::fill(std::begin(symbol), std::end(symbol), '\0');
+        std::copy(name.begin(), name.begin() + length, symbol);
+    }
+    
+    const char* side_name() const {
+        return side == Side::Buy ? "Buy" : "Sell";
+    }
+};
+
+static_assert(std::is_trivially_copyable_v<TradeRecord>, "TradeRecord is written to disk as raw bytes");
+static_assert(sizeof(TradeRecord) == 40, "TradeRecord layout is part of the log format");
+
+// Log file layout: this header, then TradeRecords back to back
+struct TradeLogHeader {
+    char magic[8] = {'H', 'F', 'T', 'T', 'R', 'A', 'D', 'E'};
+    uint32_t version = 1;
+    uint32_t record_size = sizeof(TradeRecord);
+};
+
+// Appends trade records to a binary log from a background thread.
+//
+// append() only pushes the record onto an SPSC ring, so formatting and
+// disk writes stay off the strategy thread. The writer batches records into
+// a large buffer and writes it with one write(2) per WRITE_BUFFER_SIZE bytes
+// (and once more when the log is closed).
+class TradeLog {
+public:
+    static constexpr size_t QUEUE_CAPACITY = 1 << 16;    // Records in flight before append() blocks
+    static constexpr size_t WRITE_BUFFER_SIZE = 1 << 20; // Bytes per write
+    static constexpr size_t WRITER_BATCH = 4096;         // Records drained per writer wakeup
+    
+    // Throws std::runtime_error if the file cannot be created
+    explicit TradeLog(const std::string& path);
+    
+    // Closes the log; write errors are reported on std::cerr
+    ~TradeLog();
+    
+    TradeLog(const TradeLog&) = delete;
+    TradeLog& operator=(const TradeLog&) = delete;
+    
+    // Single producer: the thread that owns the strategy
+    void append(const TradeRecord& record) {
+        queue_.push(record);
+    }
+    
+    // Drain every appended record to disk and stop the writer.
+    // Throws std::runtime_error if any write failed.
+    void close();
+    
+    const std::string& path() const {
+        return path_;
+    }
+
+private:
+    std::string path_;
+    int fd_ = -1;
+    ConcurrentQueue<TradeRecord> queue_;
+    std::vector<char> buffer_;  // Writer thread only
+    std::string error_;         // First write error, read after join
+    std::thread writer_;
+    
+    void run();
+    void write_buffer();
+};
+
+// Summary statistics over a sequence of trades, as reported in performance_summary.json
+struct TradeStats {
+    size_t num_trades = 0;
+    double final_capital = 0.0;
+    double total_pnl = 0.0;
+    int win_rate = 0;         // Percentage of trades with positive P&L
+    double sharpe_ratio = 0.0;
+};
+
+TradeStats compute_trade_stats(const std::vector<TradeRecord>& trades, double initial_capital);
+
+// Read every record from a trade log. Throws std::runtime_error if the file
+// is missing or not a trade log.
+std::vector<TradeRecord> read_trade_log(const std::string& path);
+
+// Render trades as CSV: timestamp,symbol,side,quantity,price,pnl
+void write_trades_csv(const std::vector<TradeRecord>& trades, std::ostream& out);
+
+} // namespace hft
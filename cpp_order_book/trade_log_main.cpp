@@ -0,0 +1,50 @@
+#include "trade_log.h"
+#include <nlohmann/json.hpp>
+#include <iostream>
+#include <string>
+
+using json = nlohmann::json;
+using namespace hft;
+
+// Render a binary trade log (trades_YYYYMMDD.bin) as the CSV the strategy
+// used to write, or as the trade statistics from performance_summary.json
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <trades.bin> [csv|summary] [initial_capital]" << std::endl;
+        std::cerr << "  csv     : timestamp,symbol,side,quantity,price,pnl to stdout (default)" << std::endl;
+        std::cerr << "  summary : trade statistics as JSON to stdout" << std::endl;
+        return 1;
+    }
+    
+    std::string input_file = argv[1];
+    std::string format = (argc > 2) ? argv[2] : "csv";
+    double initial_capital = (argc > 3) ? std::stod(argv[3]) : 1000000.0;
+    
+    std::vector<TradeRecord> trades;
+    try {
+        trades = read_trade_log(input_file);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    
+    if (format == "csv") {
+        write_trades_csv(trades, std::cout);
+    } else if (format == "summary") {
+        TradeStats stats = compute_trade_stats(trades, initial_capital);
+        json summary;
+        summary["initial_capital"] = initial_capital;
+        summary["final_capital"] = stats.final_capital;
+        summary["total_pnl"] = stats.total_pnl;
+        summary["return_pct"] = (stats.final_capital - initial_capital) / initial_capital * 100.0;
+        summary["num_trades"] = stats.num_trades;
+        summary["win_rate"] = stats.win_rate;
+        summary["sharpe_ratio"] = stats.sharpe_ratio;
+        std::cout << summary.dump(4) << std::endl;
+    } else {
+        std::cerr << "Unknown format: " << format << " (expected csv or summary)" << std::endl;
+        return 1;
+    }
+    
+    return 0;
+}
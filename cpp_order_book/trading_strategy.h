@@ -1,18 +1,55 @@
 #pragma once
 
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
-#include <deque>
-#include <fstream>
+#include <functional>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <type_traits>
+#include <utility>
 #include "order_book.h"
+#include "market_update.h"
+#include "metrics.h"
+#include "rolling_window.h"
+#include "trade_log.h"
 #include <nlohmann/json.hpp>
-#include <mutex>
 
 using json = nlohmann::json;
 
 namespace hft {
 
+// One parameter set chosen at run time, defaulting to the tuned values
+// integrated_processor runs with (TunedStrategyParams)
+struct StrategyParams {
+    static constexpr size_t price_history = 100;  // Mid prices kept per symbol
+    
+    double liquidity_threshold = 1.8;  // Buy above this imbalance
+    double reverse_threshold = 0.6;    // Sell below this imbalance
+    int position_size = 100;
+    int hold_time_ticks = 15;          // Updates a position is held before it is closed
+};
+
+// One parameter set fixed at compile time, so the thresholds, size and hold
+// time reach the update path as constants. Thresholds are in hundredths:
+// C++17 has no floating-point template arguments.
+template <int LiquidityHundredths, int ReverseHundredths, int PositionSize, int HoldTimeTicks,
+          size_t PriceHistory = StrategyParams::price_history>
+struct FixedStrategyParams {
+    static_assert(PositionSize > 0 && HoldTimeTicks > 0, "Position size and hold time must be positive");
+    
+    static constexpr size_t price_history = PriceHistory;
+    static constexpr double liquidity_threshold = LiquidityHundredths / 100.0;
+    static constexpr double reverse_threshold = ReverseHundredths / 100.0;
+    static constexpr int position_size = PositionSize;
+    static constexpr int hold_time_ticks = HoldTimeTicks;
+};
+
+// StrategyParams' defaults as constants
+using TunedStrategyParams = FixedStrategyParams<180, 60, 100, 15>;
+
 struct Position {
     std::string symbol;
     int quantity;
@@ -21,90 +58,319 @@ struct Position {
     double pnl;
 };
 
-struct Trade {
-    std::string symbol;
-    std::string side;
-    int quantity;
-    double price;
-    uint64_t timestamp;
-    double pnl;
-};
+// Ticker for a symbol ID, asked once per ID for trade records
+using SymbolNames = std::function<const std::string&(SymbolId symbol)>;
+
+// What BasicIntegratedProcessor needs from a strategy type, checked at
+// compile time rather than through a virtual base: construction as
+// Strategy(SymbolNames, output_dir, initial_capital), and
+// process_market_update(const MarketUpdate&), set_metrics(PipelineMetrics*)
+// and print_performance(). Calls go straight to the type, so the path from
+// book to signal can be inlined.
+template <typename Strategy, typename = void>
+struct is_market_update_strategy : std::false_type {};
+
+template <typename Strategy>
+struct is_market_update_strategy<Strategy, std::void_t<
+    decltype(std::declval<Strategy&>().process_market_update(std::declval<const MarketUpdate&>())),
+    decltype(std::declval<Strategy&>().set_metrics(std::declval<PipelineMetrics*>())),
+    decltype(std::declval<Strategy&>().print_performance())>>
+    : std::is_constructible<Strategy, SymbolNames, const std::string&, double> {};
+
+template <typename Strategy>
+inline constexpr bool is_market_update_strategy_v = is_market_update_strategy<Strategy>::value;
 
-class LiquidityReversionStrategy {
+// Bookkeeping shared by every strategy, kept out of line: capital, fills,
+// the binary trade log, and performance_summary.json, written on destruction
+class StrategyAccount {
 public:
-    LiquidityReversionStrategy(
-        OrderBook& order_book,
-        const std::string& output_dir,
-        double initial_capital = 1000000.0,
-        double liquidity_threshold = 1.5,
-        double reverse_threshold = 0.67,
-        int position_size = 100,
-        int hold_time_ticks = 20
-    );
+    StrategyAccount(const std::string& output_dir, double initial_capital);
+    ~StrategyAccount();
     
-    ~LiquidityReversionStrategy();
+    StrategyAccount(const StrategyAccount&) = delete;
+    StrategyAccount& operator=(const StrategyAccount&) = delete;
     
-    // Process market update and execute trading strategy
-    void process_market_update(const std::string& symbol, 
-                              double bid_price, double ask_price,
-                              uint32_t bid_volume, uint32_t ask_volume,
-                              double imbalance, uint64_t timestamp);
+    // Time each MarketUpdate into Stage::StrategyDecision, and stamped ones into
+    // Stage::FeedToSignal; null (the default) turns it off
+    void set_metrics(PipelineMetrics* metrics) { metrics_ = metrics; }
     
     // Run strategy on all updates in the order book
     void run();
     
     // Print performance metrics
     void print_performance();
+    
+    // Every fill so far, in order, and the capital after them
+    const std::vector<TradeRecord>& trades() const { return trades_; }
+    double capital() const { return current_capital_; }
+
+protected:
+    double current_capital_;
+    PipelineMetrics* metrics_ = nullptr;
+    
+    // Keep the fill for the summary and hand it to the trade log
+    void record_trade(std::string_view symbol, Side side, int quantity, double price,
+                      uint64_t timestamp, double pnl);
 
 private:
-    OrderBook& order_book_;
     std::string output_dir_;
     double initial_capital_;
-    double current_capital_;
+    std::vector<TradeRecord> trades_;
+    std::unique_ptr<TradeLog> trade_log_;  // Null if the log could not be created
+    
+    // Timing
+    std::chrono::time_point<std::chrono::system_clock> start_time_;
+};
+
+// Liquidity reversion: buy when a symbol's imbalance is above
+// liquidity_threshold, sell when it is below reverse_threshold, and close the
+// position at the mid of the symbol's last quote once it has been held for
+// hold_time_ticks updates. Only quotes handed to process_market_update are
+// read, so the strategy can run on another thread than the book.
+//
+// Params is StrategyParams, read at run time, or a FixedStrategyParams, whose
+// values are constants; either way the window length is part of the type.
+// The per-update path is defined here so callers can inline it.
+template <typename Params>
+class BasicLiquidityReversionStrategy : public StrategyAccount {
+public:
+    // Symbol IDs and names from the book. The string overload of
+    // process_market_update looks names up in it, so call that only from
+    // the thread applying the book.
+    BasicLiquidityReversionStrategy(
+        OrderBook& order_book,
+        const std::string& output_dir,
+        double initial_capital = 1000000.0,
+        const Params& params = Params{}
+    ) : BasicLiquidityReversionStrategy(
+            &order_book,
+            [&order_book](SymbolId symbol) -> const std::string& { return order_book.symbols().name(symbol); },
+            output_dir, initial_capital, params) {}
+    
+    // For callers without a single shared book (e.g. ShardedOrderBook), or
+    // whose book is applied on another thread
+    BasicLiquidityReversionStrategy(
+        SymbolNames names,
+        const std::string& output_dir,
+        double initial_capital = 1000000.0,
+        const Params& params = Params{}
+    ) : BasicLiquidityReversionStrategy(nullptr, std::move(names), output_dir, initial_capital, params) {}
+    
+    const Params& params() const { return params_; }
+    
+    // Process market update and execute trading strategy
+    void process_market_update(const std::string& symbol,
+                               double bid_price, double ask_price,
+                               uint32_t bid_volume, uint32_t ask_volume,
+                               double imbalance, uint64_t timestamp) {
+        // The book's IDs when there is one, so both overloads agree on them
+        const SymbolId id = book_ ? book_->symbols().find(symbol) : named_.intern(symbol);
+        if (id == INVALID_SYMBOL) {
+            return;
+        }
+        SymbolState& state = state_for(id);
+        if (state.name.empty()) {
+            state.name = symbol;
+        }
+        on_quote(id, state, bid_price, ask_price, imbalance, timestamp);
+    }
+    
+    // Same, for an update keyed by the book's symbol ID. Per-symbol state is
+    // indexed by ID, so this never hashes a string or allocates once the
+    // symbol has been seen. Don't mix with the string overload on one instance.
+    void process_market_update(const MarketUpdate& update) {
+        if (update.symbol == INVALID_SYMBOL) {
+            return;
+        }
+        {
+            StageTimer timer(metrics_, Stage::StrategyDecision);
+            on_quote(update.symbol, state_for(update.symbol),
+                     update.bid(), update.ask(), update.imbalance(), update.timestamp);
+        }
+        if (metrics_ && update.feed_stamp != 0) {
+            metrics_->record(Stage::FeedToSignal, cycles_since(update.feed_stamp));
+        }
+    }
+
+private:
+    static constexpr size_t MIN_HISTORY = 5;  // Mid prices needed before trading a symbol
+    
+    // Everything the strategy tracks for one symbol, indexed by SymbolId
+    struct SymbolState {
+        std::string name;  // Filled the first time the symbol is seen
+        
+        // Recent mid prices with their rolling mean/variance
+        RollingWindow<Params::price_history> mid_prices;
+        
+        // Last quote seen, used to close positions
+        double bid_price = 0.0;
+        double ask_price = 0.0;
+        
+        bool has_position = false;
+        Position position;
+        int hold_time = 0;
+    };
     
-    // Strategy parameters
-    double liquidity_threshold_;
-    double reverse_threshold_;
-    int position_size_;
-    int hold_time_ticks_;
+    const OrderBook* book_ = nullptr;  // Symbol IDs for the string overload only
+    SymbolNames names_;
+    SymbolTable named_;  // IDs for the string overload when there is no book
+    Params params_;
     
     // Trading state
-    std::unordered_map<std::string, Position> positions_;
-    std::unordered_map<std::string, int> position_hold_time_;
-    std::vector<Trade> trades_;
-    std::unordered_map<std::string, std::deque<Position>> position_history_;
-    std::mutex trades_mutex_;
-    std::ofstream trades_file_;
-    std::vector<Trade> pending_trades_;
-    std::mutex pending_trades_mutex_;
+    std::vector<SymbolState> states_;       // Grown on demand as new IDs show up
+    std::vector<SymbolId> open_positions_;  // In the order they were opened
+    std::vector<SymbolId> expired_;         // Scratch list for update_positions
     
-    // Timing
-    std::chrono::time_point<std::chrono::system_clock> start_time_;
+    BasicLiquidityReversionStrategy(
+        const OrderBook* book,
+        SymbolNames names,
+        const std::string& output_dir,
+        double initial_capital,
+        const Params& params
+    ) : StrategyAccount(output_dir, initial_capital),
+        book_(book),
+        names_(std::move(names)),
+        params_(params) {}
     
-    // Market data cache
-    std::unordered_map<std::string, std::deque<double>> price_history_;
-    std::vector<std::string> trade_buffer_;  // Buffer for batching trade writes
+    // State for an ID, created (and named) the first time the ID is seen
+    SymbolState& state_for(SymbolId symbol) {
+        if (symbol >= states_.size()) {
+            states_.resize(symbol + 1);
+        }
+        SymbolState& state = states_[symbol];
+        if (state.name.empty() && names_) {
+            state.name = names_(symbol);
+        }
+        return state;
+    }
     
-    static constexpr size_t BATCH_SIZE = 1000;  // Write to disk every 1000 trades
+    // Signal logic shared by both process_market_update overloads
+    void on_quote(SymbolId symbol, SymbolState& state,
+                  double bid_price, double ask_price,
+                  double imbalance, uint64_t timestamp) {
+        state.bid_price = bid_price;
+        state.ask_price = ask_price;
+        
+        // Skip invalid prices
+        if (bid_price <= 0 || ask_price <= 0) {
+            return;
+        }
+        
+        // Update price history, evicting the oldest entry once full
+        state.mid_prices.push((bid_price + ask_price) / 2.0);
+        
+        // Update positions (check for exit based on hold time)
+        update_positions(timestamp);
+        
+        // Skip if we already have a position in this symbol, or too little history
+        if (state.has_position || state.mid_prices.size() < MIN_HISTORY) {
+            return;
+        }
+        
+        // Buy when the bid side dominates, sell when it thins out
+        if (imbalance > params_.liquidity_threshold) {
+            execute_buy(symbol, ask_price, params_.position_size, timestamp);
+        } else if (imbalance < params_.reverse_threshold) {
+            execute_sell(symbol, bid_price, params_.position_size, timestamp);
+        }
+    }
     
     // Execute buy/sell orders
-    void execute_buy(const std::string& symbol, double price, int quantity, uint64_t timestamp);
-    void execute_sell(const std::string& symbol, double price, int quantity, uint64_t timestamp);
+    void execute_buy(SymbolId symbol, double price, int quantity, uint64_t timestamp) {
+        open_position(symbol, quantity, price, timestamp);
+        record_trade(states_[symbol].name, Side::Buy, quantity, price, timestamp, 0.0);
+        current_capital_ -= price * quantity;
+    }
     
-    // Manage positions
-    void update_positions(uint64_t current_time);
-    void close_position(const std::string& symbol, double price, uint64_t timestamp);
+    void execute_sell(SymbolId symbol, double price, int quantity, uint64_t timestamp) {
+        // Negative quantity for a short
+        open_position(symbol, -quantity, price, timestamp);
+        record_trade(states_[symbol].name, Side::Sell, quantity, price, timestamp, 0.0);
+        current_capital_ += price * quantity;
+    }
     
-    // Write trade to buffer and optionally flush to disk
-    void write_trade(const Trade& trade, bool force_flush = false);
+    void open_position(SymbolId symbol, int quantity, double price, uint64_t timestamp) {
+        SymbolState& state = states_[symbol];
+        state.position.symbol = state.name;
+        state.position.quantity = quantity;
+        state.position.entry_price = price;
+        state.position.entry_time = timestamp;
+        state.position.pnl = 0.0;
+        state.has_position = true;
+        state.hold_time = 0;
+        
+        open_positions_.push_back(symbol);
+    }
     
-    // Flush buffered trades to disk
-    void flush_trades();
+    // Age every open position and close those held for hold_time_ticks
+    void update_positions(uint64_t current_time) {
+        expired_.clear();
+        for (SymbolId symbol : open_positions_) {
+            if (++states_[symbol].hold_time >= params_.hold_time_ticks) {
+                expired_.push_back(symbol);
+            }
+        }
+        
+        for (SymbolId symbol : expired_) {
+            // The symbol's last quote; the book itself may be changing on another thread
+            const SymbolState& state = states_[symbol];
+            if (state.bid_price > 0 && state.ask_price > 0) {
+                close_position(symbol, (state.bid_price + state.ask_price) / 2.0, current_time);
+            }
+        }
+    }
     
-    // Calculate metrics
-    double calculate_sharpe_ratio();
-    double calculate_total_pnl();
-    int calculate_win_rate();
+    void close_position(SymbolId symbol, double price, uint64_t timestamp) {
+        SymbolState& state = states_[symbol];
+        if (!state.has_position) {
+            return;
+        }
+        
+        // Close a long by selling, a short by buying
+        const Position& position = state.position;
+        const int quantity = std::abs(position.quantity);
+        const bool long_position = position.quantity > 0;
+        const double pnl = long_position ? (price - position.entry_price) * quantity
+                                         : (position.entry_price - price) * quantity;
+        record_trade(state.name, long_position ? Side::Sell : Side::Buy, quantity, price, timestamp, pnl);
+        
+        current_capital_ += long_position ? price * quantity : -price * quantity;
+        current_capital_ += pnl;
+        
+        state.has_position = false;
+        open_positions_.erase(std::find(open_positions_.begin(), open_positions_.end(), symbol));
+    }
 };
 
-} // namespace hft
\ No newline at end of file
+// Parameters chosen at run time, as the command-line tools and backtests take them
+class LiquidityReversionStrategy : public BasicLiquidityReversionStrategy<StrategyParams> {
+public:
+    LiquidityReversionStrategy(
+        OrderBook& order_book,
+        const std::string& output_dir,
+        double initial_capital = 1000000.0,
+        double liquidity_threshold = 1.5,
+        double reverse_threshold = 0.67,
+        int position_size = 100,
+        int hold_time_ticks = 20
+    ) : BasicLiquidityReversionStrategy(
+            order_book, output_dir, initial_capital,
+            StrategyParams{liquidity_threshold, reverse_threshold, position_size, hold_time_ticks}) {}
+    
+    LiquidityReversionStrategy(
+        SymbolNames names,
+        const std::string& output_dir,
+        double initial_capital = 1000000.0,
+        double liquidity_threshold = 1.5,
+        double reverse_threshold = 0.67,
+        int position_size = 100,
+        int hold_time_ticks = 20
+    ) : BasicLiquidityReversionStrategy(
+            std::move(names), output_dir, initial_capital,
+            StrategyParams{liquidity_threshold, reverse_threshold, position_size, hold_time_ticks}) {}
+};
+
+// integrated_processor's strategy: the tuned parameters, compiled in
+using TunedLiquidityReversionStrategy = BasicLiquidityReversionStrategy<TunedStrategyParams>;
+
+} // namespace hft
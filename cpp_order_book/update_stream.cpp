@@ -0,0 +1,169 @@
+#include "update_stream.h"
+#include "../cpp_parser/include/parser.h"
+#include "../cpp_parser/include/decompressor.h"
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace hft {
+
+namespace {
+
+constexpr size_t WRITE_BATCH = 1 << 15;  // Updates buffered per write
+
+// Appends updates to the stream body, counting them for the header
+class UpdateWriter {
+public:
+    explicit UpdateWriter(std::ofstream& out) : out_(out) {
+        buffer_.reserve(WRITE_BATCH);
+    }
+
+    void push(const MarketUpdate& update) {
+        buffer_.push_back(update);
+        if (buffer_.size() == WRITE_BATCH) {
+            flush();
+        }
+    }
+
+    void flush() {
+        out_.write(reinterpret_cast<const char*>(buffer_.data()),
+                   static_cast<std::streamsize>(buffer_.size() * sizeof(MarketUpdate)));
+        count_ += buffer_.size();
+        buffer_.clear();
+    }
+
+    size_t count() const {
+        return count_;
+    }
+
+private:
+    std::ofstream& out_;
+    std::vector<MarketUpdate> buffer_;
+    size_t count_ = 0;
+};
+
+UpdateStreamHeader header_for(const std::string& input_path, const ChangeDetection& detection) {
+    UpdateStreamHeader header;
+    header.trigger = static_cast<uint32_t>(detection.trigger);
+    header.depth_levels = detection.trigger == ChangeTrigger::Depth ? static_cast<uint32_t>(detection.depth_levels) : 0;
+    header.source_size = std::filesystem::file_size(input_path);
+    return header;
+}
+
+bool read_header(const std::string& path, UpdateStreamHeader& header) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        return false;
+    }
+    const UpdateStreamHeader expected;
+    return std::memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0 &&
+           header.version == expected.version && header.record_size == expected.record_size;
+}
+
+size_t stream_size(const UpdateStreamHeader& header) {
+    return sizeof(UpdateStreamHeader) + header.update_count * sizeof(MarketUpdate) +
+           header.symbol_count * sizeof(UpdateStreamSymbol);
+}
+
+} // namespace
+
+size_t decode_update_stream(const std::string& input_path, const std::string& output_path,
+                            BookEngine engine, const ChangeDetection& detection) {
+    UpdateStreamHeader header = header_for(input_path, detection);
+
+    // Written under a temporary name so an interrupted decode never looks complete
+    const std::string temp_path = output_path + ".tmp";
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to create update stream " + temp_path);
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    OrderBook book(engine);
+    book.set_change_detection(detection);
+    UpdateWriter writer(out);
+
+    // Each update is snapshotted right after its message, so this goes message
+    // by message: the batch apply only reports which rows changed a book
+    itch::Compression compression;
+    const auto backend = itch::detect_compression(input_path, compression)
+        ? itch::InputBackend::Stream : itch::InputBackend::Mmap;
+    auto parser = itch::Parser::open(input_path, backend);
+    while (auto message = parser->parse_message()) {
+        const SymbolId changed = book.apply(*message);
+        if (changed != INVALID_SYMBOL) {
+            writer.push(book.get_market_update(changed, message->timestamp));
+        }
+    }
+    writer.flush();
+
+    // Every ID an update can carry has been named by now
+    const SymbolTable& symbols = book.symbols();
+    for (size_t id = 1; id < SymbolTable::MAX_SYMBOLS; id++) {
+        if (!symbols.known(static_cast<SymbolId>(id))) {
+            continue;
+        }
+        UpdateStreamSymbol symbol;
+        symbol.id = static_cast<SymbolId>(id);
+        const std::string& name = symbols.name(symbol.id);
+        std::memcpy(symbol.name, name.data(), std::min(name.size(), sizeof(symbol.name)));
+        out.write(reinterpret_cast<const char*>(&symbol), sizeof(symbol));
+        header.symbol_count++;
+    }
+
+    header.update_count = writer.count();
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    if (!out) {
+        throw std::runtime_error("Failed to write update stream " + temp_path);
+    }
+
+    std::filesystem::rename(temp_path, output_path);
+    return header.update_count;
+}
+
+bool update_stream_matches(const std::string& path, const std::string& input_path,
+                           const ChangeDetection& detection) {
+    std::error_code error;
+    if (!std::filesystem::exists(path, error)) {
+        return false;
+    }
+    UpdateStreamHeader header;
+    if (!read_header(path, header)) {
+        return false;
+    }
+    const UpdateStreamHeader expected = header_for(input_path, detection);
+    return header.trigger == expected.trigger &&
+           header.depth_levels == expected.depth_levels &&
+           header.source_size == expected.source_size &&
+           std::filesystem::file_size(path, error) == stream_size(header) &&
+           std::filesystem::last_write_time(path, error) >= std::filesystem::last_write_time(input_path, error);
+}
+
+UpdateStream::UpdateStream(const std::string& path) : path_(path) {
+    UpdateStreamHeader header;
+    if (!read_header(path, header)) {
+        throw std::runtime_error(path + " is not an update stream");
+    }
+
+    mapping_ = std::make_unique<itch::MappedFile>(path);
+    if (mapping_->size() != stream_size(header)) {
+        throw std::runtime_error(path + ": truncated update stream");
+    }
+
+    const uint8_t* body = mapping_->data() + sizeof(UpdateStreamHeader);
+    updates_ = reinterpret_cast<const MarketUpdate*>(body);
+    size_ = header.update_count;
+
+    const auto* names = reinterpret_cast<const UpdateStreamSymbol*>(body + size_ * sizeof(MarketUpdate));
+    for (size_t i = 0; i < header.symbol_count; i++) {
+        const UpdateStreamSymbol& symbol = names[i];
+        symbols_.assign(symbol.id, std::string_view(symbol.name, strnlen(symbol.name, sizeof(symbol.name))));
+    }
+}
+
+} // namespace hft
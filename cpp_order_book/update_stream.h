@@ -0,0 +1,82 @@
+#pragma once
+
+#include "order_book.h"
+#include "market_update.h"
+#include "symbol_table.h"
+#include "../cpp_parser/include/mapped_file.h"
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+namespace hft {
+
+// A day's book updates, decoded once and replayed by any number of strategies.
+//
+// File layout: this header, update_count MarketUpdates back to back, exactly
+// as the book published them under the recorded ChangeDetection, then
+// symbol_count UpdateStreamSymbols naming the IDs the updates use.
+struct UpdateStreamHeader {
+    char magic[8] = {'H', 'F', 'T', 'U', 'P', 'D', 'A', 'T'};
+    uint32_t version = 1;
+    uint32_t record_size = sizeof(MarketUpdate);
+    uint32_t trigger = 0;       // ChangeTrigger the updates were published under
+    uint32_t depth_levels = 0;  // ChangeTrigger::Depth only
+    uint64_t source_size = 0;   // Size of the ITCH file the stream was decoded from
+    uint64_t symbol_count = 0;
+    uint64_t update_count = 0;
+};
+
+// Name of a symbol ID in the stream, NUL-padded like TradeRecord::symbol
+struct UpdateStreamSymbol {
+    char name[8] = {};
+    SymbolId id = INVALID_SYMBOL;
+    uint8_t reserved[6] = {};
+};
+
+static_assert(std::is_trivially_copyable_v<UpdateStreamHeader>, "UpdateStreamHeader is written to disk as raw bytes");
+static_assert(sizeof(UpdateStreamHeader) == 48, "UpdateStreamHeader layout is part of the stream format");
+static_assert(sizeof(UpdateStreamSymbol) == 16, "UpdateStreamSymbol layout is part of the stream format");
+
+// Replay an ITCH file (optionally gzip/zstd-compressed) through an OrderBook
+// and write every update it publishes to output_path. Uncompressed files are
+// memory-mapped. Returns the number of updates written; throws
+// std::runtime_error if either file cannot be used.
+size_t decode_update_stream(const std::string& input_path, const std::string& output_path,
+                            BookEngine engine = BookEngine::Map,
+                            const ChangeDetection& detection = {});
+
+// True if path holds a complete stream decoded from input_path under detection
+bool update_stream_matches(const std::string& path, const std::string& input_path,
+                           const ChangeDetection& detection);
+
+// Read-only, memory-mapped view of an update stream file. Nothing in it
+// changes after open, so one instance is shared by every thread replaying it.
+class UpdateStream {
+public:
+    // Throws std::runtime_error if the file is missing, truncated or not a stream
+    explicit UpdateStream(const std::string& path);
+    
+    UpdateStream(const UpdateStream&) = delete;
+    UpdateStream& operator=(const UpdateStream&) = delete;
+    
+    const MarketUpdate* begin() const { return updates_; }
+    const MarketUpdate* end() const { return updates_ + size_; }
+    size_t size() const { return size_; }
+    
+    // Ticker for an ID, empty if the stream never named it
+    const std::string& name(SymbolId symbol) const { return symbols_.name(symbol); }
+    const SymbolTable& symbols() const { return symbols_; }
+    
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+    std::unique_ptr<itch::MappedFile> mapping_;
+    const MarketUpdate* updates_ = nullptr;
+    size_t size_ = 0;
+    SymbolTable symbols_;
+};
+
+} // namespace hft
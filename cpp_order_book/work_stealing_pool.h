@@ -0,0 +1,428 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <algorithm>
+#include <stdexcept>
+#include <cstddef>
+#include "ring_queue.h"
+#include "thread_placement.h"
+
+namespace hft {
+
+// Move-only, type-erased void() callable. Callables up to INLINE_SIZE bytes
+// live inside the task, so submitting a lambda that captures a moved batch
+// vector and a couple of pointers does not allocate.
+class Task {
+public:
+    static constexpr size_t INLINE_SIZE = 64;
+    
+    Task() = default;
+    
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>>
+    Task(F&& callable) {
+        using Callable = std::decay_t<F>;
+        if constexpr (fits_inline<Callable>()) {
+            new (storage_) Callable(std::forward<F>(callable));
+            ops_ = &InlineOps<Callable>::TABLE;
+        } else {
+            *reinterpret_cast<Callable**>(storage_) = new Callable(std::forward<F>(callable));
+            ops_ = &HeapOps<Callable>::TABLE;
+        }
+    }
+    
+    Task(Task&& other) noexcept {
+        take(other);
+    }
+    
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            take(other);
+        }
+        return *this;
+    }
+    
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    
+    ~Task() {
+        reset();
+    }
+    
+    explicit operator bool() const {
+        return ops_ != nullptr;
+    }
+    
+    void operator()() {
+        ops_->invoke(storage_);
+    }
+    
+    void reset() {
+        if (ops_) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*move)(void* from, void* to);  // Move-constructs into `to` and destroys `from`
+        void (*destroy)(void* storage);
+    };
+    
+    template <typename F>
+    static constexpr bool fits_inline() {
+        return sizeof(F) <= INLINE_SIZE && alignof(F) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible_v<F>;
+    }
+    
+    template <typename F>
+    struct InlineOps {
+        static void invoke(void* storage) {
+            (*static_cast<F*>(storage))();
+        }
+        
+        static void move(void* from, void* to) {
+            new (to) F(std::move(*static_cast<F*>(from)));
+            static_cast<F*>(from)->~F();
+        }
+        
+        static void destroy(void* storage) {
+            static_cast<F*>(storage)->~F();
+        }
+        
+        static constexpr Ops TABLE = {&invoke, &move, &destroy};
+    };
+    
+    // Too big for the buffer: the buffer holds a pointer to the callable
+    template <typename F>
+    struct HeapOps {
+        static void invoke(void* storage) {
+            (**static_cast<F**>(storage))();
+        }
+        
+        static void move(void* from, void* to) {
+            *static_cast<F**>(to) = *static_cast<F**>(from);
+        }
+        
+        static void destroy(void* storage) {
+            delete *static_cast<F**>(storage);
+        }
+        
+        static constexpr Ops TABLE = {&invoke, &move, &destroy};
+    };
+    
+    alignas(std::max_align_t) unsigned char storage_[INLINE_SIZE];
+    const Ops* ops_ = nullptr;
+    
+    void take(Task& other) {
+        if (other.ops_) {
+            other.ops_->move(other.storage_, storage_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+};
+
+// Where a pool's workers run
+struct PoolOptions {
+    bool pin_threads = false;  // Pin each worker to one CPU (Linux only; ignored elsewhere)
+    int numa_node = -1;        // Only use the node with this ID; -1 fills nodes in order
+    size_t first_cpu = 0;      // Position in that CPU list of worker 0, so pools can sit side by side
+    std::vector<int> cpus;     // Explicit CPUs, worker i on cpus[(first_cpu + i) % size]; overrides numa_node
+    int memory_node = -1;      // Node workers prefer for the memory they allocate; -1 leaves it to the OS
+    bool busy_poll = false;    // Idle workers spin instead of sleeping
+};
+
+// Pool options for the workers of a placed stage, starting at thread `first`
+// of the stage (earlier threads being ones the stage runs outside the pool)
+inline PoolOptions pool_options_for(const StagePlacement& stage, size_t first) {
+    PoolOptions options;
+    options.busy_poll = stage.busy_poll;
+    if (!stage.placed()) {
+        return options;
+    }
+    options.pin_threads = true;
+    options.first_cpu = first;
+    options.cpus = stage.cpus;
+    options.numa_node = stage.numa_node;
+    options.memory_node = stage.memory_node(numa_topology());
+    return options;
+}
+
+// Thread pool with one task deque per worker. Tasks submitted from outside
+// the pool are dealt to the workers in turn, and tasks submitted from a
+// worker go to its own deque. A worker runs its own tasks oldest first, so
+// a single-worker pool keeps submission order, and when it runs dry it
+// steals the newest task of another worker, trying workers pinned to its
+// own NUMA node before the rest. The destructor runs every queued task
+// before joining.
+//
+// Tasks on different workers run in no particular order, and stealing takes
+// the newest, so the pool is for independent work: decoding and serializing
+// chunks whose output is put back in order afterwards (ReorderRing), or
+// backtest runs. Work whose result depends on order, such as applying
+// messages to a book, belongs on one thread; IntegratedProcessor applies the
+// book on its own thread for that reason.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(size_t num_threads, const PoolOptions& options = {})
+        : queues_(std::max<size_t>(1, num_threads)) {
+        
+        const size_t count = queues_.size();
+        std::vector<int> cpus;
+        std::vector<int> cpu_nodes;
+        const auto topology = numa_topology();
+        if (!options.cpus.empty()) {
+            for (int cpu : options.cpus) {
+                cpus.push_back(cpu);
+                cpu_nodes.push_back(numa_node_of(cpu, topology));
+            }
+        } else {
+            for (const NumaNode& node : topology) {
+                if (options.numa_node >= 0 && options.numa_node != node.id) {
+                    continue;
+                }
+                for (int cpu : node.cpus) {
+                    cpus.push_back(cpu);
+                    cpu_nodes.push_back(node.id);
+                }
+            }
+        }
+        if (cpus.empty()) {
+            throw std::runtime_error("No CPUs on NUMA node " + std::to_string(options.numa_node));
+        }
+        
+        // Worker i takes the i-th CPU after first_cpu, wrapping if the pool is bigger than the list
+        std::vector<int> worker_cpus(count, -1);
+        std::vector<int> worker_nodes(count, 0);
+        for (size_t i = 0; i < count; ++i) {
+            const size_t slot = (options.first_cpu + i) % cpus.size();
+            if (options.pin_threads) {
+                worker_cpus[i] = cpus[slot];
+                worker_nodes[i] = cpu_nodes[slot];
+            }
+        }
+        
+        // Steal order: the other workers on the same node, then everyone else
+        steal_order_.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            for (int same_node = 1; same_node >= 0; --same_node) {
+                for (size_t step = 1; step < count; ++step) {
+                    const size_t victim = (i + step) % count;
+                    if ((worker_nodes[victim] == worker_nodes[i]) == (same_node == 1)) {
+                        steal_order_[i].push_back(victim);
+                    }
+                }
+            }
+        }
+        
+        busy_poll_ = options.busy_poll;
+        workers_.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            workers_.emplace_back([this, i, cpu = worker_cpus[i], node = options.memory_node] {
+                if (cpu >= 0) {
+                    pin_current_thread(cpu);
+                }
+                if (node >= 0) {
+                    prefer_numa_node(node);
+                }
+                worker_loop(i);
+            });
+        }
+    }
+    
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            stop_ = true;
+            stopping_.store(true, std::memory_order_release);
+        }
+        wake_.notify_all();
+        
+        for (std::thread& worker : workers_) {
+            worker.join();
+        }
+    }
+    
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+    
+    size_t get_thread_count() const {
+        return workers_.size();
+    }
+    
+    // Run a task with no result. An exception escaping it terminates the program.
+    void submit(Task task) {
+        push(target_queue(), std::move(task));
+        notify(1);
+    }
+    
+    // Run f(args...) and return a future for its result or exception
+    template <class F, class... Args>
+    auto enqueue(F&& f, Args&&... args) {
+        using return_type = std::invoke_result_t<F, Args...>;
+        
+        std::packaged_task<return_type()> task(
+            std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        std::future<return_type> result = task.get_future();
+        submit(Task(std::move(task)));
+        return result;
+    }
+    
+    // Run process(batch) with the batch moved into the task rather than copied
+    template <typename Batch, typename F>
+    std::future<void> submit_batch(Batch&& batch, F&& process) {
+        static_assert(!std::is_lvalue_reference_v<Batch>, "std::move the batch into submit_batch");
+        return enqueue([batch = std::move(batch), process = std::forward<F>(process)]() mutable {
+            process(batch);
+        });
+    }
+    
+    // Run process(batch) for every batch, dealt across the workers with a single wakeup
+    template <typename Batch, typename F>
+    std::vector<std::future<void>> submit_batches(std::vector<Batch>&& batches, const F& process) {
+        std::vector<std::future<void>> results;
+        results.reserve(batches.size());
+        for (Batch& batch : batches) {
+            std::packaged_task<void()> task([batch = std::move(batch), process]() mutable {
+                process(batch);
+            });
+            results.push_back(task.get_future());
+            push(target_queue(), Task(std::move(task)));
+        }
+        batches.clear();
+        notify(results.size());
+        return results;
+    }
+
+private:
+    // One worker's tasks; the owner takes from the front, thieves from the back
+    struct alignas(64) WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+    
+    std::vector<WorkerQueue> queues_;
+    std::vector<std::vector<size_t>> steal_order_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> next_queue_{0};  // Round-robin target for outside submissions
+    std::atomic<size_t> pending_{0};     // Tasks queued and not yet taken
+    
+    // Idle workers sleep here until pending_ rises or the pool stops
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    
+    // Busy-polling workers never sleep; they watch stopping_ instead of stop_
+    bool busy_poll_ = false;
+    std::atomic<bool> stopping_{false};
+    
+    // Set on worker threads, so tasks they submit stay on their own deque
+    static WorkStealingPool*& current_pool() {
+        thread_local WorkStealingPool* pool = nullptr;
+        return pool;
+    }
+    
+    static size_t& current_worker() {
+        thread_local size_t worker = 0;
+        return worker;
+    }
+    
+    size_t target_queue() {
+        if (current_pool() == this) {
+            return current_worker();
+        }
+        return next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+    }
+    
+    void push(size_t index, Task&& task) {
+        // pending_ moves under the deque lock, so a thief can never take a task before it is counted
+        std::lock_guard<std::mutex> lock(queues_[index].mutex);
+        queues_[index].tasks.push_back(std::move(task));
+        pending_.fetch_add(1, std::memory_order_release);
+    }
+    
+    void notify(size_t tasks) {
+        // Taking the lock orders this against a worker checking pending_ before it sleeps
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+        }
+        if (tasks == 1) {
+            wake_.notify_one();
+        } else if (tasks > 1) {
+            wake_.notify_all();
+        }
+    }
+    
+    bool take(size_t index, Task& task) {
+        if (pending_.load(std::memory_order_acquire) == 0) {
+            return false;
+        }
+        {
+            WorkerQueue& own = queues_[index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.front());
+                own.tasks.pop_front();
+                pending_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        for (size_t victim : steal_order_[index]) {
+            WorkerQueue& other = queues_[victim];
+            std::lock_guard<std::mutex> lock(other.mutex);
+            if (!other.tasks.empty()) {
+                task = std::move(other.tasks.back());
+                other.tasks.pop_back();
+                pending_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    void worker_loop(size_t index) {
+        current_pool() = this;
+        current_worker() = index;
+        
+        Task task;
+        while (true) {
+            if (take(index, task)) {
+                task();
+                task.reset();
+                continue;
+            }
+            
+            if (busy_poll_) {
+                if (stopping_.load(std::memory_order_acquire) && pending_.load(std::memory_order_acquire) == 0) {
+                    return;
+                }
+                cpu_relax();
+                continue;
+            }
+            
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            wake_.wait(lock, [this] {
+                return stop_ || pending_.load(std::memory_order_acquire) > 0;
+            });
+            if (stop_ && pending_.load(std::memory_order_acquire) == 0) {
+                return;
+            }
+        }
+    }
+};
+
+} // namespace hft
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "message.h"
+#include "mapped_file.h"
+#include "parser.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+namespace itch {
+
+// Row kinds of a MessageBatch. The hot kinds are the fixed-layout order
+// messages that make up most of a trading day; everything else is Other.
+enum class BatchKind : uint8_t {
+    Add,      // 'A' and 'F' (the MPID is dropped)
+    Execute,  // 'E' and 'C' (the execution price is dropped)
+    Cancel,   // 'X'
+    Delete,   // 'D'
+    Replace,  // 'U'
+    Other     // Any other type, decoded by Parser into MessageBatch::others
+};
+
+// Struct-of-arrays batch of consecutive messages, in feed order.
+//
+// Row i of every column belongs to message i. Columns are sized to the
+// batch's capacity and only the first size() rows are meaningful; within
+// those, a column is only written for the kinds that carry the field:
+//
+//   locates, timestamps   every hot row
+//   refs                  every hot row (the old reference for Replace)
+//   new_refs              Replace
+//   shares                Add, Replace; executed for Execute, cancelled for Cancel
+//   prices                Add, Replace (raw, 1/10000 dollars)
+//   sides, stocks         Add
+//
+// Rows of kind Other take the next entry of others, in order.
+struct MessageBatch {
+    std::vector<BatchKind> kinds;
+    std::vector<uint16_t> locates;
+    std::vector<uint64_t> timestamps;
+    std::vector<uint64_t> refs;
+    std::vector<uint64_t> new_refs;
+    std::vector<uint32_t> shares;
+    std::vector<uint32_t> prices;
+    std::vector<Side> sides;
+    std::vector<ArrayString8> stocks;
+    std::vector<Message> others;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // Drop the rows but keep the columns' storage
+    void clear() {
+        count = 0;
+        others.clear();
+    }
+
+    // Grow every column to hold at least rows entries
+    void reserve_rows(size_t rows);
+
+private:
+    friend class BatchDecoder;
+    size_t count = 0;
+};
+
+// Decodes a memory-mapped ITCH file a batch at a time.
+//
+// The hot order messages are read at fixed offsets straight from the
+// mapping: whole big-endian fields are loaded and byte-swapped in one go
+// (with SSSE3, one 16-byte load and a pshufb yield both the timestamp and
+// the order reference), with a single bounds check per message instead of
+// one per field. Every other type, and anything malformed, goes through
+// Parser at the same offset, so errors and rare types behave exactly as
+// they do on the per-message path.
+class BatchDecoder {
+public:
+    static constexpr size_t DEFAULT_BATCH_SIZE = 1024;
+
+    explicit BatchDecoder(std::shared_ptr<const MappedFile> mapping);
+
+    // Decode only bytes [begin, end) of a mapping; begin must sit on a message boundary
+    BatchDecoder(std::shared_ptr<const MappedFile> mapping, size_t begin, size_t end);
+
+    // Map a file. Compressed files cannot be mapped; use Parser for those.
+    static std::unique_ptr<BatchDecoder> open(const std::string& path);
+
+    // Replace batch with up to max_messages of the next messages.
+    // Returns false once the input is exhausted.
+    bool next_batch(MessageBatch& batch, size_t max_messages = DEFAULT_BATCH_SIZE);
+
+    // Input byte offset of the next message
+    uint64_t offset() const {
+        return pos_;
+    }
+
+    bool eof() const {
+        return pos_ >= end_;
+    }
+
+private:
+    std::shared_ptr<const MappedFile> mapping_;
+    const uint8_t* data_;
+    size_t pos_;
+    size_t end_;
+    Parser parser_;  // Rare types and malformed input, positioned with seek()
+
+    // Decode one hot message starting at its type byte into row `row`.
+    // Returns false, leaving the row unused, for anything the fixed layout
+    // does not cover.
+    static bool decode_hot(const uint8_t* message, size_t length, MessageBatch& batch, size_t row);
+};
+
+} // namespace itch
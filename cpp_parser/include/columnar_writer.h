@@ -0,0 +1,73 @@
+#pragma once
+
+#include "message.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
+
+namespace itch {
+
+// Writes messages as one table per message type and one flat file per column:
+//
+//   <directory>/schema.json           tables, row counts, column types, dictionaries
+//   <directory>/<Table>/<column>.bin  `rows` fixed-width little-endian values
+//
+// Table and column names match the JSON output (AddOrder/price, ...). Every
+// table starts with stock_locate, tracking_number and timestamp. Prices are
+// the raw integers (schema lists their decimal scale), enums are uint8
+// ordinals with their names in the schema, booleans are uint8 (255 = absent),
+// MPIDs and other 4-character codes are S4 (NUL-filled when absent), and
+// stocks are uint16 indexes into the schema's symbol dictionary.
+// Any column loads with numpy.fromfile or numpy.memmap.
+class ColumnarWriter {
+public:
+    // Creates the directory; throws std::runtime_error if a column file cannot be opened
+    explicit ColumnarWriter(const std::string& directory);
+    
+    // Finishes the output if finish() was not called
+    ~ColumnarWriter();
+    
+    ColumnarWriter(const ColumnarWriter&) = delete;
+    ColumnarWriter& operator=(const ColumnarWriter&) = delete;
+    
+    void write(const Message& message);
+    
+    // Flush every column and write schema.json
+    void finish();
+    
+    // Bytes written to column files so far
+    uint64_t bytes_written() const {
+        return bytes_written_;
+    }
+
+private:
+    static constexpr size_t FLUSH_SIZE = 64 * 1024;  // Buffered bytes per column before a write
+    
+    struct Column;
+    struct Table;
+    class Row;
+    
+    // Distinct strings in first-seen order, referenced by uint16 code
+    struct Dictionary {
+        std::vector<std::string> values;
+        std::unordered_map<std::string, uint16_t> codes;
+        
+        uint16_t code(std::string_view value);
+    };
+    
+    std::string directory_;
+    std::vector<std::unique_ptr<Table>> tables_;  // By MessageBody alternative
+    Dictionary symbols_;  // Stock symbols, trailing spaces trimmed
+    uint64_t messages_ = 0;
+    uint64_t bytes_written_ = 0;
+    bool finished_ = false;
+    
+    Table& table(size_t index, const char* name);
+    Column& add_column(Table& table, const char* name, const char* type);
+    void flush(Column& column);
+};
+
+} // namespace itch
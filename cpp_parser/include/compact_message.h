@@ -0,0 +1,116 @@
+#pragma once
+
+#include "message.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+namespace itch {
+
+// How a CompactMessage stores its body
+enum class CompactKind : uint8_t {
+    AddOrder,                // 'A'
+    OrderExecuted,           // 'E'
+    OrderExecutedWithPrice,  // 'C'
+    OrderCancelled,          // 'X'
+    DeleteOrder,             // 'D'
+    ReplaceOrder,            // 'U'
+    OutOfLine                // Every other type, kept whole in the chunk's arena
+};
+
+// A Message in 40 bytes instead of sizeof(Message) (80 on x86-64).
+//
+// The header is stored as plain integers and the hot order bodies as
+// tightly packed structs sharing 24 bytes; the MPID of 'F' and the rarer
+// types, whose variant alternatives set the size of every Message, live
+// out of line in the owning CompactChunk's arena.
+struct CompactMessage {
+    struct Add {
+        uint64_t reference;
+        uint32_t shares;
+        uint32_t price;  // Raw Price4
+        ArrayString8 stock;
+    };
+    struct Executed {
+        uint64_t reference;
+        uint32_t executed;
+        uint32_t price;  // Raw Price4; 'C' only
+        uint64_t match_number;
+    };
+    struct Cancelled {
+        uint64_t reference;
+        uint32_t cancelled;
+    };
+    struct Delete {
+        uint64_t reference;
+    };
+    struct Replace {
+        uint64_t old_reference;
+        uint64_t new_reference;
+        uint32_t shares;
+        uint32_t price;  // Raw Price4
+    };
+
+    uint64_t timestamp;
+    uint16_t stock_locate;
+    uint16_t tracking_number;
+    uint8_t tag;
+    CompactKind kind;
+    uint8_t flag;  // Add: 1 for a buy; OrderExecutedWithPrice: printable
+    union {
+        Add add;
+        Executed executed;
+        Cancelled cancelled;
+        Delete deleted;
+        Replace replace;
+        uint32_t arena_index;  // OutOfLine: position in the chunk's arena
+    };
+};
+
+static_assert(std::is_trivially_copyable_v<CompactMessage>, "CompactMessage is copied as plain bytes");
+static_assert(sizeof(CompactMessage) == 40, "CompactMessage should stay at 40 bytes");
+
+// A run of messages in compact form, e.g. one chunk of ShardedDecoder.
+// Hot messages take sizeof(CompactMessage) each; out-of-line messages add
+// a full Message in the arena, which is freed with the chunk.
+class CompactChunk {
+public:
+    void push_back(Message&& message);
+
+    // Rebuild message i as a full Message
+    Message at(size_t index) const;
+
+    const CompactMessage& operator[](size_t index) const {
+        return messages_[index];
+    }
+
+    // The full message behind an OutOfLine entry
+    const Message& out_of_line(const CompactMessage& message) const {
+        return arena_[message.arena_index];
+    }
+
+    size_t size() const { return messages_.size(); }
+    bool empty() const { return messages_.empty(); }
+    size_t out_of_line_count() const { return arena_.size(); }
+
+    void reserve(size_t messages) {
+        messages_.reserve(messages);
+    }
+
+    void clear() {
+        messages_.clear();
+        arena_.clear();
+    }
+
+    // Bytes of message storage the chunk holds
+    size_t bytes() const {
+        return messages_.capacity() * sizeof(CompactMessage) + arena_.capacity() * sizeof(Message);
+    }
+
+private:
+    std::vector<CompactMessage> messages_;
+    std::vector<Message> arena_;
+};
+
+} // namespace itch
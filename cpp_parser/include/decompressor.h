@@ -0,0 +1,80 @@
+#pragma once
+
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace itch {
+
+// Compressed input formats
+enum class Compression {
+    Gzip,
+    Zstd
+};
+
+// Detect the compression format from a file's magic bytes
+// Returns false for uncompressed files
+bool detect_compression(const std::string& path, Compression& format);
+
+class Decoder;
+
+// Stream buffer that decompresses on a background thread.
+// Two blocks are used in turn: while the parser drains one, the
+// decompressor fills the other, so decompression overlaps with parsing.
+class DecompressingStreambuf : public std::streambuf {
+public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 1024 * 1024; // 1MB per block
+
+    DecompressingStreambuf(const std::string& path, Compression format,
+                           size_t block_size = DEFAULT_BLOCK_SIZE);
+    ~DecompressingStreambuf() override;
+
+    DecompressingStreambuf(const DecompressingStreambuf&) = delete;
+    DecompressingStreambuf& operator=(const DecompressingStreambuf&) = delete;
+
+protected:
+    int_type underflow() override;
+
+private:
+    struct Block {
+        std::vector<char> data;
+        size_t size = 0;
+        bool ready = false; // Filled and waiting for the consumer
+        bool last = false;  // No more blocks after this one
+    };
+
+    std::unique_ptr<Decoder> decoder_;
+    Block blocks_[2];
+    size_t consume_index_ = 0;
+    Block* current_ = nullptr;
+    bool finished_ = false;
+    std::string error_;
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stop_ = false;
+    std::thread worker_;
+
+    // Producer loop running on worker_
+    void run();
+};
+
+// Input stream that owns its decompressing stream buffer.
+// Errors from the decompressor, including a file that ends inside a
+// compressed stream, are rethrown as std::runtime_error once the data
+// decoded before them has been read.
+class DecompressingStream : public std::istream {
+public:
+    DecompressingStream(const std::string& path, Compression format,
+                        size_t block_size = DecompressingStreambuf::DEFAULT_BLOCK_SIZE);
+
+private:
+    DecompressingStreambuf buffer_;
+};
+
+} // namespace itch
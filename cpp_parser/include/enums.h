@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <array>
 #include <optional>
 #include <cstdint>
@@ -219,6 +220,24 @@ enum class InterestFlag {
 IssueClassification parse_issue_classification(char value);
 IssueSubType parse_issue_subtype(const char* value);
 
+// Enum names as static strings (no allocation)
+std::string_view to_string_view(EventCode code);
+std::string_view to_string_view(MarketCategory category);
+std::string_view to_string_view(FinancialStatus status);
+std::string_view to_string_view(IssueClassification classification);
+std::string_view to_string_view(IssueSubType subtype);
+std::string_view to_string_view(LuldRefPriceTier tier);
+std::string_view to_string_view(MarketMakerMode mode);
+std::string_view to_string_view(MarketParticipantState state);
+std::string_view to_string_view(RegShoAction action);
+std::string_view to_string_view(TradingState state);
+std::string_view to_string_view(Side side);
+std::string_view to_string_view(ImbalanceDirection direction);
+std::string_view to_string_view(CrossType type);
+std::string_view to_string_view(IpoReleaseQualifier qualifier);
+std::string_view to_string_view(LevelBreached level);
+std::string_view to_string_view(InterestFlag flag);
+
 // String conversion functions
 std::string to_string(EventCode code);
 std::string to_string(MarketCategory category);
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "message.h"
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+namespace itch {
+
+// Writes messages as compact JSON straight into a reusable buffer. The text is
+// byte for byte what JsonSerializer::to_json(message).dump() produces (keys in
+// sorted order, prices as fixed-point strings), built without a DOM or any
+// temporary strings. Once the buffer has grown, writing does not allocate.
+class JsonWriter {
+public:
+    // Append one message to the buffer
+    void write(const Message& message);
+    
+    // Append raw text, e.g. separators between messages
+    void append(std::string_view text) {
+        buffer_.append(text);
+    }
+    
+    std::string_view view() const {
+        return buffer_;
+    }
+    
+    size_t size() const {
+        return buffer_.size();
+    }
+    
+    // Empty the buffer, keeping its capacity
+    void clear() {
+        buffer_.clear();
+    }
+
+private:
+    std::string buffer_;
+    
+    // Message bodies, as {"<Type>":{fields}} minus the outer braces
+    void body(const AddOrder& order);
+    void body(LevelBreached level);
+    void body(const BrokenTrade& trade);
+    void body(const CrossTrade& trade);
+    void body(const DeleteOrder& order);
+    void body(const ImbalanceIndicator& indicator);
+    void body(const IpoQuotingPeriod& period);
+    void body(const LULDAuctionCollar& collar);
+    void body(const MwcbDeclineLevel& level);
+    void body(const NonCrossTrade& trade);
+    void body(const OrderCancelled& order);
+    void body(const OrderExecuted& order);
+    void body(const OrderExecutedWithPrice& order);
+    void body(const MarketParticipantPosition& position);
+    void body(const RegShoRestriction& restriction);
+    void body(const ReplaceOrder& order);
+    void body(const StockDirectory& directory);
+    void body(const SystemEvent& event);
+    void body(const TradingAction& action);
+    void body(const RetailPriceImprovementIndicator& indicator);
+    
+    // Values
+    void number(uint64_t value);
+    void boolean(bool value);
+    void price(const Price4& price);
+    void price(const Price8& price);
+    void string(std::string_view text);  // Escaped as nlohmann::json does
+    void name(std::string_view text);    // Enum names, which never need escaping
+    
+    template <size_t N>
+    void string(const std::array<char, N>& text) {
+        string(std::string_view(text.data(), N));
+    }
+};
+
+} // namespace itch
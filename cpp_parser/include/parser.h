@@ -1,6 +1,7 @@
 #pragma once
 
 #include "message.h"
+#include "mapped_file.h"
 #include <vector>
 #include <string>
 #include <cstdint>
@@ -10,23 +11,38 @@
 
 namespace itch {
 
+// Where the parser gets its bytes from
+enum class InputBackend {
+    Stream,  // std::istream through an 8KB buffer
+    Mmap     // Memory-mapped file, decoded in place
+};
+
+// Message lengths from the ITCH 5.0 spec, excluding the 2-byte length prefix.
+// Zero means the message type is unknown.
+size_t message_size(uint8_t message_type);
+
 class Parser {
 private:
     static constexpr size_t BUFFER_SIZE = 8 * 1024; // 8KB buffer
     std::vector<uint8_t> buffer;
+    const uint8_t* data = nullptr; // buffer.data() or the start of the mapping
     size_t current_pos = 0;
     size_t bytes_read = 0;
+    uint64_t consumed = 0; // Input bytes that come before data[0]
     std::unique_ptr<std::istream> stream;
+    std::shared_ptr<const MappedFile> mapping;
     bool is_end_of_stream = false;
     
-    // Helper methods for parsing binary data
+    // Helper methods for parsing binary data. These do not check bounds:
+    // parse_message() makes sure the whole message is available up front.
     uint8_t read_u8();
     uint16_t read_u16();
     uint32_t read_u32();
     uint64_t read_u64();
     uint64_t read_u48();
-    void read_bytes(void* data, size_t len);
+    void read_bytes(void* dst, size_t len);
     bool fetch_more_bytes();
+    bool ensure_available(size_t len);
     ArrayString8 read_stock();
     ArrayString4 read_array_string4();
     bool parse_char_to_bool();
@@ -58,6 +74,12 @@ private:
 public:
     explicit Parser(std::unique_ptr<std::istream> stream);
     
+    // Decode straight from a memory-mapped file
+    explicit Parser(std::shared_ptr<const MappedFile> mapping);
+    
+    // Decode only bytes [begin, end) of a mapping; begin must sit on a message boundary
+    Parser(std::shared_ptr<const MappedFile> mapping, size_t begin, size_t end);
+    
     // Parse a message from the stream
     std::optional<Message> parse_message();
     
@@ -67,11 +89,31 @@ public:
     // Check if we've reached the end of the stream
     bool eof() const;
     
+    // Input byte offset of the next message (uncompressed bytes for gzip/zstd input)
+    uint64_t offset() const {
+        return consumed + current_pos;
+    }
+    
+    // Continue parsing from a message boundary previously returned by offset().
+    // Mapped and plain-file input jump straight there; compressed input is
+    // decompressed and skipped forward, so it cannot seek backwards.
+    void seek(uint64_t offset);
+    
     // Static constructor for file path
     static std::unique_ptr<Parser> from_file(const std::string& path);
     
-    // Static constructor for gzipped file
+    // Static constructor for a memory-mapped file path
+    static std::unique_ptr<Parser> from_mmap(const std::string& path);
+    
+    // Static constructor for a file path using the given backend.
+    // Gzip and zstd files are detected and decompressed regardless of backend.
+    static std::unique_ptr<Parser> open(const std::string& path, InputBackend backend);
+    
+    // Static constructor for gzipped file, decompressed on a background thread
     static std::unique_ptr<Parser> from_gzip(const std::string& path);
+    
+    // Static constructor for zstd-compressed file (requires a build with libzstd)
+    static std::unique_ptr<Parser> from_zstd(const std::string& path);
 };
 
 } // namespace itch
\ No newline at end of file
@@ -1,10 +1,33 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 #include <string>
 
 namespace itch {
 
+// Write `value` with `decimals` implied decimal places (at least one digit before
+// the point, e.g. 1012500 -> "101.2500") and return the end of the text
+inline char* format_fixed_point(uint64_t value, int decimals, char* out) {
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (count <= decimals) {
+        digits[count++] = '0';
+    }
+    
+    while (count > 0) {
+        if (count == decimals) {
+            *out++ = '.';
+        }
+        *out++ = digits[--count];
+    }
+    return out;
+}
+
 // Price with 4 decimal places
 class Price4 {
 private:
@@ -16,20 +39,18 @@ public:
     
     uint32_t raw() const { return value; }
     
+    // Longest to_string() result: 10 digits and the decimal point
+    static constexpr size_t MAX_CHARS = 11;
+    
+    // Write the to_string() text to `out` (room for MAX_CHARS) and return its end
+    char* format(char* out) const {
+        return format_fixed_point(value, 4, out);
+    }
+    
     // Convert to decimal string representation
     std::string to_string() const {
-        std::string result = std::to_string(value);
-        
-        // Ensure we have at least 5 digits (one before decimal point and 4 after)
-        while (result.length() < 5) {
-            result = "0" + result;
-        }
-        
-        // Insert decimal point
-        size_t decimal_pos = result.length() - 4;
-        result.insert(decimal_pos, ".");
-        
-        return result;
+        char text[MAX_CHARS];
+        return std::string(text, format(text));
     }
 };
 
@@ -44,20 +65,18 @@ public:
     
     uint64_t raw() const { return value; }
     
+    // Longest to_string() result: 20 digits and the decimal point
+    static constexpr size_t MAX_CHARS = 21;
+    
+    // Write the to_string() text to `out` (room for MAX_CHARS) and return its end
+    char* format(char* out) const {
+        return format_fixed_point(value, 8, out);
+    }
+    
     // Convert to decimal string representation
     std::string to_string() const {
-        std::string result = std::to_string(value);
-        
-        // Ensure we have at least 9 digits (one before decimal point and 8 after)
-        while (result.length() < 9) {
-            result = "0" + result;
-        }
-        
-        // Insert decimal point
-        size_t decimal_pos = result.length() - 8;
-        result.insert(decimal_pos, ".");
-        
-        return result;
+        char text[MAX_CHARS];
+        return std::string(text, format(text));
     }
 };
 
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "message.h"
+#include "compact_message.h"
+#include "mapped_file.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+namespace itch {
+
+// Decodes a memory-mapped ITCH file on several threads.
+// A scan thread hops along the length prefixes and cuts the file into
+// chunks at message boundaries. Workers decode whole chunks in parallel
+// and next_chunk() hands them back in file order. Only a bounded window
+// of chunks is decoded ahead of the consumer, so memory stays flat on
+// full-day files. Chunks are held as CompactChunks, half the size of the
+// same messages in a std::vector<Message>.
+class ShardedDecoder {
+public:
+    static constexpr size_t DEFAULT_CHUNK_BYTES = 4 * 1024 * 1024; // 4MB per chunk
+
+    ShardedDecoder(std::shared_ptr<const MappedFile> mapping, size_t num_threads,
+                   size_t message_limit = 0, size_t chunk_bytes = DEFAULT_CHUNK_BYTES);
+    ~ShardedDecoder();
+
+    ShardedDecoder(const ShardedDecoder&) = delete;
+    ShardedDecoder& operator=(const ShardedDecoder&) = delete;
+
+    // Replace chunk with the next chunk in file order.
+    // Returns false once every chunk has been handed out. A message that
+    // does not decode ends the stream where a sequential Parser would stop:
+    // its chunk is delivered up to that message and no later chunk follows.
+    bool next_chunk(CompactChunk& chunk);
+
+private:
+    struct Slot {
+        CompactChunk messages;
+        bool ready = false; // Decoded and waiting for the consumer
+        bool last = false;  // Decoding stopped inside this chunk
+        std::string error;  // Set if decoding threw
+    };
+
+    std::shared_ptr<const MappedFile> mapping_;
+    size_t message_limit_;
+    size_t chunk_bytes_;
+
+    // Chunk i covers [boundaries_[i], boundaries_[i + 1])
+    std::vector<size_t> boundaries_;
+    bool scan_done_ = false;
+    std::vector<Slot> slots_;
+    size_t next_decode_ = 0;  // Next chunk a worker will claim
+    size_t next_consume_ = 0; // Next chunk handed to the consumer
+    size_t stop_chunk_ = SIZE_MAX; // First chunk where decoding stopped early
+    bool finished_ = false;        // The consumer has been handed the last chunk
+    bool stop_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::thread scanner_;
+    std::vector<std::thread> workers_;
+
+    // Boundary scan running on scanner_
+    void scan();
+
+    // Worker loop: claim a chunk, decode it, publish it
+    void decode_chunks();
+};
+
+} // namespace itch
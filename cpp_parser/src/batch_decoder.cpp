@@ -0,0 +1,178 @@
+#include "../include/batch_decoder.h"
+#include <cstring>
+#include <stdexcept>
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+namespace itch {
+
+namespace {
+
+// Big-endian loads of whole fields: one unaligned load and one byte swap each
+inline uint16_t load_be16(const uint8_t* p) {
+    uint16_t value;
+    std::memcpy(&value, p, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    value = __builtin_bswap16(value);
+#endif
+    return value;
+}
+
+inline uint32_t load_be32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    value = __builtin_bswap32(value);
+#endif
+    return value;
+}
+
+inline uint64_t load_be64(const uint8_t* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+// The 48-bit timestamp at offset 5 and the order reference at offset 11,
+// shared by every hot type. Each hot message is at least 19 bytes long, so
+// the 16 bytes from offset 3 are always inside it.
+inline void load_timestamp_and_reference(const uint8_t* message, uint64_t& timestamp, uint64_t& reference) {
+#if defined(__SSSE3__) && defined(__x86_64__)
+    // Bytes 3..18: tracking number, timestamp, reference. One shuffle
+    // reverses the timestamp into the low lane (zeroing its top two bytes)
+    // and the reference into the high lane.
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(message + 3));
+    const __m128i order = _mm_setr_epi8(7, 6, 5, 4, 3, 2, -1, -1, 15, 14, 13, 12, 11, 10, 9, 8);
+    const __m128i swapped = _mm_shuffle_epi8(bytes, order);
+    timestamp = static_cast<uint64_t>(_mm_cvtsi128_si64(swapped));
+    reference = static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(swapped, swapped)));
+#else
+    timestamp = load_be64(message + 3) & 0xFFFFFFFFFFFFull;
+    reference = load_be64(message + 11);
+#endif
+}
+
+} // namespace
+
+void MessageBatch::reserve_rows(size_t rows) {
+    if (kinds.size() >= rows) {
+        return;
+    }
+    kinds.resize(rows);
+    locates.resize(rows);
+    timestamps.resize(rows);
+    refs.resize(rows);
+    new_refs.resize(rows);
+    shares.resize(rows);
+    prices.resize(rows);
+    sides.resize(rows);
+    stocks.resize(rows);
+}
+
+BatchDecoder::BatchDecoder(std::shared_ptr<const MappedFile> mapping)
+    : BatchDecoder(mapping, 0, mapping->size()) {}
+
+BatchDecoder::BatchDecoder(std::shared_ptr<const MappedFile> mapping, size_t begin, size_t end)
+    : mapping_(mapping),
+      data_(mapping->data()),
+      pos_(begin),
+      end_(end),
+      parser_(mapping, begin, end) {}
+
+std::unique_ptr<BatchDecoder> BatchDecoder::open(const std::string& path) {
+    return std::make_unique<BatchDecoder>(std::make_shared<const MappedFile>(path));
+}
+
+bool BatchDecoder::decode_hot(const uint8_t* message, size_t length, MessageBatch& batch, size_t row) {
+    const uint8_t type = message[0];
+    if (length < message_size(type)) {
+        return false;
+    }
+
+    BatchKind kind;
+    switch (type) {
+        case 'A':
+        case 'F': {
+            const uint8_t side = message[19];
+            if (side != 'B' && side != 'S') {
+                return false;
+            }
+            kind = BatchKind::Add;
+            batch.sides[row] = side == 'B' ? Side::Buy : Side::Sell;
+            batch.shares[row] = load_be32(message + 20);
+            std::memcpy(batch.stocks[row].data(), message + 24, 8);
+            batch.prices[row] = load_be32(message + 32);
+            break;
+        }
+        case 'E':
+        case 'C':
+            kind = BatchKind::Execute;
+            batch.shares[row] = load_be32(message + 19);
+            break;
+        case 'X':
+            kind = BatchKind::Cancel;
+            batch.shares[row] = load_be32(message + 19);
+            break;
+        case 'D':
+            kind = BatchKind::Delete;
+            break;
+        case 'U':
+            kind = BatchKind::Replace;
+            batch.new_refs[row] = load_be64(message + 19);
+            batch.shares[row] = load_be32(message + 27);
+            batch.prices[row] = load_be32(message + 31);
+            break;
+        default:
+            return false;
+    }
+
+    batch.kinds[row] = kind;
+    batch.locates[row] = load_be16(message + 1);
+    load_timestamp_and_reference(message, batch.timestamps[row], batch.refs[row]);
+    return true;
+}
+
+bool BatchDecoder::next_batch(MessageBatch& batch, size_t max_messages) {
+    batch.clear();
+    if (max_messages == 0) {
+        return !eof();
+    }
+    batch.reserve_rows(max_messages);
+
+    size_t row = 0;
+    while (row < max_messages && pos_ < end_) {
+        // One bounds check covers the whole message
+        if (pos_ + sizeof(uint16_t) <= end_) {
+            const size_t length = load_be16(data_ + pos_);
+            const uint8_t* message = data_ + pos_ + sizeof(uint16_t);
+            if (length > 0 && pos_ + sizeof(uint16_t) + length <= end_ &&
+                decode_hot(message, length, batch, row)) {
+                pos_ += sizeof(uint16_t) + length;
+                row++;
+                continue;
+            }
+        }
+
+        // Rare types, and anything malformed, take the per-message path, which
+        // reports a bad message and ends the input exactly where Parser would
+        parser_.seek(pos_);
+        auto message = parser_.parse_message();
+        if (!message) {
+            pos_ = end_;
+            break;
+        }
+        batch.kinds[row] = BatchKind::Other;
+        batch.others.push_back(std::move(*message));
+        pos_ = static_cast<size_t>(parser_.offset());
+        row++;
+    }
+
+    batch.count = row;
+    return row > 0;
+}
+
+} // namespace itch
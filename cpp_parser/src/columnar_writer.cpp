@@ -0,0 +1,380 @@
+#include "../include/columnar_writer.h"
+#include <nlohmann/json.hpp>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <type_traits>
+#include <variant>
+
+namespace itch {
+
+// Column files are raw copies of host integers, and schema.json says little-endian
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "columnar output assumes a little-endian host");
+
+struct ColumnarWriter::Column {
+    std::string name;
+    std::string type;                            // numpy dtype name
+    int scale = 0;                               // Decimal places of a raw price
+    bool symbols = false;                        // uint16 codes into the symbol dictionary
+    std::map<uint32_t, std::string> categories;  // Enum ordinal -> name, as seen
+    std::string path;                            // Relative to the output directory
+    std::ofstream file;
+    std::string buffer;
+};
+
+struct ColumnarWriter::Table {
+    std::string name;
+    uint64_t rows = 0;
+    std::vector<std::unique_ptr<Column>> columns;
+};
+
+// Appends one row to a table. The table's first row creates its columns, in
+// call order; later rows must make the same calls in the same order.
+class ColumnarWriter::Row {
+public:
+    Row(ColumnarWriter& writer, Table& table) : writer_(writer), table_(table) {}
+    
+    ~Row() {
+        table_.rows++;
+    }
+    
+    void u16(const char* name, uint16_t value) { append(column(name, "uint16"), value); }
+    void u32(const char* name, uint32_t value) { append(column(name, "uint32"), value); }
+    void u64(const char* name, uint64_t value) { append(column(name, "uint64"), value); }
+    
+    void price(const char* name, Price4 value) {
+        Column& c = column(name, "uint32");
+        c.scale = 4;
+        append(c, value.raw());
+    }
+    
+    void price(const char* name, Price8 value) {
+        Column& c = column(name, "uint64");
+        c.scale = 8;
+        append(c, value.raw());
+    }
+    
+    void flag(const char* name, bool value) {
+        append(column(name, "uint8"), static_cast<uint8_t>(value));
+    }
+    
+    void flag(const char* name, std::optional<bool> value) {
+        append(column(name, "uint8"), static_cast<uint8_t>(value ? *value : 255));
+    }
+    
+    void character(const char* name, char value) {
+        append(column(name, "S1"), value);
+    }
+    
+    void code(const char* name, const std::optional<ArrayString4>& value) {
+        Column& c = column(name, "S4");
+        if (value) {
+            append(c, *value);
+        } else {
+            append(c, ArrayString4{});
+        }
+    }
+    
+    void code(const char* name, const ArrayString4& value) {
+        append(column(name, "S4"), value);
+    }
+    
+    void stock(const char* name, const ArrayString8& value) {
+        Column& c = column(name, "uint16");
+        c.symbols = true;
+        std::string_view symbol(value.data(), value.size());
+        symbol = symbol.substr(0, symbol.find_last_not_of(' ') + 1);
+        append(c, writer_.symbols_.code(symbol));
+    }
+    
+    template <typename E>
+    void category(const char* name, E value) {
+        Column& c = column(name, "uint8");
+        const auto ordinal = static_cast<uint8_t>(value);
+        if (c.categories.find(ordinal) == c.categories.end()) {
+            c.categories.emplace(ordinal, to_string(value));
+        }
+        append(c, ordinal);
+    }
+
+private:
+    ColumnarWriter& writer_;
+    Table& table_;
+    size_t index_ = 0;
+    
+    Column& column(const char* name, const char* type) {
+        if (index_ == table_.columns.size()) {
+            writer_.add_column(table_, name, type);
+        }
+        return *table_.columns[index_++];
+    }
+    
+    template <typename T>
+    void append(Column& c, const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "columns hold plain values");
+        c.buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        if (c.buffer.size() >= FLUSH_SIZE) {
+            writer_.flush(c);
+        }
+    }
+};
+
+uint16_t ColumnarWriter::Dictionary::code(std::string_view value) {
+    std::string key(value);
+    auto it = codes.find(key);
+    if (it != codes.end()) {
+        return it->second;
+    }
+    if (values.size() > UINT16_MAX) {
+        throw std::runtime_error("Too many distinct symbols for a uint16 dictionary");
+    }
+    const auto next = static_cast<uint16_t>(values.size());
+    values.push_back(key);
+    codes.emplace(std::move(key), next);
+    return next;
+}
+
+ColumnarWriter::ColumnarWriter(const std::string& directory)
+    : directory_(directory), tables_(std::variant_size_v<MessageBody>) {
+    std::filesystem::create_directories(directory_);
+}
+
+ColumnarWriter::~ColumnarWriter() {
+    if (!finished_) {
+        try {
+            finish();
+        } catch (...) {
+            // Destructors must not throw; call finish() to see errors
+        }
+    }
+}
+
+ColumnarWriter::Table& ColumnarWriter::table(size_t index, const char* name) {
+    if (!tables_[index]) {
+        tables_[index] = std::make_unique<Table>();
+        tables_[index]->name = name;
+        std::filesystem::create_directories(directory_ + "/" + name);
+    }
+    return *tables_[index];
+}
+
+ColumnarWriter::Column& ColumnarWriter::add_column(Table& table, const char* name, const char* type) {
+    auto column = std::make_unique<Column>();
+    column->name = name;
+    column->type = type;
+    column->path = table.name + "/" + name + ".bin";
+    column->file.open(directory_ + "/" + column->path, std::ios::binary | std::ios::trunc);
+    if (!column->file) {
+        throw std::runtime_error("Cannot open column file: " + directory_ + "/" + column->path);
+    }
+    column->buffer.reserve(FLUSH_SIZE + 16);
+    table.columns.push_back(std::move(column));
+    return *table.columns.back();
+}
+
+void ColumnarWriter::flush(Column& column) {
+    column.file.write(column.buffer.data(), static_cast<std::streamsize>(column.buffer.size()));
+    if (!column.file) {
+        throw std::runtime_error("Failed to write column file: " + directory_ + "/" + column.path);
+    }
+    bytes_written_ += column.buffer.size();
+    column.buffer.clear();
+}
+
+void ColumnarWriter::write(const Message& message) {
+    std::visit([this, &message](auto&& body) {
+        using T = std::decay_t<decltype(body)>;
+        
+        // Table names follow the JSON body keys
+        const char* name = nullptr;
+        if constexpr (std::is_same_v<T, AddOrder>) name = "AddOrder";
+        else if constexpr (std::is_same_v<T, LevelBreached>) name = "Breach";
+        else if constexpr (std::is_same_v<T, BrokenTrade>) name = "BrokenTrade";
+        else if constexpr (std::is_same_v<T, CrossTrade>) name = "CrossTrade";
+        else if constexpr (std::is_same_v<T, DeleteOrder>) name = "DeleteOrder";
+        else if constexpr (std::is_same_v<T, ImbalanceIndicator>) name = "Imbalance";
+        else if constexpr (std::is_same_v<T, IpoQuotingPeriod>) name = "IpoQuotingPeriod";
+        else if constexpr (std::is_same_v<T, LULDAuctionCollar>) name = "LULDAuctionCollar";
+        else if constexpr (std::is_same_v<T, MwcbDeclineLevel>) name = "MwcbDeclineLevel";
+        else if constexpr (std::is_same_v<T, NonCrossTrade>) name = "NonCrossTrade";
+        else if constexpr (std::is_same_v<T, OrderCancelled>) name = "OrderCancelled";
+        else if constexpr (std::is_same_v<T, OrderExecuted>) name = "OrderExecuted";
+        else if constexpr (std::is_same_v<T, OrderExecutedWithPrice>) name = "OrderExecutedWithPrice";
+        else if constexpr (std::is_same_v<T, MarketParticipantPosition>) name = "ParticipantPosition";
+        else if constexpr (std::is_same_v<T, RegShoRestriction>) name = "RegShoRestriction";
+        else if constexpr (std::is_same_v<T, ReplaceOrder>) name = "ReplaceOrder";
+        else if constexpr (std::is_same_v<T, StockDirectory>) name = "StockDirectory";
+        else if constexpr (std::is_same_v<T, SystemEvent>) name = "SystemEvent";
+        else if constexpr (std::is_same_v<T, TradingAction>) name = "TradingAction";
+        else if constexpr (std::is_same_v<T, RetailPriceImprovementIndicator>) name = "RetailPriceImprovementIndicator";
+        
+        Row row(*this, table(message.body.index(), name));
+        row.u16("stock_locate", message.stock_locate);
+        row.u16("tracking_number", message.tracking_number);
+        row.u64("timestamp", message.timestamp);
+        
+        if constexpr (std::is_same_v<T, AddOrder>) {
+            row.u64("reference", body.reference);
+            row.category("side", body.side);
+            row.u32("shares", body.shares);
+            row.stock("stock", body.stock);
+            row.price("price", body.price);
+            row.code("mpid", body.mpid);
+        } else if constexpr (std::is_same_v<T, LevelBreached>) {
+            row.category("level", body);
+        } else if constexpr (std::is_same_v<T, BrokenTrade>) {
+            row.u64("match_number", body.match_number);
+        } else if constexpr (std::is_same_v<T, CrossTrade>) {
+            row.u64("shares", body.shares);
+            row.stock("stock", body.stock);
+            row.price("cross_price", body.cross_price);
+            row.u64("match_number", body.match_number);
+            row.category("cross_type", body.cross_type);
+        } else if constexpr (std::is_same_v<T, DeleteOrder>) {
+            row.u64("reference", body.reference);
+        } else if constexpr (std::is_same_v<T, ImbalanceIndicator>) {
+            row.u64("paired_shares", body.paired_shares);
+            row.u64("imbalance_shares", body.imbalance_shares);
+            row.category("imbalance_direction", body.imbalance_direction);
+            row.stock("stock", body.stock);
+            row.price("far_price", body.far_price);
+            row.price("near_price", body.near_price);
+            row.price("current_ref_price", body.current_ref_price);
+            row.category("cross_type", body.cross_type);
+            row.character("price_variation_indicator", body.price_variation_indicator);
+        } else if constexpr (std::is_same_v<T, IpoQuotingPeriod>) {
+            row.stock("stock", body.stock);
+            row.u32("release_time", body.release_time);
+            row.category("release_qualifier", body.release_qualifier);
+            row.price("price", body.price);
+        } else if constexpr (std::is_same_v<T, LULDAuctionCollar>) {
+            row.stock("stock", body.stock);
+            row.price("ref_price", body.ref_price);
+            row.price("upper_price", body.upper_price);
+            row.price("lower_price", body.lower_price);
+            row.u32("extension", body.extension);
+        } else if constexpr (std::is_same_v<T, MwcbDeclineLevel>) {
+            row.price("level1", body.level1);
+            row.price("level2", body.level2);
+            row.price("level3", body.level3);
+        } else if constexpr (std::is_same_v<T, NonCrossTrade>) {
+            row.u64("reference", body.reference);
+            row.category("side", body.side);
+            row.u32("shares", body.shares);
+            row.stock("stock", body.stock);
+            row.price("price", body.price);
+            row.u64("match_number", body.match_number);
+        } else if constexpr (std::is_same_v<T, OrderCancelled>) {
+            row.u64("reference", body.reference);
+            row.u32("cancelled", body.cancelled);
+        } else if constexpr (std::is_same_v<T, OrderExecuted>) {
+            row.u64("reference", body.reference);
+            row.u32("executed", body.executed);
+            row.u64("match_number", body.match_number);
+        } else if constexpr (std::is_same_v<T, OrderExecutedWithPrice>) {
+            row.u64("reference", body.reference);
+            row.u32("executed", body.executed);
+            row.u64("match_number", body.match_number);
+            row.flag("printable", body.printable);
+            row.price("price", body.price);
+        } else if constexpr (std::is_same_v<T, MarketParticipantPosition>) {
+            row.code("mpid", body.mpid);
+            row.stock("stock", body.stock);
+            row.flag("primary_market_maker", body.primary_market_maker);
+            row.category("market_maker_mode", body.market_maker_mode);
+            row.category("market_participant_state", body.market_participant_state);
+        } else if constexpr (std::is_same_v<T, RegShoRestriction>) {
+            row.stock("stock", body.stock);
+            row.category("action", body.action);
+        } else if constexpr (std::is_same_v<T, ReplaceOrder>) {
+            row.u64("old_reference", body.old_reference);
+            row.u64("new_reference", body.new_reference);
+            row.u32("shares", body.shares);
+            row.price("price", body.price);
+        } else if constexpr (std::is_same_v<T, StockDirectory>) {
+            row.stock("stock", body.stock);
+            row.category("market_category", body.market_category);
+            row.category("financial_status", body.financial_status);
+            row.u32("round_lot_size", body.round_lot_size);
+            row.flag("round_lots_only", body.round_lots_only);
+            row.category("issue_classification", body.issue_classification);
+            row.category("issue_subtype", body.issue_subtype);
+            row.flag("authenticity", body.authenticity);
+            row.flag("short_sale_threshold", body.short_sale_threshold);
+            row.flag("ipo_flag", body.ipo_flag);
+            row.category("luld_ref_price_tier", body.luld_ref_price_tier);
+            row.flag("etp_flag", body.etp_flag);
+            row.u32("etp_leverage_factor", body.etp_leverage_factor);
+            row.flag("inverse_indicator", body.inverse_indicator);
+        } else if constexpr (std::is_same_v<T, SystemEvent>) {
+            row.category("event", body.event);
+        } else if constexpr (std::is_same_v<T, TradingAction>) {
+            row.stock("stock", body.stock);
+            row.category("trading_state", body.trading_state);
+            row.code("reason", body.reason);
+        } else if constexpr (std::is_same_v<T, RetailPriceImprovementIndicator>) {
+            row.stock("stock", body.stock);
+            row.category("interest_flag", body.interest_flag);
+        }
+    }, message.body);
+    
+    messages_++;
+}
+
+void ColumnarWriter::finish() {
+    finished_ = true;
+    
+    nlohmann::json tables = nlohmann::json::object();
+    for (auto& table : tables_) {
+        if (!table) {
+            continue;
+        }
+        
+        nlohmann::json columns = nlohmann::json::array();
+        for (auto& column : table->columns) {
+            flush(*column);
+            column->file.close();
+            
+            nlohmann::json entry;
+            entry["name"] = column->name;
+            entry["type"] = column->type;
+            entry["file"] = column->path;
+            if (column->scale > 0) {
+                entry["scale"] = column->scale;
+            }
+            if (column->symbols) {
+                entry["dictionary"] = "symbols";
+            }
+            if (!column->categories.empty()) {
+                // Indexed by ordinal; values never seen are null
+                nlohmann::json categories = nlohmann::json::array();
+                for (const auto& [ordinal, name] : column->categories) {
+                    while (categories.size() < ordinal) {
+                        categories.push_back(nullptr);
+                    }
+                    categories.push_back(name);
+                }
+                entry["categories"] = categories;
+            }
+            columns.push_back(entry);
+        }
+        tables[table->name] = {{"rows", table->rows}, {"columns", columns}};
+    }
+    
+    nlohmann::json schema;
+    schema["format"] = "itch-columnar";
+    schema["version"] = 1;
+    schema["byte_order"] = "little";
+    schema["messages"] = messages_;
+    schema["symbols"] = symbols_.values;
+    schema["tables"] = tables;
+    
+    std::ofstream file(directory_ + "/schema.json");
+    if (!file) {
+        throw std::runtime_error("Cannot write " + directory_ + "/schema.json");
+    }
+    file << schema.dump(2) << std::endl;
+}
+
+} // namespace itch
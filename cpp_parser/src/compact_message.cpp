@@ -0,0 +1,96 @@
+#include "../include/compact_message.h"
+#include <variant>
+
+namespace itch {
+
+void CompactChunk::push_back(Message&& message) {
+    CompactMessage compact;
+    compact.timestamp = message.timestamp;
+    compact.stock_locate = message.stock_locate;
+    compact.tracking_number = message.tracking_number;
+    compact.tag = message.tag;
+    compact.flag = 0;
+
+    const bool inline_body = std::visit([&compact](const auto& body) {
+        using T = std::decay_t<decltype(body)>;
+        if constexpr (std::is_same_v<T, AddOrder>) {
+            if (body.mpid) {
+                return false;
+            }
+            compact.kind = CompactKind::AddOrder;
+            compact.flag = body.side == Side::Buy;
+            compact.add = {body.reference, body.shares, body.price.raw(), body.stock};
+        } else if constexpr (std::is_same_v<T, OrderExecuted>) {
+            compact.kind = CompactKind::OrderExecuted;
+            compact.executed = {body.reference, body.executed, 0, body.match_number};
+        } else if constexpr (std::is_same_v<T, OrderExecutedWithPrice>) {
+            compact.kind = CompactKind::OrderExecutedWithPrice;
+            compact.flag = body.printable;
+            compact.executed = {body.reference, body.executed, body.price.raw(), body.match_number};
+        } else if constexpr (std::is_same_v<T, OrderCancelled>) {
+            compact.kind = CompactKind::OrderCancelled;
+            compact.cancelled = {body.reference, body.cancelled};
+        } else if constexpr (std::is_same_v<T, DeleteOrder>) {
+            compact.kind = CompactKind::DeleteOrder;
+            compact.deleted = {body.reference};
+        } else if constexpr (std::is_same_v<T, ReplaceOrder>) {
+            compact.kind = CompactKind::ReplaceOrder;
+            compact.replace = {body.old_reference, body.new_reference, body.shares, body.price.raw()};
+        } else {
+            return false;
+        }
+        return true;
+    }, message.body);
+
+    if (!inline_body) {
+        compact.kind = CompactKind::OutOfLine;
+        compact.arena_index = static_cast<uint32_t>(arena_.size());
+        arena_.push_back(std::move(message));
+    }
+    messages_.push_back(compact);
+}
+
+Message CompactChunk::at(size_t index) const {
+    const CompactMessage& compact = messages_[index];
+    if (compact.kind == CompactKind::OutOfLine) {
+        return arena_[compact.arena_index];
+    }
+
+    Message message{compact.tag, compact.stock_locate, compact.tracking_number, compact.timestamp, MessageBody{}};
+    switch (compact.kind) {
+        case CompactKind::AddOrder: {
+            const auto& add = compact.add;
+            message.body = AddOrder{add.reference, compact.flag ? Side::Buy : Side::Sell, add.shares,
+                                    add.stock, Price4(add.price), std::nullopt};
+            break;
+        }
+        case CompactKind::OrderExecuted: {
+            const auto& executed = compact.executed;
+            message.body = OrderExecuted{executed.reference, executed.executed, executed.match_number};
+            break;
+        }
+        case CompactKind::OrderExecutedWithPrice: {
+            const auto& executed = compact.executed;
+            message.body = OrderExecutedWithPrice{executed.reference, executed.executed, executed.match_number,
+                                                  compact.flag != 0, Price4(executed.price)};
+            break;
+        }
+        case CompactKind::OrderCancelled:
+            message.body = OrderCancelled{compact.cancelled.reference, compact.cancelled.cancelled};
+            break;
+        case CompactKind::DeleteOrder:
+            message.body = DeleteOrder{compact.deleted.reference};
+            break;
+        case CompactKind::ReplaceOrder: {
+            const auto& replace = compact.replace;
+            message.body = ReplaceOrder{replace.old_reference, replace.new_reference, replace.shares,
+                                        Price4(replace.price)};
+            break;
+        }
+        case CompactKind::OutOfLine:
+            break;
+    }
+    return message;
+}
+
+} // namespace itch
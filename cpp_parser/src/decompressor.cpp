@@ -0,0 +1,264 @@
+#include "../include/decompressor.h"
+#include <fstream>
+#include <stdexcept>
+#include <zlib.h>
+#ifdef ITCH_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace itch {
+
+// Pulls decompressed bytes out of a compressed file
+class Decoder {
+public:
+    virtual ~Decoder() = default;
+
+    // Fill up to len bytes; returns fewer only at end of input. If the input
+    // is corrupt or truncated, sets error and returns the bytes decoded before it
+    virtual size_t read(char* dst, size_t len, std::string& error) = 0;
+};
+
+namespace {
+
+class GzipDecoder : public Decoder {
+public:
+    explicit GzipDecoder(const std::string& path) {
+        file_ = gzopen(path.c_str(), "rb");
+        if (!file_) {
+            throw std::runtime_error("Could not open gzipped file: " + path);
+        }
+        // A large input buffer keeps zlib's own reads off the hot path
+        gzbuffer(file_, 256 * 1024);
+    }
+
+    ~GzipDecoder() override {
+        gzclose(file_);
+    }
+
+    size_t read(char* dst, size_t len, std::string& error) override {
+        size_t total = 0;
+        while (total < len) {
+            const int n = gzread(file_, dst + total, static_cast<unsigned>(len - total));
+            if (n <= 0) {
+                // gzread also returns 0 when the file ends inside a deflate
+                // stream; only a clean end of input leaves no error behind
+                int errnum = 0;
+                const char* message = gzerror(file_, &errnum);
+                if (n < 0 || errnum != Z_OK) {
+                    error = std::string("Gzip decompression failed: ") + message;
+                }
+                break;
+            }
+            total += static_cast<size_t>(n);
+        }
+        return total;
+    }
+
+private:
+    gzFile file_ = nullptr;
+};
+
+#ifdef ITCH_HAVE_ZSTD
+class ZstdDecoder : public Decoder {
+public:
+    explicit ZstdDecoder(const std::string& path)
+        : file_(path, std::ios::binary), input_(ZSTD_DStreamInSize()) {
+        if (!file_.is_open()) {
+            throw std::runtime_error("Could not open zstd file: " + path);
+        }
+        stream_ = ZSTD_createDStream();
+        ZSTD_initDStream(stream_);
+    }
+
+    ~ZstdDecoder() override {
+        ZSTD_freeDStream(stream_);
+    }
+
+    size_t read(char* dst, size_t len, std::string& error) override {
+        ZSTD_outBuffer out = { dst, len, 0 };
+        while (out.pos < out.size) {
+            if (in_.pos == in_.size && !eof_) {
+                file_.read(input_.data(), input_.size());
+                const size_t n = static_cast<size_t>(file_.gcount());
+                if (n == 0) {
+                    eof_ = true;
+                } else {
+                    in_ = { input_.data(), n, 0 };
+                }
+            }
+            if (eof_ && remaining_ == 0) {
+                break; // Every frame ended and all of its output was handed out
+            }
+
+            // Past the end of the file zstd may still hold output, so keep
+            // calling with empty input until it reports the frame finished
+            const size_t before = out.pos;
+            remaining_ = ZSTD_decompressStream(stream_, &out, &in_);
+            if (ZSTD_isError(remaining_)) {
+                error = std::string("Zstd decompression failed: ") + ZSTD_getErrorName(remaining_);
+                break;
+            }
+            if (eof_ && remaining_ != 0 && out.pos == before) {
+                error = "Zstd decompression failed: file ends inside a frame";
+                break;
+            }
+        }
+        return out.pos;
+    }
+
+private:
+    std::ifstream file_;
+    std::vector<char> input_;
+    ZSTD_inBuffer in_ = { nullptr, 0, 0 };
+    ZSTD_DStream* stream_ = nullptr;
+    size_t remaining_ = 0; // Last ZSTD_decompressStream result; 0 at a frame boundary
+    bool eof_ = false;
+};
+#endif
+
+std::unique_ptr<Decoder> make_decoder(const std::string& path, Compression format) {
+    switch (format) {
+        case Compression::Gzip:
+            return std::make_unique<GzipDecoder>(path);
+        case Compression::Zstd:
+#ifdef ITCH_HAVE_ZSTD
+            return std::make_unique<ZstdDecoder>(path);
+#else
+            throw std::runtime_error("Zstd decompression not available - rebuild with libzstd");
+#endif
+    }
+    throw std::runtime_error("Unknown compression format");
+}
+
+} // namespace
+
+bool detect_compression(const std::string& path, Compression& format) {
+    std::ifstream file(path, std::ios::binary);
+    unsigned char magic[4] = { 0, 0, 0, 0 };
+    file.read(reinterpret_cast<char*>(magic), sizeof(magic));
+
+    if (file.gcount() >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+        format = Compression::Gzip;
+        return true;
+    }
+    if (file.gcount() == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+        format = Compression::Zstd;
+        return true;
+    }
+    return false;
+}
+
+DecompressingStreambuf::DecompressingStreambuf(const std::string& path, Compression format,
+                                               size_t block_size)
+    : decoder_(make_decoder(path, format)) {
+    for (auto& block : blocks_) {
+        block.data.resize(block_size);
+    }
+    worker_ = std::thread([this] { run(); });
+}
+
+DecompressingStreambuf::~DecompressingStreambuf() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    condition_.notify_all();
+    worker_.join();
+}
+
+void DecompressingStreambuf::run() {
+    size_t index = 0;
+
+    while (true) {
+        Block& block = blocks_[index];
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [&] { return !block.ready || stop_; });
+            if (stop_) {
+                return;
+            }
+        }
+
+        // The consumer never touches a block that isn't ready, so fill it unlocked
+        size_t size = 0;
+        std::string error;
+        try {
+            size = decoder_->read(block.data.data(), block.data.size(), error);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+
+        const bool last = !error.empty() || size < block.data.size();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            block.size = size;
+            block.last = last;
+            block.ready = true;
+            if (!error.empty()) {
+                error_ = error;
+            }
+        }
+        condition_.notify_all();
+
+        if (last) {
+            return;
+        }
+        index ^= 1;
+    }
+}
+
+DecompressingStreambuf::int_type DecompressingStreambuf::underflow() {
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    if (finished_) {
+        return traits_type::eof();
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // Hand the drained block back to the decompressor
+    if (current_) {
+        const bool last = current_->last;
+        current_->ready = false;
+        current_ = nullptr;
+        setg(nullptr, nullptr, nullptr);
+        condition_.notify_all();
+
+        if (last) {
+            finished_ = true;
+            if (!error_.empty()) {
+                throw std::runtime_error(error_);
+            }
+            return traits_type::eof();
+        }
+        consume_index_ ^= 1;
+    }
+
+    Block& block = blocks_[consume_index_];
+    condition_.wait(lock, [&] { return block.ready; });
+
+    // A failed block still carries what was decoded before the error; the
+    // error is raised once that has been read
+    current_ = &block;
+    if (block.size == 0) {
+        finished_ = true;
+        if (!error_.empty()) {
+            throw std::runtime_error(error_);
+        }
+        return traits_type::eof();
+    }
+
+    setg(block.data.data(), block.data.data(), block.data.data() + block.size);
+    return traits_type::to_int_type(*gptr());
+}
+
+DecompressingStream::DecompressingStream(const std::string& path, Compression format,
+                                         size_t block_size)
+    : std::istream(nullptr), buffer_(path, format, block_size) {
+    rdbuf(&buffer_);
+    // Surface decompression errors instead of a silently truncated stream
+    exceptions(std::ios::badbit);
+}
+
+} // namespace itch
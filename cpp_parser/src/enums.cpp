@@ -1,6 +1,7 @@
 #include "../include/enums.h"
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <algorithm>
 
 namespace itch {
@@ -93,7 +94,7 @@ IssueSubType parse_issue_subtype(const char* value) {
     throw std::runtime_error("Invalid issue subtype: " + val);
 }
 
-std::string to_string(EventCode code) {
+std::string_view to_string_view(EventCode code) {
     switch (code) {
         case EventCode::StartOfMessages: return "StartOfMessages";
         case EventCode::StartOfSystemHours: return "StartOfSystemHours";
@@ -105,7 +106,7 @@ std::string to_string(EventCode code) {
     }
 }
 
-std::string to_string(MarketCategory category) {
+std::string_view to_string_view(MarketCategory category) {
     switch (category) {
         case MarketCategory::NasdaqGlobalSelect: return "NasdaqGlobalSelect";
         case MarketCategory::NasdaqGlobalMarket: return "NasdaqGlobalMarket";
@@ -120,7 +121,7 @@ std::string to_string(MarketCategory category) {
     }
 }
 
-std::string to_string(FinancialStatus status) {
+std::string_view to_string_view(FinancialStatus status) {
     switch (status) {
         case FinancialStatus::Normal: return "Normal";
         case FinancialStatus::Deficient: return "Deficient";
@@ -137,7 +138,7 @@ std::string to_string(FinancialStatus status) {
     }
 }
 
-std::string to_string(IssueClassification classification) {
+std::string_view to_string_view(IssueClassification classification) {
     switch (classification) {
         case IssueClassification::AmericanDepositaryShare: return "AmericanDepositaryShare";
         case IssueClassification::Bond: return "Bond";
@@ -159,7 +160,7 @@ std::string to_string(IssueClassification classification) {
     }
 }
 
-std::string to_string(IssueSubType subtype) {
+std::string_view to_string_view(IssueSubType subtype) {
     switch (subtype) {
         case IssueSubType::PreferredTrustSecurities: return "PreferredTrustSecurities";
         case IssueSubType::AlphaIndexETNs: return "AlphaIndexETNs";
@@ -223,7 +224,7 @@ std::string to_string(IssueSubType subtype) {
     }
 }
 
-std::string to_string(LuldRefPriceTier tier) {
+std::string_view to_string_view(LuldRefPriceTier tier) {
     switch (tier) {
         case LuldRefPriceTier::Tier1: return "Tier1";
         case LuldRefPriceTier::Tier2: return "Tier2";
@@ -232,7 +233,7 @@ std::string to_string(LuldRefPriceTier tier) {
     }
 }
 
-std::string to_string(MarketMakerMode mode) {
+std::string_view to_string_view(MarketMakerMode mode) {
     switch (mode) {
         case MarketMakerMode::Normal: return "Normal";
         case MarketMakerMode::Passive: return "Passive";
@@ -243,7 +244,7 @@ std::string to_string(MarketMakerMode mode) {
     }
 }
 
-std::string to_string(MarketParticipantState state) {
+std::string_view to_string_view(MarketParticipantState state) {
     switch (state) {
         case MarketParticipantState::Active: return "Active";
         case MarketParticipantState::Excused: return "Excused";
@@ -254,7 +255,7 @@ std::string to_string(MarketParticipantState state) {
     }
 }
 
-std::string to_string(RegShoAction action) {
+std::string_view to_string_view(RegShoAction action) {
     switch (action) {
         case RegShoAction::None: return "None";
         case RegShoAction::Intraday: return "Intraday";
@@ -263,7 +264,7 @@ std::string to_string(RegShoAction action) {
     }
 }
 
-std::string to_string(TradingState state) {
+std::string_view to_string_view(TradingState state) {
     switch (state) {
         case TradingState::Halted: return "Halted";
         case TradingState::Paused: return "Paused";
@@ -273,7 +274,7 @@ std::string to_string(TradingState state) {
     }
 }
 
-std::string to_string(Side side) {
+std::string_view to_string_view(Side side) {
     switch (side) {
         case Side::Buy: return "Buy";
         case Side::Sell: return "Sell";
@@ -281,7 +282,7 @@ std::string to_string(Side side) {
     }
 }
 
-std::string to_string(ImbalanceDirection direction) {
+std::string_view to_string_view(ImbalanceDirection direction) {
     switch (direction) {
         case ImbalanceDirection::Buy: return "Buy";
         case ImbalanceDirection::Sell: return "Sell";
@@ -291,7 +292,7 @@ std::string to_string(ImbalanceDirection direction) {
     }
 }
 
-std::string to_string(CrossType type) {
+std::string_view to_string_view(CrossType type) {
     switch (type) {
         case CrossType::Opening: return "Opening";
         case CrossType::Closing: return "Closing";
@@ -302,7 +303,7 @@ std::string to_string(CrossType type) {
     }
 }
 
-std::string to_string(IpoReleaseQualifier qualifier) {
+std::string_view to_string_view(IpoReleaseQualifier qualifier) {
     switch (qualifier) {
         case IpoReleaseQualifier::Anticipated: return "Anticipated";
         case IpoReleaseQualifier::Cancelled: return "Cancelled";
@@ -310,7 +311,7 @@ std::string to_string(IpoReleaseQualifier qualifier) {
     }
 }
 
-std::string to_string(LevelBreached level) {
+std::string_view to_string_view(LevelBreached level) {
     switch (level) {
         case LevelBreached::L1: return "L1";
         case LevelBreached::L2: return "L2";
@@ -319,7 +320,7 @@ std::string to_string(LevelBreached level) {
     }
 }
 
-std::string to_string(InterestFlag flag) {
+std::string_view to_string_view(InterestFlag flag) {
     switch (flag) {
         case InterestFlag::RPIAvailableBuySide: return "RPIAvailableBuySide";
         case InterestFlag::RPIAvailableSellSide: return "RPIAvailableSellSide";
@@ -329,6 +330,70 @@ std::string to_string(InterestFlag flag) {
     }
 }
 
+std::string to_string(EventCode code) {
+    return std::string(to_string_view(code));
+}
+
+std::string to_string(MarketCategory category) {
+    return std::string(to_string_view(category));
+}
+
+std::string to_string(FinancialStatus status) {
+    return std::string(to_string_view(status));
+}
+
+std::string to_string(IssueClassification classification) {
+    return std::string(to_string_view(classification));
+}
+
+std::string to_string(IssueSubType subtype) {
+    return std::string(to_string_view(subtype));
+}
+
+std::string to_string(LuldRefPriceTier tier) {
+    return std::string(to_string_view(tier));
+}
+
+std::string to_string(MarketMakerMode mode) {
+    return std::string(to_string_view(mode));
+}
+
+std::string to_string(MarketParticipantState state) {
+    return std::string(to_string_view(state));
+}
+
+std::string to_string(RegShoAction action) {
+    return std::string(to_string_view(action));
+}
+
+std::string to_string(TradingState state) {
+    return std::string(to_string_view(state));
+}
+
+std::string to_string(Side side) {
+    return std::string(to_string_view(side));
+}
+
+std::string to_string(ImbalanceDirection direction) {
+    return std::string(to_string_view(direction));
+}
+
+std::string to_string(CrossType type) {
+    return std::string(to_string_view(type));
+}
+
+std::string to_string(IpoReleaseQualifier qualifier) {
+    return std::string(to_string_view(qualifier));
+}
+
+std::string to_string(LevelBreached level) {
+    return std::string(to_string_view(level));
+}
+
+std::string to_string(InterestFlag flag) {
+    return std::string(to_string_view(flag));
+}
+
 std::string array_to_string(const ArrayString4& arr, bool preserve_spaces) {
     std::string result(arr.begin(), arr.end());
     
@@ -0,0 +1,337 @@
+#include "../include/json_writer.h"
+#include <charconv>
+#include <variant>
+
+namespace itch {
+
+// Keys are written in the sorted order nlohmann::json's object map gives them,
+// so the output matches JsonSerializer::to_json(message).dump() exactly.
+
+void JsonWriter::write(const Message& message) {
+    buffer_ += "{\"body\":{";
+    std::visit([this](const auto& fields) { body(fields); }, message.body);
+    buffer_ += "},\"stock_locate\":";
+    number(message.stock_locate);
+    buffer_ += ",\"tag\":";
+    number(message.tag);
+    buffer_ += ",\"timestamp\":";
+    number(message.timestamp);
+    buffer_ += ",\"tracking_number\":";
+    number(message.tracking_number);
+    buffer_ += '}';
+}
+
+void JsonWriter::body(const AddOrder& order) {
+    buffer_ += "\"AddOrder\":{";
+    if (order.mpid) {
+        buffer_ += "\"mpid\":";
+        string(order.mpid.value());
+        buffer_ += ',';
+    }
+    buffer_ += "\"price\":";
+    price(order.price);
+    buffer_ += ",\"reference\":";
+    number(order.reference);
+    buffer_ += ",\"shares\":";
+    number(order.shares);
+    buffer_ += ",\"side\":";
+    name(to_string_view(order.side));
+    buffer_ += ",\"stock\":";
+    string(order.stock);
+    buffer_ += '}';
+}
+
+void JsonWriter::body(LevelBreached level) {
+    buffer_ += "\"Breach\":";
+    name(to_string_view(level));
+}
+
+void JsonWriter::body(const BrokenTrade& trade) {
+    buffer_ += "\"BrokenTrade\":{\"match_number\":";
+    number(trade.match_number);
+    buffer_ += '}';
+}
+
+void JsonWriter::body(const CrossTrade& trade) {
+    buffer_ += "\"CrossTrade\":{\"cross_price\":";
+    price(trade.cross_price);
+    buffer_ += ",\"cross_type\":";
+    name(to_string_view(trade.cross_type));
+    buffer_ += ",\"match_number\":";
+    number(trade.match_number);
+    buffer_ += ",\"shares\":";
+    number(trade.shares);
+    buffer_ += ",\"stock\":";
+    string(trade.stock);
+    buffer_ += '}';
+}
+
+void JsonWriter::body(const DeleteOrder& order) {
+    buffer_ += "\"DeleteOrder\":{\"reference\":";
+    number(order.reference);
+    buffer_ += '}';
+}
+
+void JsonWriter::body(const ImbalanceIndicator& indicator) {
+    buffer_ += "\"Imbalance\":{\"cross_type\":";
+    name(to_string_view(indicator.cross_type));
+    buffer_ += ",\"current_ref_price\":";
+    price(indicator.current_ref_price);
+    buffer_ += ",\"far_price\":";
+    price(indicator.far_price);
+    buffer_ += ",\"imbalance_direction\":";
+    name(to_string_view(indicator.imbalance_direction));
+    buffer_ += ",\"imbalance_shares\":";
+    number(indicator.imbalance_shares);
+    buffer_ += ",\"near_price\":";
+    price(indicator.near_price);
+    buffer_ += ",\"paired_shares\":";
+    number(indicator.paired_shares);
+    buffer_ += ",\"price_variation_indicator\":";
+    string(std::string_view(&indicator.price_variation_indicator, 1));
+    buffer_ += ",\"stock\":";
+    string(indicator.stock);
+    buffer_ += '}';
+}
+
+void JsonWriter::body(const IpoQuotingPeriod& period) {
+    buffer_ += "\"IpoQuotingPeriod\":{\"price\":";
+    price(period.price);
+    buffer_ += ",\"release_qualifier\":";
+    name(to_string_view(period.release_qualifier));
+    buffer_ += ",\"release_time\":";
+    number(period.release_time);
+    buffer_ += ",\"stock\":";
+    string(period.stock);
+    buffer_ += '}';
+}
+
+void JsonWriter::body(const LULDAuctionCollar& collar) {
+    buffer_ += "\"LULDAuctionCollar\":{\"extension\":";
+    number(collar.extension);
+    buffer_ += ",\"lower_price\":";
+    price(collar.lower_price);
+    buffer_ += ",\"ref_price\":";
+    price(collar.ref_price);
+    buffer_ += ",\"stock\":";
+    string(collar.stock);
+    buffer_ += ",\"upper_price\":";
+    price(collar.upper_price);
+    buffer_ += '}';
+}
+
+void JsonWriter::body(const MwcbDeclineLevel& level) {
+    buffer_ += "\"MwcbDeclineLevel\":{\"level1\":";
+    price(level.level1);
+    buffer_ += ",\"level2\":";
+    price(level.level2);
+    buffer_ += ",\"level3\":";
+    price(level.level3);
+    buffer_ += '}';
+}
+
+void JsonWriter::body(const NonCrossTrade& trade) {
+    buffer_ += "\"NonCrossTrade\":{\"match_number\":";
+    number(trade.match_number);
+    buffer_ += ",\"price\":";
+    price(trade.price);
+    buffer_ += ",\"reference\":";
+    number(trade.reference);
+    buffer_ += ",\"shares\":";
+    number(trade.shares);
+    buffer_ += ",\"side\":";
+    name(to_string_view(trade.side));
+    buffer_ += ",\"stock\":";
+    string(trade.stock);
+    buffer_ += '}';
+}
+
+void JsonWriter::body(const OrderCancelled& order) {
+    buffer_ += "\"OrderCancelled\":{\"cancelled\":";
+    number(order.cancelled);
+    buffer_ += ",\"reference\":";
+    number(order.reference);
+    buffer_ += '}';
+}
+
+void JsonWriter::body(const OrderExecuted& order) {
+    buffer_ += "\"OrderExecuted\":{\"executed\":";
+    number(order.executed);
+    buffer_ += ",\"match_number\":";
+    number(order.match_number);
+    buffer_ += ",\"reference\":";
+    number(order.reference);
+    buffer_ += '}';
+}
+
+void JsonWriter::body(const OrderExecutedWithPrice& order) {
+    buffer_ += "\"OrderExecutedWithPrice\":{\"executed\":";
+    number(order.executed);
+    buffer_ += ",\"match_number\":";
+    number(order.match_number);
+    buffer_ += ",\"price\":";
+    price(order.price);
+    buffer_ += ",\"printable\":";
+    boolean(order.printable);
+    buffer_ += ",\"reference\":";
+    number(order.reference);
+    buffer_ += '}';
+}
+
+void JsonWriter::body(const MarketParticipantPosition& position) {
+    buffer_ += "\"ParticipantPosition\":{\"market_maker_mode\":";
+    name(to_string_view(position.market_maker_mode));
+    buffer_ += ",\"market_participant_state\":";
+    name(to_string_view(position.market_participant_state));
+    buffer_ += ",\"mpid\":";
+    string(position.mpid);
+    buffer_ += ",\"primary_market_maker\":";
+    boolean(position.primary_market_maker);
+    buffer_ += ",\"stock\":";
+    string(position.stock);
+    buffer_ += '}';
+}
+
+void JsonWriter::body(const RegShoRestriction& restriction) {
+    buffer_ += "\"RegShoRestriction\":{\"action\":";
+    name(to_string_view(restriction.action));
+    buffer_ += ",\"stock\":";
+    string(restriction.stock);
+    buffer_ += '}';
+}
+
+void JsonWriter::body(const ReplaceOrder& order) {
+    buffer_ += "\"ReplaceOrder\":{\"new_reference\":";
+    number(order.new_reference);
+    buffer_ += ",\"old_reference\":";
+    number(order.old_reference);
+    buffer_ += ",\"price\":";
+    price(order.price);
+    buffer_ += ",\"shares\":";
+    number(order.shares);
+    buffer_ += '}';
+}
+
+void JsonWriter::body(const StockDirectory& directory) {
+    buffer_ += "\"StockDirectory\":{\"authenticity\":";
+    boolean(directory.authenticity);
+    // An absent ETP flag is written as false, the other optional flags as null
+    buffer_ += ",\"etp_flag\":";
+    boolean(directory.etp_flag.value_or(false));
+    buffer_ += ",\"etp_leverage_factor\":";
+    number(directory.etp_leverage_factor);
+    buffer_ += ",\"financial_status\":";
+    name(to_string_view(directory.financial_status));
+    buffer_ += ",\"inverse_indicator\":";
+    boolean(directory.inverse_indicator);
+    buffer_ += ",\"ipo_flag\":";
+    if (directory.ipo_flag) {
+        boolean(directory.ipo_flag.value());
+    } else {
+        buffer_ += "null";
+    }
+    buffer_ += ",\"issue_classification\":";
+    name(to_string_view(directory.issue_classification));
+    buffer_ += ",\"issue_subtype\":";
+    name(to_string_view(directory.issue_subtype));
+    buffer_ += ",\"luld_ref_price_tier\":";
+    name(to_string_view(directory.luld_ref_price_tier));
+    buffer_ += ",\"market_category\":";
+    name(to_string_view(directory.market_category));
+    buffer_ += ",\"round_lot_size\":";
+    number(directory.round_lot_size);
+    buffer_ += ",\"round_lots_only\":";
+    boolean(directory.round_lots_only);
+    buffer_ += ",\"short_sale_threshold\":";
+    if (directory.short_sale_threshold) {
+        boolean(directory.short_sale_threshold.value());
+    } else {
+        buffer_ += "null";
+    }
+    buffer_ += ",\"stock\":";
+    string(directory.stock);
+    buffer_ += '}';
+}
+
+void JsonWriter::body(const SystemEvent& event) {
+    buffer_ += "\"SystemEvent\":{\"event\":";
+    name(to_string_view(event.event));
+    buffer_ += '}';
+}
+
+void JsonWriter::body(const TradingAction& action) {
+    buffer_ += "\"TradingAction\":{\"reason\":";
+    string(action.reason);
+    buffer_ += ",\"stock\":";
+    string(action.stock);
+    buffer_ += ",\"trading_state\":";
+    name(to_string_view(action.trading_state));
+    buffer_ += '}';
+}
+
+void JsonWriter::body(const RetailPriceImprovementIndicator& indicator) {
+    buffer_ += "\"RetailPriceImprovementIndicator\":{\"interest_flag\":";
+    name(to_string_view(indicator.interest_flag));
+    buffer_ += ",\"stock\":";
+    string(indicator.stock);
+    buffer_ += '}';
+}
+
+void JsonWriter::number(uint64_t value) {
+    char text[20];
+    auto result = std::to_chars(text, text + sizeof(text), value);
+    buffer_.append(text, result.ptr);
+}
+
+void JsonWriter::boolean(bool value) {
+    buffer_ += value ? "true" : "false";
+}
+
+void JsonWriter::price(const Price4& price) {
+    char text[Price4::MAX_CHARS + 2];
+    text[0] = '"';
+    char* end = price.format(text + 1);
+    *end++ = '"';
+    buffer_.append(text, end);
+}
+
+void JsonWriter::price(const Price8& price) {
+    char text[Price8::MAX_CHARS + 2];
+    text[0] = '"';
+    char* end = price.format(text + 1);
+    *end++ = '"';
+    buffer_.append(text, end);
+}
+
+void JsonWriter::string(std::string_view text) {
+    buffer_ += '"';
+    for (char c : text) {
+        switch (c) {
+            case '"': buffer_ += "\\\""; break;
+            case '\\': buffer_ += "\\\\"; break;
+            case '\b': buffer_ += "\\b"; break;
+            case '\f': buffer_ += "\\f"; break;
+            case '\n': buffer_ += "\\n"; break;
+            case '\r': buffer_ += "\\r"; break;
+            case '\t': buffer_ += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    // Other control characters (NUL padding included) as \u00XX
+                    static constexpr char HEX[] = "0123456789abcdef";
+                    const char escape[] = {'\\', 'u', '0', '0', HEX[(c >> 4) & 0xF], HEX[c & 0xF]};
+                    buffer_.append(escape, sizeof(escape));
+                } else {
+                    buffer_ += c;
+                }
+        }
+    }
+    buffer_ += '"';
+}
+
+void JsonWriter::name(std::string_view text) {
+    buffer_ += '"';
+    buffer_ += text;
+    buffer_ += '"';
+}
+
+} // namespace itch
@@ -1,5 +1,8 @@
 #include "../include/parser.h"
-#include "../include/json_serializer.h"
+#include "../include/decompressor.h"
+#include "../include/sharded_decoder.h"
+#include "../include/json_writer.h"
+#include "../include/columnar_writer.h"
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -9,6 +12,7 @@
 #include <memory>
 #include <variant>
 #include <iomanip>
+#include <filesystem>
 #include <sys/resource.h>
 
 namespace fs = std::filesystem;
@@ -32,22 +36,29 @@ struct CliConfig {
     size_t message_limit = 0; // 0 means unlimited
     bool output_to_stdout = false;
     bool show_stats = false;
+    bool use_mmap = false;
+    size_t decode_threads = 0; // 0 means decode on the main thread
+    bool columnar = false;     // Per-message-type column files instead of JSON
 };
 
 void print_usage(const std::string& program_name) {
     std::cout << "Usage: " << program_name << " [options] <path-to-itch-file>" << std::endl;
-    std::cout << "Parses NASDAQ ITCH 5.0 file and outputs JSON." << std::endl;
+    std::cout << "Parses NASDAQ ITCH 5.0 file and outputs JSON or columnar binary files." << std::endl;
     std::cout << "\nOptions:" << std::endl;
     std::cout << "  -h, --help       Show this help message" << std::endl;
-    std::cout << "  -o <file>        Output to specified file (default: <input-file>.json)" << std::endl;
+    std::cout << "  -o <file>        Output to specified file (default: <input-file>.json, or <input-file>.columns for -f columnar)" << std::endl;
+    std::cout << "  -f <format>      Output format: json (default) or columnar (one directory of column files per message type)" << std::endl;
     std::cout << "  -l <number>      Limit number of messages to process (default: all)" << std::endl;
     std::cout << "  -d               Enable debug mode with verbose output" << std::endl;
     std::cout << "  -s               Show statistics after parsing" << std::endl;
     std::cout << "  -c               Output to stdout instead of file" << std::endl;
+    std::cout << "  -m               Memory-map the input file instead of reading it through a stream" << std::endl;
+    std::cout << "  -j <threads>     Decode in parallel by splitting the mapped file at message boundaries" << std::endl;
     std::cout << "\nExamples:" << std::endl;
     std::cout << "  " << program_name << " data.itch              # Basic usage" << std::endl;
     std::cout << "  " << program_name << " -l 2000000 data.itch   # Process 2M messages" << std::endl;
     std::cout << "  " << program_name << " -o output.json data.itch # Custom output file" << std::endl;
+    std::cout << "  " << program_name << " -f columnar data.itch  # Columnar output in data.itch.columns/" << std::endl;
 }
 
 CliConfig parse_arguments(int argc, char** argv) {
@@ -74,6 +85,23 @@ CliConfig parse_arguments(int argc, char** argv) {
             config.show_stats = true;
         } else if (arg == "-c") {
             config.output_to_stdout = true;
+        } else if (arg == "-m") {
+            config.use_mmap = true;
+        } else if (arg == "-f" && i < argc) {
+            std::string format = argv[i++];
+            if (format == "columnar") {
+                config.columnar = true;
+            } else if (format != "json") {
+                std::cerr << "Error: Unknown output format: " << format << " (expected json or columnar)" << std::endl;
+                exit(1);
+            }
+        } else if (arg == "-j" && i < argc) {
+            try {
+                config.decode_threads = std::stoull(argv[i++]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Invalid thread count. Must be a positive number." << std::endl;
+                exit(1);
+            }
         } else if (arg[0] == '-') {
             std::cerr << "Unknown option: " << arg << std::endl;
             print_usage(argv[0]);
@@ -91,9 +119,14 @@ CliConfig parse_arguments(int argc, char** argv) {
         exit(1);
     }
     
-    // If no output path was specified, use input path + .json
+    if (config.columnar && config.output_to_stdout) {
+        std::cerr << "Error: Columnar output is a directory and cannot go to stdout." << std::endl;
+        exit(1);
+    }
+    
+    // If no output path was specified, use input path + .json (or .columns)
     if (config.output_path.empty()) {
-        config.output_path = config.input_path + ".json";
+        config.output_path = config.input_path + (config.columnar ? ".columns" : ".json");
     }
     
     return config;
@@ -108,33 +141,41 @@ int main(int argc, char** argv) {
             std::cout << "*** Message limit: " << (config.message_limit > 0 ? std::to_string(config.message_limit) : "No limit") << " ***" << std::endl;
         }
         
-        // Create the parser
+        // Create the parser (or the sharded decoder with -j)
         std::unique_ptr<itch::Parser> parser;
+        std::unique_ptr<itch::ShardedDecoder> decoder;
         
-        // Check if the file is gzipped
+        // Check that the file exists before detecting its format
         std::ifstream file(config.input_path, std::ios::binary);
         if (!file) {
             std::cerr << "Cannot open file: " << config.input_path << std::endl;
             return 1;
         }
+        file.close();
         
         if (config.debug_mode) {
             std::cout << "Opening file: " << config.input_path << std::endl;
         }
         
-        char header[2];
-        file.read(header, 2);
-        file.close();
-        
-        const bool is_gzipped = (header[0] == 0x1f && header[1] == 0x8b);
+        itch::Compression compression;
+        const bool is_compressed = itch::detect_compression(config.input_path, compression);
         
         try {
-            if (is_gzipped) {
+            if (is_compressed && compression == itch::Compression::Gzip) {
                 std::cout << "Detected gzipped file. Processing..." << std::endl;
                 parser = itch::Parser::from_gzip(config.input_path);
+            } else if (is_compressed) {
+                std::cout << "Detected zstd file. Processing..." << std::endl;
+                parser = itch::Parser::from_zstd(config.input_path);
+            } else if (config.decode_threads > 0) {
+                std::cout << "Processing raw ITCH file (sharded decode, " << config.decode_threads << " threads)..." << std::endl;
+                decoder = std::make_unique<itch::ShardedDecoder>(
+                    std::make_shared<const itch::MappedFile>(config.input_path),
+                    config.decode_threads, config.message_limit);
             } else {
-                std::cout << "Processing raw ITCH file..." << std::endl;
-                parser = itch::Parser::from_file(config.input_path);
+                std::cout << "Processing raw ITCH file" << (config.use_mmap ? " (memory-mapped)" : "") << "..." << std::endl;
+                parser = itch::Parser::open(config.input_path,
+                    config.use_mmap ? itch::InputBackend::Mmap : itch::InputBackend::Stream);
             }
             
             if (config.debug_mode) {
@@ -145,11 +186,14 @@ int main(int argc, char** argv) {
             return 1;
         }
         
-        // Prepare output stream (file or stdout)
+        // Prepare output stream (file or stdout), or the column writer
         std::ofstream output_file;
         std::ostream* output_stream = nullptr;
+        std::unique_ptr<itch::ColumnarWriter> columns;
         
-        if (config.output_to_stdout) {
+        if (config.columnar) {
+            columns = std::make_unique<itch::ColumnarWriter>(config.output_path);
+        } else if (config.output_to_stdout) {
             output_stream = &std::cout;
         } else {
             output_file.open(config.output_path, std::ios::binary);
@@ -165,7 +209,9 @@ int main(int argc, char** argv) {
         }
         
         // Write JSON array start
-        *output_stream << "[";
+        if (output_stream) {
+            *output_stream << "[";
+        }
         
         // Set up message counters for statistics
         std::map<uint8_t, size_t> message_type_counts;
@@ -174,29 +220,45 @@ int main(int argc, char** argv) {
         auto start_time = std::chrono::high_resolution_clock::now();
         size_t start_memory = get_memory_usage();
         
-        while (auto message = parser->parse_message()) {
-            if (!first_message) {
-                *output_stream << ",\n";
-            } else {
+        // JSON text is built in one reused buffer and written out in large chunks
+        constexpr size_t JSON_FLUSH_SIZE = 1 << 20;
+        itch::JsonWriter json_writer;
+        auto flush_json = [&]() {
+            output_stream->write(json_writer.view().data(), json_writer.size());
+            json_writer.clear();
+        };
+        
+        // Write one message; returns false once the message limit is reached
+        auto write_message = [&](const itch::Message& message) {
+            if (first_message) {
                 first_message = false;
                 if (config.debug_mode) {
                     std::cout << "First message parsed successfully." << std::endl;
                 }
+            } else if (output_stream) {
+                json_writer.append(",\n");
             }
             
-            // Convert to JSON and write to output
-            nlohmann::json json_message = itch::JsonSerializer::to_json(*message);
-            std::string json_str = json_message.dump();
-            *output_stream << json_str;
+            if (columns) {
+                // Append the fields to the message type's column files
+                columns->write(message);
+            } else {
+                // Convert to JSON and write to output
+                const size_t start = json_writer.size();
+                json_writer.write(message);
+                
+                if (config.debug_mode && message_count < 5) {
+                    // Print first few messages for debugging
+                    std::cout << "Message " << (message_count + 1) << ": " << json_writer.view().substr(start) << std::endl;
+                }
+                if (json_writer.size() >= JSON_FLUSH_SIZE) {
+                    flush_json();
+                }
+            }
             
             // Update message counters
             message_count++;
-            message_type_counts[message->tag]++;
-            
-            if (config.debug_mode && message_count <= 5) {
-                // Print first few messages for debugging
-                std::cout << "Message " << message_count << ": " << json_str << std::endl;
-            }
+            message_type_counts[message.tag]++;
             
             // Print progress (less frequently for large datasets)
             size_t progress_interval = config.message_limit > 1000000 ? 100000 : 10000;
@@ -207,7 +269,27 @@ int main(int argc, char** argv) {
             // Stop if we've reached the message limit
             if (config.message_limit > 0 && message_count >= config.message_limit) {
                 std::cout << "Reached message limit of " << config.message_limit << ". Stopping." << std::endl;
-                break;
+                return false;
+            }
+            return true;
+        };
+        
+        if (decoder) {
+            itch::CompactChunk chunk;
+            bool more = true;
+            while (more && decoder->next_chunk(chunk)) {
+                for (size_t i = 0; i < chunk.size(); ++i) {
+                    if (!write_message(chunk.at(i))) {
+                        more = false;
+                        break;
+                    }
+                }
+            }
+        } else {
+            while (auto message = parser->parse_message()) {
+                if (!write_message(*message)) {
+                    break;
+                }
             }
         }
         
@@ -216,10 +298,17 @@ int main(int argc, char** argv) {
         size_t end_memory = get_memory_usage();
         size_t memory_used = end_memory - start_memory;
         
-        // Write JSON array end
-        *output_stream << "]";
+        // Write JSON array end, or the schema for the column files
+        if (columns) {
+            columns->finish();
+            std::cout << "Column data: " << std::fixed << std::setprecision(2)
+                      << (columns->bytes_written() / (1024.0 * 1024.0)) << " MB" << std::endl;
+        } else {
+            flush_json();
+            *output_stream << "]";
+        }
         
-        if (!config.output_to_stdout) {
+        if (output_file.is_open()) {
             output_file.close();
         }
         
@@ -0,0 +1,49 @@
+#include "../include/mapped_file.h"
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace itch {
+
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open file: " + path);
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Could not stat file: " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+
+    // mmap rejects zero-length mappings; an empty file simply has no messages
+    if (size_ > 0) {
+        void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("Could not memory-map file: " + path);
+        }
+        data_ = static_cast<const uint8_t*>(addr);
+
+        // Hints only, failures are harmless
+        ::madvise(addr, size_, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+        ::madvise(addr, size_, MADV_HUGEPAGE);
+#endif
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        ::munmap(const_cast<uint8_t*>(data_), size_);
+    }
+}
+
+} // namespace itch
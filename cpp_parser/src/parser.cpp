@@ -1,18 +1,68 @@
 #include "../include/parser.h"
+#include "../include/decompressor.h"
 #include <fstream>
 #include <iostream>
 #include <cstring>
 #include <stdexcept>
-#include <zlib.h>
+#include <algorithm>
 
 namespace itch {
 
+size_t message_size(uint8_t message_type) {
+    switch (message_type) {
+        case 'S': return 12;
+        case 'R': return 39;
+        case 'H': return 25;
+        case 'Y': return 20;
+        case 'L': return 26;
+        case 'V': return 35;
+        case 'W': return 12;
+        case 'K': return 28;
+        case 'J': return 35;
+        case 'A': return 36;
+        case 'F': return 40;
+        case 'E': return 31;
+        case 'C': return 36;
+        case 'X': return 23;
+        case 'D': return 19;
+        case 'U': return 35;
+        case 'P': return 44;
+        case 'Q': return 40;
+        case 'B': return 19;
+        case 'I': return 50;
+        case 'N': return 20;
+        default: return 0;
+    }
+}
+
 Parser::Parser(std::unique_ptr<std::istream> stream)
-    : stream(std::move(stream)), buffer(BUFFER_SIZE) {
+    : buffer(BUFFER_SIZE), stream(std::move(stream)) {
+    data = buffer.data();
+    
     // Initialize the buffer
     fetch_more_bytes();
 }
 
+Parser::Parser(std::shared_ptr<const MappedFile> mapping)
+    : mapping(std::move(mapping)) {
+    // The whole file is already "read"
+    data = this->mapping->data();
+    bytes_read = this->mapping->size();
+    is_end_of_stream = true;
+}
+
+Parser::Parser(std::shared_ptr<const MappedFile> mapping, size_t begin, size_t end)
+    : mapping(std::move(mapping)) {
+    if (begin > end || end > this->mapping->size()) {
+        throw std::runtime_error("Invalid byte range for parser");
+    }
+    // Same as the whole-file case, just offset into the mapping
+    data = this->mapping->data() + begin;
+    bytes_read = end - begin;
+    consumed = begin;
+    is_end_of_stream = true;
+}
+
 std::unique_ptr<Parser> Parser::from_file(const std::string& path) {
     auto file_stream = std::make_unique<std::ifstream>(path, std::ios::binary);
     if (!file_stream->is_open()) {
@@ -21,15 +71,30 @@ std::unique_ptr<Parser> Parser::from_file(const std::string& path) {
     return std::make_unique<Parser>(std::move(file_stream));
 }
 
-std::unique_ptr<Parser> Parser::from_gzip(const std::string& path) {
-    // Open the gzipped file
-    auto file = std::make_unique<std::ifstream>(path, std::ios::binary);
-    if (!file->is_open()) {
-        throw std::runtime_error("Could not open gzipped file: " + path);
+std::unique_ptr<Parser> Parser::from_mmap(const std::string& path) {
+    return std::make_unique<Parser>(std::make_shared<const MappedFile>(path));
+}
+
+std::unique_ptr<Parser> Parser::open(const std::string& path, InputBackend backend) {
+    // Compressed files can't be mapped, always stream them through the decompressor
+    Compression format;
+    if (detect_compression(path, format)) {
+        return format == Compression::Zstd ? from_zstd(path) : from_gzip(path);
     }
     
-    // Gzip decompression not implemented in current version
-    throw std::runtime_error("Gzip decompression not available - please use uncompressed ITCH files");
+    switch (backend) {
+        case InputBackend::Mmap: return from_mmap(path);
+        case InputBackend::Stream: break;
+    }
+    return from_file(path);
+}
+
+std::unique_ptr<Parser> Parser::from_gzip(const std::string& path) {
+    return std::make_unique<Parser>(std::make_unique<DecompressingStream>(path, Compression::Gzip));
+}
+
+std::unique_ptr<Parser> Parser::from_zstd(const std::string& path) {
+    return std::make_unique<Parser>(std::make_unique<DecompressingStream>(path, Compression::Zstd));
 }
 
 bool Parser::eof() const {
@@ -38,7 +103,14 @@ bool Parser::eof() const {
 
 void Parser::reset() {
     current_pos = 0;
+    
+    if (mapping) {
+        // Nothing to re-read, just rewind
+        return;
+    }
+    
     bytes_read = 0;
+    consumed = 0;
     is_end_of_stream = false;
     
     if (stream) {
@@ -60,6 +132,7 @@ bool Parser::fetch_more_bytes() {
         if (remaining > 0) {
             std::memcpy(buffer.data(), buffer.data() + current_pos, remaining);
         }
+        consumed += current_pos;
         bytes_read = remaining;
         current_pos = 0;
     }
@@ -79,94 +152,102 @@ bool Parser::fetch_more_bytes() {
     return bytes_read > current_pos;
 }
 
-uint8_t Parser::read_u8() {
-    if (current_pos + sizeof(uint8_t) > bytes_read) {
-        if (!fetch_more_bytes() || current_pos + sizeof(uint8_t) > bytes_read) {
-            throw std::runtime_error("Unexpected end of stream while reading uint8");
+void Parser::seek(uint64_t target) {
+    if (mapping) {
+        if (target < consumed || target - consumed > bytes_read) {
+            throw std::runtime_error("Seek outside the mapped input: " + std::to_string(target));
         }
+        current_pos = static_cast<size_t>(target - consumed);
+        return;
     }
     
-    uint8_t value = buffer[current_pos];
+    // Plain files can be repositioned directly
+    stream->clear();
+    if (stream->seekg(static_cast<std::streamoff>(target), std::ios::beg)) {
+        consumed = target;
+        current_pos = 0;
+        bytes_read = 0;
+        is_end_of_stream = false;
+        fetch_more_bytes();
+        return;
+    }
+    
+    // Decompressing streams only read forward, so skip the bytes in between
+    stream->clear();
+    if (target < offset()) {
+        throw std::runtime_error("Cannot seek backwards in a compressed stream");
+    }
+    while (offset() < target) {
+        if (current_pos == bytes_read && !fetch_more_bytes()) {
+            throw std::runtime_error("Seek past the end of the input: " + std::to_string(target));
+        }
+        const uint64_t available = bytes_read - current_pos;
+        current_pos += static_cast<size_t>(std::min<uint64_t>(available, target - offset()));
+    }
+}
+
+bool Parser::ensure_available(size_t len) {
+    while (bytes_read - current_pos < len) {
+        const size_t available = bytes_read - current_pos;
+        if (!fetch_more_bytes() || bytes_read - current_pos == available) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint8_t Parser::read_u8() {
+    uint8_t value = data[current_pos];
     current_pos += sizeof(uint8_t);
     return value;
 }
 
 uint16_t Parser::read_u16() {
-    if (current_pos + sizeof(uint16_t) > bytes_read) {
-        if (!fetch_more_bytes() || current_pos + sizeof(uint16_t) > bytes_read) {
-            throw std::runtime_error("Unexpected end of stream while reading uint16");
-        }
-    }
-    
     // Read big-endian 16-bit value
-    const uint16_t value = static_cast<uint16_t>(buffer[current_pos]) << 8 |
-                          static_cast<uint16_t>(buffer[current_pos + 1]);
+    const uint16_t value = static_cast<uint16_t>(data[current_pos]) << 8 |
+                          static_cast<uint16_t>(data[current_pos + 1]);
     current_pos += sizeof(uint16_t);
     return value;
 }
 
 uint32_t Parser::read_u32() {
-    if (current_pos + sizeof(uint32_t) > bytes_read) {
-        if (!fetch_more_bytes() || current_pos + sizeof(uint32_t) > bytes_read) {
-            throw std::runtime_error("Unexpected end of stream while reading uint32");
-        }
-    }
-    
     // Read big-endian 32-bit value
-    const uint32_t value = static_cast<uint32_t>(buffer[current_pos]) << 24 |
-                          static_cast<uint32_t>(buffer[current_pos + 1]) << 16 |
-                          static_cast<uint32_t>(buffer[current_pos + 2]) << 8 |
-                          static_cast<uint32_t>(buffer[current_pos + 3]);
+    const uint32_t value = static_cast<uint32_t>(data[current_pos]) << 24 |
+                          static_cast<uint32_t>(data[current_pos + 1]) << 16 |
+                          static_cast<uint32_t>(data[current_pos + 2]) << 8 |
+                          static_cast<uint32_t>(data[current_pos + 3]);
     current_pos += sizeof(uint32_t);
     return value;
 }
 
 uint64_t Parser::read_u64() {
-    if (current_pos + sizeof(uint64_t) > bytes_read) {
-        if (!fetch_more_bytes() || current_pos + sizeof(uint64_t) > bytes_read) {
-            throw std::runtime_error("Unexpected end of stream while reading uint64");
-        }
-    }
-    
     // Read big-endian 64-bit value
-    const uint64_t value = static_cast<uint64_t>(buffer[current_pos]) << 56 |
-                          static_cast<uint64_t>(buffer[current_pos + 1]) << 48 |
-                          static_cast<uint64_t>(buffer[current_pos + 2]) << 40 |
-                          static_cast<uint64_t>(buffer[current_pos + 3]) << 32 |
-                          static_cast<uint64_t>(buffer[current_pos + 4]) << 24 |
-                          static_cast<uint64_t>(buffer[current_pos + 5]) << 16 |
-                          static_cast<uint64_t>(buffer[current_pos + 6]) << 8 |
-                          static_cast<uint64_t>(buffer[current_pos + 7]);
+    const uint64_t value = static_cast<uint64_t>(data[current_pos]) << 56 |
+                          static_cast<uint64_t>(data[current_pos + 1]) << 48 |
+                          static_cast<uint64_t>(data[current_pos + 2]) << 40 |
+                          static_cast<uint64_t>(data[current_pos + 3]) << 32 |
+                          static_cast<uint64_t>(data[current_pos + 4]) << 24 |
+                          static_cast<uint64_t>(data[current_pos + 5]) << 16 |
+                          static_cast<uint64_t>(data[current_pos + 6]) << 8 |
+                          static_cast<uint64_t>(data[current_pos + 7]);
     current_pos += sizeof(uint64_t);
     return value;
 }
 
 uint64_t Parser::read_u48() {
-    if (current_pos + 6 > bytes_read) {
-        if (!fetch_more_bytes() || current_pos + 6 > bytes_read) {
-            throw std::runtime_error("Unexpected end of stream while reading uint48");
-        }
-    }
-    
     // Read big-endian 48-bit value
-    const uint64_t value = static_cast<uint64_t>(buffer[current_pos]) << 40 |
-                          static_cast<uint64_t>(buffer[current_pos + 1]) << 32 |
-                          static_cast<uint64_t>(buffer[current_pos + 2]) << 24 |
-                          static_cast<uint64_t>(buffer[current_pos + 3]) << 16 |
-                          static_cast<uint64_t>(buffer[current_pos + 4]) << 8 |
-                          static_cast<uint64_t>(buffer[current_pos + 5]);
+    const uint64_t value = static_cast<uint64_t>(data[current_pos]) << 40 |
+                          static_cast<uint64_t>(data[current_pos + 1]) << 32 |
+                          static_cast<uint64_t>(data[current_pos + 2]) << 24 |
+                          static_cast<uint64_t>(data[current_pos + 3]) << 16 |
+                          static_cast<uint64_t>(data[current_pos + 4]) << 8 |
+                          static_cast<uint64_t>(data[current_pos + 5]);
     current_pos += 6;
     return value;
 }
 
-void Parser::read_bytes(void* data, size_t len) {
-    if (current_pos + len > bytes_read) {
-        if (!fetch_more_bytes() || current_pos + len > bytes_read) {
-            throw std::runtime_error("Unexpected end of stream while reading bytes");
-        }
-    }
-    
-    std::memcpy(data, buffer.data() + current_pos, len);
+void Parser::read_bytes(void* dst, size_t len) {
+    std::memcpy(dst, data + current_pos, len);
     current_pos += len;
 }
 
@@ -203,7 +284,25 @@ std::optional<Message> Parser::parse_message() {
     }
     
     try {
+        // Bounds are checked once per message, using the length prefix
+        if (!ensure_available(sizeof(uint16_t))) {
+            throw std::runtime_error("Unexpected end of stream while reading message length");
+        }
         uint16_t message_length = read_u16();
+        
+        if (message_length == 0 || !ensure_available(message_length)) {
+            throw std::runtime_error("Unexpected end of stream while reading message body");
+        }
+        const size_t message_end = current_pos + message_length;
+        
+        const size_t expected_length = message_size(data[current_pos]);
+        if (expected_length == 0) {
+            throw std::runtime_error("Unknown message type: " + std::to_string(data[current_pos]));
+        }
+        if (message_length < expected_length) {
+            throw std::runtime_error("Truncated message of type " + std::string(1, static_cast<char>(data[current_pos])));
+        }
+        
         uint8_t message_type = read_u8();
         uint16_t stock_locate = read_u16();
         uint16_t tracking_number = read_u16();
@@ -279,6 +378,9 @@ std::optional<Message> Parser::parse_message() {
                 throw std::runtime_error("Unknown message type: " + std::to_string(message_type));
         }
         
+        // Skip any trailing bytes beyond the fields we know about
+        current_pos = message_end;
+        
         return Message {
             message_type,
             stock_locate,
@@ -0,0 +1,174 @@
+#include "../include/sharded_decoder.h"
+#include "../include/parser.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace itch {
+
+ShardedDecoder::ShardedDecoder(std::shared_ptr<const MappedFile> mapping, size_t num_threads,
+                               size_t message_limit, size_t chunk_bytes)
+    : mapping_(std::move(mapping)),
+      message_limit_(message_limit),
+      chunk_bytes_(chunk_bytes > 0 ? chunk_bytes : DEFAULT_CHUNK_BYTES) {
+    if (num_threads == 0) {
+        num_threads = 1;
+    }
+
+    // Two chunks per worker keeps everyone busy while the consumer catches up
+    slots_.resize(num_threads * 2);
+    boundaries_.push_back(0);
+
+    scanner_ = std::thread([this] { scan(); });
+    for (size_t i = 0; i < num_threads; ++i) {
+        workers_.emplace_back([this] { decode_chunks(); });
+    }
+}
+
+ShardedDecoder::~ShardedDecoder() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    condition_.notify_all();
+
+    scanner_.join();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ShardedDecoder::scan() {
+    const uint8_t* data = mapping_->data();
+    const size_t size = mapping_->size();
+    size_t pos = 0;
+    size_t count = 0;
+    size_t next_cut = chunk_bytes_;
+
+    // Stop at the first framing error, exactly where a sequential Parser would
+    while (pos + sizeof(uint16_t) <= size) {
+        const size_t length = static_cast<size_t>(data[pos]) << 8 | data[pos + 1];
+        if (length == 0 || pos + sizeof(uint16_t) + length > size) {
+            break;
+        }
+        const size_t expected = message_size(data[pos + sizeof(uint16_t)]);
+        if (expected == 0 || length < expected) {
+            break;
+        }
+
+        pos += sizeof(uint16_t) + length;
+        count++;
+        if (message_limit_ > 0 && count >= message_limit_) {
+            break;
+        }
+
+        if (pos >= next_cut) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stop_) {
+                    return;
+                }
+                boundaries_.push_back(pos);
+            }
+            condition_.notify_all();
+            next_cut = pos + chunk_bytes_;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (boundaries_.back() != pos) {
+            boundaries_.push_back(pos);
+        }
+        scan_done_ = true;
+    }
+    condition_.notify_all();
+}
+
+void ShardedDecoder::decode_chunks() {
+    while (true) {
+        size_t index;
+        size_t begin;
+        size_t end;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this] {
+                const bool has_chunk = next_decode_ + 1 < boundaries_.size();
+                const bool has_slot = next_decode_ < next_consume_ + slots_.size();
+                const bool past_stop = next_decode_ > stop_chunk_;
+                return stop_ || past_stop || (has_chunk && has_slot) || (scan_done_ && !has_chunk);
+            });
+            if (stop_ || next_decode_ > stop_chunk_ || next_decode_ + 1 >= boundaries_.size()) {
+                return;
+            }
+
+            index = next_decode_++;
+            begin = boundaries_[index];
+            end = boundaries_[index + 1];
+        }
+
+        // The slot for index was released when chunk index - slots_.size() was consumed
+        CompactChunk messages;
+        messages.reserve((end - begin) / 32); // Typical messages are 20-40 bytes
+        std::string error;
+        bool complete = false;
+        try {
+            Parser parser(mapping_, begin, end);
+            while (auto message = parser.parse_message()) {
+                messages.push_back(std::move(*message));
+            }
+            // parse_message reports a message it cannot decode as the end of
+            // input; a sequential Parser stops there, and so does the stream
+            complete = parser.offset() >= end;
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Slot& slot = slots_[index % slots_.size()];
+            slot.messages = std::move(messages);
+            slot.error = std::move(error);
+            slot.last = !complete;
+            slot.ready = true;
+            if (!complete) {
+                stop_chunk_ = std::min(stop_chunk_, index);
+            }
+        }
+        condition_.notify_all();
+    }
+}
+
+bool ShardedDecoder::next_chunk(CompactChunk& chunk) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Slot* slot = nullptr;
+    condition_.wait(lock, [&] {
+        if (finished_) {
+            return true;
+        }
+        if (next_consume_ + 1 >= boundaries_.size()) {
+            return scan_done_;
+        }
+        slot = &slots_[next_consume_ % slots_.size()];
+        return slot->ready;
+    });
+
+    if (finished_ || next_consume_ + 1 >= boundaries_.size()) {
+        return false;
+    }
+    if (!slot->error.empty()) {
+        finished_ = true;
+        throw std::runtime_error("Sharded decode failed: " + slot->error);
+    }
+
+    // Chunks after one where decoding stopped are never delivered
+    chunk = std::move(slot->messages);
+    finished_ = slot->last;
+    slot->messages = CompactChunk();
+    slot->ready = false;
+    next_consume_++;
+    lock.unlock();
+    condition_.notify_all();
+    return true;
+}
+
+} // namespace itch
@@ -1,21 +1,126 @@
 #include "parallel_parser.h"
 #include "integrated_processor.h"
+#include "../cpp_order_book/metrics.h"
+#include "../cpp_order_book/market_data_server.h"
 #include <iostream>
 #include <string>
 #include <vector>
 #include <thread>
 #include <chrono>
+#include <memory>
 
 using namespace integrated;
 
 int main(int argc, char* argv[]) {
+    // Split option flags from positional arguments
+    bool json_mode = false;
+    itch::InputBackend backend = itch::InputBackend::Stream;
+    size_t batch_size = ParallelParser::DEFAULT_BATCH_SIZE;
+    size_t decode_threads = 0;
+    hft::BookEngine engine = hft::BookEngine::Map;
+    hft::QueueKind queue_kind = hft::QueueKind::Spsc;
+    bool pin_threads = false;
+    std::string placement_file;
+    std::vector<std::string> placement_settings;
+    std::string update_trigger = "totals";
+    bool conflate = false;
+    std::string metrics_file;
+    size_t metrics_interval_ms = 1000;
+    std::string publish_shm;
+    int publish_port = -1;
+    size_t publish_ring = hft::MarketDataRing::DEFAULT_CAPACITY;
+    std::vector<char*> args;
+    for (int i = 0; i < argc; i++) {
+        if (std::string(argv[i]) == "--json") {
+            json_mode = true;
+        } else if (std::string(argv[i]) == "--mmap") {
+            backend = itch::InputBackend::Mmap;
+        } else if (std::string(argv[i]) == "--ladder") {
+            engine = hft::BookEngine::Ladder;
+        } else if (std::string(argv[i]) == "--locked-queues") {
+            queue_kind = hft::QueueKind::Locked;
+        } else if (std::string(argv[i]) == "--pin-threads") {
+            pin_threads = true;
+        } else if (std::string(argv[i]) == "--placement" && i + 1 < argc) {
+            placement_file = argv[++i];
+        } else if (std::string(argv[i]) == "--place" && i + 1 < argc) {
+            placement_settings.push_back(argv[++i]);
+        } else if (std::string(argv[i]) == "--update-trigger" && i + 1 < argc) {
+            update_trigger = argv[++i];
+        } else if (std::string(argv[i]) == "--conflate") {
+            conflate = true;
+        } else if (std::string(argv[i]) == "--batch-size" && i + 1 < argc) {
+            batch_size = std::stoul(argv[++i]);
+        } else if (std::string(argv[i]) == "--decode-threads" && i + 1 < argc) {
+            decode_threads = std::stoul(argv[++i]);
+        } else if (std::string(argv[i]) == "--metrics" && i + 1 < argc) {
+            metrics_file = argv[++i];
+        } else if (std::string(argv[i]) == "--metrics-interval" && i + 1 < argc) {
+            metrics_interval_ms = std::stoul(argv[++i]);
+        } else if (std::string(argv[i]) == "--publish-shm" && i + 1 < argc) {
+            publish_shm = argv[++i];
+        } else if (std::string(argv[i]) == "--publish-port" && i + 1 < argc) {
+            publish_port = std::stoi(argv[++i]);
+        } else if (std::string(argv[i]) == "--publish-ring" && i + 1 < argc) {
+            publish_ring = std::stoul(argv[++i]);
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    argc = static_cast<int>(args.size());
+    argv = args.data();
+    
+    // The config file first, then each --place on top of it
+    hft::ThreadPlacement placement;
+    try {
+        if (!placement_file.empty()) {
+            placement.load(placement_file);
+        }
+        for (const auto& setting : placement_settings) {
+            placement.set(setting);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    
+    hft::ChangeDetection change_detection;
+    try {
+        change_detection = hft::parse_change_detection(update_trigger);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    
     if (argc < 3) {
-        std::cerr << "Usage: " << argv[0] << " <input_itch_file> <num_messages> [trading_output_dir] [parser_threads] [processor_threads] [debug] [stocks...]" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " [--json] [--mmap] [--batch-size N] [--decode-threads N] [--ladder] [--locked-queues] [--pin-threads] [--placement FILE] [--place STAGE.KEY=VALUE] [--update-trigger totals|top|depth:N] [--conflate] [--metrics FILE] [--metrics-interval MS] [--publish-shm NAME] [--publish-port PORT] [--publish-ring N] <input_itch_file> <num_messages> [trading_output_dir] [parser_threads] [processor_threads] [debug] [stocks...]" << std::endl;
+        std::cerr << "  --json              : Route messages through JSON (default: parsed structs go straight to the order book)" << std::endl;
+        std::cerr << "  --mmap              : Memory-map the input file instead of reading it through a stream" << std::endl;
+        std::cerr << "  --batch-size N      : Messages per parser batch (default: " << ParallelParser::DEFAULT_BATCH_SIZE << ")" << std::endl;
+        std::cerr << "  --decode-threads N  : Decode the memory-mapped file on N threads, split at message boundaries (default: sequential)" << std::endl;
+        std::cerr << "  --ladder            : Use the integer-tick ladder book instead of the std::map book" << std::endl;
+        std::cerr << "  --locked-queues     : Use mutex-guarded queues between threads instead of lock-free rings" << std::endl;
+        std::cerr << "  --pin-threads       : Pin parser pool workers to CPUs, filling NUMA nodes in order" << std::endl;
+        std::cerr << "  --placement FILE    : Thread placement config, one STAGE.KEY=VALUE per line; placed stages ignore --pin-threads" << std::endl;
+        std::cerr << "  --place STAGE.KEY=VALUE: One placement setting, applied after --placement; repeatable" << std::endl;
+        std::cerr << "                        STAGE is decode (parser thread, then parser pool), book (processor thread)" << std::endl;
+        std::cerr << "                        or strategy; KEY is cpus (e.g. 4-7,12), numa (node)" << std::endl;
+        std::cerr << "                        or busy_poll (1/0)" << std::endl;
+        std::cerr << "  --update-trigger T  : Publish a market update when a message changes a symbol's best prices and" << std::endl;
+        std::cerr << "                        side totals (totals, default), best prices and best-level sizes (top), or" << std::endl;
+        std::cerr << "                        best prices and the volume of the best N levels (depth:N)" << std::endl;
+        std::cerr << "  --conflate          : Keep only the latest update per symbol while the strategy thread is behind" << std::endl;
+        std::cerr << "  --metrics FILE      : Append per-stage latency percentiles and queue depths to FILE as JSON lines" << std::endl;
+        std::cerr << "  --metrics-interval MS: Milliseconds between metrics reports (default: 1000)" << std::endl;
+        std::cerr << "  --publish-shm NAME  : Publish every book change to a shared-memory ring, /dev/shm/NAME" << std::endl;
+        std::cerr << "  --publish-port PORT : Serve book changes to TCP subscribers on PORT (0 picks a free port)" << std::endl;
+        std::cerr << "  --publish-ring N    : Deltas the ring keeps for subscribers that fall behind (default: "
+                  << hft::MarketDataRing::DEFAULT_CAPACITY << ")" << std::endl;
         std::cerr << "  <input_itch_file>   : Path to the NASDAQ ITCH 5.0 binary file" << std::endl;
         std::cerr << "  <num_messages>      : Number of messages to process (0 for all)" << std::endl;
         std::cerr << "  [trading_output_dir]: Directory for trading output (default: trading_output_integrated)" << std::endl;
         std::cerr << "  [parser_threads]    : Number of threads for parser (default: half of hardware concurrency)" << std::endl;
-        std::cerr << "  [processor_threads] : Number of threads for processor (default: half of hardware concurrency)" << std::endl;
+        std::cerr << "  [processor_threads] : Ignored; the book is applied on one thread, in feed order" << std::endl;
         std::cerr << "  [debug]             : Enable debug mode (1) or disable (0) (default: 0)" << std::endl;
         std::cerr << "  [stocks...]         : Optional list of stock symbols to filter (default: process all stocks)" << std::endl;
         return 1;
@@ -28,17 +133,14 @@ int main(int argc, char* argv[]) {
     
     // Determine number of threads (0 means use hardware concurrency)
     size_t parser_threads = (argc > 4) ? std::stoi(argv[4]) : 0;
-    size_t processor_threads = (argc > 5) ? std::stoi(argv[5]) : 0;
+    // argv[5] (processor_threads) is accepted for compatibility: book
+    // messages depend on feed order, so the processor applies them on one thread
     bool debug_mode = (argc > 6) ? (std::stoi(argv[6]) != 0) : false;
     
     if (parser_threads == 0) {
         parser_threads = std::max(1u, std::thread::hardware_concurrency() / 2);
     }
     
-    if (processor_threads == 0) {
-        processor_threads = std::max(1u, std::thread::hardware_concurrency() / 2);
-    }
-    
     // Collect stock filters
     std::vector<std::string> stocks;
     for (int i = 7; i < argc; i++) {
@@ -50,8 +152,23 @@ int main(int argc, char* argv[]) {
     std::cout << "Input file: " << input_file << std::endl;
     std::cout << "Trading output directory: " << trading_output_dir << std::endl;
     std::cout << "Parser threads: " << parser_threads << std::endl;
-    std::cout << "Processor threads: " << processor_threads << std::endl;
+    std::cout << "Processor threads: 1 (feed order)" << std::endl;
+    std::cout << "Parser batch size: " << batch_size << std::endl;
+    std::cout << "Decode threads: " << (decode_threads > 0 ? std::to_string(decode_threads) : "sequential") << std::endl;
     std::cout << "Debug mode: " << (debug_mode ? "Enabled" : "Disabled") << std::endl;
+    std::cout << "Order book: " << (engine == hft::BookEngine::Ladder ? "ladder" : "map") << std::endl;
+    std::cout << "Queues: " << (queue_kind == hft::QueueKind::Locked ? "locked" : "lock-free rings") << std::endl;
+    std::cout << "Pool threads: " << (pin_threads ? "pinned" : "unpinned") << std::endl;
+    std::cout << "Decode placement: " << placement.decode.describe() << std::endl;
+    std::cout << "Book placement: " << placement.book.describe() << std::endl;
+    std::cout << "Strategy placement: " << placement.strategy.describe() << std::endl;
+    std::cout << "Update trigger: " << hft::change_detection_name(change_detection) << std::endl;
+    std::cout << "Update queue: " << (conflate ? "conflating" : "every update") << std::endl;
+    std::cout << "Metrics: " << (metrics_file.empty() ? "off" : metrics_file) << std::endl;
+    std::cout << "Market data: " << (publish_shm.empty() ? "no shared memory" : "/dev/shm/" + publish_shm) << ", "
+              << (publish_port >= 0 ? "TCP port " + std::to_string(publish_port) : "no TCP") << std::endl;
+    std::cout << "Message path: " << (json_mode ? "JSON" : "Binary") << std::endl;
+    std::cout << "Input backend: " << (backend == itch::InputBackend::Mmap ? "mmap" : "stream") << std::endl;
     std::cout << "Message limit: " << (num_messages > 0 ? std::to_string(num_messages) : "No limit") << std::endl;
     
     if (!stocks.empty()) {
@@ -65,24 +182,96 @@ int main(int argc, char* argv[]) {
     
     auto start_time = std::chrono::high_resolution_clock::now();
     
-    // Create shared message queue
-    ParsedMessageQueue message_queue(debug_mode);
+    // Create shared message queue (only one is used, depending on the message path)
+    ParsedMessageQueue json_queue(debug_mode, queue_kind);
+    RawMessageQueue raw_queue(debug_mode, queue_kind);
+    
+    // Optional metrics, reported from their own thread so nothing is printed on the hot path
+    std::unique_ptr<hft::PipelineMetrics> metrics;
+    if (!metrics_file.empty()) {
+        metrics = std::make_unique<hft::PipelineMetrics>();
+        if (json_mode) {
+            metrics->add_gauge("parser_queue", [&json_queue] { return json_queue.size(); });
+        } else {
+            metrics->add_gauge("parser_queue", [&raw_queue] { return raw_queue.size(); });
+        }
+        try {
+            metrics->start_reporting(metrics_file, std::chrono::milliseconds(metrics_interval_ms));
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    
+    // Market data publishing: the book writes the ring, the server reads it
+    std::unique_ptr<hft::MarketDataRing> market_data;
+    std::unique_ptr<hft::MarketDataServer> market_data_server;
+    try {
+        if (!publish_shm.empty() || publish_port >= 0) {
+            market_data = std::make_unique<hft::MarketDataRing>(publish_shm, publish_ring);
+        }
+        if (publish_port >= 0) {
+            market_data_server = std::make_unique<hft::MarketDataServer>(*market_data, static_cast<uint16_t>(publish_port));
+            std::cout << "Market data server listening on port " << market_data_server->port() << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    
+    // Pinned parser workers take the first CPUs. A placed decode stage's pool
+    // takes the stage's CPUs after its first thread, the parser thread.
+    hft::PoolOptions parser_pool;
+    parser_pool.pin_threads = pin_threads;
+    if (placement.decode.placed()) {
+        parser_pool = hft::pool_options_for(placement.decode, 1);
+    }
+    parser_pool.busy_poll = placement.decode.busy_poll;
     
     // Create parser and processor
-    ParallelParser parser(input_file, message_queue, parser_threads, num_messages, debug_mode);
-    IntegratedProcessor processor(message_queue, processor_threads, trading_output_dir, stocks, debug_mode);
+    std::unique_ptr<ParallelParser> parser;
+    std::unique_ptr<IntegratedProcessor> processor;
+    if (json_mode) {
+        parser = std::make_unique<ParallelParser>(input_file, json_queue, parser_threads, num_messages, debug_mode, backend, batch_size, decode_threads, parser_pool);
+        processor = std::make_unique<IntegratedProcessor>(json_queue, trading_output_dir, stocks, debug_mode, engine);
+    } else {
+        parser = std::make_unique<ParallelParser>(input_file, raw_queue, parser_threads, num_messages, debug_mode, backend, batch_size, decode_threads, parser_pool);
+        processor = std::make_unique<IntegratedProcessor>(raw_queue, trading_output_dir, stocks, debug_mode, engine);
+    }
+    parser->set_metrics(metrics.get());
+    processor->set_metrics(metrics.get());
+    processor->set_placement(placement.book, placement.strategy);
+    processor->set_update_options(change_detection, conflate);
+    processor->set_market_data(market_data.get());
     
     // Start parser thread
-    std::thread parser_thread([&parser]() {
-        parser.run();
+    std::thread parser_thread([&parser, &placement]() {
+        placement.decode.apply_to_current_thread(0);
+        parser->run();
     });
     
     // Start processor
-    processor.run();
+    processor->run();
     
     // Wait for parser thread to complete (should already be done by this point)
     parser_thread.join();
     
+    if (market_data) {
+        std::cout << "Market data deltas published: " << market_data->last_sequence() << std::endl;
+    }
+    if (market_data_server) {
+        market_data_server->stop();
+        std::cout << "Market data records sent: " << market_data_server->records_sent()
+                  << " (" << market_data_server->snapshots_sent() << " snapshots)" << std::endl;
+    }
+    
+    if (metrics) {
+        metrics->stop_reporting();
+        std::cout << "Metrics written to " << metrics_file << std::endl;
+    }
+    
+    size_t total_messages = json_mode ? json_queue.total_messages() : raw_queue.total_messages();
+    
     // Print overall performance statistics
     auto end_time = std::chrono::high_resolution_clock::now();
     auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
@@ -91,8 +280,8 @@ int main(int argc, char* argv[]) {
     std::cout << "\nOverall performance:" << std::endl;
     std::cout << "---------------------------------" << std::endl;
     std::cout << "Total execution time: " << elapsed << " seconds" << std::endl;
-    std::cout << "Total messages processed: " << message_queue.total_messages() << std::endl;
-    std::cout << "Overall throughput: " << (message_queue.total_messages() / (double)elapsed) 
+    std::cout << "Total messages processed: " << total_messages << std::endl;
+    std::cout << "Overall throughput: " << (total_messages / (double)elapsed) 
               << " messages per second" << std::endl;
     
     return 0;
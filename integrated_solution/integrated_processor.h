@@ -2,10 +2,14 @@
 
 #include "../cpp_order_book/order_book.h"
 #include "../cpp_order_book/trading_strategy.h"
-#include "thread_pool.h"
+#include "../cpp_order_book/metrics.h"
+#include "../cpp_order_book/thread_placement.h"
+#include "../cpp_order_book/conflating_queue.h"
+#include "../cpp_order_book/market_data.h"
 #include "parsed_message_queue.h"
 #include <string>
 #include <vector>
+#include <memory>
 #include <thread>
 #include <atomic>
 #include <chrono>
@@ -14,111 +18,207 @@
 
 namespace integrated {
 
-// Market update structure (same as in parallel_processor.h)
-struct MarketUpdate {
-    std::string symbol;
-    double bid_price;
-    double ask_price;
-    uint32_t bid_volume;
-    uint32_t ask_volume;
-    double imbalance;
-    uint64_t timestamp;
-};
+// Book snapshot keyed on the symbol ID, copied through the queue as plain bytes
+using MarketUpdate = hft::MarketUpdate;
 
-// Thread-safe queue for market updates
+// Queue of market updates from the book to the strategy thread. The book is
+// applied on one thread, so it has a single producer. With conflate set it
+// is a ConflatingUpdateQueue instead, keeping only the latest update per
+// symbol while the strategy thread is behind.
 class MarketUpdateQueue {
 public:
-    MarketUpdateQueue(bool debug_mode = false) : debug_mode_(debug_mode), update_count_(0) {
+    MarketUpdateQueue(bool debug_mode = false, hft::QueueKind kind = hft::QueueKind::Spsc, bool conflate = false)
+        : queue_(kind, conflate ? 1 : hft::ConcurrentQueue<MarketUpdate>::DEFAULT_CAPACITY),
+          debug_mode_(debug_mode), update_count_(0) {
+        if (conflate) {
+            conflating_ = std::make_unique<hft::ConflatingUpdateQueue>();
+        }
         if (debug_mode_) {
-            std::cout << "DEBUG: MarketUpdateQueue initialized" << std::endl;
+            std::cout << "DEBUG: MarketUpdateQueue initialized ("
+                      << (conflate ? "conflating" : hft::queue_kind_name(kind)) << ")" << std::endl;
         }
     }
     
     void push(const MarketUpdate& update) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        queue_.push(update);
-        update_count_++;
-        
-        if (debug_mode_ && update_count_ % 10000 == 0) {
-            std::cout << "DEBUG: MarketUpdateQueue pushed update #" << update_count_ 
-                      << ", current queue size: " << queue_.size() << std::endl;
+        if (conflating_) {
+            conflating_->push(update);
+        } else {
+            queue_.push(update);
         }
+        const size_t count = ++update_count_;
         
-        lock.unlock();
-        condition_.notify_one();
+        if (debug_mode_ && count % 10000 == 0) {
+            std::cout << "DEBUG: MarketUpdateQueue pushed update #" << count 
+                      << ", current queue size: " << size() << std::endl;
+        }
     }
     
     bool pop(MarketUpdate& update) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        condition_.wait(lock, [this] { 
-            return !queue_.empty() || is_done_; 
-        });
-        
-        if (queue_.empty() && is_done_) {
+        if (!(conflating_ ? conflating_->pop(update) : queue_.pop(update))) {
             if (debug_mode_) {
                 std::cout << "DEBUG: MarketUpdateQueue is empty and marked as done, signaling consumer to exit" << std::endl;
             }
             return false; // Signal consumer to exit
         }
         
-        update = queue_.front();
-        queue_.pop();
-        
         if (debug_mode_ && pop_count_ % 10000 == 0) {
             std::cout << "DEBUG: MarketUpdateQueue popped update #" << pop_count_ 
-                      << ", remaining queue size: " << queue_.size() << std::endl;
+                      << ", remaining queue size: " << size() << std::endl;
         }
         pop_count_++;
         
         return true;
     }
     
+    // Replace updates with up to max queued updates; 0 once done and drained
+    size_t pop_batch(std::vector<MarketUpdate>& updates, size_t max) {
+        const size_t count = conflating_ ? conflating_->pop_batch(updates, max) : queue_.pop_batch(updates, max);
+        pop_count_ += count;
+        return count;
+    }
+    
+    // Spin instead of sleeping while the queue is empty; call before the consumer starts
+    void set_consumer_busy_poll(bool busy_poll) {
+        if (conflating_) {
+            conflating_->set_consumer_busy_poll(busy_poll);
+        } else {
+            queue_.set_consumer_busy_poll(busy_poll);
+        }
+    }
+    
     void set_done() {
-        std::unique_lock<std::mutex> lock(mutex_);
-        is_done_ = true;
+        if (conflating_) {
+            conflating_->set_done();
+        } else {
+            queue_.set_done();
+        }
         if (debug_mode_) {
             std::cout << "DEBUG: MarketUpdateQueue marked as done, total updates: " << update_count_ << std::endl;
         }
-        lock.unlock();
-        condition_.notify_all();
     }
     
-    size_t size() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return queue_.size();
+    size_t size() const {
+        return conflating_ ? conflating_->size() : queue_.size();
     }
     
     size_t total_updates() const {
         return update_count_;
     }
     
+    // Updates replaced by a newer one for the same symbol; always 0 without conflation
+    size_t conflated() const {
+        return conflating_ ? conflating_->conflated() : 0;
+    }
+
 private:
-    std::queue<MarketUpdate> queue_;
-    std::mutex mutex_;
-    std::condition_variable condition_;
-    bool is_done_ = false;
+    hft::ConcurrentQueue<MarketUpdate> queue_;
+    std::unique_ptr<hft::ConflatingUpdateQueue> conflating_;
     bool debug_mode_ = false;
-    size_t update_count_ = 0;
-    size_t pop_count_ = 0;
+    std::atomic<size_t> update_count_;
+    size_t pop_count_ = 0;  // Consumer thread only
 };
 
-class IntegratedProcessor {
+// Book stage plus strategy thread, instantiated on the strategy type.
+// Strategy is called directly (see hft::is_market_update_strategy), so the
+// compiler sees the whole path from book update to signal, and any
+// parameters the type fixes at compile time fold into it.
+template <typename Strategy = hft::TunedLiquidityReversionStrategy>
+class BasicIntegratedProcessor {
+    static_assert(hft::is_market_update_strategy_v<Strategy>,
+                  "Strategy needs Strategy(SymbolNames, output_dir, initial_capital), "
+                  "process_market_update(const MarketUpdate&), set_metrics and print_performance");
+
 public:
-    IntegratedProcessor(
+    static constexpr size_t BOOK_BATCH_SIZE = 256;      // Messages the book thread takes per pop
+    static constexpr size_t STRATEGY_BATCH_SIZE = 256;  // Updates the strategy thread takes per pop
+    
+    // JSON mode: the parser's JSON text is decoded in place (hft::decode_json_message) and applied
+    BasicIntegratedProcessor(
         ParsedMessageQueue& message_queue,
-        size_t num_threads,
         const std::string& trading_output_dir,
         const std::vector<std::string>& stock_filters = {},
-        bool debug_mode = false
-    ) : thread_pool(num_threads, debug_mode),
-        message_queue_(message_queue),
+        bool debug_mode = false,
+        hft::BookEngine engine = hft::BookEngine::Map
+    ) : BasicIntegratedProcessor(&message_queue, nullptr, trading_output_dir, stock_filters, debug_mode, engine) {}
+    
+    // Binary mode: parsed structs go straight to OrderBook::apply
+    BasicIntegratedProcessor(
+        RawMessageQueue& message_queue,
+        const std::string& trading_output_dir,
+        const std::vector<std::string>& stock_filters = {},
+        bool debug_mode = false,
+        hft::BookEngine engine = hft::BookEngine::Map
+    ) : BasicIntegratedProcessor(nullptr, &message_queue, trading_output_dir, stock_filters, debug_mode, engine) {}
+    
+    // Record book, emit and strategy latencies and the update queue depth; null turns it off
+    void set_metrics(hft::PipelineMetrics* metrics) {
+        metrics_ = metrics;
+    }
+    
+    // Where the thread calling run(), which applies the book, and the strategy
+    // thread run, and whether they busy-poll their input queues
+    void set_placement(const hft::StagePlacement& book, const hft::StagePlacement& strategy) {
+        book_placement_ = book;
+        strategy_placement_ = strategy;
+    }
+    
+    // What change in a symbol's book publishes an update (default: side
+    // totals), and whether the strategy queue keeps only the latest update
+    // per symbol while the strategy thread is behind
+    void set_update_options(const hft::ChangeDetection& detection, bool conflate) {
+        change_detection_ = detection;
+        conflate_ = conflate;
+    }
+    
+    // Also publish every book change, for all symbols regardless of the stock
+    // filters, to a market data ring (local subscribers, MarketDataServer);
+    // null (the default) turns it off
+    void set_market_data(hft::MarketDataRing* ring) {
+        market_data_ = ring;
+    }
+    
+    void run() {
+        if (raw_queue_) {
+            run_pipeline(*raw_queue_);
+        } else {
+            run_pipeline(*json_queue_);
+        }
+    }
+
+private:
+    ParsedMessageQueue* json_queue_;
+    RawMessageQueue* raw_queue_;
+    std::string trading_output_dir_;
+    std::vector<std::string> stock_filters_;
+    hft::SymbolFilter symbol_filter_;
+    bool debug_mode_;
+    hft::BookEngine engine_;
+    hft::PipelineMetrics* metrics_ = nullptr;
+    hft::StagePlacement book_placement_;
+    hft::StagePlacement strategy_placement_;
+    hft::ChangeDetection change_detection_;
+    bool conflate_ = false;
+    hft::MarketDataRing* market_data_ = nullptr;  // Written by the book thread only
+    
+    BasicIntegratedProcessor(
+        ParsedMessageQueue* json_queue,
+        RawMessageQueue* raw_queue,
+        const std::string& trading_output_dir,
+        const std::vector<std::string>& stock_filters,
+        bool debug_mode,
+        hft::BookEngine engine
+    ) : json_queue_(json_queue),
+        raw_queue_(raw_queue),
         trading_output_dir_(trading_output_dir),
         stock_filters_(stock_filters),
-        debug_mode_(debug_mode) {
+        symbol_filter_(stock_filters),
+        debug_mode_(debug_mode),
+        engine_(engine) {
         
         if (debug_mode_) {
             std::cout << "DEBUG: IntegratedProcessor initialized with:" << std::endl
-                      << "  - Threads: " << num_threads << std::endl
+                      << "  - Mode: " << (raw_queue_ ? "binary" : "JSON") << std::endl
+                      << "  - Book: " << (engine_ == hft::BookEngine::Ladder ? "ladder" : "map") << std::endl
                       << "  - Trading output directory: " << trading_output_dir_ << std::endl;
             
             if (!stock_filters_.empty()) {
@@ -134,29 +234,39 @@ public:
         std::filesystem::create_directories(trading_output_dir_);
     }
     
-    void run() {
+    template <typename Message>
+    void run_pipeline(MessageQueue<Message>& message_queue) {
         if (debug_mode_) {
             std::cout << "DEBUG: Starting processor" << std::endl;
         }
+        book_placement_.apply_to_current_thread(0);
+        message_queue.set_consumer_busy_poll(book_placement_.busy_poll);
         
         auto start_time = std::chrono::high_resolution_clock::now();
         
-        // Create market update queue
-        MarketUpdateQueue market_updates(debug_mode_);
+        // Create market update queue; this thread is its only producer
+        const hft::QueueKind update_kind =
+            message_queue.kind() == hft::QueueKind::Locked ? hft::QueueKind::Locked : hft::QueueKind::Spsc;
+        MarketUpdateQueue market_updates(debug_mode_, update_kind, conflate_);
+        market_updates.set_consumer_busy_poll(strategy_placement_.busy_poll);
         
         // Create order book
-        hft::OrderBook order_book;
+        hft::OrderBook order_book(engine_);
+        order_book.set_metrics(metrics_);
+        order_book.set_change_detection(change_detection_);
         
-        // Create trading strategy with optimized parameters from memory
-        hft::LiquidityReversionStrategy strategy(
-            order_book,
-            trading_output_dir_,
-            1000000.0,  // Initial capital
-            1.8,        // Liquidity threshold - increased to reduce false signals
-            0.6,        // Reverse threshold - more aggressive selling on imbalance
-            100,        // Position size
-            15          // Hold time ticks - reduced to lock in profits faster
-        );
+        // Create trading strategy; its parameters come with its type. It gets
+        // names, not the book: this thread keeps applying messages while the
+        // strategy runs, so it prices exits from the quotes it was sent. A
+        // name is written before its ID is first queued, so it is safe to read.
+        auto names = [&order_book](hft::SymbolId symbol) -> const std::string& {
+            return order_book.symbols().name(symbol);
+        };
+        Strategy strategy(names, trading_output_dir_, 1000000.0);  // Initial capital
+        strategy.set_metrics(metrics_);
+        if (metrics_) {
+            metrics_->add_gauge("update_queue", [&market_updates] { return market_updates.size(); });
+        }
         
         // Start consumer thread for trading strategy
         std::atomic<bool> strategy_done(false);
@@ -167,26 +277,21 @@ public:
         }
         
         std::thread strategy_thread([&] {
-            MarketUpdate update;
-            while (market_updates.pop(update)) {
-                strategy.process_market_update(
-                    update.symbol,
-                    update.bid_price,
-                    update.ask_price,
-                    update.bid_volume,
-                    update.ask_volume,
-                    update.imbalance,
-                    update.timestamp
-                );
-                updates_processed++;
-                
-                // Print progress every 100,000 updates
-                if (updates_processed % 100000 == 0) {
-                    std::cout << "Strategy processed " << updates_processed 
-                              << " market updates" << std::endl;
+            strategy_placement_.apply_to_current_thread(0);
+            std::vector<MarketUpdate> updates;
+            while (market_updates.pop_batch(updates, STRATEGY_BATCH_SIZE)) {
+                for (const MarketUpdate& update : updates) {
+                    strategy.process_market_update(update);
+                    updates_processed++;
                     
-                    // Print strategy performance every 100,000 updates
-                    strategy.print_performance();
+                    // Print progress every 100,000 updates
+                    if (updates_processed % 100000 == 0) {
+                        std::cout << "Strategy processed " << updates_processed 
+                                  << " market updates" << std::endl;
+                        
+                        // Print strategy performance every 100,000 updates
+                        strategy.print_performance();
+                    }
                 }
             }
             strategy_done = true;
@@ -196,30 +301,31 @@ public:
             }
         });
         
-        // Process messages from queue
-        json message;
+        // Apply messages on this thread, in the order the parser delivered
+        // them: the book's state, and so every update, depends on feed order.
+        // With metrics on, each batch is stamped as it comes off the queue.
+        std::vector<Message> batch;
         size_t count = 0;
-        std::vector<std::future<void>> futures;
-        std::vector<json> batch;
-        size_t batch_size = 100; // Smaller batch size for proof of concept
         size_t last_report_time = 0;
         
         if (debug_mode_) {
-            std::cout << "DEBUG: Starting to process messages with batch size: " << batch_size << std::endl;
+            std::cout << "DEBUG: Starting to process messages with batch size: " << BOOK_BATCH_SIZE << std::endl;
         }
         
-        while (message_queue_.pop(message)) {
-            batch.push_back(message);
-            count++;
+        while (message_queue.pop_batch(batch, BOOK_BATCH_SIZE) > 0) {
+            const uint32_t feed_stamp = metrics_ ? hft::cycle_stamp() : 0;
+            process_batch(batch, feed_stamp, order_book, market_updates);
             
-            // Report progress every 100,000 messages or every 5 seconds
-            if (count % 100000 == 0 || count == 1) {
+            // Report progress every 100,000 messages, at most every 5 seconds
+            const size_t previous = count;
+            count += batch.size();
+            if (count / 100000 != previous / 100000 || previous == 0) {
                 auto current_time = std::chrono::high_resolution_clock::now();
                 auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
                     current_time - start_time).count();
                 
-                // Only print if it's been at least 5 seconds since last print or it's the first message
-                if (elapsed_ms - last_report_time > 5000 || count == 1) {
+                // Only print if it's been at least 5 seconds since last print or it's the first batch
+                if (elapsed_ms - last_report_time > 5000 || previous == 0) {
                     last_report_time = elapsed_ms;
                     double msgs_per_sec = count * 1000.0 / (elapsed_ms > 0 ? elapsed_ms : 1);
                     
@@ -228,39 +334,6 @@ public:
                               << "Queue: " << market_updates.size() << ")" << std::endl;
                 }
             }
-            
-            if (batch.size() >= batch_size) {
-                auto batch_copy = batch;
-                futures.push_back(
-                    thread_pool.enqueue([this, batch_copy, &order_book, &market_updates]() {
-                        process_batch(batch_copy, order_book, market_updates);
-                    })
-                );
-                batch.clear();
-            }
-        }
-        
-        // Process any remaining messages
-        if (!batch.empty()) {
-            if (debug_mode_) {
-                std::cout << "DEBUG: Processing final batch of " << batch.size() << " messages" << std::endl;
-            }
-            
-            auto batch_copy = batch;
-            futures.push_back(
-                thread_pool.enqueue([this, batch_copy, &order_book, &market_updates]() {
-                    process_batch(batch_copy, order_book, market_updates);
-                })
-            );
-        }
-        
-        // Wait for all futures to complete
-        if (debug_mode_) {
-            std::cout << "DEBUG: Waiting for " << futures.size() << " batch processing tasks to complete" << std::endl;
-        }
-        
-        for (auto& f : futures) {
-            f.get();
         }
         
         std::cout << "\nProcessing complete - waiting for strategy to catch up (" 
@@ -271,6 +344,9 @@ public:
         
         // Wait for strategy thread to complete
         strategy_thread.join();
+        if (metrics_) {
+            metrics_->remove_gauge("update_queue");
+        }
         
         // Print performance statistics
         auto end_time = std::chrono::high_resolution_clock::now();
@@ -283,21 +359,17 @@ public:
         std::cout << "Rate: " << (count / (double)elapsed) << " messages per second" << std::endl;
         // Show actual market updates count
         std::cout << "Market updates processed: " << updates_processed.load() << std::endl;
+        if (conflate_) {
+            std::cout << "Market updates conflated: " << market_updates.conflated() << std::endl;
+        }
         
         // Print trading strategy performance
         strategy.print_performance();
     }
     
-private:
-    ThreadPool thread_pool;
-    ParsedMessageQueue& message_queue_;
-    std::string trading_output_dir_;
-    std::vector<std::string> stock_filters_;
-    bool debug_mode_;
-    std::mutex order_book_mutex_;
-    
     void process_batch(
-        const std::vector<json>& messages, 
+        const std::vector<std::string>& messages, 
+        uint32_t feed_stamp,
         hft::OrderBook& order_book,
         MarketUpdateQueue& market_updates
     ) {
@@ -305,73 +377,76 @@ private:
             std::cout << "DEBUG: Processing batch of " << messages.size() << " messages in order book" << std::endl;
         }
         
+        hft::JsonBookMessage decoded;
         for (const auto& message : messages) {
-            std::string message_json = message.dump();
-            
-            // Process message in order book (thread-safe via mutex)
+            // The parser wrote these with JsonWriter, so they always decode
+            hft::JsonDecodeResult result;
             {
-                std::lock_guard<std::mutex> lock(order_book_mutex_);
-                order_book.process_message(message_json);
+                hft::StageTimer timer(metrics_, hft::Stage::JsonDecode);
+                result = hft::decode_json_message(message, decoded);
             }
-            
-            // Extract stock from message
-            std::string stock;
-            if (message.contains("body")) {
-                const auto& body = message["body"];
-                
-                if (body.contains("AddOrder") && body["AddOrder"].contains("stock")) {
-                    stock = body["AddOrder"]["stock"];
-                    // Trim whitespace from stock symbol
-                    stock.erase(0, stock.find_first_not_of(" \t\n\r\f\v"));
-                    stock.erase(stock.find_last_not_of(" \t\n\r\f\v") + 1);
-                }
+            if (result != hft::JsonDecodeResult::Ok) {
+                continue;
             }
             
-            // Update market data and trading strategy if we have a valid stock
-            if (!stock.empty()) {
-                // Skip if we have stock filters and this stock is not in the filter
-                if (!stock_filters_.empty() && 
-                    std::find(stock_filters_.begin(), stock_filters_.end(), stock) == stock_filters_.end()) {
-                    continue;
-                }
-                
-                // Get market data from order book (thread-safe via mutex)
-                double imbalance;
-                std::pair<double, double> best_prices;
-                std::pair<uint32_t, uint32_t> volumes;
-                
-                {
-                    std::lock_guard<std::mutex> lock(order_book_mutex_);
-                    best_prices = order_book.get_best_prices(stock);
-                    volumes = order_book.get_volumes(stock);
-                    imbalance = order_book.get_imbalance(stock);
-                }
-                
-                // Get timestamp
-                uint64_t timestamp = 0;
-                if (message.contains("timestamp")) {
-                    if (message["timestamp"].is_string()) {
-                        timestamp = std::stoull(message["timestamp"].get<std::string>());
-                    } else {
-                        timestamp = message["timestamp"].get<uint64_t>();
-                    }
-                }
-                
-                // Push market update to queue for strategy thread
-                MarketUpdate update{
-                    stock,
-                    best_prices.first,   // bid price
-                    best_prices.second,  // ask price
-                    volumes.first,       // bid volume
-                    volumes.second,      // ask volume
-                    imbalance,           // order book imbalance
-                    timestamp            // timestamp
-                };
-                
-                market_updates.push(update);
-            }
+            apply_and_publish(decoded, decoded.timestamp, feed_stamp, order_book, market_updates);
         }
     }
+    
+    void process_batch(
+        const std::vector<itch::Message>& messages, 
+        uint32_t feed_stamp,
+        hft::OrderBook& order_book,
+        MarketUpdateQueue& market_updates
+    ) {
+        if (debug_mode_ && messages.size() > 0) {
+            std::cout << "DEBUG: Processing batch of " << messages.size() << " messages in order book" << std::endl;
+        }
+        
+        for (const auto& message : messages) {
+            apply_and_publish(message, message.timestamp, feed_stamp, order_book, market_updates);
+        }
+    }
+    
+    // Apply one message and, if it changed a symbol's book (per the book's
+    // ChangeDetection), snapshot that book, publish it to the market data
+    // ring and push it to the strategy thread. Any message type can produce
+    // an update.
+    template <typename Message>
+    void apply_and_publish(
+        const Message& message,
+        uint64_t timestamp,
+        uint32_t feed_stamp,
+        hft::OrderBook& order_book,
+        MarketUpdateQueue& market_updates
+    ) {
+        const hft::SymbolId changed = order_book.apply(message);
+        if (changed == hft::INVALID_SYMBOL) {
+            return;
+        }
+        
+        // Skip if we have stock filters and this stock is not in the filter, unless it is published
+        const bool to_strategy = symbol_filter_.allows(changed, order_book.symbols());
+        if (!to_strategy && !market_data_) {
+            return;
+        }
+        
+        hft::StageTimer timer(metrics_, hft::Stage::UpdateEmit);
+        MarketUpdate update = order_book.get_market_update(changed, timestamp);
+        if (market_data_) {
+            market_data_->publish(update, order_book.symbols().name(changed));
+        }
+        if (!to_strategy) {
+            return;
+        }
+        update.feed_stamp = feed_stamp;
+        
+        // Push market update to queue for strategy thread
+        market_updates.push(update);
+    }
 };
 
+// integrated_processor's pipeline: the liquidity reversion strategy with its tuned parameters compiled in
+using IntegratedProcessor = BasicIntegratedProcessor<>;
+
 } // namespace integrated
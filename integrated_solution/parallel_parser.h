@@ -1,11 +1,17 @@
 #pragma once
 
 #include "../cpp_parser/include/parser.h"
-#include "../cpp_parser/include/json_serializer.h"
-#include "thread_pool.h"
+#include "../cpp_parser/include/json_writer.h"
+#include "../cpp_parser/include/sharded_decoder.h"
+#include "../cpp_parser/include/decompressor.h"
+#include "../cpp_order_book/work_stealing_pool.h"
+#include "../cpp_order_book/metrics.h"
 #include "parsed_message_queue.h"
+#include "reorder_ring.h"
 #include <string>
 #include <vector>
+#include <deque>
+#include <algorithm>
 #include <future>
 #include <chrono>
 #include <iomanip>
@@ -14,24 +20,38 @@ namespace integrated {
 
 class ParallelParser {
 public:
+    static constexpr size_t DEFAULT_BATCH_SIZE = 1024;
+    
+    // JSON mode: messages are serialized on the thread pool
     ParallelParser(
         const std::string& input_file,
         ParsedMessageQueue& message_queue,
         size_t num_threads,
         size_t message_limit = 0,
-        bool debug_mode = false
-    ) : thread_pool(num_threads, debug_mode),
-        input_file_(input_file),
-        message_queue_(message_queue),
-        message_limit_(message_limit),
-        debug_mode_(debug_mode) {
-        
-        if (debug_mode_) {
-            std::cout << "DEBUG: ParallelParser initialized with:" << std::endl
-                      << "  - Input file: " << input_file_ << std::endl
-                      << "  - Threads: " << num_threads << std::endl
-                      << "  - Message limit: " << (message_limit_ > 0 ? std::to_string(message_limit_) : "No limit") << std::endl;
-        }
+        bool debug_mode = false,
+        itch::InputBackend backend = itch::InputBackend::Stream,
+        size_t batch_size = DEFAULT_BATCH_SIZE,
+        size_t decode_threads = 0,
+        const hft::PoolOptions& pool_options = {}
+    ) : ParallelParser(input_file, &message_queue, nullptr, num_threads, message_limit, debug_mode, backend, batch_size, decode_threads, pool_options) {}
+
+    // Binary mode: parsed structs are pushed as-is, with no JSON in between
+    ParallelParser(
+        const std::string& input_file,
+        RawMessageQueue& message_queue,
+        size_t num_threads,
+        size_t message_limit = 0,
+        bool debug_mode = false,
+        itch::InputBackend backend = itch::InputBackend::Stream,
+        size_t batch_size = DEFAULT_BATCH_SIZE,
+        size_t decode_threads = 0,
+        const hft::PoolOptions& pool_options = {}
+    ) : ParallelParser(input_file, nullptr, &message_queue, num_threads, message_limit, debug_mode, backend, batch_size, decode_threads, pool_options) {}
+    
+    // Record decode and serialize latencies; null turns it off. Sharded decode
+    // runs on the decoder's own threads and is not timed.
+    void set_metrics(hft::PipelineMetrics* metrics) {
+        metrics_ = metrics;
     }
     
     void run() {
@@ -47,22 +67,20 @@ public:
                 std::cout << "DEBUG: Creating parser from file: " << input_file_ << std::endl;
             }
             
-            auto parser = itch::Parser::from_file(input_file_);
-            
             // Process messages in batches
-            std::vector<std::future<void>> futures;
+            std::deque<std::future<void>> futures;
             std::vector<itch::Message> batch;
-            size_t batch_size = 100; // Smaller batch size for proof of concept
+            batch.reserve(batch_size_);
             size_t message_count = 0;
             size_t last_report_time = 0;
             auto batch_start_time = std::chrono::high_resolution_clock::now();
             
             if (debug_mode_) {
-                std::cout << "DEBUG: Starting to parse messages with batch size: " << batch_size << std::endl;
+                std::cout << "DEBUG: Starting to parse messages with batch size: " << batch_size_ << std::endl;
             }
             
-            while (auto message = parser->parse_message()) {
-                batch.push_back(*message);
+            // Batch one message; returns false once the message limit is reached
+            auto consume = [&](itch::Message&& message) {
                 message_count++;
                 
                 // Report progress periodically
@@ -80,21 +98,48 @@ public:
                     }
                 }
                 
-                if (batch.size() >= batch_size) {
-                    auto batch_copy = batch;
-                    futures.push_back(
-                        thread_pool.enqueue([this, batch_copy]() {
-                            process_batch(batch_copy);
-                        })
-                    );
-                    batch.clear();
+                batch.push_back(std::move(message));
+                if (batch.size() >= batch_size_) {
+                    dispatch_batch(batch, futures);
                 }
                 
                 if (message_limit_ > 0 && message_count >= message_limit_) {
                     if (debug_mode_) {
                         std::cout << "DEBUG: Reached message limit of " << message_limit_ << ". Stopping." << std::endl;
                     }
-                    break;
+                    return false;
+                }
+                return true;
+            };
+            
+            if (decode_threads_ > 0) {
+                // Sharded decode: chunks come back in file order, so batches stay in feed order
+                itch::Compression format;
+                if (itch::detect_compression(input_file_, format)) {
+                    throw std::runtime_error("Sharded decode needs an uncompressed ITCH file");
+                }
+                itch::ShardedDecoder decoder(std::make_shared<const itch::MappedFile>(input_file_),
+                                             decode_threads_, message_limit_);
+                itch::CompactChunk chunk;
+                bool more = true;
+                while (more && decoder.next_chunk(chunk)) {
+                    for (size_t i = 0; i < chunk.size(); ++i) {
+                        if (!consume(chunk.at(i))) {
+                            more = false;
+                            break;
+                        }
+                    }
+                }
+            } else {
+                auto parser = itch::Parser::open(input_file_, backend_);
+                auto next_message = [&] {
+                    hft::StageTimer timer(metrics_, hft::Stage::Decode);
+                    return parser->parse_message();
+                };
+                while (auto message = next_message()) {
+                    if (!consume(std::move(*message))) {
+                        break;
+                    }
                 }
             }
             
@@ -104,12 +149,7 @@ public:
                     std::cout << "DEBUG: Processing final batch of " << batch.size() << " messages" << std::endl;
                 }
                 
-                auto batch_copy = batch;
-                futures.push_back(
-                    thread_pool.enqueue([this, batch_copy]() {
-                        process_batch(batch_copy);
-                    })
-                );
+                dispatch_batch(batch, futures);
             }
             
             // Wait for all futures to complete
@@ -120,9 +160,10 @@ public:
             for (auto& f : futures) {
                 f.get();
             }
+            reorder_ring_.wait_idle();
             
             // Signal that no more messages will be coming
-            message_queue_.set_done();
+            set_done();
             
             auto end_time = std::chrono::high_resolution_clock::now();
             auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -135,29 +176,118 @@ public:
             
         } catch (const std::exception& e) {
             std::cerr << "ERROR in parser: " << e.what() << std::endl;
-            message_queue_.set_done(); // Signal that we're done in case of error
+            set_done(); // Signal that we're done in case of error
         }
     }
     
 private:
-    ThreadPool thread_pool;
+    // Declared before the pool so it outlives any task still running
+    ReorderRing<std::vector<std::string>> reorder_ring_;
+    hft::WorkStealingPool thread_pool;
     std::string input_file_;
-    ParsedMessageQueue& message_queue_;
+    ParsedMessageQueue* json_queue_;
+    RawMessageQueue* raw_queue_;
     size_t message_limit_;
     bool debug_mode_;
+    itch::InputBackend backend_;
+    size_t batch_size_;
+    size_t decode_threads_;
+    hft::PipelineMetrics* metrics_ = nullptr;
     
-    void process_batch(const std::vector<itch::Message>& messages) {
+    ParallelParser(
+        const std::string& input_file,
+        ParsedMessageQueue* json_queue,
+        RawMessageQueue* raw_queue,
+        size_t num_threads,
+        size_t message_limit,
+        bool debug_mode,
+        itch::InputBackend backend,
+        size_t batch_size,
+        size_t decode_threads,
+        const hft::PoolOptions& pool_options
+    ) : reorder_ring_(std::max<size_t>(2, num_threads * 4)),
+        thread_pool(num_threads, pool_options),
+        input_file_(input_file),
+        json_queue_(json_queue),
+        raw_queue_(raw_queue),
+        message_limit_(message_limit),
+        debug_mode_(debug_mode),
+        backend_(backend),
+        batch_size_(batch_size > 0 ? batch_size : 1),
+        decode_threads_(decode_threads) {
+        
+        if (debug_mode_) {
+            std::cout << "DEBUG: ParallelParser initialized with:" << std::endl
+                      << "  - Input file: " << input_file_ << std::endl
+                      << "  - Mode: " << (raw_queue_ ? "binary" : "JSON") << std::endl
+                      << "  - Backend: " << (backend_ == itch::InputBackend::Mmap ? "mmap" : "stream") << std::endl
+                      << "  - Threads: " << num_threads << std::endl
+                      << "  - Batch size: " << batch_size_ << std::endl
+                      << "  - Decode threads: " << (decode_threads_ > 0 ? std::to_string(decode_threads_) : "sequential") << std::endl
+                      << "  - Message limit: " << (message_limit_ > 0 ? std::to_string(message_limit_) : "No limit") << std::endl;
+        }
+    }
+    
+    void set_done() {
+        if (raw_queue_) {
+            raw_queue_->set_done();
+        } else {
+            json_queue_->set_done();
+        }
+    }
+    
+    // Hand a full batch downstream and start a fresh one
+    void dispatch_batch(std::vector<itch::Message>& batch, std::deque<std::future<void>>& futures) {
+        if (raw_queue_) {
+            // Nothing to serialize, hand the structs straight to the processor
+            raw_queue_->push_batch(batch);
+            return;
+        }
+        
+        // Sequence the batch so the reorder ring can commit it in feed order
+        const uint64_t seq = reorder_ring_.acquire();
+        futures.push_back(
+            thread_pool.submit_batch(std::move(batch), [this, seq](const std::vector<itch::Message>& messages) {
+                process_batch(seq, messages);
+            })
+        );
+        batch = std::vector<itch::Message>();
+        batch.reserve(batch_size_);
+        
+        // At most capacity() batches are in flight, so older tasks are already done
+        while (futures.size() > reorder_ring_.capacity()) {
+            futures.front().get();
+            futures.pop_front();
+        }
+    }
+    
+    void process_batch(uint64_t seq, const std::vector<itch::Message>& messages) {
         if (debug_mode_ && messages.size() > 0) {
-            std::cout << "DEBUG: Processing batch of " << messages.size() << " messages" << std::endl;
+            std::cout << "DEBUG: Processing batch " << seq << " of " << messages.size() << " messages" << std::endl;
         }
         
-        for (const auto& message : messages) {
-            // Convert to JSON
-            json json_message = itch::JsonSerializer::to_json(message);
-            
-            // Push to queue
-            message_queue_.push(json_message);
+        auto commit = [this](std::vector<std::string>& batch) {
+            json_queue_->push_batch(batch);
+        };
+        
+        std::vector<std::string> json_messages;
+        json_messages.reserve(messages.size());
+        try {
+            // Convert to JSON text in one reused buffer
+            itch::JsonWriter writer;
+            for (const auto& message : messages) {
+                hft::StageTimer timer(metrics_, hft::Stage::Serialize);
+                writer.clear();
+                writer.write(message);
+                json_messages.emplace_back(writer.view());
+            }
+        } catch (...) {
+            // Still release the slot so later batches aren't blocked forever
+            reorder_ring_.publish(seq, std::vector<std::string>(), commit);
+            throw;
         }
+        
+        reorder_ring_.publish(seq, std::move(json_messages), commit);
     }
 };
 
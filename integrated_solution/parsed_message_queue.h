@@ -1,55 +1,55 @@
 #pragma once
 
-#include <nlohmann/json.hpp>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
+#include "../cpp_parser/include/message.h"
+#include "../cpp_order_book/ring_queue.h"
+#include <string>
+#include <vector>
 #include <atomic>
 #include <iostream>
 
-using json = nlohmann::json;
-
 namespace integrated {
 
-// Thread-safe queue for parsed ITCH messages
-class ParsedMessageQueue {
+// Queue of parsed ITCH messages between the parser and the processor. The
+// parser side is a single producer at a time (the parser thread, or whichever
+// worker is committing the reorder ring), so the lock-free SPSC ring is the default.
+template <typename T>
+class MessageQueue {
 public:
-    ParsedMessageQueue(bool debug_mode = false) : debug_mode_(debug_mode), message_count_(0) {
+    MessageQueue(bool debug_mode = false,
+                 hft::QueueKind kind = hft::QueueKind::Spsc,
+                 size_t capacity = hft::ConcurrentQueue<T>::DEFAULT_CAPACITY)
+        : queue_(kind, capacity), debug_mode_(debug_mode), message_count_(0) {
         if (debug_mode_) {
-            std::cout << "DEBUG: ParsedMessageQueue initialized" << std::endl;
+            std::cout << "DEBUG: ParsedMessageQueue initialized (" << hft::queue_kind_name(kind)
+                      << ", capacity " << queue_.capacity() << ")" << std::endl;
         }
     }
     
-    void push(const json& message) {
-        std::unique_lock<std::mutex> lock(mutex_);
+    void push(const T& message) {
         queue_.push(message);
-        message_count_++;
-        
-        if (debug_mode_ && message_count_ % 10000 == 0) {
-            std::cout << "DEBUG: Queue pushed message #" << message_count_ 
-                      << ", current queue size: " << queue_.size() << std::endl;
-        }
-        
-        lock.unlock();
-        condition_.notify_one();
+        on_push(1);
     }
     
-    bool pop(json& message) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        condition_.wait(lock, [this] { 
-            return !queue_.empty() || is_done_; 
-        });
-        
-        if (queue_.empty() && is_done_) {
+    void push(T&& message) {
+        queue_.push(std::move(message));
+        on_push(1);
+    }
+    
+    // Push a whole batch with a single wakeup, preserving its order
+    void push_batch(std::vector<T>& messages) {
+        const size_t count = messages.size();
+        queue_.push_batch(messages);
+        on_push(count);
+    }
+    
+    bool pop(T& message) {
+        if (!queue_.pop(message)) {
             if (debug_mode_) {
                 std::cout << "DEBUG: Queue is empty and marked as done, signaling consumer to exit" << std::endl;
             }
             return false; // Signal consumer to exit
         }
         
-        message = queue_.front();
-        queue_.pop();
-        
         if (debug_mode_ && pop_count_ % 10000 == 0) {
             std::cout << "DEBUG: Queue popped message #" << pop_count_ 
                       << ", remaining queue size: " << queue_.size() << std::endl;
@@ -59,18 +59,26 @@ public:
         return true;
     }
     
+    // Replace messages with up to max queued messages; 0 once done and drained
+    size_t pop_batch(std::vector<T>& messages, size_t max) {
+        const size_t count = queue_.pop_batch(messages, max);
+        pop_count_ += count;
+        return count;
+    }
+    
+    // Spin instead of sleeping while the queue is empty; call on the consumer before its first pop
+    void set_consumer_busy_poll(bool busy_poll) {
+        queue_.set_consumer_busy_poll(busy_poll);
+    }
+    
     void set_done() {
-        std::unique_lock<std::mutex> lock(mutex_);
-        is_done_ = true;
+        queue_.set_done();
         if (debug_mode_) {
             std::cout << "DEBUG: Queue marked as done, total messages: " << message_count_ << std::endl;
         }
-        lock.unlock();
-        condition_.notify_all();
     }
     
-    size_t size() {
-        std::lock_guard<std::mutex> lock(mutex_);
+    size_t size() const {
         return queue_.size();
     }
     
@@ -78,14 +86,31 @@ public:
         return message_count_;
     }
     
+    hft::QueueKind kind() const {
+        return queue_.kind();
+    }
+
 private:
-    std::queue<json> queue_;
-    std::mutex mutex_;
-    std::condition_variable condition_;
-    bool is_done_ = false;
+    hft::ConcurrentQueue<T> queue_;
     bool debug_mode_ = false;
-    size_t message_count_ = 0;
-    size_t pop_count_ = 0;
+    std::atomic<size_t> message_count_;
+    size_t pop_count_ = 0;  // Consumer thread only
+    
+    // Called on the producing thread
+    void on_push(size_t count) {
+        const size_t before = message_count_.fetch_add(count, std::memory_order_relaxed);
+        
+        if (debug_mode_ && (before + count) / 10000 != before / 10000) {
+            std::cout << "DEBUG: Queue pushed message #" << before + count 
+                      << ", current queue size: " << queue_.size() << std::endl;
+        }
+    }
 };
 
+// JSON text of each message (itch::JsonWriter), used when JSON output is actually wanted
+using ParsedMessageQueue = MessageQueue<std::string>;
+
+// Parsed ITCH structs, applied straight to the order book
+using RawMessageQueue = MessageQueue<itch::Message>;
+
 } // namespace integrated
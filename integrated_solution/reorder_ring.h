@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <utility>
+
+namespace integrated {
+
+// Ring of batch slots that lets workers finish out of order while
+// results are committed strictly in sequence order.
+//
+// The producer takes a sequence number with acquire() (blocking while the
+// ring is full), hands the batch to a worker, and the worker calls
+// publish() with its result. Whichever publisher finds the next expected
+// sequence ready becomes the committer and drains every consecutive ready
+// slot, calling commit() outside the lock, one batch at a time, in order.
+template <typename T>
+class ReorderRing {
+public:
+    explicit ReorderRing(size_t capacity) : slots_(capacity > 0 ? capacity : 1) {}
+
+    // Reserve the next sequence number, waiting until its slot is free
+    uint64_t acquire() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        slot_free_.wait(lock, [this] { return next_seq_ - commit_seq_ < slots_.size(); });
+        return next_seq_++;
+    }
+
+    // Store the result for seq and commit any batches that are now in order
+    template <typename Commit>
+    void publish(uint64_t seq, T&& value, Commit&& commit) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        Slot& slot = slots_[seq % slots_.size()];
+        slot.value = std::move(value);
+        slot.ready = true;
+
+        // Another thread is already draining, it will pick this slot up
+        if (committing_) {
+            return;
+        }
+        committing_ = true;
+
+        while (true) {
+            Slot& next = slots_[commit_seq_ % slots_.size()];
+            if (!next.ready) {
+                break;
+            }
+            T batch = std::move(next.value);
+            next.ready = false;
+
+            lock.unlock();
+            commit(batch);
+            lock.lock();
+
+            commit_seq_++;
+            slot_free_.notify_all();
+        }
+
+        committing_ = false;
+        if (commit_seq_ == next_seq_) {
+            idle_.notify_all();
+        }
+    }
+
+    // Wait until every acquired sequence number has been committed
+    void wait_idle() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return commit_seq_ == next_seq_ && !committing_; });
+    }
+
+    size_t capacity() const {
+        return slots_.size();
+    }
+
+private:
+    struct Slot {
+        T value;
+        bool ready = false;
+    };
+
+    std::vector<Slot> slots_;
+    uint64_t next_seq_ = 0;   // Next sequence number handed out
+    uint64_t commit_seq_ = 0; // Next sequence number to commit
+    bool committing_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable slot_free_;
+    std::condition_variable idle_;
+};
+
+} // namespace integrated
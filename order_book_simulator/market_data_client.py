@@ -0,0 +1,278 @@
+#!/usr/bin/env python3
+"""
+Subscriber for the C++ market data publisher (integrated_processor
+--publish-shm / --publish-port), replacing the gRPC MarketDataService.
+
+Both transports carry the same fixed 56-byte little-endian records
+(MarketDataRecord in cpp_order_book/market_data.h): a snapshot of every
+subscribed symbol, a SnapshotEnd marker, then deltas as books change.
+A subscriber that falls behind is sent a fresh snapshot instead of a
+backlog, so the latest state per symbol is always correct.
+
+    client = TcpMarketDataClient("localhost", 9100, ["AAPL", "MSFT"])
+    for update in client.updates():
+        print(update.symbol, update.bid_price, update.ask_price)
+
+    reader = SharedMemoryMarketDataReader("nasdaq_md")  # same host
+    while True:
+        for update in reader.poll():
+            ...
+"""
+import argparse
+import mmap
+import os
+import socket
+import struct
+import time
+from dataclasses import dataclass
+from typing import Dict, Iterator, List, Optional
+
+# MarketDataRecord: sequence, kind, count, symbol, then the MarketUpdate
+# (timestamp, bid/ask price and volume, symbol id, feed stamp)
+RECORD = struct.Struct("<QB3xI8sQIIIIH2xI")
+assert RECORD.size == 56
+
+DELTA, SNAPSHOT, SNAPSHOT_END, HEARTBEAT = 1, 2, 3, 4
+KIND_NAMES = {DELTA: "delta", SNAPSHOT: "snapshot", SNAPSHOT_END: "snapshot_end", HEARTBEAT: "heartbeat"}
+
+# MarketDataRing layout: a 128-byte header, then 64-byte slots (an 8-byte
+# stamp and a record), `capacity` ring slots followed by one per symbol id
+RING_HEADER = struct.Struct("<8sIIQQ")
+RING_MAGIC = b"HFTMDRNG"
+RING_HEADER_SIZE = 128
+LAST_SEQUENCE_OFFSET = 64
+SLOT_SIZE = 64
+BUSY = 2**64 - 1
+# Tries for a state slot that is busy or changing before treating it as
+# absent: one left busy belongs to a publisher that died mid-write
+STATE_READ_ATTEMPTS = 10000
+
+
+@dataclass
+class MarketDataUpdate:
+    """One record, with prices in dollars."""
+    kind: str
+    sequence: int
+    symbol: str
+    symbol_id: int
+    timestamp: int
+    bid_price: float
+    ask_price: float
+    bid_volume: int
+    ask_volume: int
+    count: int = 0
+
+    @property
+    def mid_price(self) -> float:
+        return (self.bid_price + self.ask_price) / 2.0
+
+    @property
+    def spread(self) -> float:
+        return self.ask_price - self.bid_price
+
+    @property
+    def imbalance(self) -> float:
+        """Bid share of the resting volume, as the C++ strategy computes it."""
+        total = self.bid_volume + self.ask_volume
+        return self.bid_volume / total if total else 0.0
+
+
+def decode_record(data: bytes, offset: int = 0) -> MarketDataUpdate:
+    (sequence, kind, count, symbol, timestamp, bid_price, ask_price,
+     bid_volume, ask_volume, symbol_id, _feed_stamp) = RECORD.unpack_from(data, offset)
+    return MarketDataUpdate(
+        kind=KIND_NAMES.get(kind, str(kind)),
+        sequence=sequence,
+        symbol=symbol.rstrip(b"\0").decode("ascii", "replace"),
+        symbol_id=symbol_id,
+        timestamp=timestamp,
+        bid_price=bid_price / 10000.0,
+        ask_price=ask_price / 10000.0,
+        bid_volume=bid_volume,
+        ask_volume=ask_volume,
+        count=count,
+    )
+
+
+class TcpMarketDataClient:
+    """
+    Remote subscriber. `books` holds the latest update per symbol once the
+    first snapshot has arrived.
+    """
+
+    def __init__(self, host: str, port: int, symbols: Optional[List[str]] = None):
+        self.sock = socket.create_connection((host, port))
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.books: Dict[str, MarketDataUpdate] = {}
+        self.sequence = 0
+        self.snapshots = 0
+        self._buffer = b""
+        self.subscribe(symbols or [])
+
+    def subscribe(self, symbols: List[str]):
+        """Replace the symbol filter (empty means all); a new snapshot follows."""
+        request = b"MDSB" + struct.pack("<I", len(symbols))
+        request += b"".join(symbol.encode("ascii")[:8].ljust(8, b"\0") for symbol in symbols)
+        self.sock.sendall(request)
+
+    def updates(self, include_snapshots: bool = True) -> Iterator[MarketDataUpdate]:
+        """Yield records as they arrive, keeping `books` current. Ends when the server closes."""
+        while True:
+            chunk = self.sock.recv(1 << 16)
+            if not chunk:
+                return
+            self._buffer += chunk
+            whole = len(self._buffer) - len(self._buffer) % RECORD.size
+            for offset in range(0, whole, RECORD.size):
+                update = decode_record(self._buffer, offset)
+                if self._apply(update) and (include_snapshots or update.kind == "delta"):
+                    yield update
+            self._buffer = self._buffer[whole:]
+
+    def _apply(self, update: MarketDataUpdate) -> bool:
+        if update.kind == "snapshot_end":
+            self.sequence = update.sequence
+            self.snapshots += 1
+            return False
+        if update.kind == "heartbeat":
+            return False
+        if update.kind == "delta":
+            self.sequence = update.sequence
+        self.books[update.symbol] = update
+        return True
+
+    def close(self):
+        self.sock.close()
+
+
+class SharedMemoryMarketDataReader:
+    """
+    Local subscriber reading /dev/shm/<name> directly, with the same
+    snapshot-plus-delta recovery as the C++ MarketDataReader.
+    """
+
+    def __init__(self, name: str, symbols: Optional[List[str]] = None):
+        path = os.path.join("/dev/shm", name.lstrip("/"))
+        with open(path, "rb") as f:
+            self.map = mmap.mmap(f.fileno(), 0, prot=mmap.PROT_READ)
+        magic, version, record_size, capacity, symbol_slots = RING_HEADER.unpack_from(self.map, 0)
+        if magic != RING_MAGIC or version != 1 or record_size != RECORD.size:
+            raise ValueError(f"{path} is not a market data ring")
+        self.capacity = capacity
+        self.symbol_slots = symbol_slots
+        self.symbols = set(symbols or [])
+        self.books: Dict[str, MarketDataUpdate] = {}
+        self.next_sequence = 1
+        self.recoveries = 0
+        self._snapshot_sequence: Dict[int, int] = {}
+        self._needs_snapshot = True
+
+    def last_sequence(self) -> int:
+        return struct.unpack_from("<Q", self.map, LAST_SEQUENCE_OFFSET)[0]
+
+    def _read_slot(self, index: int) -> Optional[tuple]:
+        """(stamp, record bytes), or None if the slot is busy or kept changing under us."""
+        offset = RING_HEADER_SIZE + index * SLOT_SIZE
+        for _ in range(STATE_READ_ATTEMPTS):
+            stamp = struct.unpack_from("<Q", self.map, offset)[0]
+            if stamp == BUSY:
+                return None
+            data = self.map[offset + 8:offset + 8 + RECORD.size]
+            if struct.unpack_from("<Q", self.map, offset)[0] == stamp:
+                return stamp, data
+        return None
+
+    def _wanted(self, update: MarketDataUpdate) -> bool:
+        return not self.symbols or update.symbol in self.symbols
+
+    def snapshot(self) -> List[MarketDataUpdate]:
+        resume = self.last_sequence()
+        updates = []
+        self._snapshot_sequence = {}
+        for symbol_id in range(1, self.symbol_slots):
+            slot = None
+            for _ in range(STATE_READ_ATTEMPTS):
+                slot = self._read_slot(self.capacity + symbol_id)
+                if slot is not None:
+                    break
+            if slot is None:
+                continue  # Stuck busy: the publisher stopped mid-write
+            stamp, data = slot
+            if stamp == 0:
+                continue
+            update = decode_record(data)
+            if not self._wanted(update):
+                continue
+            update.kind = "snapshot"
+            self._snapshot_sequence[symbol_id] = update.sequence
+            self.books[update.symbol] = update
+            updates.append(update)
+        self.next_sequence = resume + 1
+        self._needs_snapshot = False
+        return updates
+
+    def poll(self, max_updates: int = 4096) -> List[MarketDataUpdate]:
+        """Deltas since the last poll, or a snapshot if this is the first call or the ring lapped us."""
+        updates = self.snapshot() if self._needs_snapshot else []
+        while len(updates) < max_updates:
+            sequence = self.next_sequence
+            if sequence > self.last_sequence():
+                break
+            slot = self._read_slot((sequence - 1) % self.capacity)
+            if slot is None or slot[0] != sequence:
+                self.recoveries += 1
+                updates.extend(self.snapshot())
+                continue
+            self.next_sequence += 1
+            update = decode_record(slot[1])
+            if update.sequence <= self._snapshot_sequence.get(update.symbol_id, 0) or not self._wanted(update):
+                continue
+            self.books[update.symbol] = update
+            updates.append(update)
+        return updates
+
+    def close(self):
+        self.map.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Print market data from the C++ publisher")
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--shm", help="Shared-memory ring name (integrated_processor --publish-shm)")
+    source.add_argument("--tcp", help="HOST:PORT of integrated_processor --publish-port")
+    parser.add_argument("symbols", nargs="*", help="Symbols to follow (default: all)")
+    parser.add_argument("--summary", action="store_true", help="Only print counts when the stream ends")
+    args = parser.parse_args()
+
+    count = 0
+    if args.tcp:
+        host, port = args.tcp.rsplit(":", 1)
+        client = TcpMarketDataClient(host, int(port), args.symbols)
+        try:
+            for update in client.updates():
+                count += 1
+                if not args.summary:
+                    print(update)
+        except KeyboardInterrupt:
+            pass
+        print(f"{count} records, {client.snapshots} snapshots, {len(client.books)} symbols, "
+              f"last sequence {client.sequence}")
+        return
+
+    reader = SharedMemoryMarketDataReader(args.shm, args.symbols)
+    try:
+        while True:
+            updates = reader.poll()
+            count += len(updates)
+            if not args.summary:
+                for update in updates:
+                    print(update)
+            if not updates:
+                time.sleep(0.001)
+    except KeyboardInterrupt:
+        pass
+    print(f"{count} records, {reader.recoveries} recoveries, {len(reader.books)} symbols")
+
+
+if __name__ == "__main__":
+    main()